@@ -598,6 +598,7 @@ namespace FIFFLIB
 //
 #define FIFF_MNE_RT_COMMAND         3700              /**< Fiff Real-Time Command */
 #define FIFF_MNE_RT_CLIENT_ID       3701              /**< Fiff Real-Time mne_t_server client id */
+#define FIFF_MNE_RT_TIMESTAMP       3702              /**< Fiff Real-Time monotonic clock time [ns] at which mne_rt_server received the following data buffer from its connector */
 
 //
 // 3710... Real-Time Blocks
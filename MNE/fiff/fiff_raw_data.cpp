@@ -42,6 +42,7 @@
 #include "fiff_tag.h"
 #include "fiff_stream.h"
 #include "cstdlib"
+#include <string.h>
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -51,6 +52,112 @@
 using namespace FIFFLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Reads a raw data value which is either stored in big endian byte order (file mapping) or already in host byte
+* order (converted tag data).
+*/
+template<typename _Tp, bool bBigEndian>
+inline double rawValue(const uchar* p)
+{
+    _Tp value;
+    if(bBigEndian)
+    {
+        uchar t_swap[sizeof(_Tp)];
+        for(size_t b = 0; b < sizeof(_Tp); ++b)
+            t_swap[b] = p[sizeof(_Tp) - 1 - b];
+        memcpy(&value, t_swap, sizeof(_Tp));
+    }
+    else
+        memcpy(&value, p, sizeof(_Tp));
+    return (double)value;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp, bool bBigEndian>
+void decodeRawSamples(const uchar* p_pSrc, qint32 p_iNChan, qint32 p_iFirstPick, qint32 p_iPickSamp,
+                      const VectorXi& p_vecPicks, const VectorXd& p_vecCal, MatrixXd& p_matDest, qint32 p_iDestCol)
+{
+    const qint32 t_iRows = p_vecPicks.size();
+    for(qint32 s = 0; s < p_iPickSamp; ++s)
+    {
+        const uchar* t_pSample = p_pSrc + (qint64)(p_iFirstPick + s) * p_iNChan * sizeof(_Tp);
+        double* t_pDest = p_matDest.data() + (qint64)(p_iDestCol + s) * p_matDest.rows();
+        for(qint32 r = 0; r < t_iRows; ++r)
+            t_pDest[r] = p_vecCal[r] * rawValue<_Tp, bBigEndian>(t_pSample + p_vecPicks[r] * sizeof(_Tp));
+    }
+}
+
+
+//*************************************************************************************************************
+/**
+* Decodes the samples [p_iFirstPick, p_iFirstPick + p_iPickSamp) of a raw data buffer (channel fastest), picks
+* the rows p_vecPicks, multiplies them by p_vecCal and writes them to p_matDest starting at column p_iDestCol.
+*
+* @return false if the data type is not supported.
+*/
+bool decodeRawBuffer(fiff_int_t p_iType, bool p_bBigEndian, const uchar* p_pSrc, qint32 p_iNChan, qint32 p_iFirstPick, qint32 p_iPickSamp,
+                     const VectorXi& p_vecPicks, const VectorXd& p_vecCal, MatrixXd& p_matDest, qint32 p_iDestCol)
+{
+    switch(p_iType)
+    {
+        case FIFFT_DAU_PACK16:
+        case FIFFT_SHORT:
+            if(p_bBigEndian)
+                decodeRawSamples<qint16, true>(p_pSrc, p_iNChan, p_iFirstPick, p_iPickSamp, p_vecPicks, p_vecCal, p_matDest, p_iDestCol);
+            else
+                decodeRawSamples<qint16, false>(p_pSrc, p_iNChan, p_iFirstPick, p_iPickSamp, p_vecPicks, p_vecCal, p_matDest, p_iDestCol);
+            return true;
+        case FIFFT_INT:
+            if(p_bBigEndian)
+                decodeRawSamples<qint32, true>(p_pSrc, p_iNChan, p_iFirstPick, p_iPickSamp, p_vecPicks, p_vecCal, p_matDest, p_iDestCol);
+            else
+                decodeRawSamples<qint32, false>(p_pSrc, p_iNChan, p_iFirstPick, p_iPickSamp, p_vecPicks, p_vecCal, p_matDest, p_iDestCol);
+            return true;
+        case FIFFT_FLOAT:
+            if(p_bBigEndian)
+                decodeRawSamples<float, true>(p_pSrc, p_iNChan, p_iFirstPick, p_iPickSamp, p_vecPicks, p_vecCal, p_matDest, p_iDestCol);
+            else
+                decodeRawSamples<float, false>(p_pSrc, p_iNChan, p_iFirstPick, p_iPickSamp, p_vecPicks, p_vecCal, p_matDest, p_iDestCol);
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+//*************************************************************************************************************
+/**
+* Returns the index of the first raw directory entry which ends at or after the given sample (binary search).
+*/
+qint32 lowerRawDirBound(const QList<FiffRawDir>& p_qListRawDir, fiff_int_t p_iSample)
+{
+    qint32 lo = 0;
+    qint32 hi = p_qListRawDir.size();
+    while(lo < hi)
+    {
+        qint32 mid = lo + (hi - lo) / 2;
+        if(p_qListRawDir[mid].last < p_iSample)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+} // NAMESPACE
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -146,100 +253,43 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
     }
     printf("Reading %d ... %d  =  %9.3f ... %9.3f secs...", from, to, ((float)from)/this->info.sfreq, ((float)to)/this->info.sfreq);
     //
-    //  Initialize the data and calibration vector
+    //  Initialize the data, the channel picks and the calibration vector
     //
     qint32 nchan = this->info.nchan;
+    qint32 nrows = sel.size() > 0 ? sel.size() : nchan;
     qint32 dest  = 0;//1;
-    qint32 i, k, r;
-
-    typedef Eigen::Triplet<double> T;
-    std::vector<T> tripletList;
-    tripletList.reserve(nchan);
-    for(i = 0; i < nchan; ++i)
-        tripletList.push_back(T(i, i, this->cals[i]));
+    qint32 i, k;
 
-    SparseMatrix<double> cal(nchan, nchan);
-    cal.setFromTriplets(tripletList.begin(), tripletList.end());
-//    cal.makeCompressed();
-
-    MatrixXd mult_full;
-    //
-    if (sel.size() == 0)
+    VectorXi picks(nrows);
+    VectorXd cal(nrows);
+    for(i = 0; i < nrows; ++i)
     {
-        data = MatrixXd(nchan, to-from+1);
-//            data->setZero();
-        if (projAvailable || this->comp.kind != -1)
-        {
-            if (!projAvailable)
-                mult_full = this->comp.data->data*cal;
-            else if (this->comp.kind == -1)
-                mult_full = this->proj*cal;
-            else
-                mult_full = this->proj*this->comp.data->data*cal;
-        }
+        picks[i] = sel.size() > 0 ? sel[i] : i;
+        cal[i] = this->cals[picks[i]];
     }
-    else
-    {
-        data = MatrixXd(sel.size(),to-from+1);
-//            data->setZero();
 
-        MatrixXd selVect(sel.size(), nchan);
+    data = MatrixXd(nrows, to-from+1);
 
-        selVect.setZero();
-
-        if (!projAvailable && this->comp.kind == -1)
-        {
-            tripletList.clear();
-            tripletList.reserve(sel.size());
-            for(i = 0; i < sel.size(); ++i)
-                tripletList.push_back(T(i, i, this->cals[sel[i]]));
-            cal = SparseMatrix<double>(sel.size(), sel.size());
-            cal.setFromTriplets(tripletList.begin(), tripletList.end());
-        }
-        else
-        {
-            if (!projAvailable)
-            {
-                qDebug() << "This has to be debugged! #1";
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->comp.data->data.block(sel[i],0,1,nchan);
-                mult_full = selVect*cal;
-            }
-            else if (this->comp.kind == -1)
-            {
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
-
-                mult_full = selVect*cal;
-            }
-            else
-            {
-                qDebug() << "This has to be debugged! #3";
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
-
-                mult_full = selVect*this->comp.data->data*cal;
-            }
-        }
-    }
-
-    bool do_debug = false;
     //
-    // Make mult sparse
+    //  Projection and compensation are applied to the calibrated data of all channels
+    //  -> combine picks, operator and calibration into one matrix
     //
-    tripletList.clear();
-    tripletList.reserve(mult_full.rows()*mult_full.cols());
-    for(i = 0; i < mult_full.rows(); ++i)
-        for(k = 0; k < mult_full.cols(); ++k)
-            if(mult_full(i,k) != 0)
-                tripletList.push_back(T(i, k, mult_full(i,k)));
-
-    SparseMatrix<double> mult(mult_full.rows(),mult_full.cols());
-    if(tripletList.size() > 0)
-        mult.setFromTriplets(tripletList.begin(), tripletList.end());
-//    mult.makeCompressed();
+    MatrixXd mult;
+    if (projAvailable || this->comp.kind != -1)
+    {
+        MatrixXd op;
+        if (!projAvailable)
+            op = this->comp.data->data;
+        else if (this->comp.kind == -1)
+            op = this->proj;
+        else
+            op = this->proj*this->comp.data->data;
 
-    //
+        mult.resize(nrows, nchan);
+        for(i = 0; i < nrows; ++i)
+            mult.row(i) = op.row(picks[i]);
+        mult.array().rowwise() *= this->cals.array();
+    }
 
     FiffStream::SPtr fid;
     if (!this->file->device()->isOpen())
@@ -255,165 +305,105 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
         fid = this->file;
     }
 
+    //
+    //  Binary search for the first and the last buffer we need
+    //
+    qint32 k_first = lowerRawDirBound(this->rawdir, from);
+    qint32 k_last = qMin(lowerRawDirBound(this->rawdir, to), this->rawdir.size() - 1);
+
+    //
+    //  Map the file range of the needed buffers - data are decoded straight from the mapping.
+    //  Devices which can't be mapped fall back to reading tag by tag.
+    //
+    QFile* t_pFile = qobject_cast<QFile*>(fid->device());
+    uchar* t_pMap = NULL;
+    qint64 t_iMapStart = -1;
+    qint64 t_iMapEnd = -1;
+    for(k = k_first; k <= k_last && t_pFile; ++k)
+    {
+        const FiffDirEntry& ent = this->rawdir[k].ent;
+        if(ent.kind != -1)
+        {
+            if(t_iMapStart < 0)
+                t_iMapStart = ent.pos;
+            t_iMapEnd = (qint64)ent.pos + FIFFC_DATA_OFFSET + ent.size;
+        }
+    }
+    if(t_pFile && t_iMapStart >= 0)
+        t_pMap = t_pFile->map(t_iMapStart, t_iMapEnd - t_iMapStart);
+
+    VectorXi allPicks;
+    VectorXd ones;
     MatrixXd one;
+    if(mult.size() > 0)
+    {
+        allPicks = VectorXi::LinSpaced(nchan, 0, nchan - 1);
+        ones = VectorXd::Ones(nchan);
+    }
+
     fiff_int_t first_pick, last_pick, picksamp;
-    for(k = 0; k < this->rawdir.size(); ++k)
+    for(k = k_first; k < this->rawdir.size(); ++k)
     {
-        FiffRawDir thisRawDir = this->rawdir[k];
+        const FiffRawDir& thisRawDir = this->rawdir[k];
         //
-        //  Do we need this buffer
+        //  The part of the buffer we need
         //
-        if (thisRawDir.last > from)
+        first_pick = qMax(from, thisRawDir.first) - thisRawDir.first;
+        last_pick  = qMin(to, thisRawDir.last) - thisRawDir.first;
+        picksamp = last_pick - first_pick + 1;
+
+        if (picksamp > 0)
         {
             if (thisRawDir.ent.kind == -1)
             {
                 //
                 //  Take the easy route: skip is translated to zeros
                 //
-                if(do_debug)
-                    printf("S");
-                if (sel.cols() <= 0)
-                    one.resize(nchan,thisRawDir.nsamp);
-                else
-                    one.resize(sel.cols(),thisRawDir.nsamp);
-
-                one.setZero();
+                data.block(0,dest,nrows,picksamp).setZero();
             }
             else
             {
+                const uchar* t_pSrc;
+                fiff_int_t t_iType;
+                bool t_bBigEndian;
                 FiffTag::SPtr t_pTag;
-                FiffTag::read_tag(fid.data(), t_pTag, thisRawDir.ent.pos);
-                //
-                //   Depending on the state of the projection and selection
-                //   we proceed a little bit differently
-                //
-                if (mult.cols() == 0)
+                if(t_pMap)
                 {
-                    if (sel.cols() == 0)
-                    {
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                            one = cal*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_INT)
-                            one = cal*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                            one = cal*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else
-                            printf("Data Storage Format not known jet [1]!! Type: %d\n", t_pTag->type);
-                    }
-                    else
-                    {
-
-                        //ToDo find a faster solution for this!! --> make cal and mul sparse like in MATLAB
-                        MatrixXd newData(sel.cols(), thisRawDir.nsamp); //ToDo this can be done much faster, without newData
-
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixDau16 > ( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_INT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXf > ( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else
-                        {
-                            printf("Data Storage Format not known jet [2]!! Type: %d\n", t_pTag->type);
-                        }
-
-                        one = cal*newData;
-                    }
+                    t_pSrc = t_pMap + ((qint64)thisRawDir.ent.pos + FIFFC_DATA_OFFSET - t_iMapStart);
+                    t_iType = thisRawDir.ent.type;
+                    t_bBigEndian = true;
                 }
                 else
                 {
-                    if (t_pTag->type == FIFFT_DAU_PACK16)
-                        one = mult*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_INT)
-                        one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_FLOAT)
-                        one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else
-                        printf("Data Storage Format not known jet [3]!! Type: %d\n", t_pTag->type);
+                    FiffTag::read_tag(fid.data(), t_pTag, thisRawDir.ent.pos);
+                    t_pSrc = (const uchar*)t_pTag->data();
+                    t_iType = t_pTag->type;
+                    t_bBigEndian = false;
                 }
-            }
-            //
-            //  The picking logic is a bit complicated
-            //
-            if (to >= thisRawDir.last && from <= thisRawDir.first)
-            {
-                //
-                //  We need the whole buffer
-                //
-                first_pick = 0;//1;
-                last_pick  = thisRawDir.nsamp - 1;
-                if (do_debug)
-                    printf("W");
-            }
-            else if (from > thisRawDir.first)
-            {
-                first_pick = from - thisRawDir.first;// + 1;
-                if(to < thisRawDir.last)
+
+                bool t_bKnownType;
+                if (mult.size() == 0)
                 {
                     //
-                    //  Something from the middle
+                    //  Decode, pick and calibrate in one pass straight into the output
                     //
-//                    qDebug() << "This needs to be debugged!";
-                    last_pick = thisRawDir.nsamp + to - thisRawDir.last - 1;//is this alright?
-                    if (do_debug)
-                        printf("M");
+                    t_bKnownType = decodeRawBuffer(t_iType, t_bBigEndian, t_pSrc, nchan, first_pick, picksamp, picks, cal, data, dest);
                 }
                 else
                 {
                     //
-                    //  From the middle to the end
+                    //  Decode the picked samples of all channels and apply the operator in one product
                     //
-                    last_pick = thisRawDir.nsamp - 1;
-                    if (do_debug)
-                        printf("E");
+                    one.resize(nchan, picksamp);
+                    t_bKnownType = decodeRawBuffer(t_iType, t_bBigEndian, t_pSrc, nchan, first_pick, picksamp, allPicks, ones, one, 0);
+                    data.block(0,dest,nrows,picksamp).noalias() = mult*one;
                 }
-            }
-            else
-            {
-                //
-                //  From the beginning to the middle
-                //
-                first_pick = 0;//1;
-                last_pick  = to - thisRawDir.first;// + 1;
-                if (do_debug)
-                    printf("B");
-            }
-            //
-            //  Now we are ready to pick
-            //
-            picksamp = last_pick - first_pick + 1;
 
-            if(do_debug)
-            {
-                qDebug() << "first_pick: " << first_pick;
-                qDebug() << "last_pick: " << last_pick;
-                qDebug() << "picksamp: " << picksamp;
+                if(!t_bKnownType)
+                    printf("Data Storage Format not known jet!! Type: %d\n", t_iType);
             }
 
-            if (picksamp > 0)
-            {
-//                    for(r = 0; r < data->rows(); ++r)
-//                        for(c = 0; c < picksamp; ++c)
-//                            (*data)(r,dest + c) = one(r,first_pick + c);
-                data.block(0,dest,data.rows(),picksamp) = one.block(0, first_pick, data.rows(), picksamp);
-
-                dest += picksamp;
-            }
+            dest += picksamp;
         }
         //
         //  Done?
@@ -425,7 +415,8 @@ bool FiffRawData::read_raw_segment(MatrixXd& data, MatrixXd& times, fiff_int_t f
         }
     }
 
-//        fclose(fid);
+    if(t_pMap)
+        t_pFile->unmap(t_pMap);
 
     times = MatrixXd(1, to-from+1);
 
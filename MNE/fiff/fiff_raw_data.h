@@ -146,7 +146,8 @@ public:
     /**
     * ### MNE toolbox root function ###: Implementation of the fiff_read_raw_segment function
     *
-    * Read a specific raw data segment
+    * Read a specific raw data segment. The needed buffers are located by binary search in the raw directory and,
+    * when the data are stored in a file, decoded straight from a memory mapping of the file.
     *
     * @param[out] data      returns the data matrix (channels x samples)
     * @param[out] times     returns the time values corresponding to the samples
@@ -48,6 +48,7 @@
 #include "fiff_cov.h"
 
 #include <utils/mnemath.h>
+#include <utils/ioutils.h>
 
 
 //*************************************************************************************************************
@@ -1977,10 +1978,7 @@ void FiffStream::write_double(fiff_int_t kind, const double* data, fiff_int_t ne
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-//    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    this->write_words(data, nel, sizeof(double));
 }
 
 
@@ -1995,10 +1993,7 @@ void FiffStream::write_float(fiff_int_t kind, const float* data, fiff_int_t nel)
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-//    this->setFloatingPointPrecision(QDataStream::SinglePrecision);
-
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    this->write_words(data, nel, sizeof(float));
 }
 
 
@@ -2018,17 +2013,14 @@ void FiffStream::write_float_matrix(fiff_int_t kind, const MatrixXf& mat)
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-    qint32 i;
-    for(i = 0; i < numel; ++i)
-        *this << mat.data()[i];
+    this->write_words(mat.data(), numel, sizeof(float));
 
     qint32 dims[3];
     dims[0] = mat.cols();
     dims[1] = mat.rows();
     dims[2] = 2;
 
-    for(i = 0; i < 3; ++i)
-        *this << dims[i];
+    this->write_words(dims, 3, sizeof(qint32));
 }
 
 
@@ -2343,8 +2335,7 @@ void FiffStream::write_int(fiff_int_t kind, const fiff_int_t* data, fiff_int_t n
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-    for(qint32 i = 0; i < nel; ++i)
-        *this << data[i];
+    this->write_words(data, nel, sizeof(fiff_int_t));
 }
 
 
@@ -2364,17 +2355,14 @@ void FiffStream::write_int_matrix(fiff_int_t kind, const MatrixXi& mat)
     *this << (qint32)datasize;
     *this << (qint32)FIFFV_NEXT_SEQ;
 
-    qint32 i;
-    for(i = 0; i < numel; ++i)
-        *this << mat.data()[i];
+    this->write_words(mat.data(), numel, sizeof(qint32));
 
     qint32 dims[3];
     dims[0] = mat.cols();
     dims[1] = mat.rows();
     dims[2] = 2;
 
-    for(i = 0; i < 3; ++i)
-        *this << dims[i];
+    this->write_words(dims, 3, sizeof(qint32));
 }
 
 
@@ -2445,16 +2433,7 @@ bool FiffStream::write_raw_buffer(const MatrixXd& buf, const RowVectorXd& cals)
         return false;
     }
 
-    typedef Eigen::Triplet<double> T;
-    std::vector<T> tripletList;
-    tripletList.reserve(cals.cols());
-    for(qint32 i = 0; i < cals.cols(); ++i)
-        tripletList.push_back(T(i, i, 1.0/cals[i]));
-
-    SparseMatrix<double> inv_calsMat(cals.cols(), cals.cols());
-    inv_calsMat.setFromTriplets(tripletList.begin(), tripletList.end());
-
-    MatrixXf tmp = (inv_calsMat*buf).cast<float>();
+    MatrixXf tmp = (cals.cwiseInverse().asDiagonal()*buf).cast<float>();
     this->write_float(FIFF_DATA_BUFFER,tmp.data(),tmp.rows()*tmp.cols());
     return true;
 }
@@ -2487,3 +2466,43 @@ void FiffStream::write_rt_command(fiff_int_t command, const QString& data)
 
     this->writeRawData(data.toUtf8().constData(),datasize);
 }
+
+
+//*************************************************************************************************************
+
+void FiffStream::write_words(const void* data, qint64 nel, int width)
+{
+    if(nel <= 0)
+        return;
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    bool t_bSwap = this->byteOrder() == QDataStream::LittleEndian;
+#else
+    bool t_bSwap = this->byteOrder() == QDataStream::BigEndian;
+#endif
+
+    const char* t_pData = static_cast<const char*>(data);
+
+    if(!t_bSwap) {
+        this->writeRawData(t_pData, nel*width);
+        return;
+    }
+
+    //
+    //   Swap chunk wise, keeps the scratch buffer in cache and bounded for large matrices
+    //
+    const qint64 t_iChunk = 65536/width;
+    if(m_qByteArrayScratch.size() < t_iChunk*width)
+        m_qByteArrayScratch.resize(t_iChunk*width);
+
+    for(qint64 i = 0; i < nel; i += t_iChunk) {
+        qint64 n = qMin(t_iChunk, nel - i);
+        if(width == 2)
+            IOUtils::swap_16_copy(t_pData + i*width, m_qByteArrayScratch.data(), n);
+        else if(width == 4)
+            IOUtils::swap_32_copy(t_pData + i*width, m_qByteArrayScratch.data(), n);
+        else
+            IOUtils::swap_64_copy(t_pData + i*width, m_qByteArrayScratch.data(), n);
+        this->writeRawData(m_qByteArrayScratch.constData(), n*width);
+    }
+}
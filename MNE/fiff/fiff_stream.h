@@ -663,6 +663,21 @@ public:
     * @param[in] data       The string data to write
     */
     void write_rt_command(fiff_int_t command, const QString& data);
+
+private:
+    //=========================================================================================================
+    /**
+    * Writes nel consecutive words of the given width (2, 4 or 8 bytes) in the byte order of the stream. Instead
+    * of streaming element by element, the words are byte swapped chunk wise into a reused scratch buffer and
+    * handed to the device with one writeRawData call per chunk.
+    *
+    * @param[in] data       The words to write
+    * @param[in] nel        Number of words
+    * @param[in] width      Word width in bytes
+    */
+    void write_words(const void* data, qint64 nel, int width);
+
+    QByteArray m_qByteArrayScratch;     /**< Reused byte swap buffer of write_words. */
 };
 
 } // NAMESPACE
@@ -0,0 +1,512 @@
+//=============================================================================================================
+/**
+* @file     ringmatrixbuffer.h
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     October, 2014
+*
+* @section  LICENSE
+*
+* Copyright (C) 2014, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    RingMatrixBuffer class declaration
+*
+*/
+
+#ifndef RINGMATRIXBUFFER_H
+#define RINGMATRIXBUFFER_H
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "generics_global.h"
+#include "buffer.h"
+
+#include <typeinfo>
+#include <string.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QThread>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE IOBuffer
+//=============================================================================================================
+
+namespace IOBuffer
+{
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+
+//=============================================================================================================
+/**
+* Lock-free single producer/single consumer ring buffer of equally sized matrices. Each matrix occupies one
+* contiguous slot, so push and pop copy whole matrices with a single memcpy. Only one thread may push and only
+* one thread may pop at a time. Drop-in replacement for CircularMatrixBuffer, which additionally offers timed
+* pops into caller supplied matrices.
+*
+* @brief Lock-free SPSC matrix ring buffer.
+*/
+template<typename _Tp>
+class RingMatrixBuffer : public Buffer
+{
+public:
+    typedef QSharedPointer<RingMatrixBuffer> SPtr;              /**< Shared pointer type for RingMatrixBuffer. */
+    typedef QSharedPointer<const RingMatrixBuffer> ConstSPtr;   /**< Const shared pointer type for RingMatrixBuffer. */
+
+    //=========================================================================================================
+    /**
+    * Constructs a RingMatrixBuffer.
+    * length of buffer = uiMaxNumMatrizes*rows*cols
+    *
+    * @param [in] uiMaxNumMatrices  length of buffer.
+    * @param [in] uiRows            Number of rows.
+    * @param [in] uiCols            Number of columns.
+    */
+    explicit RingMatrixBuffer(unsigned int uiMaxNumMatrices, unsigned int uiRows, unsigned int uiCols);
+
+    //=========================================================================================================
+    /**
+    * Destroys the RingMatrixBuffer.
+    */
+    ~RingMatrixBuffer();
+
+    //=========================================================================================================
+    /**
+    * Adds a whole matrix at the end buffer. Blocks while the buffer is full, until releaseFromPush() is called.
+    *
+    * @param [in] pMatrix pointer to a Matrix which should be apend to the end.
+    */
+    inline void push(const Matrix<_Tp, Dynamic, Dynamic>* pMatrix);
+
+    //=========================================================================================================
+    /**
+    * Tries to add a whole matrix at the end of the buffer.
+    *
+    * @param [in] pMatrix       pointer to a Matrix which should be apend to the end.
+    * @param [in] iTimeoutMs    maximal time to wait for a free slot in ms; 0 returns immediately.
+    *
+    * @return true if the matrix was added, false if the buffer stayed full, was released or dimensions mismatch.
+    */
+    inline bool tryPush(const Matrix<_Tp, Dynamic, Dynamic>* pMatrix, int iTimeoutMs = 0);
+
+    //=========================================================================================================
+    /**
+    * Returns the first matrix (first in first out). Blocks until a matrix is available or releaseFromPop() is
+    * called, in which case a zero matrix is returned.
+    *
+    * @return the first matrix
+    */
+    inline Matrix<_Tp, Dynamic, Dynamic> pop();
+
+    //=========================================================================================================
+    /**
+    * Pops the first matrix into a caller supplied matrix. No memory is allocated when p_matOut already has the
+    * buffer dimensions. Blocks until a matrix is available or releaseFromPop() is called.
+    *
+    * @param [out] p_matOut     the matrix to pop into.
+    *
+    * @return true if a matrix was popped, false if the buffer was released.
+    */
+    inline bool pop(Matrix<_Tp, Dynamic, Dynamic>& p_matOut);
+
+    //=========================================================================================================
+    /**
+    * Tries to pop the first matrix into a caller supplied matrix.
+    *
+    * @param [out] p_matOut     the matrix to pop into.
+    * @param [in] iTimeoutMs    maximal time to wait for a matrix in ms; 0 returns immediately.
+    *
+    * @return true if a matrix was popped, false if no matrix was available within the timeout or the buffer was released.
+    */
+    inline bool tryPop(Matrix<_Tp, Dynamic, Dynamic>& p_matOut, int iTimeoutMs = 0);
+
+    //=========================================================================================================
+    /**
+    * Clears the buffer and any pending release of both sides. Producer and consumer must both be stopped, i.e.
+    * no thread may be inside or about to enter push or pop.
+    */
+    void clear();
+
+    //=========================================================================================================
+    /**
+    * Resets the consumer side: drops all stored matrices and clears a pending releaseFromPop(). Must be called
+    * from the consumer thread or while no consumer exists, e.g. before a consumer thread is (re)started. A
+    * producer may keep pushing meanwhile.
+    */
+    inline void resetConsumer();
+
+    //=========================================================================================================
+    /**
+    * Resets the producer side: clears a pending releaseFromPush(). Must be called from the producer thread or
+    * while no producer exists.
+    */
+    inline void resetProducer();
+
+    //=========================================================================================================
+    /**
+    * Size of the buffer.
+    */
+    inline quint32 size() const;
+
+    //=========================================================================================================
+    /**
+    * Number of matrices which are currently stored in the buffer.
+    */
+    inline quint32 count() const;
+
+    //=========================================================================================================
+    /**
+    * Rows of the stored matrices of the buffer.
+    */
+    inline quint32 rows() const;
+
+    //=========================================================================================================
+    /**
+    * Cols of the stored matrices of the buffer.
+    */
+    inline quint32 cols() const;
+
+    //=========================================================================================================
+    /**
+    * Pauses the buffer. Skpis any incoming matrices and only pops zero matrices.
+    */
+    inline void pause(bool);
+
+    //=========================================================================================================
+    /**
+    * Releases the consumer: a blocked pop() or tryPop() returns and further pops on an empty buffer return
+    * immediately until resetConsumer() or clear() is called.
+    * @param [out] bool returns true.
+    */
+    inline bool releaseFromPop();
+
+    //=========================================================================================================
+    /**
+    * Releases the producer: a blocked push() or tryPush() returns and further pushes on a full buffer return
+    * immediately until resetProducer() or clear() is called.
+    * @param [out] bool returns true.
+    */
+    inline bool releaseFromPush();
+
+private:
+    //=========================================================================================================
+    /**
+    * Waits with an increasing back-off until a matrix (consumer) or a free slot (producer) is available, the
+    * timeout expires or the waiting side is released.
+    *
+    * @param [in] bForPop       whether the consumer (true) or the producer (false) is waiting.
+    * @param [in] iTimeoutMs    maximal time to wait in ms; negative waits infinitely.
+    *
+    * @return true if the awaited slot is available.
+    */
+    inline bool waitForSlot(bool bForPop, int iTimeoutMs);
+
+    unsigned int    m_uiMaxNumMatrices;         /**< Holds the maximal number of matrices.*/
+    unsigned int    m_uiRows;                   /**< Holds the number rows.*/
+    unsigned int    m_uiCols;                   /**< Holds the number cols.*/
+    unsigned int    m_uiMatrixSize;             /**< Holds the number of elements of one matrix.*/
+    _Tp*            m_pBuffer;                  /**< Holds the ring buffer.*/
+    QAtomicInt      m_iReadCount;               /**< Holds the number of matrices popped so far (written by the consumer only).*/
+    QAtomicInt      m_iWriteCount;              /**< Holds the number of matrices pushed so far (written by the producer only).*/
+    QAtomicInt      m_iReleasedPop;             /**< Holds whether the consumer side is released - sticky until reset.*/
+    QAtomicInt      m_iReleasedPush;            /**< Holds whether the producer side is released - sticky until reset.*/
+    bool            m_bPause;
+};
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+template<typename _Tp>
+RingMatrixBuffer<_Tp>::RingMatrixBuffer(unsigned int uiMaxNumMatrices, unsigned int uiRows, unsigned int uiCols)
+: Buffer(typeid(_Tp).name())
+, m_uiMaxNumMatrices(uiMaxNumMatrices)
+, m_uiRows(uiRows)
+, m_uiCols(uiCols)
+, m_uiMatrixSize(m_uiRows*m_uiCols)
+, m_pBuffer(new _Tp[m_uiMaxNumMatrices*m_uiMatrixSize])
+, m_iReadCount(0)
+, m_iWriteCount(0)
+, m_iReleasedPop(0)
+, m_iReleasedPush(0)
+, m_bPause(false)
+{
+
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+RingMatrixBuffer<_Tp>::~RingMatrixBuffer()
+{
+    delete [] m_pBuffer;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline void RingMatrixBuffer<_Tp>::push(const Matrix<_Tp, Dynamic, Dynamic>* pMatrix)
+{
+    tryPush(pMatrix, -1);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline bool RingMatrixBuffer<_Tp>::tryPush(const Matrix<_Tp, Dynamic, Dynamic>* pMatrix, int iTimeoutMs)
+{
+    if(m_bPause || (unsigned int)pMatrix->size() != m_uiMatrixSize)
+        return false;
+
+    if(!waitForSlot(false, iTimeoutMs))
+        return false;
+
+    int t_iWrite = m_iWriteCount.load();
+    memcpy(m_pBuffer + (quint32)t_iWrite % m_uiMaxNumMatrices * m_uiMatrixSize, pMatrix->data(), m_uiMatrixSize * sizeof(_Tp));
+    m_iWriteCount.storeRelease(t_iWrite + 1);
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline Matrix<_Tp, Dynamic, Dynamic> RingMatrixBuffer<_Tp>::pop()
+{
+    Matrix<_Tp, Dynamic, Dynamic> matrix(m_uiRows, m_uiCols);
+
+    if(m_bPause || !pop(matrix))
+        matrix.setZero();
+
+    return matrix;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline bool RingMatrixBuffer<_Tp>::pop(Matrix<_Tp, Dynamic, Dynamic>& p_matOut)
+{
+    return tryPop(p_matOut, -1);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline bool RingMatrixBuffer<_Tp>::tryPop(Matrix<_Tp, Dynamic, Dynamic>& p_matOut, int iTimeoutMs)
+{
+    if(!waitForSlot(true, iTimeoutMs))
+        return false;
+
+    if((quint32)p_matOut.rows() != m_uiRows || (quint32)p_matOut.cols() != m_uiCols)
+        p_matOut.resize(m_uiRows, m_uiCols);
+
+    int t_iRead = m_iReadCount.load();
+    memcpy(p_matOut.data(), m_pBuffer + (quint32)t_iRead % m_uiMaxNumMatrices * m_uiMatrixSize, m_uiMatrixSize * sizeof(_Tp));
+    m_iReadCount.storeRelease(t_iRead + 1);
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline bool RingMatrixBuffer<_Tp>::waitForSlot(bool bForPop, int iTimeoutMs)
+{
+    QElapsedTimer t_timer;
+    int t_iSpin = 0;
+
+    while(true)
+    {
+        //Counters are free running - the difference stays valid across the integer wrap around
+        quint32 t_uiUsed = (quint32)m_iWriteCount.loadAcquire() - (quint32)m_iReadCount.loadAcquire();
+
+        if(bForPop ? t_uiUsed > 0 : t_uiUsed < m_uiMaxNumMatrices)
+            return true;
+
+        //The release is sticky - a release issued before the waiter arrived is not lost
+        if(bForPop ? m_iReleasedPop.loadAcquire() : m_iReleasedPush.loadAcquire())
+            return false;
+
+        if(iTimeoutMs == 0)
+            return false;
+
+        if(t_iSpin == 0)
+            t_timer.start();
+        else if(iTimeoutMs > 0 && t_timer.elapsed() >= iTimeoutMs)
+            return false;
+
+        //Back-off: spin shortly, then yield, then sleep to not burn a core while idle
+        if(t_iSpin >= 128)
+            QThread::usleep(100);
+        else if(t_iSpin >= 64)
+            QThread::yieldCurrentThread();
+        ++t_iSpin;
+    }
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+void RingMatrixBuffer<_Tp>::clear()
+{
+    m_iReadCount.storeRelease(0);
+    m_iWriteCount.storeRelease(0);
+    m_iReleasedPop.storeRelease(0);
+    m_iReleasedPush.storeRelease(0);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline void RingMatrixBuffer<_Tp>::resetConsumer()
+{
+    //Only the read counter is touched, which is owned by the consumer - safe against a running producer
+    m_iReadCount.storeRelease(m_iWriteCount.loadAcquire());
+    m_iReleasedPop.storeRelease(0);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline void RingMatrixBuffer<_Tp>::resetProducer()
+{
+    m_iReleasedPush.storeRelease(0);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline quint32 RingMatrixBuffer<_Tp>::size() const
+{
+    return m_uiMaxNumMatrices;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline quint32 RingMatrixBuffer<_Tp>::count() const
+{
+    return (quint32)m_iWriteCount.loadAcquire() - (quint32)m_iReadCount.loadAcquire();
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline quint32 RingMatrixBuffer<_Tp>::rows() const
+{
+    return m_uiRows;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline quint32 RingMatrixBuffer<_Tp>::cols() const
+{
+    return m_uiCols;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline void RingMatrixBuffer<_Tp>::pause(bool bPause)
+{
+    m_bPause = bPause;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline bool RingMatrixBuffer<_Tp>::releaseFromPop()
+{
+    m_iReleasedPop.storeRelease(1);
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline bool RingMatrixBuffer<_Tp>::releaseFromPush()
+{
+    m_iReleasedPush.storeRelease(1);
+    return true;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// TYPEDEF
+//=============================================================================================================
+
+typedef GENERICSSHARED_EXPORT RingMatrixBuffer<float>                       _float_RingMatrixBuffer;                   /**< Defines RingMatrixBuffer of float type.*/
+typedef GENERICSSHARED_EXPORT RingMatrixBuffer<double>                      _double_RingMatrixBuffer;                  /**< Defines RingMatrixBuffer of double type.*/
+
+} // NAMESPACE
+
+#endif // RINGMATRIXBUFFER_H
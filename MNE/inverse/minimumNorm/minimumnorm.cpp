@@ -43,6 +43,8 @@
 #include <mne/mne_sourceestimate.h>
 #include <fiff/fiff_evoked.h>
 
+#include <cmath>
+
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -62,6 +64,77 @@ using namespace MNELIB;
 using namespace INVERSELIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Applies a dense kernel (p_matKernel non-empty) or the factored chain p_matLeads * (p_matScaledFields * data),
+* followed by the fused xyz combination and noise normalization. Shared by the double and float paths.
+*/
+template<typename T>
+void applyKernelT(const Matrix<T,Dynamic,Dynamic> &p_matKernel,
+                  const Ref<const Matrix<T,Dynamic,Dynamic> > &p_matLeads,
+                  const Matrix<T,Dynamic,Dynamic> &p_matScaledFields,
+                  const Matrix<T,Dynamic,1> &p_vecNoiseNorm,
+                  bool p_bCombine,
+                  const Matrix<T,Dynamic,Dynamic> &p_matData,
+                  Matrix<T,Dynamic,Dynamic> &p_matScratchFields,
+                  Matrix<T,Dynamic,Dynamic> &p_matScratchSources,
+                  Matrix<T,Dynamic,Dynamic> &p_matSol)
+{
+    const bool t_bNormalize = p_vecNoiseNorm.size() > 0;
+
+    //
+    //   Kernel: dense K or the chain A * (diag(reginv) * B * data)
+    //
+    Matrix<T,Dynamic,Dynamic> &t_matSources = p_bCombine ? p_matScratchSources : p_matSol;
+    if(p_matKernel.size() == 0)
+    {
+        p_matScratchFields.noalias() = p_matScaledFields * p_matData;
+        t_matSources.noalias() = p_matLeads * p_matScratchFields;
+    }
+    else
+        t_matSources.noalias() = p_matKernel * p_matData;
+
+    //
+    //   Fused xyz combination and noise normalization
+    //
+    if(p_bCombine)
+    {
+        const qint32 nloc = t_matSources.rows()/3;
+        const qint32 ntimes = t_matSources.cols();
+        p_matSol.resize(nloc, ntimes);
+
+        for(qint32 t = 0; t < ntimes; ++t)
+        {
+            const T *in = t_matSources.col(t).data();
+            T *out = p_matSol.col(t).data();
+            if(t_bNormalize)
+            {
+                const T *nn = p_vecNoiseNorm.data();
+                for(qint32 i = 0; i < nloc; ++i, in += 3)
+                    out[i] = nn[i] * std::sqrt(in[0]*in[0] + in[1]*in[1] + in[2]*in[2]);
+            }
+            else
+            {
+                for(qint32 i = 0; i < nloc; ++i, in += 3)
+                    out[i] = std::sqrt(in[0]*in[0] + in[1]*in[1] + in[2]*in[2]);
+            }
+        }
+    }
+    else if(t_bNormalize)
+        p_matSol.array().colwise() *= p_vecNoiseNorm.array();
+}
+
+} // anonymous namespace
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -69,7 +142,15 @@ using namespace INVERSELIB;
 
 MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lambda, const QString method)
 : m_inverseOperator(p_inverseOperator)
+, m_fLambda(0.0f)
 , inverseSetup(false)
+, m_iNave(1)
+, m_bPickNormal(false)
+, m_bFactorsValid(false)
+, m_iKernelCacheSize(4)
+, m_eKernelMode(DenseKernel)
+, m_iRank(0)
+, m_eKernelPrecision(DoublePrecision)
 {
     this->setRegularization(lambda);
     this->setMethod(method);
@@ -79,7 +160,15 @@ MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lamb
 
 MinimumNorm::MinimumNorm(const MNEInverseOperator &p_inverseOperator, float lambda, bool dSPM, bool sLORETA)
 : m_inverseOperator(p_inverseOperator)
+, m_fLambda(0.0f)
 , inverseSetup(false)
+, m_iNave(1)
+, m_bPickNormal(false)
+, m_bFactorsValid(false)
+, m_iKernelCacheSize(4)
+, m_eKernelMode(DenseKernel)
+, m_iRank(0)
+, m_eKernelPrecision(DoublePrecision)
 {
     this->setRegularization(lambda);
     this->setMethod(dSPM, sLORETA);
@@ -193,33 +282,8 @@ MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin
         return MNESourceEstimate();
     }
 
-    MatrixXd sol = K * data; //apply imaging kernel
-
-    if (inv.source_ori == FIFFV_MNE_FREE_ORI)
-    {
-        printf("combining the current components...");
-        MatrixXd sol1(sol.rows()/3,sol.cols());
-        for(qint32 i = 0; i < sol.cols(); ++i)
-        {
-            VectorXd* tmp = MNEMath::combine_xyz(sol.block(0,i,sol.rows(),1));
-            sol1.block(0,i,sol.rows()/3,1) = tmp->cwiseSqrt();
-            delete tmp;
-        }
-        sol.resize(sol1.rows(),sol1.cols());
-        sol = sol1;
-    }
-
-    if (m_bdSPM)
-    {
-        printf("(dSPM)...");
-        sol = inv.noisenorm*sol;
-    }
-    else if (m_bsLORETA)
-    {
-        printf("(sLORETA)...");
-        sol = inv.noisenorm*sol;
-    }
-    printf("[done]\n");
+    MatrixXd sol;
+    applyKernel(data, sol);
 
     //Results
     VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
@@ -234,24 +298,367 @@ MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin
 }
 
 
+//*************************************************************************************************************
+
+MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXf &data, float tmin, float tstep) const
+{
+    if(!inverseSetup)
+    {
+        qWarning("Inverse not setup -> call doInverseSetup first!");
+        return MNESourceEstimate();
+    }
+
+    MatrixXf sol;
+    applyKernel(data, sol);
+
+    VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
+    p_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
+
+    return MNESourceEstimate(sol.cast<double>(), p_vecVertices, tmin, tstep);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXd &p_matData, MatrixXd &p_matSol)
+{
+    applyKernel(p_matData, p_matSol, m_matScratchFields, m_matScratchSources);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXd &p_matData, MatrixXd &p_matSol) const
+{
+    MatrixXd t_matScratchFields, t_matScratchSources;
+    applyKernel(p_matData, p_matSol, t_matScratchFields, t_matScratchSources);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXf &p_matData, MatrixXf &p_matSol)
+{
+    applyKernel(p_matData, p_matSol, m_matScratchFieldsF, m_matScratchSourcesF);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXf &p_matData, MatrixXf &p_matSol) const
+{
+    MatrixXf t_matScratchFields, t_matScratchSources;
+    applyKernel(p_matData, p_matSol, t_matScratchFields, t_matScratchSources);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXd &p_matData, MatrixXd &p_matSol, MatrixXd &p_matScratchFields, MatrixXd &p_matScratchSources) const
+{
+    const bool t_bCombine = inv.source_ori == FIFFV_MNE_FREE_ORI && !m_bPickNormal;
+
+    //without K (factored mode or a kernel only held in float) the factored chain is applied
+    applyKernelT<double>(K, m_kernelFactors.matLeads.leftCols(m_iRank), m_matScaledFields, m_vecNoiseNorm, t_bCombine, p_matData, p_matScratchFields, p_matScratchSources, p_matSol);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::applyKernel(const MatrixXf &p_matData, MatrixXf &p_matSol, MatrixXf &p_matScratchFields, MatrixXf &p_matScratchSources) const
+{
+    const bool t_bCombine = inv.source_ori == FIFFV_MNE_FREE_ORI && !m_bPickNormal;
+
+    if(m_eKernelPrecision == SinglePrecision)
+        applyKernelT<float>(m_matKernelF, m_matLeadsF, m_matScaledFieldsF, m_vecNoiseNormF, t_bCombine, p_matData, p_matScratchFields, p_matScratchSources, p_matSol);
+    else
+    {
+        //the double path brings its own scratch
+        MatrixXd t_matSol;
+        MatrixXd t_matScratchFields, t_matScratchSources;
+        applyKernel(MatrixXd(p_matData.cast<double>()), t_matSol, t_matScratchFields, t_matScratchSources);
+        p_matSol = t_matSol.cast<float>();
+    }
+}
+
+
 //*************************************************************************************************************
 
 void MinimumNorm::doInverseSetup(qint32 nave, bool pick_normal)
 {
+    m_iNave = nave;
+    m_bPickNormal = pick_normal;
+
+    QString t_sLabelKey = labelKey(label);
+
     //
-    //   Set up the inverse according to the parameters
+    //   Kernel cache
     //
-    inv = m_inverseOperator.prepare_inverse_operator(nave, m_fLambda, m_bdSPM, m_bsLORETA);
+    for(qint32 i = 0; i < m_qListKernelCache.size(); ++i)
+    {
+        const CachedKernel &t_cached = m_qListKernelCache[i];
+        if(t_cached.nave == nave && t_cached.lambda2 == m_fLambda && t_cached.method == m_sMethod && t_cached.pick_normal == pick_normal && t_cached.sLabelKey == t_sLabelKey)
+        {
+            m_qListKernelCache.move(i, 0);
+
+            if(!updateKernelFactors(nave, pick_normal))
+                return;
+
+            inv = m_kernelFactors.inv;
+            inv.reginv = t_cached.reginv;
+            inv.noisenorm = t_cached.noise_norm;
+            K = t_cached.K;
+            m_matKernelF = t_cached.KF;
+            noise_norm = t_cached.noise_norm;
+            finishSetup();
+            inverseSetup = true;
+            return;
+        }
+    }
+
+    //
+    //   Set up the inverse according to the parameters - only the regularization dependent diagonal is new
+    //
+    if(!updateKernelFactors(nave, pick_normal))
+        return;
+
+    inv = m_kernelFactors.inv;
+
+    const VectorXd &sing = inv.sing;
+    VectorXd sing2 = sing.cwiseAbs2();
+    inv.reginv = sing.cwiseQuotient((sing2.array() + m_fLambda).matrix());
 
     printf("Computing inverse...");
-    inv.assemble_kernel(label, m_sMethod, pick_normal, K, noise_norm, vertno);
+    K.resize(0, 0);
+    m_matKernelF.resize(0, 0);
+
+    //
+    //   Noise normalization: noise_norm[k] = || A(k,:) .* noise_weight ||, all rows at once
+    //
+    if(m_bdSPM || m_bsLORETA)
+    {
+        VectorXd noise_weight2;
+        if(m_bdSPM)
+            noise_weight2 = inv.reginv.cwiseAbs2();
+        else
+            noise_weight2 = inv.reginv.cwiseAbs2().cwiseProduct((VectorXd::Ones(sing.size()) + sing2/m_fLambda));
+
+        VectorXd t_vecNoiseNorm2 = m_kernelFactors.matLeadsSquared * noise_weight2;
+
+        //free orientations: one factor per location from the three components
+        if(inv.source_ori == FIFFV_MNE_FREE_ORI)
+            t_vecNoiseNorm2 = Map<MatrixXd>(t_vecNoiseNorm2.data(), 3, t_vecNoiseNorm2.size()/3).colwise().sum().transpose();
+
+        VectorXd t_vecInvNoiseNorm = t_vecNoiseNorm2.cwiseSqrt().cwiseInverse();
+
+        typedef Eigen::Triplet<double> T;
+        std::vector<T> tripletList;
+        tripletList.reserve(t_vecInvNoiseNorm.size());
+        for(qint32 i = 0; i < t_vecInvNoiseNorm.size(); ++i)
+            tripletList.push_back(T(i, i, t_vecInvNoiseNorm[i]));
+
+        inv.noisenorm = SparseMatrix<double>(t_vecInvNoiseNorm.size(), t_vecInvNoiseNorm.size());
+        inv.noisenorm.setFromTriplets(tripletList.begin(), tripletList.end());
+    }
+    else
+        inv.noisenorm = SparseMatrix<double>();
+
+    noise_norm = inv.noisenorm;
+
+    finishSetup();
+
+    std::cout << "K " << m_kernelFactors.matLeads.rows() << " x " << m_kernelFactors.matFields.cols() << std::endl;
 
-    std::cout << "K " << K.rows() << " x " << K.cols() << std::endl;
+    //
+    //   Store in cache
+    //
+    if(m_iKernelCacheSize > 0)
+    {
+        CachedKernel t_cached;
+        t_cached.nave = nave;
+        t_cached.lambda2 = m_fLambda;
+        t_cached.method = m_sMethod;
+        t_cached.pick_normal = pick_normal;
+        t_cached.sLabelKey = t_sLabelKey;
+        t_cached.K = K;
+        t_cached.KF = m_matKernelF;
+        t_cached.reginv = inv.reginv;
+        t_cached.noise_norm = inv.noisenorm;
+        m_qListKernelCache.prepend(t_cached);
+        while(m_qListKernelCache.size() > m_iKernelCacheSize)
+            m_qListKernelCache.removeLast();
+    }
 
     inverseSetup = true;
 }
 
 
+//*************************************************************************************************************
+
+void MinimumNorm::finishSetup()
+{
+    //noise normalization as a dense vector for the fused application
+    if(inv.noisenorm.nonZeros() > 0)
+        m_vecNoiseNorm = inv.noisenorm.diagonal();
+    else
+        m_vecNoiseNorm.resize(0);
+
+    //singular values are sorted descending -> the nonzero components come first
+    m_iRank = 0;
+    while(m_iRank < inv.reginv.size() && inv.reginv[m_iRank] != 0.0)
+        ++m_iRank;
+
+    m_matScaledFields = inv.reginv.head(m_iRank).asDiagonal() * m_kernelFactors.matFields.topRows(m_iRank);
+
+    if(m_eKernelPrecision == SinglePrecision)
+    {
+        m_vecNoiseNormF = m_vecNoiseNorm.cast<float>();
+        if(m_eKernelMode == DenseKernel)
+        {
+            //form K in double, keep it in float only - a float kernel from the cache is used as it is
+            if(K.size() != 0)
+                m_matKernelF = K.cast<float>();
+            else if(m_matKernelF.size() == 0)
+                m_matKernelF = (m_kernelFactors.matLeads.leftCols(m_iRank) * m_matScaledFields).cast<float>();
+            m_matLeadsF.resize(0, 0);
+            m_matScaledFieldsF.resize(0, 0);
+        }
+        else
+        {
+            m_matKernelF.resize(0, 0);
+            m_matLeadsF = m_kernelFactors.matLeads.leftCols(m_iRank).cast<float>();
+            m_matScaledFieldsF = m_matScaledFields.cast<float>();
+        }
+        K.resize(0, 0);
+        return;
+    }
+
+    m_matKernelF.resize(0, 0);
+    m_matLeadsF.resize(0, 0);
+    m_matScaledFieldsF.resize(0, 0);
+    m_vecNoiseNormF.resize(0);
+
+    if(m_eKernelMode == DenseKernel)
+    {
+        if(K.size() == 0)
+            K.noalias() = m_kernelFactors.matLeads.leftCols(m_iRank) * m_matScaledFields;
+    }
+    else
+        K.resize(0, 0);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::setKernelMode(KernelMode p_eMode)
+{
+    m_eKernelMode = p_eMode;
+
+    if(inverseSetup)
+        finishSetup();
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::setKernelPrecision(KernelPrecision p_ePrecision)
+{
+    m_eKernelPrecision = p_ePrecision;
+
+    if(inverseSetup)
+        finishSetup();
+}
+
+
+//*************************************************************************************************************
+
+bool MinimumNorm::updateKernelFactors(qint32 nave, bool pick_normal)
+{
+    QString t_sLabelKey = labelKey(label);
+    if(m_bFactorsValid && m_kernelFactors.nave == nave && m_kernelFactors.pick_normal == pick_normal && m_kernelFactors.sLabelKey == t_sLabelKey)
+        return true;
+
+    //
+    //   Scaling, projector and whitener; the noise normalization is done per kernel
+    //
+    if(nave <= 0)
+        return false;
+    MNEInverseOperator t_inv = m_inverseOperator.prepare_inverse_operator(nave, m_fLambda, false, false);
+
+    //
+    //   A = R^0.5 * eigen_leads (unless the eigen leads are already weighted)
+    //
+    MatrixXd t_matLeads = t_inv.eigen_leads->data;
+    if(!t_inv.eigen_leads_weighted)
+        t_matLeads = t_inv.source_cov->data.col(0).cwiseSqrt().asDiagonal() * t_matLeads;
+
+    vertno = t_inv.src.get_vertno();
+
+    if(!label.isEmpty())
+    {
+        VectorXi src_sel;
+        vertno = t_inv.src.label_src_vertno_sel(label, src_sel);
+
+        qint32 t_iComp = t_inv.source_ori == FIFFV_MNE_FREE_ORI ? 3 : 1;
+        MatrixXd t_matSel(src_sel.size()*t_iComp, t_matLeads.cols());
+        for(qint32 i = 0; i < src_sel.size(); ++i)
+            t_matSel.middleRows(i*t_iComp, t_iComp) = t_matLeads.middleRows(src_sel[i]*t_iComp, t_iComp);
+        t_matLeads = t_matSel;
+    }
+
+    m_kernelFactors.matLeadsSquared = t_matLeads.cwiseAbs2();
+
+    if(pick_normal)
+    {
+        if(t_inv.source_ori != FIFFV_MNE_FREE_ORI)
+        {
+            qWarning("Warning: Pick normal can only be used with a free orientation inverse operator.\n");
+            return false;
+        }
+
+        bool is_loose = ((0 < t_inv.orient_prior->data(0,0)) && (t_inv.orient_prior->data(0,0) < 1)) ? true : false;
+        if(!is_loose)
+        {
+            qWarning("The pick_normal parameter is only valid when working with loose orientations.\n");
+            return false;
+        }
+
+        // keep only the normal components
+        MatrixXd t_matNormal(t_matLeads.rows()/3, t_matLeads.cols());
+        for(qint32 i = 0; i < t_matNormal.rows(); ++i)
+            t_matNormal.row(i) = t_matLeads.row(3*i+2);
+        t_matLeads = t_matNormal;
+    }
+
+    m_kernelFactors.matLeads = t_matLeads;
+
+    //
+    //   B = eigen_fields * whitener * proj
+    //
+    m_kernelFactors.matFields = t_inv.eigen_fields->data * t_inv.whitener * t_inv.proj;
+
+    m_kernelFactors.nave = nave;
+    m_kernelFactors.pick_normal = pick_normal;
+    m_kernelFactors.sLabelKey = t_sLabelKey;
+    m_kernelFactors.inv = t_inv;
+    m_bFactorsValid = true;
+
+    //kernels of other factors are still valid, they are keyed by nave, pick_normal and label as well
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+QString MinimumNorm::labelKey(const Label &p_label)
+{
+    if(p_label.isEmpty())
+        return QString();
+
+    return QString("%1/%2/%3/%4").arg(p_label.name).arg(p_label.hemi).arg(p_label.label_id).arg(p_label.vertices.size());
+}
+
+
 //*************************************************************************************************************
 
 const char* MinimumNorm::getName() const
@@ -292,6 +699,8 @@ void MinimumNorm::setMethod(QString method)
 
 void MinimumNorm::setMethod(bool dSPM, bool sLORETA)
 {
+    QString t_sOldMethod = m_sMethod;
+
     if(dSPM && sLORETA)
     {
         qWarning("Cant activate dSPM and sLORETA at the same time! - Activating dSPM");
@@ -310,6 +719,10 @@ void MinimumNorm::setMethod(bool dSPM, bool sLORETA)
             m_sMethod = QString("MNE");
 
     }
+
+    //cheap with the cached factors -> keep the kernel up to date
+    if(inverseSetup && m_sMethod != t_sOldMethod)
+        doInverseSetup(m_iNave, m_bPickNormal);
 }
 
 
@@ -317,5 +730,31 @@ void MinimumNorm::setMethod(bool dSPM, bool sLORETA)
 
 void MinimumNorm::setRegularization(float lambda)
 {
+    bool t_bChanged = m_fLambda != lambda;
     m_fLambda = lambda;
+
+    //only the diagonal of the kernel depends on lambda -> keep the kernel up to date
+    if(inverseSetup && t_bChanged)
+        doInverseSetup(m_iNave, m_bPickNormal);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::setLabel(const Label &p_label)
+{
+    label = p_label;
+
+    if(inverseSetup)
+        doInverseSetup(m_iNave, m_bPickNormal);
+}
+
+
+//*************************************************************************************************************
+
+void MinimumNorm::setKernelCacheSize(qint32 p_iSize)
+{
+    m_iKernelCacheSize = p_iSize > 0 ? p_iSize : 0;
+    while(m_qListKernelCache.size() > m_iKernelCacheSize)
+        m_qListKernelCache.removeLast();
 }
@@ -48,6 +48,7 @@
 #include <fs/label.h>
 
 #include <QSharedPointer>
+#include <QList>
 
 
 //*************************************************************************************************************
@@ -85,6 +86,26 @@ public:
     typedef QSharedPointer<MinimumNorm> SPtr;             /**< Shared pointer type for MinimumNorm. */
     typedef QSharedPointer<const MinimumNorm> ConstSPtr;  /**< Const shared pointer type for MinimumNorm. */
 
+    //=========================================================================================================
+    /**
+    * How the imaging kernel is applied to the data
+    */
+    enum KernelMode
+    {
+        DenseKernel,    /**< K (n_sources x n_channels) is formed and applied with one product. */
+        FactoredKernel  /**< K is kept factored, applied as (A * (diag(reginv) * B * data)) with rank <= n_channels. */
+    };
+
+    //=========================================================================================================
+    /**
+    * Scalar type the imaging kernel is stored and applied in
+    */
+    enum KernelPrecision
+    {
+        DoublePrecision,    /**< Kernel and data in double precision. */
+        SinglePrecision     /**< Kernel kept in float, for the MatrixXf data path; halves the kernel memory traffic. */
+    };
+
     //=========================================================================================================
     /**
     * Constructs minimum norm inverse algorithm
@@ -127,6 +148,59 @@ public:
 
     virtual MNESourceEstimate calculateInverse(const MatrixXd &data, float tmin, float tstep) const;
 
+    //=========================================================================================================
+    /**
+    * Computes the inverse solution of single precision data, e.g. the raw buffers of RtClient. The kernel is
+    * applied in float; only the combined source estimate is widened to double.
+    *
+    * @param[in] data   Data (n_channels x n_times), channels picked as the inverse operator
+    * @param[in] tmin   Time of the first sample
+    * @param[in] tstep  Time between two samples
+    *
+    * @return the calculated source estimation
+    */
+    MNESourceEstimate calculateInverse(const MatrixXf &data, float tmin, float tstep) const;
+
+    //=========================================================================================================
+    /**
+    * Applies the imaging kernel to a data block, combines the xyz components of free orientations and applies
+    * the dSPM/sLORETA noise normalization in one pass over the output. Apart from growing the internal scratch
+    * buffers and p_matSol on size changes, no memory is allocated. The internal scratch buffers make this
+    * overload single threaded, concurrent callers use the const overload.
+    *
+    * @param[in] p_matData  Data (n_channels x n_times), channels picked as the inverse operator
+    * @param[out] p_matSol  Source estimate (n_locations x n_times)
+    */
+    void applyKernel(const MatrixXd &p_matData, MatrixXd &p_matSol);
+
+    //=========================================================================================================
+    /**
+    * Applies the imaging kernel with scratch buffers of its own, so concurrent calls on one object are safe.
+    *
+    * @param[in] p_matData  Data (n_channels x n_times), channels picked as the inverse operator
+    * @param[out] p_matSol  Source estimate (n_locations x n_times)
+    */
+    void applyKernel(const MatrixXd &p_matData, MatrixXd &p_matSol) const;
+
+    //=========================================================================================================
+    /**
+    * Single precision version of applyKernel. Uses the float kernel when the precision is set to SinglePrecision,
+    * otherwise the double kernel is converted on every call. Single threaded like the double version.
+    *
+    * @param[in] p_matData  Data (n_channels x n_times), channels picked as the inverse operator
+    * @param[out] p_matSol  Source estimate (n_locations x n_times)
+    */
+    void applyKernel(const MatrixXf &p_matData, MatrixXf &p_matSol);
+
+    //=========================================================================================================
+    /**
+    * Single precision version of the const applyKernel, safe for concurrent calls on one object.
+    *
+    * @param[in] p_matData  Data (n_channels x n_times), channels picked as the inverse operator
+    * @param[out] p_matSol  Source estimate (n_locations x n_times)
+    */
+    void applyKernel(const MatrixXf &p_matData, MatrixXf &p_matSol) const;
+
     virtual void doInverseSetup(qint32 nave, bool pick_normal = false);
 
 
@@ -167,9 +241,110 @@ public:
     */
     void setRegularization(float lambda);
 
+    //=========================================================================================================
+    /**
+    * Restricts the kernel to the sources inside a label. An empty label selects all sources.
+    *
+    * @param[in] p_label    The label
+    */
+    void setLabel(const Label &p_label);
+
+    //=========================================================================================================
+    /**
+    * Sets the number of imaging kernels kept in the kernel cache (default 4). Each kernel takes
+    * n_sources x n_channels doubles.
+    *
+    * @param[in] p_iSize    Number of cached kernels, 0 disables caching of complete kernels
+    */
+    void setKernelCacheSize(qint32 p_iSize);
+
+    //=========================================================================================================
+    /**
+    * Selects between a dense and a factored imaging kernel (default dense). The factored kernel avoids forming K
+    * and skips the components with zero singular values.
+    *
+    * @param[in] p_eMode    kernel mode
+    */
+    void setKernelMode(KernelMode p_eMode);
+
+    //=========================================================================================================
+    /**
+    * Selects the precision of the stored kernel (default double). With single precision the double kernel is
+    * released and only formed again by getKernel().
+    *
+    * @param[in] p_ePrecision   kernel precision
+    */
+    void setKernelPrecision(KernelPrecision p_ePrecision);
+
     inline MatrixXd& getKernel();
 
 private:
+    //=========================================================================================================
+    /**
+    * Regularization independent factors of the imaging kernel K = A * diag(reginv) * B for one nave, pick_normal
+    * and label. The SVD is stored in the inverse operator, so a new lambda only rescales the diagonal.
+    */
+    struct KernelFactors
+    {
+        qint32 nave;                /**< Number of averages the factors are scaled for. */
+        bool pick_normal;           /**< Whether only the normal components are kept. */
+        QString sLabelKey;          /**< Identifies the label selection. */
+        MatrixXd matLeads;          /**< A: source weighted eigen leads of the kernel rows. */
+        MatrixXd matLeadsSquared;   /**< Squared weighted eigen leads of all components, for the noise normalization. */
+        MatrixXd matFields;         /**< B: eigen fields * whitener * projector. */
+        MNEInverseOperator inv;     /**< Inverse operator prepared for nave (reginv and noisenorm set per kernel). */
+    };
+
+    //=========================================================================================================
+    /**
+    * A cached imaging kernel
+    */
+    struct CachedKernel
+    {
+        qint32 nave;                    /**< Number of averages. */
+        float lambda2;                  /**< Regularization. */
+        QString method;                 /**< "MNE", "dSPM" or "sLORETA". */
+        bool pick_normal;               /**< Whether only the normal components are kept. */
+        QString sLabelKey;              /**< Identifies the label selection. */
+        MatrixXd K;                     /**< Imaging kernel, empty in single precision. */
+        MatrixXf KF;                    /**< Float imaging kernel, single precision dense mode only. */
+        VectorXd reginv;                /**< Regularized inverse of the singular values. */
+        SparseMatrix<double> noise_norm;/**< Noise normalization. */
+    };
+
+    //=========================================================================================================
+    /**
+    * Computes the regularization independent kernel factors, if they do not match nave, pick_normal and label.
+    *
+    * @return true if succeeded, false otherwise
+    */
+    bool updateKernelFactors(qint32 nave, bool pick_normal);
+
+    //=========================================================================================================
+    /**
+    * Identifies a label for the kernel cache.
+    */
+    static QString labelKey(const Label &p_label);
+
+    //=========================================================================================================
+    /**
+    * Derives the application data from reginv, noisenorm and the kernel factors: noise normalization vector,
+    * the dense kernel or the scaled, rank truncated fields.
+    */
+    void finishSetup();
+
+    //=========================================================================================================
+    /**
+    * Applies the kernel with the given scratch buffers, see applyKernel.
+    */
+    void applyKernel(const MatrixXd &p_matData, MatrixXd &p_matSol, MatrixXd &p_matScratchFields, MatrixXd &p_matScratchSources) const;
+
+    //=========================================================================================================
+    /**
+    * Applies the single precision kernel with the given scratch buffers, see applyKernel.
+    */
+    void applyKernel(const MatrixXf &p_matData, MatrixXf &p_matSol, MatrixXf &p_matScratchFields, MatrixXf &p_matScratchSources) const;
+
     MNEInverseOperator m_inverseOperator;   /**< The inverse operator */
     float m_fLambda;                        /**< Regularization parameter */
     QString m_sMethod;                      /**< Selected method */
@@ -183,6 +358,28 @@ private:
     Label label;                            /**< The corresponding labels */
     MatrixXd K;                             /**< Imaging kernel */
 
+    qint32 m_iNave;                         /**< Number of averages of the current setup */
+    bool m_bPickNormal;                     /**< pick_normal of the current setup */
+    bool m_bFactorsValid;                   /**< Whether m_kernelFactors is computed */
+    KernelFactors m_kernelFactors;          /**< Regularization independent kernel factors */
+    qint32 m_iKernelCacheSize;              /**< Maximal number of cached kernels */
+    QList<CachedKernel> m_qListKernelCache; /**< Cached kernels, most recently used first */
+
+    KernelMode m_eKernelMode;               /**< Dense or factored kernel application */
+    qint32 m_iRank;                         /**< Number of components with nonzero reginv (factored mode) */
+    MatrixXd m_matScaledFields;             /**< diag(reginv) * B, rank truncated (factored mode) */
+    VectorXd m_vecNoiseNorm;                /**< Diagonal of the noise normalization, empty for MNE */
+    MatrixXd m_matScratchFields;            /**< Scratch of the non-const applyKernel: data in the eigen field basis */
+    MatrixXd m_matScratchSources;           /**< Scratch of the non-const applyKernel: source components before xyz combination */
+
+    KernelPrecision m_eKernelPrecision;     /**< Precision of the stored kernel */
+    MatrixXf m_matKernelF;                  /**< Float imaging kernel (dense mode, single precision) */
+    MatrixXf m_matLeadsF;                   /**< Float A, rank truncated (factored mode, single precision) */
+    MatrixXf m_matScaledFieldsF;            /**< Float diag(reginv) * B, rank truncated (factored mode, single precision) */
+    VectorXf m_vecNoiseNormF;               /**< Float diagonal of the noise normalization */
+    MatrixXf m_matScratchFieldsF;           /**< Scratch of the non-const applyKernel: float data in the eigen field basis */
+    MatrixXf m_matScratchSourcesF;          /**< Scratch of the non-const applyKernel: float source components before xyz combination */
+
 };
 
 //*************************************************************************************************************
@@ -192,6 +389,9 @@ private:
 
 inline MatrixXd& MinimumNorm::getKernel()
 {
+    //factored mode and single precision do not keep K unless it is requested
+    if(inverseSetup && K.size() == 0)
+        K = m_kernelFactors.matLeads.leftCols(m_iRank) * m_matScaledFields;
     return K;
 }
 
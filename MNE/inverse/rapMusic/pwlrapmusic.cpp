@@ -140,11 +140,29 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
     MatrixXT* t_pMatPhi_s = NULL;//(m_iNumChannels, m_iN < t_r ? m_iN : t_r);
     int t_r = calcPhi_s(/*(MatrixXT)*/p_matMeasurement, t_pMatPhi_s);
 
-    int t_iMaxSearch = m_iN < t_r ? m_iN : t_r; //The smallest of Rank and Iterations
+    calcDipolePairs(*t_pMatPhi_s, t_r, p_RapDipoles);
 
-    if (t_r < m_iN)
+    end = clock();
+
+    float t_fElapsedTime = ( (float)(end-start) / (float)CLOCKS_PER_SEC ) * 1000.0f;
+    std::cout << "Total Time Elapsed: " << t_fElapsedTime << " ms" << std::endl << std::endl;
+
+    //garbage collecting
+    delete t_pMatPhi_s;
+
+    return p_SourceEstimate;
+}
+
+
+//*************************************************************************************************************
+
+void PwlRapMusic::calcDipolePairs(const MatrixXT& p_matPhi_s, int p_iRank, QList< DipolePair<double> > &p_RapDipoles) const
+{
+    int t_iMaxSearch = m_iN < p_iRank ? m_iN : p_iRank; //The smallest of Rank and Iterations
+
+    if (p_iRank < m_iN)
     {
-        std::cout << "Warning: Rank " << t_r << " of the measurement data is smaller than the " << m_iN;
+        std::cout << "Warning: Rank " << p_iRank << " of the measurement data is smaller than the " << m_iN;
         std::cout << " sources to find." << std::endl;
         std::cout << "         Searching now for " << t_iMaxSearch << " correlated sources.";
         std::cout << std::endl << std::endl;
@@ -177,16 +195,11 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
 
     std::cout << "##### Calculation of PWL RAP MUSIC started ######\n\n";
 
-    MatrixXT t_matProj_Phi_s(t_matOrthProj.rows(), t_pMatPhi_s->cols());
-    //new Version: Calculate projection before
-    MatrixXT t_matProj_LeadField(m_ForwardSolution.sol->data.rows(), m_ForwardSolution.sol->data.cols());
+    MatrixXT t_matProj_Phi_s(t_matOrthProj.rows(), p_matPhi_s.cols());
 
     for(int r = 0; r < t_iMaxSearch ; ++r)
     {
-        t_matProj_Phi_s = t_matOrthProj*(*t_pMatPhi_s);
-
-        //new Version: Calculating Projection before
-        t_matProj_LeadField = t_matOrthProj * m_ForwardSolution.sol->data;//Subtract the found sources from the current found source
+        t_matProj_Phi_s = t_matOrthProj*(p_matPhi_s);
 
         //###First Option###
         //Step 1: lt. Mosher 1998 -> Maybe tmp_Proj_Phi_S is already orthogonal -> so no SVD needed -> U_B = tmp_Proj_Phi_S;
@@ -203,6 +216,12 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
         clock_t start_subcorr, end_subcorr;
         start_subcorr = clock();
 
+        //Per source bases of the projected lead field (reused while the found sources do not change) and their
+        //projection onto the signal subspace - one decomposition per source instead of one SVD per pair
+        SubcorrBases t_bases;
+        t_bases.matQ = projectedSourceBases(r, p_RapDipoles, t_matOrthProj);
+        calcSubcorrBases(t_matU_B, t_bases);
+
         double t_val_roh_k;
 
         //Powell
@@ -235,16 +254,8 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
                 for(int i = 0; i < t_iNumVecElements; i++)
                 {
                     int k = t_pVecIdxElements(i);
-                    //new Version: calculate matrix multiplication before
-                    //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
-                    MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
-
-                    int idx1 = m_ppPairIdxCombinations[k]->x1;
-                    int idx2 = m_ppPairIdxCombinations[k]->x2;
 
-                    RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
-
-                    t_vecRoh(k) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
+                    t_vecRoh(k) = RapMusic::subcorrPair(t_bases, m_vecPairIdx1[k], m_vecPairIdx2[k]);//t_vecRoh holds the correlations roh_k
                 }
             }
 
@@ -279,8 +290,8 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
             {
                 t_iMaxIdx_old = t_iMaxIdx;
                 //get positions in sparsed leadfield from index combinations;
-                t_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
-                t_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
+                t_iIdx1 = m_vecPairIdx1[t_iMaxIdx];
+                t_iIdx2 = m_vecPairIdx2[t_iMaxIdx];
             }
 
 
@@ -340,16 +351,6 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
     }
 
     std::cout << "##### Calculation of PWL RAP MUSIC completed ######"<< std::endl << std::endl << std::endl;
-
-    end = clock();
-
-    float t_fElapsedTime = ( (float)(end-start) / (float)CLOCKS_PER_SEC ) * 1000.0f;
-    std::cout << "Total Time Elapsed: " << t_fElapsedTime << " ms" << std::endl << std::endl;
-
-    //garbage collecting
-    delete t_pMatPhi_s;
-
-    return p_SourceEstimate;
 }
 
 
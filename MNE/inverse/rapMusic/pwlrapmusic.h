@@ -152,6 +152,16 @@ public:
 
     virtual const char* getName() const;
 
+protected:
+    //=========================================================================================================
+    /**
+    * Searches the correlated dipole pairs in the signal subspace Phi_s with the Powell search.
+    *
+    * @param[in] p_matPhi_s     The signal subspace.
+    * @param[in] p_iRank        The rank of the measurement.
+    * @param[out] p_RapDipoles  The found dipole pairs.
+    */
+    virtual void calcDipolePairs(const MatrixXT& p_matPhi_s, int p_iRank, QList< DipolePair<double> > &p_RapDipoles) const;
 };
 
 //*************************************************************************************************************
@@ -65,11 +65,12 @@ RapMusic::RapMusic()
 , m_iNumGridPoints(0)
 , m_iNumChannels(0)
 , m_iNumLeadFieldCombinations(0)
-, m_ppPairIdxCombinations(NULL)
 , m_iMaxNumThreads(1)
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
 , m_fStcOverlap(-1)
+, m_bStreaming(false)
+, m_dOrientationTolerance(1e-3)
 {
 }
 
@@ -82,11 +83,12 @@ RapMusic::RapMusic(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, double
 , m_iNumGridPoints(0)
 , m_iNumChannels(0)
 , m_iNumLeadFieldCombinations(0)
-, m_ppPairIdxCombinations(NULL)
 , m_iMaxNumThreads(1)
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
 , m_fStcOverlap(-1)
+, m_bStreaming(false)
+, m_dOrientationTolerance(1e-3)
 {
     //Init
     init(p_pFwd, p_bSparsed, p_iN, p_dThr);
@@ -97,8 +99,6 @@ RapMusic::RapMusic(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, double
 
 RapMusic::~RapMusic()
 {
-    if(m_ppPairIdxCombinations != NULL)
-        free(m_ppPairIdxCombinations);
 }
 
 
@@ -159,9 +159,11 @@ bool RapMusic::init(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, doubl
 
     m_iNumLeadFieldCombinations = MNEMath::nchoose2(m_iNumGridPoints+1);
 
-    m_ppPairIdxCombinations = (Pair **)malloc(m_iNumLeadFieldCombinations * sizeof(Pair *));
+    calcPairCombinations(m_iNumGridPoints, m_iNumLeadFieldCombinations, m_vecPairIdx1, m_vecPairIdx2);
 
-    calcPairCombinations(m_iNumGridPoints, m_iNumLeadFieldCombinations, m_ppPairIdxCombinations);
+    //source bases of the unprojected lead field, used by the first iteration of every localization
+    calcSourceBases(m_ForwardSolution.sol->data, m_matSourceBases);
+    m_qVecProjectionCache.clear();
 
     std::cout << "Gain matrix combinations calculated. \n\n";
 
@@ -267,6 +269,9 @@ MNESourceEstimate RapMusic::calculateInverse(const FiffEvoked &p_fiffEvoked, boo
 
         MatrixXd data = MatrixXd::Zero(t_iNumSensors, m_iSamplesStcWindow);
 
+        MatrixXT t_matScatter;          //streaming: F F^T of the current window
+        qint32 t_iScatterStart = -1;    //streaming: first sample of the window in t_matScatter
+
         qint32 curSample = 0;
         qint32 curResultSample = 0;
         qint32 stcWindowSize = m_iSamplesStcWindow - 2*t_iSamplesDiscard;
@@ -276,13 +281,13 @@ MNESourceEstimate RapMusic::calculateInverse(const FiffEvoked &p_fiffEvoked, boo
             QList< DipolePair<double> > t_RapDipoles;
 
             //Data
+            qint32 t_iWindowStart = curSample;
             if(curSample + m_iSamplesStcWindow >= t_iNumSteps) //last
             {
                 last = true;
-                data = p_fiffEvoked.data.block(0, p_fiffEvoked.data.cols()-m_iSamplesStcWindow, t_iNumSensors, m_iSamplesStcWindow);
+                t_iWindowStart = p_fiffEvoked.data.cols()-m_iSamplesStcWindow;
             }
-            else
-                data = p_fiffEvoked.data.block(0, curSample, t_iNumSensors, m_iSamplesStcWindow);
+            data = p_fiffEvoked.data.block(0, t_iWindowStart, t_iNumSensors, m_iSamplesStcWindow);
 
 
             curSample += (m_iSamplesStcWindow - t_iSamplesOverlap);
@@ -290,7 +295,18 @@ MNESourceEstimate RapMusic::calculateInverse(const FiffEvoked &p_fiffEvoked, boo
                 curSample -= t_iSamplesDiscard; //shift on start t_iSamplesDiscard backwards
 
             //Calculate
-            calculateInverse(data, t_RapDipoles);
+            if(m_bStreaming && m_bIsInit)
+            {
+                //signal subspace from the incrementally updated F F^T of the overlapping windows
+                updateScatter(p_fiffEvoked.data, t_iScatterStart, t_iWindowStart, m_iSamplesStcWindow, t_matScatter);
+                t_iScatterStart = t_iWindowStart;
+
+                MatrixXT t_matPhi_s;
+                int t_r = calcPhi_sFromScatter(t_matScatter, m_iSamplesStcWindow, t_matPhi_s);
+                calcDipolePairs(t_matPhi_s, t_r, t_RapDipoles);
+            }
+            else
+                calculateInverse(data, t_RapDipoles);
 
             //Assign Result
             if(last)
@@ -415,11 +431,29 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
     MatrixXT* t_pMatPhi_s = NULL;//(m_iNumChannels, m_iN < t_r ? m_iN : t_r);
     int t_r = calcPhi_s(/*(MatrixXT)*/p_matMeasurement, t_pMatPhi_s);
 
-    int t_iMaxSearch = m_iN < t_r ? m_iN : t_r; //The smallest of Rank and Iterations
+    calcDipolePairs(*t_pMatPhi_s, t_r, p_RapDipoles);
+
+    end = clock();
 
-    if (t_r < m_iN)
+    float t_fElapsedTime = ( (float)(end-start) / (float)CLOCKS_PER_SEC ) * 1000.0f;
+    std::cout << "Total Time Elapsed: " << t_fElapsedTime << " ms" << std::endl << std::endl;
+
+    //garbage collecting
+    delete t_pMatPhi_s;
+
+    return p_SourceEstimate;
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::calcDipolePairs(const MatrixXT& p_matPhi_s, int p_iRank, QList< DipolePair<double> > &p_RapDipoles) const
+{
+    int t_iMaxSearch = m_iN < p_iRank ? m_iN : p_iRank; //The smallest of Rank and Iterations
+
+    if (p_iRank < m_iN)
     {
-        std::cout << "Warning: Rank " << t_r << " of the measurement data is smaller than the " << m_iN;
+        std::cout << "Warning: Rank " << p_iRank << " of the measurement data is smaller than the " << m_iN;
         std::cout << " sources to find." << std::endl;
         std::cout << "         Searching now for " << t_iMaxSearch << " correlated sources.";
         std::cout << std::endl << std::endl;
@@ -452,16 +486,11 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
 
     std::cout << "##### Calculation of RAP MUSIC started ######\n\n";
 
-    MatrixXT t_matProj_Phi_s(t_matOrthProj.rows(), t_pMatPhi_s->cols());
-    //new Version: Calculate projection before
-    MatrixXT t_matProj_LeadField(m_ForwardSolution.sol->data.rows(), m_ForwardSolution.sol->data.cols());
+    MatrixXT t_matProj_Phi_s(t_matOrthProj.rows(), p_matPhi_s.cols());
 
     for(int r = 0; r < t_iMaxSearch ; ++r)
     {
-        t_matProj_Phi_s = t_matOrthProj*(*t_pMatPhi_s);
-
-        //new Version: Calculating Projection before
-        t_matProj_LeadField = t_matOrthProj * m_ForwardSolution.sol->data;//Subtract the found sources from the current found source
+        t_matProj_Phi_s = t_matOrthProj*(p_matPhi_s);
 
         //###First Option###
         //Step 1: lt. Mosher 1998 -> Maybe tmp_Proj_Phi_S is already orthogonal -> so no SVD needed -> U_B = tmp_Proj_Phi_S;
@@ -478,6 +507,15 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         clock_t start_subcorr, end_subcorr;
         start_subcorr = clock();
 
+        //Per source bases of the projected lead field (reused while the found sources do not change) and their
+        //projection onto the signal subspace - one decomposition per source instead of one SVD per pair
+        SubcorrBases t_bases;
+        t_bases.matQ = projectedSourceBases(r, p_RapDipoles, t_matOrthProj);
+        calcSubcorrBases(t_matU_B, t_bases);
+
+        const int* t_pIdx1 = m_vecPairIdx1.data();
+        const int* t_pIdx2 = m_vecPairIdx2.data();
+
         //Multithreading correlation calculation
         #ifdef _OPENMP
         #pragma omp parallel num_threads(m_iMaxNumThreads)
@@ -487,18 +525,7 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         #pragma omp for
         #endif
             for(int i = 0; i < m_iNumLeadFieldCombinations; i++)
-            {
-                //new Version: calculate matrix multiplication before
-                //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
-                MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
-
-                int idx1 = m_ppPairIdxCombinations[i]->x1;
-                int idx2 = m_ppPairIdxCombinations[i]->x2;
-
-                RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
-
-                t_vecRoh(i) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
-            }
+                t_vecRoh(i) = RapMusic::subcorrPair(t_bases, t_pIdx1[i], t_pIdx2[i]);//t_vecRoh holds the correlations roh_k
         }
 
 
@@ -532,8 +559,8 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         t_val_roh_k = t_vecRoh.maxCoeff(&t_iMaxIdx);//p_vecCor = ^roh_k
 
         //get positions in sparsed leadfield from index combinations;
-        int t_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
-        int t_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
+        int t_iIdx1 = m_vecPairIdx1[t_iMaxIdx];
+        int t_iIdx2 = m_vecPairIdx2[t_iMaxIdx];
 
         // (Idx+1) because of MATLAB positions -> starting with 1 not with 0
         std::cout << "Iteration: " << r+1 << " of " << t_iMaxSearch
@@ -575,16 +602,6 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
     }
 
     std::cout << "##### Calculation of RAP MUSIC completed ######"<< std::endl << std::endl << std::endl;
-
-    end = clock();
-
-    float t_fElapsedTime = ( (float)(end-start) / (float)CLOCKS_PER_SEC ) * 1000.0f;
-    std::cout << "Total Time Elapsed: " << t_fElapsedTime << " ms" << std::endl << std::endl;
-
-    //garbage collecting
-    delete t_pMatPhi_s;
-
-    return p_SourceEstimate;
 }
 
 
@@ -751,6 +768,218 @@ double RapMusic::subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B, Vecto
 }
 
 
+//*************************************************************************************************************
+
+void RapMusic::calcSourceBases(const MatrixXT& p_matProj_LeadField, MatrixXT& p_matQ) const
+{
+    const int t_iNumSources = p_matProj_LeadField.cols()/3;
+
+    //
+    //   Eigen decomposition of the 3 x 3 gram matrix of every source: G_i^T G_i = V diag(sigma^2) V^T
+    //
+    MatrixXT t_matSigma2(3, t_iNumSources);
+    MatrixXT t_matV(3, 3*t_iNumSources);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for num_threads(m_iMaxNumThreads)
+    #endif
+    for(int i = 0; i < t_iNumSources; ++i)
+    {
+        Matrix3T t_matGram = p_matProj_LeadField.middleCols<3>(3*i).transpose() * p_matProj_LeadField.middleCols<3>(3*i);
+        Eigen::SelfAdjointEigenSolver<Matrix3T> t_eig;
+        t_eig.computeDirect(t_matGram);
+        t_matSigma2.col(i) = t_eig.eigenvalues();
+        t_matV.middleCols<3>(3*i) = t_eig.eigenvectors();
+    }
+
+    //lt. Mosher 1998: Only retain the components with nonzero singular values. Relative to the strongest source,
+    //so that sources which are projected out by the found ones drop out completely.
+    const double t_dMinSigma2 = 1e-10 * (t_iNumSources > 0 ? t_matSigma2.maxCoeff() : 0.0);
+
+    //
+    //   Q_i = G_i V diag(1/sigma), zero columns for the dropped components
+    //
+    p_matQ.resize(p_matProj_LeadField.rows(), 3*t_iNumSources);
+
+    #ifdef _OPENMP
+    #pragma omp parallel for num_threads(m_iMaxNumThreads)
+    #endif
+    for(int i = 0; i < t_iNumSources; ++i)
+    {
+        Matrix3T t_matScaledV = t_matV.middleCols<3>(3*i);
+        for(int k = 0; k < 3; ++k)
+        {
+            if(t_matSigma2(k,i) > t_dMinSigma2)
+                t_matScaledV.col(k) /= sqrt(t_matSigma2(k,i));
+            else
+                t_matScaledV.col(k).setZero();
+        }
+        p_matQ.middleCols<3>(3*i).noalias() = p_matProj_LeadField.middleCols<3>(3*i) * t_matScaledV;
+    }
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::calcSubcorrBases(const MatrixXT& p_matU_B, SubcorrBases& p_bases) const
+{
+    const int t_iNumSources = p_bases.matQ.cols()/3;
+
+    //
+    //   Projection onto the signal subspace for all sources with one product
+    //
+    p_bases.matW.noalias() = p_matU_B.transpose() * p_bases.matQ;
+
+    p_bases.matS.resize(3, 3*t_iNumSources);
+    for(int i = 0; i < t_iNumSources; ++i)
+        p_bases.matS.middleCols<3>(3*i).noalias() = p_bases.matW.middleCols<3>(3*i).transpose() * p_bases.matW.middleCols<3>(3*i);
+}
+
+
+//*************************************************************************************************************
+
+const RapMusic::MatrixXT& RapMusic::projectedSourceBases(int p_iIteration, const QList< DipolePair<double> > &p_RapDipoles, const MatrixXT& p_matOrthProj) const
+{
+    //the first iteration scans the unprojected lead field, its bases are computed once in init
+    if(p_iIteration == 0)
+        return m_matSourceBases;
+
+    if(m_qVecProjectionCache.size() < p_iIteration)
+        m_qVecProjectionCache.resize(p_iIteration);
+    ProjectionCacheEntry &t_entry = m_qVecProjectionCache[p_iIteration-1];
+
+    //the dipole pairs the projector is built from
+    VectorXi t_vecIdx(2*p_iIteration);
+    MatrixXT t_matPhi(6, p_iIteration);
+    for(int i = 0; i < p_iIteration; ++i)
+    {
+        t_vecIdx[2*i] = p_RapDipoles[i].m_iIdx1;
+        t_vecIdx[2*i+1] = p_RapDipoles[i].m_iIdx2;
+        t_matPhi.col(i) << p_RapDipoles[i].m_Dipole1.phi_x(), p_RapDipoles[i].m_Dipole1.phi_y(), p_RapDipoles[i].m_Dipole1.phi_z(),
+                           p_RapDipoles[i].m_Dipole2.phi_x(), p_RapDipoles[i].m_Dipole2.phi_y(), p_RapDipoles[i].m_Dipole2.phi_z();
+    }
+
+    //
+    //   Streaming: reuse the projection while the same pairs are found with (almost) the same orientation. The
+    //   orientations are unit vectors and their sign does not change the projector.
+    //
+    if(m_bStreaming && t_entry.vecIdx.size() == t_vecIdx.size() && t_entry.vecIdx == t_vecIdx)
+    {
+        bool t_bReuse = true;
+        for(int i = 0; i < p_iIteration && t_bReuse; ++i)
+            t_bReuse = fabs(t_entry.matPhi.col(i).dot(t_matPhi.col(i))) >= 1.0 - m_dOrientationTolerance;
+
+        if(t_bReuse)
+            return t_entry.matQ;
+    }
+
+    calcSourceBases(p_matOrthProj * m_ForwardSolution.sol->data, t_entry.matQ);//Subtract the found sources from the current found source
+    t_entry.vecIdx = t_vecIdx;
+    t_entry.matPhi = t_matPhi;
+
+    return t_entry.matQ;
+}
+
+
+//*************************************************************************************************************
+
+int RapMusic::calcPhi_sFromScatter(const MatrixXT& p_matScatter, int p_iSamples, MatrixXT& p_matPhi_s) const
+{
+    //the eigenvectors of F F^T are the left singular vectors of F
+    Eigen::SelfAdjointEigenSolver<MatrixXT> t_eigScatter(p_matScatter);
+
+    const VectorXT &t_vecEig = t_eigScatter.eigenvalues();//ascending
+    const int t_iSize = t_vecEig.size();
+
+    //rank like calcPhi_s: getRank is applied to the singular values of F F^T for long windows and to the ones of F
+    //itself when the window has no more samples than channels, sqrt(eig) > epsilon <=> eig > epsilon^2
+    const double t_dEpsilon = p_iSamples <= p_matScatter.rows() ? 0.00001*0.00001 : 0.00001;
+    int t_r = 0;
+    while(t_r < t_iSize && t_vecEig(t_iSize-1-t_r) > t_dEpsilon)
+        ++t_r;
+    if(t_r == 0)
+        t_r = 1;
+
+    p_matPhi_s = t_eigScatter.eigenvectors().rightCols(t_r).rowwise().reverse();
+
+    return t_r;
+}
+
+
+//*************************************************************************************************************
+
+void RapMusic::updateScatter(const MatrixXT& p_matData, int p_iOldStart, int p_iNewStart, int p_iWindow, MatrixXT& p_matScatter)
+{
+    const int t_iOldEnd = p_iOldStart + p_iWindow;
+
+    //no overlap with the previous window -> start from scratch
+    if(p_iOldStart < 0 || p_iNewStart < p_iOldStart || p_iNewStart >= t_iOldEnd || p_matScatter.rows() != p_matData.rows())
+    {
+        p_matScatter = MatrixXT::Zero(p_matData.rows(), p_matData.rows());
+        p_matScatter.selfadjointView<Eigen::Lower>().rankUpdate(p_matData.middleCols(p_iNewStart, p_iWindow));
+        return;
+    }
+
+    //remove the samples which left the window, add the ones which entered it
+    const int t_iShift = p_iNewStart - p_iOldStart;
+    if(t_iShift > 0)
+    {
+        p_matScatter.selfadjointView<Eigen::Lower>().rankUpdate(p_matData.middleCols(p_iOldStart, t_iShift), -1.0);
+        p_matScatter.selfadjointView<Eigen::Lower>().rankUpdate(p_matData.middleCols(t_iOldEnd, t_iShift));
+    }
+}
+
+
+//*************************************************************************************************************
+
+double RapMusic::subcorrPair(const SubcorrBases& p_bases, int p_iIdx1, int p_iIdx2)
+{
+    //components of the second source which are (nearly) contained in the first source are dropped
+    static const double t_dMinResidual = 1e-8;
+
+    const Matrix3T t_matS11 = p_bases.matS.middleCols<3>(3*p_iIdx1);
+    const Matrix3T t_matS22 = p_bases.matS.middleCols<3>(3*p_iIdx2);
+
+    //C = Q_1^T Q_2 and X = W_1^T W_2
+    const Matrix3T t_matC = p_bases.matQ.middleCols<3>(3*p_iIdx1).transpose() * p_bases.matQ.middleCols<3>(3*p_iIdx2);
+    const Matrix3T t_matX = p_bases.matW.middleCols<3>(3*p_iIdx1).transpose() * p_bases.matW.middleCols<3>(3*p_iIdx2);
+
+    //
+    //   Orthogonalize Q_2 against Q_1: Q_2' = (Q_2 - Q_1 C) T with T^T (I - C^T C) T = I on the kept components
+    //
+    Eigen::SelfAdjointEigenSolver<Matrix3T> t_eigResidual;
+    t_eigResidual.computeDirect(Matrix3T::Identity() - t_matC.transpose() * t_matC);
+
+    Matrix3T t_matT = t_eigResidual.eigenvectors();
+    for(int k = 0; k < 3; ++k)
+    {
+        double t_dResidual = t_eigResidual.eigenvalues()(k);
+        if(t_dResidual > t_dMinResidual)
+            t_matT.col(k) /= sqrt(t_dResidual);
+        else
+            t_matT.col(k).setZero();
+    }
+
+    //
+    //   M = [W_1 W_2']^T [W_1 W_2'] with W_2' = (W_2 - W_1 C) T
+    //
+    const Matrix3T t_matS1C = t_matS11 * t_matC;
+    const Matrix3T t_matXC = t_matC.transpose() * t_matX;
+
+    Matrix6T t_matM;
+    t_matM.topLeftCorner<3,3>() = t_matS11;
+    t_matM.topRightCorner<3,3>() = (t_matX - t_matS1C) * t_matT;
+    t_matM.bottomLeftCorner<3,3>() = t_matM.topRightCorner<3,3>().transpose();
+    t_matM.bottomRightCorner<3,3>() = t_matT.transpose() * (t_matS22 - t_matXC - t_matXC.transpose() + t_matC.transpose() * t_matS1C) * t_matT;
+
+    Eigen::SelfAdjointEigenSolver<Matrix6T> t_eigM(t_matM, Eigen::EigenvaluesOnly);
+
+    //the largest singular value of U_A^T U_B
+    double t_dMaxEig = t_eigM.eigenvalues()(5);
+    return t_dMaxEig > 0 ? sqrt(t_dMaxEig) : 0.0;
+}
+
+
 //*************************************************************************************************************
 
 void RapMusic::calcA_k_1(   const MatrixX6T& p_matG_k_1,
@@ -814,29 +1043,22 @@ void RapMusic::calcOrthProj(const MatrixXT& p_matA_k_1, MatrixXT& p_matOrthProj)
 
 void RapMusic::calcPairCombinations(    const int p_iNumPoints,
                                         const int p_iNumCombinations,
-                                        Pair** p_ppPairIdxCombinations) const
+                                        VectorXi& p_vecPairIdx1,
+                                        VectorXi& p_vecPairIdx2) const
 {
-    int idx1 = 0;
-    int idx2 = 0;
+    p_vecPairIdx1.resize(p_iNumCombinations);
+    p_vecPairIdx2.resize(p_iNumCombinations);
 
     //Process Code in {m_max_num_threads} threads -> When compile with Intel Compiler -> probably obsolete
     #ifdef _OPENMP
-    #pragma omp parallel num_threads(m_iMaxNumThreads) private(idx1, idx2)
+    #pragma omp parallel num_threads(m_iMaxNumThreads)
     #endif
     {
     #ifdef _OPENMP
     #pragma omp for
     #endif
         for (int i = 0; i < p_iNumCombinations; ++i)
-        {
-            RapMusic::getPointPair(p_iNumPoints, i, idx1, idx2);
-
-            Pair* t_pairCombination = new Pair();
-            t_pairCombination->x1 = idx1;
-            t_pairCombination->x2 = idx2;
-
-            p_ppPairIdxCombinations[i] = t_pairCombination;
-        }
+            RapMusic::getPointPair(p_iNumPoints, i, p_vecPairIdx1[i], p_vecPairIdx2[i]);
     }
 }
 
@@ -907,3 +1129,15 @@ void RapMusic::setStcAttr(int p_iSampStcWin, float p_fStcOverlap)
     m_iSamplesStcWindow = p_iSampStcWin;
     m_fStcOverlap = p_fStcOverlap;
 }
+
+
+//*************************************************************************************************************
+
+void RapMusic::setStreaming(bool p_bStreaming, double p_dOrientationTolerance)
+{
+    m_bStreaming = p_bStreaming;
+    m_dOrientationTolerance = p_dOrientationTolerance;
+
+    if(!m_bStreaming)
+        m_qVecProjectionCache.clear();
+}
@@ -61,6 +61,7 @@
 #include <Eigen/Core>
 #include <Eigen/SVD>
 #include <Eigen/LU>
+#include <Eigen/Eigenvalues>
 
 
 //*************************************************************************************************************
@@ -88,18 +89,6 @@ using namespace MNELIB;
 #define IS_TRANSPOSED   1   /**< Defines IS_TRANSPOSED */
 
 
-//=============================================================================================================
-/**
-* Declares a pair structure for index combinations used in RAP MUSIC algorithm.
-*/
-typedef struct Pair
-{
-    int x1; /**< Index one of the pair. */
-    int x2; /**< Index two of the pair. */
-} Pair;
-
-
-
 //=============================================================================================================
 /**
 * @brief    The RapMusic class provides the RAP MUSIC Algorithm CPU implementation. ToDo: Paper references.
@@ -129,6 +118,8 @@ public:
                                                                              1> as VectorXT type. */
     typedef Eigen::Matrix<double, 6, 1> Vector6T;                            /**< Defines Eigen::Matrix<T, 6, 1>
                                                                              as Vector6T type. */
+    typedef Eigen::Matrix<double, 3, 3> Matrix3T;                            /**< Defines Eigen::Matrix<T, 3, 3>
+                                                                             as Matrix3T type. */
 
 
     //=========================================================================================================
@@ -183,6 +174,20 @@ public:
     */
     void setStcAttr(int p_iSampStcWin, float p_fStcOverlap);
 
+    //=========================================================================================================
+    /**
+    * Enables the streaming mode for sliding window localizations (see setStcAttr) and repeated calls with
+    * updated evoked data. The signal subspace of overlapping windows is derived from F F^T, which is updated
+    * with the samples entering and leaving the window instead of being recomputed, and the projected lead field
+    * of an iteration is reused as long as the same dipole pairs are found with the same orientation.
+    * The projection cache makes calculateInverse non-reentrant for one instance.
+    *
+    * @param[in] p_bStreaming               Whether to use the streaming mode.
+    * @param[in] p_dOrientationTolerance    Projections are reused while 1 - |cos| of the angle between the old
+    *                                       and the new orientation of every found pair is below this value.
+    */
+    void setStreaming(bool p_bStreaming, double p_dOrientationTolerance = 1e-3);
+
 protected:
     //=========================================================================================================
     /**
@@ -228,6 +233,101 @@ protected:
     */
     static double subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B, Vector6T& p_vec_phi_k_1);
 
+    //=========================================================================================================
+    /**
+    * Per iteration data of the batched subspace correlation: an orthonormal basis of every projected source
+    * (calcSourceBases) and its projection onto the signal subspace (calcSubcorrBases). Afterwards each pair
+    * correlation only needs 3 x 3 products and one 6 x 6 eigenvalue problem.
+    */
+    struct SubcorrBases
+    {
+        MatrixXT matQ;  /**< Orthonormal basis Q_i of each projected source, 3 columns per source (m x 3n). Columns
+                             beyond the rank of a source are zero. */
+        MatrixXT matW;  /**< W = U_B^T * Q (r x 3n). */
+        MatrixXT matS;  /**< W_i^T * W_i of each source, stacked (3 x 3n). */
+    };
+
+    //=========================================================================================================
+    /**
+    * Computes an orthonormal basis of every source of the (projected) lead field. Independent of the data.
+    *
+    * @param[in] p_matProj_LeadField    The projected lead field (m x 3n).
+    * @param[out] p_matQ                The bases, 3 columns per source, see SubcorrBases::matQ.
+    */
+    void calcSourceBases(const MatrixXT& p_matProj_LeadField, MatrixXT& p_matQ) const;
+
+    //=========================================================================================================
+    /**
+    * Projects the source bases p_bases.matQ onto the signal subspace for the batched subspace correlation.
+    *
+    * @param[in] p_matU_B       The matrix U is the subspace projection of the orthogonal projected Phi_s
+    * @param[in, out] p_bases   The per source bases, matQ has to be set.
+    */
+    void calcSubcorrBases(const MatrixXT& p_matU_B, SubcorrBases& p_bases) const;
+
+    //=========================================================================================================
+    /**
+    * Returns the source bases of the lead field projected with the projector of iteration p_iIteration. The
+    * unprojected bases are computed in init; in streaming mode the projected ones are reused while the
+    * dipole pairs the projector is built from do not change.
+    *
+    * @param[in] p_iIteration   The current iteration r.
+    * @param[in] p_RapDipoles   The dipole pairs found so far (at least p_iIteration).
+    * @param[in] p_matOrthProj  The orthogonal projector of the iteration.
+    * @return   The source bases of the projected lead field.
+    */
+    const MatrixXT& projectedSourceBases(int p_iIteration, const QList< DipolePair<double> > &p_RapDipoles, const MatrixXT& p_matOrthProj) const;
+
+    //=========================================================================================================
+    /**
+    * Searches the correlated dipole pairs in the signal subspace Phi_s. This is the RAP MUSIC scan, which is
+    * replaced by the Powell search in PwlRapMusic.
+    *
+    * @param[in] p_matPhi_s     The signal subspace.
+    * @param[in] p_iRank        The rank of the measurement.
+    * @param[out] p_RapDipoles  The found dipole pairs.
+    */
+    virtual void calcDipolePairs(const MatrixXT& p_matPhi_s, int p_iRank, QList< DipolePair<double> > &p_RapDipoles) const;
+
+    //=========================================================================================================
+    /**
+    * Computes the signal subspace Phi_s out of the scatter matrix F F^T of the measurement.
+    *
+    * @param[in] p_matScatter   F F^T, only the lower triangle is used.
+    * @param[in] p_iSamples     Number of samples of F, selects the rank threshold like calcPhi_s.
+    * @param[out] p_matPhi_s    The calculated signal subspace.
+    * @return   The rank of the measurement F
+    */
+    int calcPhi_sFromScatter(const MatrixXT& p_matScatter, int p_iSamples, MatrixXT& p_matPhi_s) const;
+
+    //=========================================================================================================
+    /**
+    * Moves the window of the scatter matrix F F^T (lower triangle) from p_iOldStart to p_iNewStart by
+    * downdating the samples which left the window and updating the ones which entered it. Starts from scratch
+    * if the windows do not overlap or p_iOldStart is negative.
+    *
+    * @param[in] p_matData          The complete data.
+    * @param[in] p_iOldStart        First sample of the current window, -1 if there is none.
+    * @param[in] p_iNewStart        First sample of the new window.
+    * @param[in] p_iWindow          Number of samples per window.
+    * @param[in, out] p_matScatter  The scatter matrix.
+    */
+    static void updateScatter(const MatrixXT& p_matData, int p_iOldStart, int p_iNewStart, int p_iWindow, MatrixXT& p_matScatter);
+
+    //=========================================================================================================
+    /**
+    * Computes the subspace correlation of the source pair (p_iIdx1, p_iIdx2) from the per source bases. The
+    * second basis is orthogonalized against the first in closed form (3 x 3), the correlation is the square
+    * root of the largest eigenvalue of the 6 x 6 matrix [W_1 W_2']^T [W_1 W_2']. No memory is allocated, which
+    * makes it safe and cheap to call from the parallel pair loop.
+    *
+    * @param[in] p_bases    The per source bases of the current iteration.
+    * @param[in] p_iIdx1    first Lead Field index point
+    * @param[in] p_iIdx2    second Lead Field index point
+    * @return   The maximal correlation c_1 of the subspace correlation of the pair and the projected measurement.
+    */
+    static double subcorrPair(const SubcorrBases& p_bases, int p_iIdx1, int p_iIdx2);
+
     //=========================================================================================================
     /**
     * Calculates the accumulated manifold vectors A_{k1}
@@ -259,13 +359,14 @@ protected:
     *
     * @param[in] p_iNumPoints   The number of Lead Field points -> for dimension check
     * @param[in] p_iNumCombinations The number of pair index combinations.
-    * @param[out] p_ppPairIdxCombinations   The destination which contains pointer to pointer of index
-    *                                       combinations of Lead Field indices -> Number of pointers =
-    *                                       Combination (number of grid points over 2 = Num + 1 C 2)
+    * @param[out] p_vecPairIdx1 First Lead Field index of each combination (number of grid points over 2 =
+    *                           Num + 1 C 2 entries)
+    * @param[out] p_vecPairIdx2 Second Lead Field index of each combination
     */
     void calcPairCombinations(  const int p_iNumPoints,
                                 const int p_iNumCombinations,
-                                Pair** p_ppPairIdxCombinations) const;
+                                VectorXi& p_vecPairIdx1,
+                                VectorXi& p_vecPairIdx2) const;
 
     //=========================================================================================================
     /**
@@ -324,7 +425,8 @@ protected:
     int m_iNumChannels;                 /**< Number of channels */
     int m_iNumLeadFieldCombinations;    /**< Number of Lead Filed combinations (grid points + 1 over 2)*/
 
-    Pair** m_ppPairIdxCombinations; /**< Index combination vector with grid pair indices. */
+    VectorXi m_vecPairIdx1;         /**< First grid index of each pair combination. */
+    VectorXi m_vecPairIdx2;         /**< Second grid index of each pair combination. */
 
     int m_iMaxNumThreads;   /**< Number of available CPU threads. */
 
@@ -334,6 +436,22 @@ protected:
     int m_iSamplesStcWindow;    /**< Number of samples per localization window */
     float m_fStcOverlap;        /**< Percentage of localization window overlap */
 
+    //=========================================================================================================
+    /**
+    * A projected lead field of one iteration, identified by the dipole pairs the projector is built from
+    */
+    struct ProjectionCacheEntry
+    {
+        VectorXi vecIdx;    /**< Grid indices of the found pairs (2 per pair). */
+        MatrixXT matPhi;    /**< Orientations of the found pairs (6 x pairs). */
+        MatrixXT matQ;      /**< Source bases of the projected lead field. */
+    };
+
+    MatrixXT m_matSourceBases;                                      /**< Source bases of the unprojected lead field. */
+    bool m_bStreaming;                                              /**< Whether the streaming mode is used. */
+    double m_dOrientationTolerance;                                 /**< Orientation tolerance for reusing projections. */
+    mutable QVector<ProjectionCacheEntry> m_qVecProjectionCache;    /**< Projected source bases per iteration r >= 1. */
+
     //=========================================================================================================
     /**
     * Returns the rank r of a singular value matrix based on non-zero singular values
@@ -58,8 +58,21 @@
 //=============================================================================================================
 
 #include <iostream>
+#include <limits>
+#include <time.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
 #include <QtConcurrent>
 #include <QFuture>
+#include <QHash>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
 
 
 //*************************************************************************************************************
@@ -72,6 +85,304 @@ using namespace UTILSLIB;
 using namespace FSLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+namespace
+{
+
+const quint32 CLUSTER_CACHE_MAGIC = 0x4d434c55;    /**< "MCLU" */
+const qint32 CLUSTER_CACHE_VERSION = 1;             /**< Bump when the cache layout or the clustering changes */
+
+//=============================================================================================================
+/**
+* Gathers the xyz column triplets of the given sources into one contiguous sensors x 3*sources buffer.
+*/
+void gatherRegion(const MatrixXd &p_matG, const VectorXi &p_vecIdcs, qint32 p_iOffset, MatrixXd &p_matRegion)
+{
+    p_matRegion.resize(p_matG.rows(), 3*p_vecIdcs.size());
+    for(qint32 j = 0; j < p_vecIdcs.size(); ++j)
+        p_matRegion.middleCols(3*j, 3) = p_matG.middleCols(3*(p_vecIdcs[j] + p_iOffset), 3);
+}
+
+
+//=============================================================================================================
+/**
+* Swaps the region layout between sensors x sources(x,y,z) and sources x sensors(x,y,z), i.e.
+* p_matOut(k, 3*j+c) = p_matIn(j, 3*k+c). The operation is its own inverse. It is done as three strided
+* block transposes, one per orientation, instead of 1x3 block copies.
+*/
+void swapRegionLayout(const MatrixXd &p_matIn, MatrixXd &p_matOut)
+{
+    const qint32 nRows = p_matIn.rows();
+    const qint32 nTriplets = p_matIn.cols()/3;
+    p_matOut.resize(nTriplets, 3*nRows);
+
+    for(qint32 c = 0; c < 3; ++c)
+        Map<MatrixXd, 0, OuterStride<> >(p_matOut.data() + c*nTriplets, nTriplets, nRows, OuterStride<>(3*nTriplets))
+                = Map<const MatrixXd, 0, OuterStride<> >(p_matIn.data() + c*nRows, nRows, nTriplets, OuterStride<>(3*nRows)).transpose();
+}
+
+
+//=============================================================================================================
+/**
+* One KMeans replicate of one region. Replicates of all regions are mapped together, so large regions
+* don't serialize the tail of the clustering.
+*/
+struct RegionReplicate
+{
+    const RegionData*   pRegion;    /**< Region to cluster */
+    quint32             iSeed;      /**< Seed of this replicate */
+};
+
+
+//=============================================================================================================
+
+RegionDataOut clusterReplicate(const RegionReplicate &p_replicate)
+{
+    return p_replicate.pRegion->cluster(1, p_replicate.iSeed);
+}
+
+
+//=============================================================================================================
+
+template<typename T>
+void writeMatrix(QDataStream &p_stream, const T &p_mat)
+{
+    p_stream << (qint32)p_mat.rows() << (qint32)p_mat.cols();
+    p_stream.writeRawData(reinterpret_cast<const char*>(p_mat.data()), p_mat.size()*sizeof(typename T::Scalar));
+}
+
+
+//=============================================================================================================
+
+template<typename T>
+bool readMatrix(QDataStream &p_stream, T &p_mat)
+{
+    qint32 rows, cols;
+    p_stream >> rows >> cols;
+    if(p_stream.status() != QDataStream::Ok || rows < 0 || cols < 0)
+        return false;
+    p_mat.resize(rows, cols);
+    qint64 nBytes = p_mat.size()*sizeof(typename T::Scalar);
+    return p_stream.readRawData(reinterpret_cast<char*>(p_mat.data()), nBytes) == nBytes;
+}
+
+
+//=============================================================================================================
+/**
+* Hashes everything the clustering result depends on: the gain matrix and source space, the annotation,
+* the cluster size and, if whitening is used, the noise covariance and channel selection.
+*/
+QByteArray clusterCacheKey(const MNEForwardSolution &p_fwd, const AnnotationSet &p_AnnotationSet, qint32 p_iClusterSize, const FiffCov &p_noiseCov, const FiffInfo &p_info)
+{
+    QCryptographicHash t_hash(QCryptographicHash::Sha1);
+
+    QByteArray t_header;
+    QDataStream t_stream(&t_header, QIODevice::WriteOnly);
+    t_stream << CLUSTER_CACHE_VERSION << p_iClusterSize << (qint32)p_fwd.sol->data.rows() << (qint32)p_fwd.sol->data.cols();
+    t_hash.addData(t_header);
+
+    t_hash.addData(reinterpret_cast<const char*>(p_fwd.sol->data.data()), p_fwd.sol->data.size()*sizeof(double));
+    for(qint32 h = 0; h < p_fwd.src.size(); ++h)
+    {
+        const VectorXi &vertno = p_fwd.src[h].vertno;
+        t_hash.addData(reinterpret_cast<const char*>(vertno.data()), vertno.size()*sizeof(int));
+
+        VectorXi t_vecLabelIds = p_AnnotationSet[h].getLabelIds();
+        VectorXi t_vecColortableIds = p_AnnotationSet[h].getColortable().getLabelIds();
+        t_hash.addData(reinterpret_cast<const char*>(t_vecLabelIds.data()), t_vecLabelIds.size()*sizeof(int));
+        t_hash.addData(reinterpret_cast<const char*>(t_vecColortableIds.data()), t_vecColortableIds.size()*sizeof(int));
+    }
+
+    if(!p_noiseCov.isEmpty() && !p_info.isEmpty())
+    {
+        t_hash.addData(reinterpret_cast<const char*>(p_noiseCov.data.data()), p_noiseCov.data.size()*sizeof(double));
+        t_hash.addData((p_noiseCov.names.join(",") + ";" + p_info.ch_names.join(",") + ";" + p_info.bads.join(",")).toUtf8());
+    }
+
+    return t_hash.result();
+}
+
+
+//=============================================================================================================
+/**
+* Stores the clustered parts of p_fwdOut, i.e. the clustered gain matrix, vertno and cluster info.
+* The cluster operator is cheap to rebuild and is not stored.
+*/
+bool writeClusterCache(const QString &p_sFileName, const QByteArray &p_key, const MNEForwardSolution &p_fwdOut)
+{
+    QSaveFile t_file(p_sFileName);
+    if(!t_file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream t_stream(&t_file);
+    t_stream.setVersion(QDataStream::Qt_5_0);
+
+    t_stream << CLUSTER_CACHE_MAGIC << CLUSTER_CACHE_VERSION << (qint32)Q_BYTE_ORDER << p_key;
+    t_stream << (qint32)p_fwdOut.src.size();
+    for(qint32 h = 0; h < p_fwdOut.src.size(); ++h)
+    {
+        const MNEClusterInfo &info = p_fwdOut.src[h].cluster_info;
+        writeMatrix(t_stream, p_fwdOut.src[h].vertno);
+        t_stream << info.clusterLabelNames << info.clusterLabelIds << info.centroidVertno;
+
+        t_stream << (qint32)info.clusterVertnos.size();
+        for(qint32 i = 0; i < info.clusterVertnos.size(); ++i)
+        {
+            writeMatrix(t_stream, info.centroidSource_rr[i]);
+            writeMatrix(t_stream, info.clusterVertnos[i]);
+            writeMatrix(t_stream, info.clusterSource_rr[i]);
+            writeMatrix(t_stream, info.clusterDistances[i]);
+        }
+    }
+    writeMatrix(t_stream, p_fwdOut.sol->data);
+
+    return t_stream.status() == QDataStream::Ok && t_file.commit();
+}
+
+
+//=============================================================================================================
+/**
+* Loads a cluster cache written by writeClusterCache into p_fwdOut, a copy of the unclustered forward solution.
+* Returns false without touching p_fwdOut if the file is missing, stale or damaged.
+*/
+bool readClusterCache(const QString &p_sFileName, const QByteArray &p_key, MNEForwardSolution &p_fwdOut)
+{
+    QFile t_file(p_sFileName);
+    if(!t_file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream t_stream(&t_file);
+    t_stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    qint32 version, byteOrder, nHemis;
+    QByteArray key;
+    t_stream >> magic >> version >> byteOrder >> key >> nHemis;
+    if(t_stream.status() != QDataStream::Ok || magic != CLUSTER_CACHE_MAGIC || version != CLUSTER_CACHE_VERSION
+            || byteOrder != Q_BYTE_ORDER || key != p_key || nHemis != p_fwdOut.src.size())
+        return false;
+
+    QList<VectorXi> t_qListVertno;
+    QList<MNEClusterInfo> t_qListInfo;
+    for(qint32 h = 0; h < nHemis; ++h)
+    {
+        VectorXi vertno;
+        MNEClusterInfo info;
+        if(!readMatrix(t_stream, vertno))
+            return false;
+        t_stream >> info.clusterLabelNames >> info.clusterLabelIds >> info.centroidVertno;
+
+        qint32 nClusters;
+        t_stream >> nClusters;
+        if(t_stream.status() != QDataStream::Ok || nClusters < 0)
+            return false;
+        for(qint32 i = 0; i < nClusters; ++i)
+        {
+            MatrixXf centroid_rr;
+            VectorXi clusterVertnos;
+            MatrixXf clusterSource_rr;
+            VectorXd clusterDistances;
+            if(!readMatrix(t_stream, centroid_rr) || centroid_rr.size() != 3 || !readMatrix(t_stream, clusterVertnos)
+                    || !readMatrix(t_stream, clusterSource_rr) || clusterSource_rr.cols() != 3 || !readMatrix(t_stream, clusterDistances))
+                return false;
+
+            info.centroidSource_rr.append(Map<const Vector3f>(centroid_rr.data()));
+            info.clusterVertnos.append(clusterVertnos);
+            info.clusterSource_rr.append(clusterSource_rr);
+            info.clusterDistances.append(clusterDistances);
+        }
+        t_qListVertno.append(vertno);
+        t_qListInfo.append(info);
+    }
+
+    MatrixXd t_G;
+    if(!readMatrix(t_stream, t_G))
+        return false;
+
+    for(qint32 h = 0; h < nHemis; ++h)
+    {
+        p_fwdOut.src[h].vertno = t_qListVertno[h];
+        p_fwdOut.src[h].cluster_info = t_qListInfo[h];
+    }
+    p_fwdOut.sol->data = t_G;
+    p_fwdOut.sol->ncol = t_G.cols();
+    p_fwdOut.nsource = p_fwdOut.sol->ncol/3;
+
+    return true;
+}
+
+
+//=============================================================================================================
+/**
+* Builds the cluster operator D (sources x clusters), which averages the sources of each cluster.
+*/
+void computeClusterOperator(const MNEForwardSolution &p_fwdIn, const MNEForwardSolution &p_fwdOut, MatrixXd &p_D)
+{
+    qint32 totalNumOfClust = 0;
+    for (qint32 h = 0; h < 2; ++h)
+        totalNumOfClust += p_fwdOut.src[h].cluster_info.clusterVertnos.size();
+
+    if(p_fwdIn.isFixedOrient())
+        p_D = MatrixXd::Zero(p_fwdIn.sol->data.cols(), totalNumOfClust);
+    else
+        p_D = MatrixXd::Zero(p_fwdIn.sol->data.cols(), totalNumOfClust*3);
+
+    QList<VectorXi> t_vertnos = p_fwdIn.src.get_vertno();
+
+//    qDebug() << "Size: " << t_vertnos[0].size()  << t_vertnos[1].size();
+//    qDebug() << "p_fwdIn.sol->data.cols(): " << p_fwdIn.sol->data.cols();
+
+    qint32 currentCluster = 0;
+    for (qint32 h = 0; h < 2; ++h)
+    {
+        int hemiOffset = h == 0 ? 0 : t_vertnos[0].size();
+        for(qint32 i = 0; i < p_fwdOut.src[h].cluster_info.clusterVertnos.size(); ++i)
+        {
+            VectorXi idx_sel;
+            MNEMath::intersect(t_vertnos[h], p_fwdOut.src[h].cluster_info.clusterVertnos[i], idx_sel);
+
+//            std::cout << "\nVertnos:\n" << t_vertnos[h] << std::endl;
+
+//            std::cout << "clusterVertnos[i]:\n" << p_fwdOut.src[h].cluster_info.clusterVertnos[i] << std::endl;
+
+            idx_sel.array() += hemiOffset;
+
+//            std::cout << "idx_sel]:\n" << idx_sel << std::endl;
+
+
+
+            double selectWeight = 1.0/idx_sel.size();
+            if(p_fwdIn.isFixedOrient())
+            {
+                for(qint32 j = 0; j < idx_sel.size(); ++j)
+                    p_D.col(currentCluster)[idx_sel(j)] = selectWeight;
+            }
+            else
+            {
+                qint32 clustOffset = currentCluster*3;
+                for(qint32 j = 0; j < idx_sel.size(); ++j)
+                {
+                    qint32 idx_sel_Offset = idx_sel(j)*3;
+                    //x
+                    p_D(idx_sel_Offset,clustOffset) = selectWeight;
+                    //y
+                    p_D(idx_sel_Offset+1, clustOffset+1) = selectWeight;
+                    //z
+                    p_D(idx_sel_Offset+2, clustOffset+2) = selectWeight;
+                }
+            }
+            ++currentCluster;
+        }
+    }
+}
+
+} // anonymous namespace
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -166,7 +477,7 @@ void MNEForwardSolution::clear()
 
 //*************************************************************************************************************
 
-MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const AnnotationSet &p_AnnotationSet, qint32 p_iClusterSize, MatrixXd& p_D, const FiffCov &p_pNoise_cov, const FiffInfo &p_pInfo) const
+MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const AnnotationSet &p_AnnotationSet, qint32 p_iClusterSize, MatrixXd& p_D, const FiffCov &p_pNoise_cov, const FiffInfo &p_pInfo, const QString &p_sCacheDir) const
 {
     MNEForwardSolution p_fwdOut = MNEForwardSolution(*this);
 
@@ -190,6 +501,24 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
 //        }
 //    }
 
+    //
+    // Load a previously clustered result
+    //
+    QByteArray t_cacheKey;
+    QString t_sCacheFile;
+    if(!p_sCacheDir.isEmpty())
+    {
+        t_cacheKey = clusterCacheKey(*this, p_AnnotationSet, p_iClusterSize, p_pNoise_cov, p_pInfo);
+        t_sCacheFile = QDir(p_sCacheDir).filePath(QString("fwd-cluster-%1.cache").arg(QString(t_cacheKey.toHex())));
+
+        if(readClusterCache(t_sCacheFile, t_cacheKey, p_fwdOut))
+        {
+            printf("Loaded clustered forward solution from %s\n", t_sCacheFile.toUtf8().constData());
+            computeClusterOperator(*this, p_fwdOut, p_D);
+            return p_fwdOut;
+        }
+    }
+
     MatrixXd t_G_Whitened(0,0);
     bool t_bUseWhitened = false;
     //
@@ -213,10 +542,14 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
     //
     // Assemble input data
     //
+    const qint32 t_iReplicates = 5;
+    quint32 t_iSeed = (quint32)time(NULL);
+
     qint32 count;
     qint32 offset;
 
-    MatrixXd t_G_new;
+    QList<MatrixXd> t_qListGPartial;
+    qint32 t_iNumClusterCols = 0;
 
     for(qint32 h = 0; h < this->src.size(); ++h )
     {
@@ -237,12 +570,22 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
         Colortable t_CurrentColorTable = p_AnnotationSet[h].getColortable();
         VectorXi label_ids = t_CurrentColorTable.getLabelIds();
 
-        // Get label ids for every vertex
-        VectorXi vertno_labeled = VectorXi::Zero(this->src[h].vertno.rows());
-
+        //
+        // Sort the sources into their labels with a single pass over the source space
+        //
         //ToDo make this more universal -> using Label instead of annotations - obsolete when using Labels
-        for(qint32 i = 0; i < vertno_labeled.rows(); ++i)
-            vertno_labeled[i] = p_AnnotationSet[h].getLabelIds()[this->src[h].vertno[i]];
+        QHash<qint32, qint32> t_qHashLabelIdx;
+        for(qint32 i = 0; i < label_ids.rows(); ++i)
+            t_qHashLabelIdx.insert(label_ids[i], i);
+
+        const VectorXi t_vecVertexLabelIds = p_AnnotationSet[h].getLabelIds();
+        QVector< QVector<qint32> > t_qVecLabelSources(label_ids.rows());
+        for(qint32 j = 0; j < this->src[h].vertno.rows(); ++j)
+        {
+            qint32 t_iLabelIdx = t_qHashLabelIdx.value(t_vecVertexLabelIds[this->src[h].vertno[j]], -1);
+            if(t_iLabelIdx >= 0)
+                t_qVecLabelSources[t_iLabelIdx].append(j);
+        }
 
         //Qt Concurrent List
         QList<RegionData> m_qListRegionDataIn;
@@ -257,63 +600,28 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
                 QString curr_name = t_CurrentColorTable.struct_names[i];//obj.label2AtlasName(label(i));
                 printf("\tCluster %d / %li %s...", i+1, label_ids.rows(), curr_name.toUtf8().constData());
 
-                //
-                // Get source space indeces
-                //
-                VectorXi idcs = VectorXi::Zero(vertno_labeled.rows());
-                qint32 c = 0;
-
-                //Select ROIs //change this use label info with a hash tabel
-                for(qint32 j = 0; j < vertno_labeled.rows(); ++j)
-                {
-                    if(vertno_labeled[j] == label_ids[i])
-                    {
-                        idcs[c] = j;
-                        ++c;
-                    }
-                }
-                idcs.conservativeResize(c);
-
-                //get selected G
-                MatrixXd t_G(this->sol->data.rows(), idcs.rows()*3);
-                MatrixXd t_G_Whitened_Roi(t_G_Whitened.rows(), idcs.rows()*3);
-
-                for(qint32 j = 0; j < idcs.rows(); ++j)
-                {
-                    t_G.block(0, j*3, t_G.rows(), 3) = this->sol->data.block(0, (idcs[j]+offset)*3, t_G.rows(), 3);
-                    if(t_bUseWhitened)
-                        t_G_Whitened_Roi.block(0, j*3, t_G_Whitened_Roi.rows(), 3) = t_G_Whitened.block(0, (idcs[j]+offset)*3, t_G_Whitened_Roi.rows(), 3);
-                }
-
-                qint32 nSens = t_G.rows();
-                qint32 nSources = t_G.cols()/3;
+                const QVector<qint32> &t_qVecSources = t_qVecLabelSources[i];
+                qint32 nSources = t_qVecSources.size();
 
                 if (nSources > 0)
                 {
                     RegionData t_sensG;
 
-                    t_sensG.idcs = idcs;
+                    t_sensG.idcs = Map<const VectorXi>(t_qVecSources.constData(), nSources);
                     t_sensG.iLabelIdxIn = i;
                     t_sensG.nClusters = ceil((double)nSources/(double)p_iClusterSize);
 
-                    t_sensG.matRoiGOrig = t_G;
-//                    if(t_bUseWhitened)
-//                        t_sensG.matRoiGOrigWhitened = t_G_Whitened_Roi;
-
                     printf("%d Cluster(s)... ", t_sensG.nClusters);
 
-                    // Reshape Input data -> sources rows; sensors columns
-                    t_sensG.matRoiG = MatrixXd(t_G.cols()/3, 3*nSens);
-                    if(t_bUseWhitened)
-                        t_sensG.matRoiGWhitened = MatrixXd(t_G_Whitened_Roi.cols()/3, 3*nSens);
+                    // Gather the region into a contiguous buffer, then reshape -> sources rows; sensors columns
+                    gatherRegion(this->sol->data, t_sensG.idcs, offset, t_sensG.matRoiGOrig);
+                    swapRegionLayout(t_sensG.matRoiGOrig, t_sensG.matRoiG);
 
-                    for(qint32 j = 0; j < nSens; ++j)
+                    if(t_bUseWhitened)
                     {
-                        for(qint32 k = 0; k < t_sensG.matRoiG.rows(); ++k)
-                            t_sensG.matRoiG.block(k,j*3,1,3) = t_G.block(j,k*3,1,3);
-                        if(t_bUseWhitened)
-                            for(qint32 k = 0; k < t_sensG.matRoiGWhitened.rows(); ++k)
-                                t_sensG.matRoiGWhitened.block(k,j*3,1,3) = t_G_Whitened_Roi.block(j,k*3,1,3);
+                        MatrixXd t_G_Whitened_Roi;
+                        gatherRegion(t_G_Whitened, t_sensG.idcs, offset, t_G_Whitened_Roi);
+                        swapRegionLayout(t_G_Whitened_Roi, t_sensG.matRoiGWhitened);
                     }
 
                     t_sensG.bUseWhitened = t_bUseWhitened;
@@ -331,28 +639,55 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
 
 
         //
-        // Calculate clusters
+        // Calculate clusters - every replicate of every region is a job of its own
         //
         printf("Clustering... ");
+        QList<RegionReplicate> t_qListReplicates;
+        for(qint32 i = 0; i < m_qListRegionDataIn.size(); ++i)
+        {
+            for(qint32 r = 0; r < t_iReplicates; ++r)
+            {
+                RegionReplicate t_replicate;
+                t_replicate.pRegion = &m_qListRegionDataIn.at(i);
+                t_replicate.iSeed = ++t_iSeed;
+                t_qListReplicates.append(t_replicate);
+            }
+        }
+
         QFuture< RegionDataOut > res;
-        res = QtConcurrent::mapped(m_qListRegionDataIn, &RegionData::cluster);
+        res = QtConcurrent::mapped(t_qListReplicates, &clusterReplicate);
         res.waitForFinished();
 
+        // Keep the replicate with the lowest total sum of distances per region
+        QList<RegionDataOut> t_qListRegionDataOut;
+        for(qint32 i = 0; i < m_qListRegionDataIn.size(); ++i)
+        {
+            qint32 t_iBest = i*t_iReplicates;
+            double t_dBestSumD = std::numeric_limits<double>::max();
+            for(qint32 r = 0; r < t_iReplicates; ++r)
+            {
+                const RegionDataOut &t_out = res.resultAt(i*t_iReplicates + r);
+                if(t_out.bClustered && t_out.sumd.sum() < t_dBestSumD)
+                {
+                    t_dBestSumD = t_out.sumd.sum();
+                    t_iBest = i*t_iReplicates + r;
+                }
+            }
+            t_qListRegionDataOut.append(res.resultAt(t_iBest));
+        }
+
         //
         // Assign results
         //
         MatrixXd t_G_partial;
 
         qint32 nClusters;
-        qint32 nSens;
         QList<RegionData>::const_iterator itIn;
         itIn = m_qListRegionDataIn.begin();
-        QFuture<RegionDataOut>::const_iterator itOut;
-        for (itOut = res.constBegin(); itOut != res.constEnd(); ++itOut)
+        QList<RegionDataOut>::const_iterator itOut;
+        for (itOut = t_qListRegionDataOut.constBegin(); itOut != t_qListRegionDataOut.constEnd(); ++itOut)
         {
             nClusters = itOut->ctrs.rows();
-            nSens = itOut->ctrs.cols()/3;
-            t_G_partial = MatrixXd::Zero(nSens, nClusters*3);
 
 //            std::cout << "Number of Clusters: " << nClusters << " x " << nSens << std::endl;//itOut->iLabelIdcsOut << std::endl;
 
@@ -360,9 +695,7 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
             // Assign the centroid for each cluster to the partial G
             //
             //ToDo change this use indeces found with whitened data
-            for(qint32 j = 0; j < nSens; ++j)
-                for(qint32 k = 0; k < nClusters; ++k)
-                    t_G_partial.block(j, k*3, 1, 3) = itOut->ctrs.block(k,j*3,1,3);
+            swapRegionLayout(itOut->ctrs, t_G_partial);
 
             //
             // Get cluster indizes and its distances to the centroid
@@ -407,8 +740,8 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
             //
             if(t_G_partial.rows() > 0 && t_G_partial.cols() > 0)
             {
-                t_G_new.conservativeResize(t_G_partial.rows(), t_G_new.cols() + t_G_partial.cols());
-                t_G_new.block(0, t_G_new.cols() - t_G_partial.cols(), t_G_new.rows(), t_G_partial.cols()) = t_G_partial;
+                t_qListGPartial.append(t_G_partial);
+                t_iNumClusterCols += t_G_partial.cols();
 
                 // Map the centroids to the closest rr
                 for(qint32 k = 0; k < nClusters; ++k)
@@ -471,62 +804,7 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
     //
     // Cluster operator D (sources x clusters)
     //
-    qint32 totalNumOfClust = 0;
-    for (qint32 h = 0; h < 2; ++h)
-        totalNumOfClust += p_fwdOut.src[h].cluster_info.clusterVertnos.size();
-
-    if(this->isFixedOrient())
-        p_D = MatrixXd::Zero(this->sol->data.cols(), totalNumOfClust);
-    else
-        p_D = MatrixXd::Zero(this->sol->data.cols(), totalNumOfClust*3);
-
-    QList<VectorXi> t_vertnos = this->src.get_vertno();
-
-//    qDebug() << "Size: " << t_vertnos[0].size()  << t_vertnos[1].size();
-//    qDebug() << "this->sol->data.cols(): " << this->sol->data.cols();
-
-    qint32 currentCluster = 0;
-    for (qint32 h = 0; h < 2; ++h)
-    {
-        int hemiOffset = h == 0 ? 0 : t_vertnos[0].size();
-        for(qint32 i = 0; i < p_fwdOut.src[h].cluster_info.clusterVertnos.size(); ++i)
-        {
-            VectorXi idx_sel;
-            MNEMath::intersect(t_vertnos[h], p_fwdOut.src[h].cluster_info.clusterVertnos[i], idx_sel);
-
-//            std::cout << "\nVertnos:\n" << t_vertnos[h] << std::endl;
-
-//            std::cout << "clusterVertnos[i]:\n" << p_fwdOut.src[h].cluster_info.clusterVertnos[i] << std::endl;
-
-            idx_sel.array() += hemiOffset;
-
-//            std::cout << "idx_sel]:\n" << idx_sel << std::endl;
-
-
-
-            double selectWeight = 1.0/idx_sel.size();
-            if(this->isFixedOrient())
-            {
-                for(qint32 j = 0; j < idx_sel.size(); ++j)
-                    p_D.col(currentCluster)[idx_sel(j)] = selectWeight;
-            }
-            else
-            {
-                qint32 clustOffset = currentCluster*3;
-                for(qint32 j = 0; j < idx_sel.size(); ++j)
-                {
-                    qint32 idx_sel_Offset = idx_sel(j)*3;
-                    //x
-                    p_D(idx_sel_Offset,clustOffset) = selectWeight;
-                    //y
-                    p_D(idx_sel_Offset+1, clustOffset+1) = selectWeight;
-                    //z
-                    p_D(idx_sel_Offset+2, clustOffset+2) = selectWeight;
-                }
-            }
-            ++currentCluster;
-        }
-    }
+    computeClusterOperator(*this, p_fwdOut, p_D);
 
 //    std::cout << "D:\n" << D.row(0) << std::endl << D.row(1) << std::endl << D.row(2) << std::endl << D.row(3) << std::endl << D.row(4) << std::endl << D.row(5) << std::endl;
 
@@ -685,11 +963,27 @@ MNEForwardSolution MNEForwardSolution::cluster_forward_solution(const Annotation
     //
     // Put it all together
     //
+    MatrixXd t_G_new(this->sol->data.rows(), t_iNumClusterCols);
+    qint32 t_iCol = 0;
+    for(qint32 i = 0; i < t_qListGPartial.size(); ++i)
+    {
+        t_G_new.middleCols(t_iCol, t_qListGPartial[i].cols()) = t_qListGPartial[i];
+        t_iCol += t_qListGPartial[i].cols();
+    }
+
     p_fwdOut.sol->data = t_G_new;
     p_fwdOut.sol->ncol = t_G_new.cols();
 
     p_fwdOut.nsource = p_fwdOut.sol->ncol/3;
 
+    if(!t_sCacheFile.isEmpty())
+    {
+        if(QDir().mkpath(p_sCacheDir) && writeClusterCache(t_sCacheFile, t_cacheKey, p_fwdOut))
+            printf("Stored clustered forward solution to %s\n", t_sCacheFile.toUtf8().constData());
+        else
+            printf("Warning: Could not store clustered forward solution to %s\n", t_sCacheFile.toUtf8().constData());
+    }
+
     return p_fwdOut;
 }
 
@@ -121,6 +121,7 @@ struct RegionDataOut
     MatrixXd    ctrs;       /**< Cluster centers */
     VectorXd    sumd;       /**< Sums of the distances to the centroid */
     MatrixXd    D;          /**< Distances to the centroid */
+    bool        bClustered; /**< Whether KMeans found a solution */
 
     qint32      iLabelIdxOut;   /**< Label ID */
 };
@@ -144,16 +145,28 @@ struct RegionData
     VectorXi    idcs;           /**< Get source space indeces */
     qint32      iLabelIdxIn;    /**< Label ID */
 
-    RegionDataOut cluster() const
+    //=========================================================================================================
+    /**
+    * Clusters the region. Replicates are computed sequentially; to spread them over several threads run
+    * single replicates with distinct seeds and keep the one with the lowest total sum of distances.
+    *
+    * @param[in] p_iReplicates  Number of KMeans replicates (default 5)
+    * @param[in] p_iSeed        Seed of the KMeans start; 0 seeds with the current time (default)
+    *
+    * @return the clustered region
+    */
+    RegionDataOut cluster(qint32 p_iReplicates = 5, quint32 p_iSeed = 0) const
     {
         // Kmeans Reduction
         RegionDataOut p_RegionDataOut;
 
-        KMeans t_kMeans(QString("cityblock"), QString("sample"), 5);//QString("cityblock")sqeuclidean
+        KMeans t_kMeans(QString("cityblock"), QString("sample"), p_iReplicates);//QString("cityblock")sqeuclidean
+        if(p_iSeed != 0)
+            t_kMeans.setSeed(p_iSeed);
 
         if(bUseWhitened)
         {
-            t_kMeans.calculate(this->matRoiGWhitened, this->nClusters, p_RegionDataOut.roiIdx, p_RegionDataOut.ctrs, p_RegionDataOut.sumd, p_RegionDataOut.D);
+            p_RegionDataOut.bClustered = t_kMeans.calculate(this->matRoiGWhitened, this->nClusters, p_RegionDataOut.roiIdx, p_RegionDataOut.ctrs, p_RegionDataOut.sumd, p_RegionDataOut.D);
 
             MatrixXd newCtrs = MatrixXd::Zero(p_RegionDataOut.ctrs.rows(), p_RegionDataOut.ctrs.cols());
             for(qint32 c = 0; c < p_RegionDataOut.ctrs.rows(); ++c)
@@ -175,7 +188,7 @@ struct RegionData
             p_RegionDataOut.ctrs = newCtrs; //Replace whitened with original
         }
         else
-            t_kMeans.calculate(this->matRoiG, this->nClusters, p_RegionDataOut.roiIdx, p_RegionDataOut.ctrs, p_RegionDataOut.sumd, p_RegionDataOut.D);
+            p_RegionDataOut.bClustered = t_kMeans.calculate(this->matRoiG, this->nClusters, p_RegionDataOut.roiIdx, p_RegionDataOut.ctrs, p_RegionDataOut.sumd, p_RegionDataOut.D);
 
         p_RegionDataOut.iLabelIdxOut = this->iLabelIdxIn;
 
@@ -252,10 +265,13 @@ public:
     * @param[out]   p_D                 The cluster operator
     * @param[in]    p_pNoise_cov
     * @param[in]    p_pInfo
+    * @param[in]    p_sCacheDir         Directory of the cluster cache. If set, a result clustered earlier with the same
+    *                                   forward solution, annotation and cluster size is loaded from there instead of
+    *                                   being recomputed; new results are stored there. (optional)
     *
     * @return clustered MNE forward solution
     */
-    MNEForwardSolution cluster_forward_solution(const AnnotationSet &p_AnnotationSet, qint32 p_iClusterSize, MatrixXd& p_D = defaultD, const FiffCov &p_pNoise_cov = defaultCov, const FiffInfo &p_pInfo = defaultInfo) const;
+    MNEForwardSolution cluster_forward_solution(const AnnotationSet &p_AnnotationSet, qint32 p_iClusterSize, MatrixXd& p_D = defaultD, const FiffCov &p_pNoise_cov = defaultCov, const FiffInfo &p_pInfo = defaultInfo, const QString &p_sCacheDir = QString()) const;
 
     //=========================================================================================================
     /**
@@ -45,6 +45,7 @@
 #include <utils/ioutils.h>
 
 #include <iostream>
+#include <algorithm>
 
 
 //*************************************************************************************************************
@@ -74,11 +75,14 @@ using namespace UTILSLIB;
 RtAve::RtAve(quint32 numAverages, quint32 p_iPreStimSamples, quint32 p_iPostStimSamples, FiffInfo::SPtr p_pFiffInfo, QObject *parent)
 : QThread(parent)
 , m_iNumAverages(numAverages)
+, m_eAveragingMode(SlidingWindow)
+, m_dAlpha(0.0)
 , m_iPreStimSamples(p_iPreStimSamples)
 , m_iPostStimSamples(p_iPostStimSamples)
 , m_pFiffInfo(p_pFiffInfo)
 , m_bIsRunning(false)
 , m_bAutoAspect(true)
+, m_iRingSamples(0)
 {
     qRegisterMetaType<FiffEvoked::SPtr>("FiffEvoked::SPtr");
 }
@@ -100,7 +104,7 @@ void RtAve::append(const MatrixXd &p_DataSegment)
     QMutexLocker locker(&m_qMutex);
     // ToDo handle change buffersize
     if(!m_pRawMatrixBuffer)
-        m_pRawMatrixBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(128, p_DataSegment.rows(), p_DataSegment.cols()));
+        m_pRawMatrixBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(128, p_DataSegment.rows(), p_DataSegment.cols()));
 
     m_pRawMatrixBuffer->push(&p_DataSegment);
 }
@@ -117,6 +121,16 @@ void RtAve::setAverages(qint32 numAve)
 }
 
 
+//*************************************************************************************************************
+
+void RtAve::setAveragingMode(AveragingMode p_eMode, double p_dAlpha)
+{
+    QMutexLocker locker(&m_qMutex);
+    m_eAveragingMode = p_eMode;
+    m_dAlpha = (p_dAlpha > 0.0 && p_dAlpha <= 1.0) ? p_dAlpha : 0.0;
+}
+
+
 //*************************************************************************************************************
 
 void RtAve::setPreStim(qint32 samples)
@@ -137,151 +151,185 @@ void RtAve::setPostStim(qint32 samples)
 
 //*************************************************************************************************************
 
-void RtAve::assemblePostStimulus(const QList<QPair<QList<qint32>, MatrixXd> > &p_qListRawMatBuf, qint32 p_iStimIdx)
+void RtAve::resetRing(qint32 p_iRows, qint32 p_iSamplesPerBuf)
 {
-    QMutexLocker locker(&m_qMutex);
-    if(m_iPostStimSamples > 0)
-    {
-        // middle of the assembled buffers
-        float ratio = (float)m_iPreStimSamples/((float)(m_iPreStimSamples+m_iPostStimSamples));
-        qint32 t_iBuffWithStim = floor((p_qListRawMatBuf.size()-1)*ratio) + 1;
+    m_matRing.resize(p_iRows, m_iPreStimSamples + m_iPostStimSamples + 2*p_iSamplesPerBuf);
+    m_iRingSamples = 0;
+    m_qListPendingTriggers.clear();
+    m_vecLastStimValue = VectorXi::Zero(m_qListStimChannelIdcs.size());
+}
 
-        qint32 nrows = p_qListRawMatBuf[t_iBuffWithStim].second.rows();
-        qint32 ncols = p_qListRawMatBuf[t_iBuffWithStim].second.cols();
 
-        //Stimulus channel row
-        qint32 t_iRowIdx = m_qListStimChannelIdcs[p_iStimIdx];
+//*************************************************************************************************************
 
-        qint32 nSampleCount = 0;
+void RtAve::writeRing(const MatrixXd &p_matRawSegment)
+{
+    qint32 t_iLength = m_matRing.cols();
+    qint32 t_iPos = m_iRingSamples % t_iLength;
+    qint32 t_iCols = p_matRawSegment.cols();
 
-        MatrixXd t_matPostStim(nrows, m_iPostStimSamples);
-        qint32 t_curBufIdx = t_iBuffWithStim;
+    qint32 t_iFirst = qMin(t_iCols, t_iLength - t_iPos);
+    m_matRing.block(0, t_iPos, m_matRing.rows(), t_iFirst) = p_matRawSegment.leftCols(t_iFirst);
+    if(t_iFirst < t_iCols)
+        m_matRing.leftCols(t_iCols - t_iFirst) = p_matRawSegment.rightCols(t_iCols - t_iFirst);
 
-        qint32 t_iSize = 0;
+    m_iRingSamples += t_iCols;
+}
 
-        qint32 pos = 0;
-        p_qListRawMatBuf[t_iBuffWithStim].second.row(t_iRowIdx).maxCoeff(&pos);
 
-        //
-        // assemble poststimulus
-        //
+//*************************************************************************************************************
 
-        // start from the stimulus itself
-        if(pos >= 0)
-        {
-            t_iSize = ncols - pos;
-            if(t_iSize <= m_iPostStimSamples)
-            {
-                t_matPostStim.block(0, 0, nrows, t_iSize) = p_qListRawMatBuf[t_iBuffWithStim].second.block(0, pos, nrows, t_iSize);
-                nSampleCount += t_iSize;
-            }
-            else
-            {
-                t_matPostStim.block(0, 0, nrows, m_iPostStimSamples) = p_qListRawMatBuf[t_iBuffWithStim].second.block(0, pos, nrows, m_iPostStimSamples);
-                nSampleCount = m_iPostStimSamples;
-            }
-        }
+void RtAve::readRing(qint64 p_iFirstSample, MatrixXd &p_matEpoch) const
+{
+    qint32 t_iLength = m_matRing.cols();
+    qint32 t_iPos = p_iFirstSample % t_iLength;
+    qint32 t_iCols = p_matEpoch.cols();
+
+    qint32 t_iFirst = qMin(t_iCols, t_iLength - t_iPos);
+    p_matEpoch.leftCols(t_iFirst) = m_matRing.block(0, t_iPos, m_matRing.rows(), t_iFirst);
+    if(t_iFirst < t_iCols)
+        p_matEpoch.rightCols(t_iCols - t_iFirst) = m_matRing.leftCols(t_iCols - t_iFirst);
+}
 
-        ++t_curBufIdx;
 
-        // remaining samples
-        while(nSampleCount < m_iPostStimSamples)
-        {
-            t_iSize = m_iPostStimSamples-nSampleCount;
+//*************************************************************************************************************
 
-            if(ncols <= t_iSize)
-            {
-                t_matPostStim.block(0, nSampleCount, nrows, ncols) = p_qListRawMatBuf[t_curBufIdx].second.block(0, 0, nrows, ncols);
-                nSampleCount += ncols;
-            }
-            else
+void RtAve::detectTriggers(const MatrixXd &p_matRawSegment, qint64 p_iFirstSample)
+{
+    QList<Trigger> t_qListNew;
+
+    for(qint32 i = 0; i < m_qListStimChannelIdcs.size(); ++i)
+    {
+        const qint32 t_iRow = m_qListStimChannelIdcs[i];
+        const bool t_bComposite = m_qListStimIsComposite[i];
+        qint32 t_iLast = m_vecLastStimValue[i];
+
+        for(qint32 j = 0; j < p_matRawSegment.cols(); ++j)
+        {
+            qint32 t_iValue = (qint32)qRound(p_matRawSegment(t_iRow, j));
+            if(t_iValue != t_iLast)
             {
-                t_matPostStim.block(0, nSampleCount, nrows, t_iSize) = p_qListRawMatBuf[t_curBufIdx].second.block(0, 0, nrows, t_iSize);
-                nSampleCount = m_iPostStimSamples;
+                if(t_bComposite ? t_iValue > 0 : (t_iLast <= 0 && t_iValue > 0))
+                {
+                    Trigger t_trigger;
+                    t_trigger.iSample = p_iFirstSample + j;
+                    t_trigger.iStimIdx = i;
+                    t_trigger.iCode = t_bComposite ? t_iValue : 0;
+                    t_qListNew.append(t_trigger);
+                }
+                t_iLast = t_iValue;
             }
-
-            ++t_curBufIdx;
         }
-
-        //
-        //Store in right post stimulus buffer vector
-        //
-        m_qListQListPostStimBuf[p_iStimIdx].append(t_matPostStim);
+        m_vecLastStimValue[i] = t_iLast;
     }
+
+    //keep pending triggers in order of occurence, so they complete in order
+    if(m_qListStimChannelIdcs.size() > 1)
+        std::stable_sort(t_qListNew.begin(), t_qListNew.end(), [](const Trigger &a, const Trigger &b) { return a.iSample < b.iSample; });
+
+    m_qListPendingTriggers.append(t_qListNew);
 }
 
 
 //*************************************************************************************************************
 
-void RtAve::assemblePreStimulus(const QList<QPair<QList<qint32>, MatrixXd> > &p_qListRawMatBuf, qint32 p_iStimIdx)
+void RtAve::resizeAverage(StimAverage &p_stimAve, qint32 p_iCapacity, qint32 p_iRows, qint32 p_iCols)
 {
-    QMutexLocker locker(&m_qMutex);
-    if(m_iPreStimSamples > 0)
+    if(p_iCapacity < 1)
+        p_iCapacity = 1;
+
+    bool t_bSameShape = p_stimAve.matSum.rows() == p_iRows && p_stimAve.matSum.cols() == p_iCols;
+
+    //Keep the newest epochs in chronological order, when only the window length changed
+    QVector<MatrixXd> t_qVecEpochs(p_iCapacity);
+    qint32 t_iKeep = 0;
+    if(t_bSameShape && m_eAveragingMode == SlidingWindow)
     {
-        // stimulus containing buffer of the assembled buffers
-        float ratio = (float)m_iPreStimSamples/((float)(m_iPreStimSamples+m_iPostStimSamples));
-        qint32 t_iBuffWithStim = floor((p_qListRawMatBuf.size()-1)*ratio) + 1;
-        qint32 nrows = p_qListRawMatBuf[t_iBuffWithStim].second.rows();
-        qint32 ncols = p_qListRawMatBuf[t_iBuffWithStim].second.cols();
+        t_iKeep = qMin(p_stimAve.iCount, p_iCapacity);
+        qint32 t_iOldCapacity = p_stimAve.qVecEpochs.size();
+        for(qint32 k = 0; k < t_iKeep; ++k)
+        {
+            qint32 t_iSlot = (p_stimAve.iHead - t_iKeep + k + t_iOldCapacity) % t_iOldCapacity;
+            t_qVecEpochs[k].swap(p_stimAve.qVecEpochs[t_iSlot]);
+        }
+    }
 
-        //Stimulus channel row
-        qint32 t_iRowIdx = m_qListStimChannelIdcs[p_iStimIdx];
+    for(qint32 k = t_iKeep; k < p_iCapacity; ++k)
+        t_qVecEpochs[k].resize(p_iRows, p_iCols);
 
-        qint32 nSampleCount = m_iPreStimSamples;
+    p_stimAve.qVecEpochs.swap(t_qVecEpochs);
+    p_stimAve.iHead = t_iKeep % p_iCapacity;
+    p_stimAve.iCount = t_iKeep;
+    p_stimAve.iEvictions = 0;
 
-        MatrixXd t_matPreStim(nrows, m_iPreStimSamples);
-        qint32 t_curBufIdx = t_iBuffWithStim;
+    if(!t_bSameShape || m_eAveragingMode == SlidingWindow)
+        p_stimAve.iTotal = t_iKeep;
 
-        qint32 t_iStart = 0;
+    p_stimAve.matSum = MatrixXd::Zero(p_iRows, p_iCols);
+    for(qint32 k = 0; k < t_iKeep; ++k)
+        p_stimAve.matSum += p_stimAve.qVecEpochs[k];
 
-        qint32 pos = 0;
-        p_qListRawMatBuf[t_iBuffWithStim].second.row(t_iRowIdx).maxCoeff(&pos);
+    if(!t_bSameShape)
+        p_stimAve.matAve.resize(0, 0);
+    else if(m_eAveragingMode == SlidingWindow)
+    {
+        if(t_iKeep == p_iCapacity)
+            p_stimAve.matAve.noalias() = p_stimAve.matSum * (1.0/t_iKeep);
+        else
+            p_stimAve.matAve.resize(0, 0);
+    }
+}
 
-        //
-        // assemble prestimulus
-        //
 
-        // start from the stimulus itself
-        if(pos > 0)
-        {
-            t_iStart = m_iPreStimSamples - pos;
-            if(t_iStart >= 0)
-            {
-                t_matPreStim.block(0, t_iStart, nrows, pos) = p_qListRawMatBuf[t_iBuffWithStim].second.block(0, 0, nrows, pos);
-                nSampleCount -= pos;
-            }
-            else
-            {
-                t_matPreStim.block(0, 0, nrows, m_iPreStimSamples) = p_qListRawMatBuf[t_iBuffWithStim].second.block(0, -t_iStart, nrows, m_iPreStimSamples);
-                nSampleCount = 0;
-            }
-        }
-        --t_curBufIdx;
+//*************************************************************************************************************
 
-        // remaining samples
-        while(nSampleCount > 0)
-        {
-            t_iStart = nSampleCount - ncols;
+MatrixXd& RtAve::beginEpoch(StimAverage &p_stimAve)
+{
+    MatrixXd &t_matSlot = p_stimAve.qVecEpochs[p_stimAve.iHead];
 
-            if(t_iStart >= 0)
-            {
-                t_matPreStim.block(0, t_iStart, nrows, ncols) = p_qListRawMatBuf[t_curBufIdx].second.block(0, 0, nrows, ncols);
-                nSampleCount -= ncols;
-            }
-            else
-            {
-                t_matPreStim.block(0, 0, nrows, nSampleCount) = p_qListRawMatBuf[t_curBufIdx].second.block(0, -t_iStart, nrows, nSampleCount);
-                nSampleCount = 0;
-            }
+    if(m_eAveragingMode == SlidingWindow && p_stimAve.iCount == p_stimAve.qVecEpochs.size())
+    {
+        p_stimAve.matSum -= t_matSlot;
+        --p_stimAve.iCount;
+        ++p_stimAve.iEvictions;
+    }
+
+    return t_matSlot;
+}
 
-            --t_curBufIdx;
-        }
 
-        //
-        //Store in right pre stimulus buffer vector
-        //
-        m_qListQListPreStimBuf[p_iStimIdx].append(t_matPreStim);
+//*************************************************************************************************************
+
+void RtAve::commitEpoch(StimAverage &p_stimAve)
+{
+    const MatrixXd &t_matEpoch = p_stimAve.qVecEpochs[p_stimAve.iHead];
+    ++p_stimAve.iTotal;
+
+    if(m_eAveragingMode == Exponential)
+    {
+        double t_dAlpha = m_dAlpha > 0.0 ? m_dAlpha : 2.0/(m_iNumAverages + 1.0);
+        if(p_stimAve.matAve.rows() != t_matEpoch.rows() || p_stimAve.matAve.cols() != t_matEpoch.cols())
+            p_stimAve.matAve = t_matEpoch;
+        else
+            p_stimAve.matAve += t_dAlpha * (t_matEpoch - p_stimAve.matAve);
+        return;
     }
+
+    p_stimAve.matSum += t_matEpoch;
+    ++p_stimAve.iCount;
+    p_stimAve.iHead = (p_stimAve.iHead + 1) % p_stimAve.qVecEpochs.size();
+
+    //Add/subtract accumulates rounding errors; rebuild the sum once per full turn of the ring (amortized O(1))
+    if(p_stimAve.iEvictions >= p_stimAve.qVecEpochs.size())
+    {
+        p_stimAve.matSum = p_stimAve.qVecEpochs[0];
+        for(qint32 k = 1; k < p_stimAve.iCount; ++k)
+            p_stimAve.matSum += p_stimAve.qVecEpochs[k];
+        p_stimAve.iEvictions = 0;
+    }
+
+    if(p_stimAve.iCount == p_stimAve.qVecEpochs.size())
+        p_stimAve.matAve.noalias() = p_stimAve.matSum * (1.0/p_stimAve.iCount);
 }
 
 
@@ -293,6 +341,10 @@ bool RtAve::start()
     if(this->isRunning())
         QThread::wait();
 
+    //The consumer thread is gone - drop stale data and the release of the last stop
+    if(m_pRawMatrixBuffer)
+        m_pRawMatrixBuffer->resetConsumer();
+
     m_qMutex.lock();
     m_bIsRunning = true;
     m_qMutex.unlock();
@@ -311,9 +363,9 @@ bool RtAve::stop()
     m_bIsRunning = false;
     m_qMutex.unlock();
 
-    m_pRawMatrixBuffer->releaseFromPop();
-
-    m_pRawMatrixBuffer->clear();
+    //Only release the consumer - clearing here would race with a push or pop still in flight
+    if(m_pRawMatrixBuffer)
+        m_pRawMatrixBuffer->releaseFromPop();
 
     return true;
 }
@@ -327,40 +379,34 @@ void RtAve::run()
     // Inits & Clears
     //
     m_qMutex.lock();
-    quint32 t_nSamplesPerBuf = 0;
-    QList<QPair<QList<qint32>, MatrixXd> > t_qListRawMatBuf;
-
-    FiffEvoked::SPtr evoked(new FiffEvoked());
-    VectorXd mu;
     qint32 i = 0;
-    qint32 j = 0;
 
-    m_qListQListPreStimBuf.clear();
-    m_qListQListPostStimBuf.clear();
-    m_qListPreStimAve.clear();
-    m_qListPostStimAve.clear();
-    m_qListStimAve.clear();
+    m_qMapStimAverages.clear();
 
     //
-    // get num stim channels
+    // get stim channels
     //
     m_qListStimChannelIdcs.clear();
-    MatrixXd t_mat;
-    QList<MatrixXd> t_qListMat;
+    m_qListStimIsComposite.clear();
     for(i = 0; i < m_pFiffInfo->nchan; ++i)
     {
-        if(m_pFiffInfo->chs[i].kind == FIFFV_STIM_CH && (m_pFiffInfo->chs[i].ch_name != QString("STI 014")))
+        if(m_pFiffInfo->chs[i].kind == FIFFV_STIM_CH)
         {
             m_qListStimChannelIdcs.append(i);
-
-            m_qListQListPreStimBuf.push_back(t_qListMat);
-            m_qListQListPostStimBuf.push_back(t_qListMat);
-            m_qListPreStimAve.push_back(t_mat);
-            m_qListPostStimAve.push_back(t_mat);
-            m_qListStimAve.push_back(t_mat);
+            m_qListStimIsComposite.append(m_pFiffInfo->chs[i].ch_name == QString("STI 014") || m_pFiffInfo->chs[i].ch_name == QString("STI 101"));
         }
     }
 
+    StimAverage t_emptyAverage;
+    t_emptyAverage.iHead = 0;
+    t_emptyAverage.iCount = 0;
+    t_emptyAverage.iEvictions = 0;
+    t_emptyAverage.iTotal = 0;
+
+    m_matRing.resize(0, 0);
+    m_iRingSamples = 0;
+    m_qListPendingTriggers.clear();
+
 
     float T = 1.0/m_pFiffInfo->sfreq;
 
@@ -401,13 +447,13 @@ void RtAve::run()
     t_stimEvoked.last = t_stimEvoked.times[t_stimEvoked.times.size()-1];
 
 
-    qint32 count = 0;
-
     m_iNewPreStimSamples = m_iPreStimSamples;
     m_iNewPostStimSamples = m_iPostStimSamples;
 
     m_qMutex.unlock();
 
+    MatrixXd rawSegment;
+
     //Enter the main loop
     while(true)
     {
@@ -460,166 +506,99 @@ void RtAve::run()
                 t_stimEvoked.last = t_stimEvoked.times[t_stimEvoked.times.size()-1];
 
 
-                MatrixXd t_resetMat;
-                t_qListRawMatBuf.clear();
-                m_qListPreStimAve.clear();
-                m_qListPostStimAve.clear();
-                m_qListStimAve.clear();
-
-                for(qint32 i = 0; i < m_qListQListPreStimBuf.size(); ++i)
-                {
-                    m_qListQListPreStimBuf[i].clear();
-                    m_qListQListPostStimBuf[i].clear();
-                    m_qListPreStimAve.push_back(t_resetMat);
-                    m_qListPostStimAve.push_back(t_resetMat);
-                    m_qListStimAve.push_back(t_resetMat);
-                }
+                //epoch length changed -> sample ring and epoch rings are reallocated
+                m_matRing.resize(0, 0);
+                m_qMapStimAverages.clear();
             }
             m_qMutex.unlock();
 
             //
             // Acquire Data
             //
-            MatrixXd rawSegment = m_pRawMatrixBuffer->pop();
-            if(t_nSamplesPerBuf == 0)
-                t_nSamplesPerBuf = rawSegment.cols();
+            if(!m_pRawMatrixBuffer->tryPop(rawSegment, 100))
+                continue;
 
-            ++count;
+            //ring has to hold one epoch plus two buffers
+            if(m_matRing.rows() != rawSegment.rows() || m_matRing.cols() < m_iPreStimSamples + m_iPostStimSamples + 2*rawSegment.cols())
+                this->resetRing(rawSegment.rows(), rawSegment.cols());
 
             //
-            // Detect Stimuli
+            // Detect Stimuli at sample resolution and store
             //
-            QList<qint32> t_qListStimuli;
-            for(i = 0; i < m_qListStimChannelIdcs.size(); ++i)
-            {
-                qint32 idx = m_qListStimChannelIdcs[i];
-                RowVectorXi stimSegment = rawSegment.row(idx).cast<int>();
-                int iMax = stimSegment.maxCoeff();
-
-                if(iMax > 0)
-                    t_qListStimuli.append(i);
-            }
+            this->detectTriggers(rawSegment, m_iRingSamples);
+            this->writeRing(rawSegment);
 
             //
-            // Store
+            // Average all triggers whose epoch is complete
             //
-            t_qListRawMatBuf.push_back(qMakePair(t_qListStimuli, rawSegment));
+            while(!m_qListPendingTriggers.isEmpty() && m_qListPendingTriggers.first().iSample + m_iPostStimSamples <= m_iRingSamples)
+            {
+                Trigger t_trigger = m_qListPendingTriggers.takeFirst();
 
-            m_qMutex.lock();
-            qint32 minSize = (m_iPreStimSamples+m_iPostStimSamples) + (2 * t_nSamplesPerBuf);
-            m_qMutex.unlock();
+                //not enough pre stimulus history since the (re)start
+                if(t_trigger.iSample - m_iPreStimSamples < qMax((qint64)0, m_iRingSamples - m_matRing.cols()))
+                    continue;
+
+                QPair<qint32, qint32> t_key(t_trigger.iStimIdx, t_trigger.iCode);
+                if(!m_qMapStimAverages.contains(t_key))
+                    m_qMapStimAverages.insert(t_key, t_emptyAverage);
+                StimAverage &t_stimAve = m_qMapStimAverages[t_key];
+
+                m_qMutex.lock();
+                qint32 t_iCapacity = m_eAveragingMode == SlidingWindow ? m_iNumAverages : 1;
+                qint32 t_iRows = rawSegment.rows();
+                qint32 t_iCols = m_iPreStimSamples + m_iPostStimSamples;
+                if(t_stimAve.qVecEpochs.size() != t_iCapacity || t_stimAve.matSum.rows() != t_iRows || t_stimAve.matSum.cols() != t_iCols)
+                    this->resizeAverage(t_stimAve, t_iCapacity, t_iRows, t_iCols);
+
+                //
+                // copy the epoch straight from the sample ring into the epoch ring
+                //
+                MatrixXd &t_matEpoch = this->beginEpoch(t_stimAve);
+                this->readRing(t_trigger.iSample - m_iPreStimSamples, t_matEpoch);
 
-            if(t_nSamplesPerBuf*t_qListRawMatBuf.size() > minSize)
-            {
                 //
-                // Average
+                // update running average
                 //
-                float ratio = (float)m_iPreStimSamples/((float)(m_iPreStimSamples+m_iPostStimSamples));
-                qint32 t_iBuffWithStim = floor((t_qListRawMatBuf.size()-1)*ratio) + 1;
+                this->commitEpoch(t_stimAve);
 
-                if(t_iBuffWithStim > 0 && t_qListRawMatBuf[t_iBuffWithStim].first.size() != 0)
+                //if averages are available -> window is filled (sliding) or at least one epoch was seen (exponential)
+                if(t_stimAve.matAve.size() > 0)
                 {
-                    for(i = 0; i < t_qListRawMatBuf[t_iBuffWithStim].first.size(); ++i)
+                    qint32 t_iNave = m_iNumAverages;
+                    if(m_eAveragingMode == Exponential)
                     {
-                        //make sure that previous buffer does not conatin this stim - prevent multiple detection
-                        if(!t_qListRawMatBuf[t_iBuffWithStim-1].first.contains(t_qListRawMatBuf[t_iBuffWithStim].first[i]))
-                        {
-                            qint32 t_iStimIndex = t_qListRawMatBuf[t_iBuffWithStim].first[i];
-
-                            //
-                            // assemble prestimulus
-                            //
-                            this->assemblePreStimulus(t_qListRawMatBuf, t_iStimIndex);
-
-                            //
-                            // assemble poststimulus
-                            //
-                            this->assemblePostStimulus(t_qListRawMatBuf, t_iStimIndex);
-
-                            qDebug() << m_pFiffInfo->ch_names[m_qListStimChannelIdcs[t_iStimIndex]] << ": Buffer Size" << m_qListQListPreStimBuf[t_iStimIndex].size();
-                            //
-                            // Prestimulus average
-                            //
-                            m_qMutex.lock();
-                            if(m_qListQListPreStimBuf[t_iStimIndex].size() >= m_iNumAverages)
-                            {
-                                while(m_qListQListPreStimBuf[t_iStimIndex].size() >= (m_iNumAverages+1))//if meanwhile number of averages was reduced
-                                    m_qListQListPreStimBuf[t_iStimIndex].pop_front();
-
-                                m_qListPreStimAve[t_iStimIndex] = m_qListQListPreStimBuf[t_iStimIndex][0];
-                                for(j = 1; j < m_qListQListPreStimBuf[t_iStimIndex].size(); ++j)
-                                    m_qListPreStimAve[t_iStimIndex] += m_qListQListPreStimBuf[t_iStimIndex][j];
-
-                                m_qListPreStimAve[t_iStimIndex].array() /= (double)m_iNumAverages;
-
-                                m_qListQListPreStimBuf[t_iStimIndex].pop_front();
-                            }
-                            m_qMutex.unlock();
-
-                            //
-                            // Poststimulus average
-                            //
-                            m_qMutex.lock();
-                            if(m_qListQListPostStimBuf[t_iStimIndex].size() >= m_iNumAverages)
-                            {
-                                while(m_qListQListPostStimBuf[t_iStimIndex].size() >= (m_iNumAverages+1))//if meanwhile number of averages was reduced
-                                    m_qListQListPostStimBuf[t_iStimIndex].pop_front();
-
-                                m_qListPostStimAve[t_iStimIndex] = m_qListQListPostStimBuf[t_iStimIndex][0];
-                                for(j = 1; j < m_qListQListPostStimBuf[t_iStimIndex].size(); ++j)
-                                    m_qListPostStimAve[t_iStimIndex] += m_qListQListPostStimBuf[t_iStimIndex][j];
-
-                                m_qListPostStimAve[t_iStimIndex].array() /= (double)m_iNumAverages;
-
-                                m_qListQListPostStimBuf[t_iStimIndex].pop_front();
-                            }
-                            m_qMutex.unlock();
-
-                            //if averages are available -> buffers are filled and first average is stored
-                            m_qMutex.lock();
-                            if(m_qListPreStimAve[t_iStimIndex].size() > 0)
-                            {
-                                //
-                                // concatenate pre + post stimulus to full stimulus
-                                //
-                                m_qListStimAve[t_iStimIndex].resize(m_qListPreStimAve[t_iStimIndex].rows(), m_qListPreStimAve[t_iStimIndex].cols() + m_qListPostStimAve[t_iStimIndex].cols());
-                                // Pre
-                                m_qListStimAve[t_iStimIndex].block(0,0,m_qListPreStimAve[t_iStimIndex].rows(),m_qListPreStimAve[t_iStimIndex].cols()) = m_qListPreStimAve[t_iStimIndex];
-                                // Post
-                                m_qListStimAve[t_iStimIndex].block(0,m_qListPreStimAve[t_iStimIndex].cols(),m_qListPostStimAve[t_iStimIndex].rows(),m_qListPostStimAve[t_iStimIndex].cols()) = m_qListPostStimAve[t_iStimIndex];
-
-                                //
-                                // Emit evoked
-                                //
-                                QString t_sStimChName = m_pFiffInfo->ch_names[m_qListStimChannelIdcs[t_iStimIndex]];
-                                FiffEvoked::SPtr t_pEvokedPreStim(new FiffEvoked(t_preStimEvoked));
-                                t_pEvokedPreStim->nave = m_iNumAverages;
-                                t_pEvokedPreStim->comment = t_sStimChName;
-                                t_pEvokedPreStim->data = m_qListPreStimAve[t_iStimIndex];
-                                emit evokedPreStim(t_pEvokedPreStim);
-
-                                FiffEvoked::SPtr t_pEvokedPostStim(new FiffEvoked(t_postStimEvoked));
-                                t_pEvokedPostStim->nave = m_iNumAverages;
-                                t_pEvokedPostStim->comment = t_sStimChName;
-                                t_pEvokedPostStim->data = m_qListPostStimAve[t_iStimIndex];
-                                emit evokedPostStim(t_pEvokedPostStim);
-
-                                FiffEvoked::SPtr t_pEvokedStim(new FiffEvoked(t_stimEvoked));
-                                t_pEvokedStim->nave = m_iNumAverages;
-                                t_pEvokedStim->comment = t_sStimChName;
-                                t_pEvokedStim->data = m_qListStimAve[t_iStimIndex];
-                                emit evokedStim(t_pEvokedStim);
-                            }
-                            m_qMutex.unlock();
-                        }
+                        //effective number of averages of an exponential average in steady state: (2-alpha)/alpha
+                        double t_dAlpha = m_dAlpha > 0.0 ? m_dAlpha : 2.0/(m_iNumAverages + 1.0);
+                        t_iNave = qMin(t_stimAve.iTotal, (qint32)((2.0 - t_dAlpha)/t_dAlpha + 0.5));
                     }
-                }
-
 
-                //
-                //dump oldest buffer
-                //
-                t_qListRawMatBuf.pop_front();
+                    //
+                    // Emit evoked, composite channels are tagged with the trigger code
+                    //
+                    QString t_sStimChName = m_pFiffInfo->ch_names[m_qListStimChannelIdcs[t_trigger.iStimIdx]];
+                    if(m_qListStimIsComposite[t_trigger.iStimIdx])
+                        t_sStimChName += QString(":%1").arg(t_trigger.iCode);
+
+                    FiffEvoked::SPtr t_pEvokedPreStim(new FiffEvoked(t_preStimEvoked));
+                    t_pEvokedPreStim->nave = t_iNave;
+                    t_pEvokedPreStim->comment = t_sStimChName;
+                    t_pEvokedPreStim->data = t_stimAve.matAve.leftCols(m_iPreStimSamples);
+                    emit evokedPreStim(t_pEvokedPreStim);
+
+                    FiffEvoked::SPtr t_pEvokedPostStim(new FiffEvoked(t_postStimEvoked));
+                    t_pEvokedPostStim->nave = t_iNave;
+                    t_pEvokedPostStim->comment = t_sStimChName;
+                    t_pEvokedPostStim->data = t_stimAve.matAve.rightCols(m_iPostStimSamples);
+                    emit evokedPostStim(t_pEvokedPostStim);
+
+                    FiffEvoked::SPtr t_pEvokedStim(new FiffEvoked(t_stimEvoked));
+                    t_pEvokedStim->nave = t_iNave;
+                    t_pEvokedStim->comment = t_sStimChName;
+                    t_pEvokedStim->data = t_stimAve.matAve;
+                    emit evokedStim(t_pEvokedStim);
+                }
+                m_qMutex.unlock();
             }
         }
     }
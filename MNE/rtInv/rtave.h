@@ -58,7 +58,7 @@
 // Generics INCLUDES
 //=============================================================================================================
 
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 
 
 //*************************************************************************************************************
@@ -71,6 +71,9 @@
 #include <QSharedPointer>
 #include <QSet>
 #include <QList>
+#include <QVector>
+#include <QMap>
+#include <QPair>
 
 
 //*************************************************************************************************************
@@ -113,6 +116,16 @@ public:
     typedef QSharedPointer<RtAve> SPtr;             /**< Shared pointer type for RtCov. */
     typedef QSharedPointer<const RtAve> ConstSPtr;  /**< Const shared pointer type for RtCov. */
 
+    //=========================================================================================================
+    /**
+    * Averaging modes
+    */
+    enum AveragingMode
+    {
+        SlidingWindow,  /**< Arithmetic mean of the last numAverages epochs (running sum, add newest/subtract oldest). */
+        Exponential     /**< Exponentially weighted moving average, no epochs are kept. */
+    };
+
     //=========================================================================================================
     /**
     * Creates the real-time covariance estimation object.
@@ -147,6 +160,17 @@ public:
     */
     void setAverages(qint32 numAve);
 
+    //=========================================================================================================
+    /**
+    * Sets the averaging mode. In exponential mode each new epoch is weighted with p_dAlpha; when p_dAlpha is
+    * not in ]0,1] it is derived from the number of averages as 2/(numAverages+1), i.e. the weight which gives
+    * the same noise reduction as a sliding window of numAverages epochs.
+    *
+    * @param[in] p_eMode    averaging mode
+    * @param[in] p_dAlpha   weight of the newest epoch in exponential mode (optional)
+    */
+    void setAveragingMode(AveragingMode p_eMode, double p_dAlpha = 0.0);
+
     //=========================================================================================================
     /**
     * Sets the number of pre stimulus samples
@@ -228,26 +252,108 @@ protected:
 private:
     //=========================================================================================================
     /**
-    * Assemble the poststimulus
+    * Running average of one stimulus channel. Epochs are kept in a preallocated ring together with their running
+    * sum, so adding an epoch costs one matrix addition and one subtraction regardless of the number of averages.
+    */
+    struct StimAverage
+    {
+        QVector<MatrixXd> qVecEpochs;   /**< Ring of the epochs in the current window (pre + post stimulus). */
+        MatrixXd matSum;                /**< Running sum of the epochs in the ring. */
+        MatrixXd matAve;                /**< Current average. */
+        qint32 iHead;                   /**< Ring slot which receives the next epoch. */
+        qint32 iCount;                  /**< Number of valid epochs in the ring. */
+        qint32 iEvictions;              /**< Evictions since the running sum was last rebuilt from the ring. */
+        qint32 iTotal;                  /**< Total number of epochs added, used by the exponential mode. */
+    };
+
+    //=========================================================================================================
+    /**
+    * (Re)allocates the epoch ring of a stimulus average. Epochs which fit into the new ring are kept, the oldest
+    * ones are dropped, the running sum is rebuilt.
+    *
+    * @param[in, out] p_stimAve     Average to resize
+    * @param[in] p_iCapacity        Number of epochs in the window
+    * @param[in] p_iRows            Number of channels
+    * @param[in] p_iCols            Number of samples per epoch
+    */
+    void resizeAverage(StimAverage &p_stimAve, qint32 p_iCapacity, qint32 p_iRows, qint32 p_iCols);
+
+    //=========================================================================================================
+    /**
+    * Returns the ring slot which receives the next epoch. If the ring is full, the oldest epoch is subtracted from
+    * the running sum first, the slot is overwritten by the caller afterwards.
+    *
+    * @param[in, out] p_stimAve     Average to append to
+    *
+    * @return the slot to write the new epoch to
+    */
+    MatrixXd& beginEpoch(StimAverage &p_stimAve);
+
+    //=========================================================================================================
+    /**
+    * Adds the epoch written to the slot returned by beginEpoch to the running sum/exponential average and
+    * updates the current average.
+    *
+    * @param[in, out] p_stimAve     Average to append to
+    */
+    void commitEpoch(StimAverage &p_stimAve);
+
+    //=========================================================================================================
+    /**
+    * A detected trigger, waiting until its post stimulus samples arrived.
+    */
+    struct Trigger
+    {
+        qint64 iSample;     /**< Absolute sample index of the rising edge. */
+        qint32 iStimIdx;    /**< Index into m_qListStimChannelIdcs. */
+        qint32 iCode;       /**< Trigger code (value of a composite stim channel, 0 for a single stim line). */
+    };
+
+    //=========================================================================================================
+    /**
+    * (Re)allocates the contiguous sample ring. Its length covers one epoch plus two buffers, so every trigger
+    * found in the newest buffer can still be read completely once its post stimulus samples arrived.
     *
-    * @param[in] p_qListRawMatBuf   List of raw buffers
-    * @param[in] p_iStimIdx         Stimulus index to investigate
+    * @param[in] p_iRows            Number of channels
+    * @param[in] p_iSamplesPerBuf   Number of samples per incoming buffer
     */
-    void assemblePostStimulus(const QList<QPair<QList<qint32>, MatrixXd> > &p_qListRawMatBuf, qint32 p_iStimIdx);
+    void resetRing(qint32 p_iRows, qint32 p_iSamplesPerBuf);
 
     //=========================================================================================================
     /**
-    * Assemble the prestimulus
+    * Appends a raw buffer to the sample ring.
     *
-    * @param[in] p_qListRawMatBuf   List of raw buffers
-    * @param[in] p_iStimIdx         Stimulus index to investigate
+    * @param[in] p_matRawSegment    Raw buffer
     */
-    void assemblePreStimulus(const QList<QPair<QList<qint32>, MatrixXd> > &p_qListRawMatBuf, qint32 p_iStimIdx);
+    void writeRing(const MatrixXd &p_matRawSegment);
+
+    //=========================================================================================================
+    /**
+    * Copies the samples [p_iFirstSample, p_iFirstSample + p_matEpoch.cols()) out of the sample ring.
+    *
+    * @param[in] p_iFirstSample     Absolute index of the first sample
+    * @param[out] p_matEpoch        Destination, has to be sized already
+    */
+    void readRing(qint64 p_iFirstSample, MatrixXd &p_matEpoch) const;
+
+    //=========================================================================================================
+    /**
+    * Detects rising edges on all stimulus channels at sample resolution and appends them to the pending
+    * triggers. Single stim lines trigger on a 0 -> positive transition; composite channels (STI 014, STI 101)
+    * trigger on every change to a nonzero value and route by that value.
+    *
+    * @param[in] p_matRawSegment    Raw buffer
+    * @param[in] p_iFirstSample     Absolute index of the buffer's first sample
+    */
+    void detectTriggers(const MatrixXd &p_matRawSegment, qint64 p_iFirstSample);
 
     QMutex m_qMutex;                    /**< Provides access serialization between threads*/
 
     qint32 m_iNumAverages;              /**< Number of averages */
 
+    AveragingMode m_eAveragingMode;     /**< Sliding window or exponential averaging. */
+    double m_dAlpha;                    /**< Weight of the newest epoch in exponential mode, 0 = derived from m_iNumAverages. */
+
     qint32     m_iPreStimSamples;       /**< Amount of samples averaged before the stimulus. */
     qint32     m_iPostStimSamples;      /**< Amount of samples averaged after the stimulus, including the stimulus sample.*/
 
@@ -259,21 +365,22 @@ private:
 
     bool        m_bIsRunning;           /**< Holds if real-time Covariance estimation is running.*/
 
-    CircularMatrixBuffer<double>::SPtr m_pRawMatrixBuffer;   /**< The Circular Raw Matrix Buffer. */
+    RingMatrixBuffer<double>::SPtr m_pRawMatrixBuffer;       /**< The Raw Matrix Ring Buffer. */
 
     bool m_bAutoAspect; /**< Auto aspect detection on or off. */
 
 
     QList<qint32> m_qListStimChannelIdcs;   /**< Stimulus channel indeces. */
+    QList<bool> m_qListStimIsComposite;     /**< Whether the stimulus channel carries trigger codes (STI 014, STI 101). */
+    VectorXi m_vecLastStimValue;            /**< Last stimulus value of every stimulus channel, for edge detection across buffers. */
 
-//    QList<fiff_int_t>  m_qSetAspectKinds;   /**< List of aspects to average. Each aspect is averaged separetely and released stored in evoked data.*/
+    MatrixXd m_matRing;                     /**< Contiguous ring of the most recent raw samples. */
+    qint64 m_iRingSamples;                  /**< Number of samples written to the ring since the last reset. */
+    QList<Trigger> m_qListPendingTriggers;  /**< Triggers, in order of occurence, whose epoch is not complete yet. */
 
-    QList<QList<MatrixXd> > m_qListQListPreStimBuf;     /**< assembles the pre stimulus data */
-    QList<QList<MatrixXd> > m_qListQListPostStimBuf;    /**< assembles the post stimulus data */
+//    QList<fiff_int_t>  m_qSetAspectKinds;   /**< List of aspects to average. Each aspect is averaged separetely and released stored in evoked data.*/
 
-    QList<MatrixXd> m_qListPreStimAve;     /**< the current pre stimulus average */
-    QList<MatrixXd> m_qListPostStimAve;    /**< the current post stimulus average */
-    QList<MatrixXd> m_qListStimAve;     /**< the current stimulus average */
+    QMap<QPair<qint32, qint32>, StimAverage> m_qMapStimAverages;    /**< Running averages, keyed by stimulus channel index and trigger code. */
 };
 
 //*************************************************************************************************************
@@ -43,6 +43,7 @@
 #include "rtcov.h"
 
 #include <iostream>
+#include <cmath>
 #include <fiff/fiff_cov.h>
 
 
@@ -52,6 +53,8 @@
 //=============================================================================================================
 
 #include <QDebug>
+#include <QMutexLocker>
+#include <QList>
 
 
 //*************************************************************************************************************
@@ -63,6 +66,112 @@ using namespace RTINVLIB;
 using namespace FIFFLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// STATIC DEFINITIONS
+//=============================================================================================================
+
+namespace
+{
+
+//=============================================================================================================
+/**
+* Welford style covariance accumulator working on whole buffers (Chan et al. pairwise update). The scatter
+* matrix is centered at the running mean, so there is no cancellation between a large sum of squares and the
+* squared mean. Only the lower triangle is updated (selfadjointView rank updates).
+*/
+template<typename T>
+class CovAccumulator
+{
+public:
+    typedef Matrix<T, Dynamic, Dynamic> MatrixT;
+    typedef Matrix<T, Dynamic, 1> VectorT;
+
+    CovAccumulator()
+    : m_dWeight(0.0)
+    {
+    }
+
+    void reset(qint32 p_iDim)
+    {
+        m_dWeight = 0.0;
+        m_vecMean = VectorT::Zero(p_iDim);
+        m_matM2 = MatrixT::Zero(p_iDim, p_iDim);
+    }
+
+    //add a buffer, the previous statistics are weighted with p_dDecay first (exponential windows)
+    void add(const MatrixT &p_matBlock, double p_dDecay = 1.0)
+    {
+        const double nb = p_matBlock.cols();
+        m_vecBlockMean = p_matBlock.rowwise().sum() / (T)nb;
+        m_matCentered = p_matBlock.colwise() - m_vecBlockMean;
+
+        double t_dWeightOld = m_dWeight;
+        if(p_dDecay != 1.0)
+        {
+            m_matM2.template triangularView<Lower>() *= (T)p_dDecay;
+            t_dWeightOld *= p_dDecay;
+        }
+        double t_dWeight = t_dWeightOld + nb;
+
+        m_vecDelta = m_vecBlockMean - m_vecMean;
+        m_matM2.template selfadjointView<Lower>().rankUpdate(m_matCentered, (T)1);
+        m_matM2.template selfadjointView<Lower>().rankUpdate(m_vecDelta, (T)(t_dWeightOld*nb/t_dWeight));
+        m_vecMean += m_vecDelta * (T)(nb/t_dWeight);
+        m_dWeight = t_dWeight;
+    }
+
+    //remove a buffer which was added before (sliding windows). Returns false if the downdate cancelled more than
+    //half of the digits of a channel's scatter (e.g. an artifact left the window) - the caller has to rebuild then
+    bool remove(const MatrixT &p_matBlock)
+    {
+        const double nb = p_matBlock.cols();
+        double t_dWeight = m_dWeight - nb;
+        if(t_dWeight < 1.0)
+        {
+            reset(m_vecMean.size());
+            return true;
+        }
+
+        m_vecBlockMean = p_matBlock.rowwise().sum() / (T)nb;
+        m_matCentered = p_matBlock.colwise() - m_vecBlockMean;
+        m_vecDiag = m_matM2.diagonal();
+
+        VectorT t_vecMean = (m_vecMean * (T)m_dWeight - m_vecBlockMean * (T)nb) / (T)t_dWeight;
+        m_vecDelta = m_vecBlockMean - t_vecMean;
+        m_matM2.template selfadjointView<Lower>().rankUpdate(m_matCentered, (T)-1);
+        m_matM2.template selfadjointView<Lower>().rankUpdate(m_vecDelta, (T)(-t_dWeight*nb/m_dWeight));
+        m_vecMean = t_vecMean;
+        m_dWeight = t_dWeight;
+
+        return !(m_matM2.diagonal().array() < m_vecDiag.array() * std::sqrt(NumTraits<T>::epsilon())).any();
+    }
+
+    double weight() const
+    {
+        return m_dWeight;
+    }
+
+    MatrixXd covariance() const
+    {
+        MatrixXd t_matCov = m_matM2.template cast<double>().template selfadjointView<Lower>();
+        return t_matCov / (m_dWeight - 1.0);
+    }
+
+private:
+    double m_dWeight;           /**< Number of samples, or their total weight in exponential windows. */
+    VectorT m_vecMean;          /**< Running mean. */
+    MatrixT m_matM2;            /**< Centered scatter matrix, lower triangle. */
+
+    VectorT m_vecBlockMean;     /**< Scratch: mean of the current buffer. */
+    VectorT m_vecDelta;         /**< Scratch: difference of the means. */
+    VectorT m_vecDiag;          /**< Scratch: diagonal of the scatter before a downdate. */
+    MatrixT m_matCentered;      /**< Scratch: centered buffer. */
+};
+
+} // NAMESPACE
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -71,9 +180,16 @@ using namespace FIFFLIB;
 RtCov::RtCov(qint32 p_iMaxSamples, FiffInfo::SPtr p_pFiffInfo, QObject *parent)
 : QThread(parent)
 , m_iMaxSamples(p_iMaxSamples)
+, m_iNewMaxSamples(p_iMaxSamples)
 , m_pFiffInfo(p_pFiffInfo)
+, m_eWindowMode(Tumbling)
+, m_iEmitInterval(0)
+, m_bFloatAccumulation(false)
+, m_bSettingsChanged(false)
 , m_bIsRunning(false)
 {
+    m_vecPicks = m_pFiffInfo->pick_types(true, true, false);
+
     qRegisterMetaType<FiffCov::SPtr>("FiffCov::SPtr");
 }
 
@@ -94,7 +210,7 @@ void RtCov::append(const MatrixXd &p_DataSegment)
 //    if(m_pRawMatrixBuffer) // ToDo handle change buffersize
 
     if(!m_pRawMatrixBuffer)
-        m_pRawMatrixBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(32, p_DataSegment.rows(), p_DataSegment.cols()));
+        m_pRawMatrixBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(32, p_DataSegment.rows(), p_DataSegment.cols()));
 
     m_pRawMatrixBuffer->push(&p_DataSegment);
 }
@@ -104,10 +220,42 @@ void RtCov::append(const MatrixXd &p_DataSegment)
 
 void RtCov::setSamples(qint32 samples)
 {
+    QMutexLocker locker(&mutex);
     m_iNewMaxSamples = samples;
 }
 
 
+//*************************************************************************************************************
+
+void RtCov::setWindowMode(WindowMode p_eMode, qint32 p_iEmitInterval)
+{
+    QMutexLocker locker(&mutex);
+    m_eWindowMode = p_eMode;
+    m_iEmitInterval = p_iEmitInterval > 0 ? p_iEmitInterval : 0;
+    m_bSettingsChanged = true;
+}
+
+
+//*************************************************************************************************************
+
+void RtCov::setFloatAccumulation(bool p_bFloat)
+{
+    QMutexLocker locker(&mutex);
+    m_bFloatAccumulation = p_bFloat;
+    m_bSettingsChanged = true;
+}
+
+
+//*************************************************************************************************************
+
+void RtCov::setPicks(const RowVectorXi &p_vecPicks)
+{
+    QMutexLocker locker(&mutex);
+    m_vecPicks = p_vecPicks;
+    m_bSettingsChanged = true;
+}
+
+
 //*************************************************************************************************************
 
 bool RtCov::start()
@@ -116,6 +264,10 @@ bool RtCov::start()
     if(this->isRunning())
         QThread::wait();
 
+    //The consumer thread is gone - drop stale data and the release of the last stop
+    if(m_pRawMatrixBuffer)
+        m_pRawMatrixBuffer->resetConsumer();
+
     m_bIsRunning = true;
     QThread::start();
 
@@ -129,9 +281,9 @@ bool RtCov::stop()
 {
     m_bIsRunning = false;
 
-    m_pRawMatrixBuffer->releaseFromPop();
-
-    m_pRawMatrixBuffer->clear();
+    //Only release the consumer - clearing here would race with a push or pop still in flight
+    if(m_pRawMatrixBuffer)
+        m_pRawMatrixBuffer->releaseFromPop();
 
     return true;
 }
@@ -139,68 +291,154 @@ bool RtCov::stop()
 
 //*************************************************************************************************************
 
-void RtCov::run()
+void RtCov::emitCovariance(const MatrixXd &p_matCov, qint32 p_iNFree)
 {
-    quint32 n_samples = 0;
-
     FiffCov::SPtr cov(new FiffCov());
-    VectorXd mu;
 
-    while(m_bIsRunning)
-    {
-        if(m_pRawMatrixBuffer)
-        {
-            MatrixXd rawSegment = m_pRawMatrixBuffer->pop();
-
-            if(n_samples == 0)
-            {
-                mu = rawSegment.rowwise().sum();
-                cov->data = rawSegment * rawSegment.transpose();
-            }
-            else
-            {
-                mu.array() += rawSegment.rowwise().sum().array();
-                cov->data += rawSegment * rawSegment.transpose();
-            }
-            n_samples += rawSegment.cols();
+    cov->data = MatrixXd::Zero(m_pFiffInfo->nchan, m_pFiffInfo->nchan);
+    for(qint32 j = 0; j < m_vecPicks.size(); ++j)
+        for(qint32 i = 0; i < m_vecPicks.size(); ++i)
+            cov->data(m_vecPicks[i], m_vecPicks[j]) = p_matCov(i, j);
 
-            if(n_samples > m_iMaxSamples)
-            {
-                mu /= (float)n_samples;
-                cov->data.array() -= n_samples * (mu * mu.transpose()).array();
-                cov->data.array() /= (n_samples - 1);
+    cov->kind = FIFFV_MNE_NOISE_COV;
+    cov->diag = false;
+    cov->dim = cov->data.rows();
 
-                cov->kind = FIFFV_MNE_NOISE_COV;
-                cov->diag = false;
-                cov->dim = cov->data.rows();
+    cov->names = m_pFiffInfo->ch_names;
+    cov->projs = m_pFiffInfo->projs;
+    cov->bads = m_pFiffInfo->bads;
+    cov->nfree = p_iNFree;
 
-                //ToDo do picks
-                cov->names = m_pFiffInfo->ch_names;
-                cov->projs = m_pFiffInfo->projs;
-                cov->bads = m_pFiffInfo->bads;
-                cov->nfree = n_samples;
+    // regularize noise covariance
+    *cov.data() = cov->regularize(*m_pFiffInfo, 0.05, 0.05, 0.1, true);
 
-                // regularize noise covariance
-                *cov.data() = cov->regularize(*m_pFiffInfo, 0.05, 0.05, 0.1, true);
+    emit covCalculated(cov);
+}
 
-                emit covCalculated(cov);
 
-                cov = FiffCov::SPtr(new FiffCov());
-                n_samples = 0;
-            }
+//*************************************************************************************************************
 
+template<typename T>
+void RtCov::estimate()
+{
+    typedef typename CovAccumulator<T>::MatrixT MatrixT;
 
-//            qint32 samples = rawSegment.cols();
-//            VectorXf mu = rawSegment.rowwise().sum().array() / (float)samples;
+    mutex.lock();
+    WindowMode t_eMode = m_eWindowMode;
+    RowVectorXi t_vecPicks = m_vecPicks;
+    m_bSettingsChanged = false;
+    mutex.unlock();
 
-//            MatrixXf noise_covariance = rawSegment * rawSegment.transpose();// noise_covariance == raw_covariance
-//            noise_covariance.array() -= samples * (mu * mu.transpose()).array();
-//            noise_covariance.array() /= (samples - 1);
+    CovAccumulator<T> t_accumulator;
+    t_accumulator.reset(t_vecPicks.size());
 
-//            std::cout << "Noise Covariance:\n" << noise_covariance.block(0,0,10,10) << std::endl;
+    QList<MatrixT> t_qListWindow;   // buffers of the sliding window
+    qint32 t_iWindowSamples = 0;
+    qint32 t_iSinceEmit = 0;
+    qint32 t_iSinceAnchor = 0;
+    bool t_bRebuild = false;
+    double t_dSamplesSeen = 0;
 
-//            printf("%d raw buffer (%d x %d) generated\r\n", count, tmp.rows(), tmp.cols());
+    MatrixXd rawSegment;
+    MatrixT t_matPicked;
 
+    while(m_bIsRunning)
+    {
+        mutex.lock();
+        if(m_bSettingsChanged)
+        {
+            mutex.unlock();
+            return;
+        }
+        m_iMaxSamples = m_iNewMaxSamples;
+        qint32 t_iMaxSamples = m_iMaxSamples;
+        qint32 t_iEmitInterval = m_iEmitInterval > 0 ? m_iEmitInterval : t_iMaxSamples;
+        mutex.unlock();
+
+        //Timed pop - lets the loop notice a stop request instead of blocking in the buffer
+        if(!m_pRawMatrixBuffer || !m_pRawMatrixBuffer->tryPop(rawSegment, 100))
+            continue;
+
+        //
+        // Picks before the outer product
+        //
+        t_matPicked.resize(t_vecPicks.size(), rawSegment.cols());
+        for(qint32 i = 0; i < t_vecPicks.size(); ++i)
+            t_matPicked.row(i) = rawSegment.row(t_vecPicks[i]).template cast<T>();
+
+        switch(t_eMode)
+        {
+            case Tumbling:
+                t_accumulator.add(t_matPicked);
+                if(t_accumulator.weight() > t_iMaxSamples)
+                {
+                    this->emitCovariance(t_accumulator.covariance(), (qint32)t_accumulator.weight());
+                    t_accumulator.reset(t_vecPicks.size());
+                }
+                break;
+
+            case Sliding:
+                t_accumulator.add(t_matPicked);
+                t_qListWindow.append(t_matPicked);
+                t_iWindowSamples += t_matPicked.cols();
+                t_bRebuild = false;
+                while(t_qListWindow.size() > 1 && t_iWindowSamples - t_qListWindow.first().cols() >= t_iMaxSamples)
+                {
+                    t_bRebuild |= !t_accumulator.remove(t_qListWindow.first());
+                    t_iWindowSamples -= t_qListWindow.first().cols();
+                    t_qListWindow.removeFirst();
+                }
+
+                //rebuild from the window once per full window turnover, which bounds the error the downdates
+                //accumulate, and right away when a downdate cancelled most of the scatter
+                t_iSinceAnchor += t_matPicked.cols();
+                if(t_bRebuild || t_iSinceAnchor >= t_iMaxSamples)
+                {
+                    t_accumulator.reset(t_vecPicks.size());
+                    for(qint32 k = 0; k < t_qListWindow.size(); ++k)
+                        t_accumulator.add(t_qListWindow[k]);
+                    t_iSinceAnchor = 0;
+                }
+
+                t_iSinceEmit += t_matPicked.cols();
+                if(t_iWindowSamples >= t_iMaxSamples && t_iSinceEmit >= t_iEmitInterval)
+                {
+                    this->emitCovariance(t_accumulator.covariance(), t_iWindowSamples);
+                    t_iSinceEmit = 0;
+                }
+                break;
+
+            case Exponential:
+                //time constant of t_iMaxSamples samples
+                t_accumulator.add(t_matPicked, std::exp(-(double)t_matPicked.cols()/t_iMaxSamples));
+                t_dSamplesSeen += t_matPicked.cols();
+
+                t_iSinceEmit += t_matPicked.cols();
+                if(t_dSamplesSeen >= t_iMaxSamples && t_iSinceEmit >= t_iEmitInterval)
+                {
+                    this->emitCovariance(t_accumulator.covariance(), (qint32)t_accumulator.weight());
+                    t_iSinceEmit = 0;
+                }
+                break;
         }
     }
 }
+
+
+//*************************************************************************************************************
+
+void RtCov::run()
+{
+    while(m_bIsRunning)
+    {
+        mutex.lock();
+        bool t_bFloat = m_bFloatAccumulation;
+        mutex.unlock();
+
+        // settings changes return from estimate and restart it
+        if(t_bFloat)
+            this->estimate<float>();
+        else
+            this->estimate<double>();
+    }
+}
@@ -58,7 +58,7 @@
 // Generics INCLUDES
 //=============================================================================================================
 
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 
 
 //*************************************************************************************************************
@@ -111,6 +111,17 @@ public:
     typedef QSharedPointer<RtCov> SPtr;             /**< Shared pointer type for RtCov. */
     typedef QSharedPointer<const RtCov> ConstSPtr;  /**< Const shared pointer type for RtCov. */
 
+    //=========================================================================================================
+    /**
+    * Estimation windows
+    */
+    enum WindowMode
+    {
+        Tumbling,       /**< Disjoint windows of the estimation samples, the covariance is emitted once per window. */
+        Sliding,        /**< The latest estimation samples, oldest buffers are removed by a downdate, rebuilt once per window turnover. */
+        Exponential     /**< Exponentially weighted, the estimation samples are the time constant. */
+    };
+
     //=========================================================================================================
     /**
     * Creates the real-time covariance estimation object.
@@ -151,6 +162,35 @@ public:
     */
     void setSamples(qint32 samples);
 
+    //=========================================================================================================
+    /**
+    * Sets the estimation window. Sliding and exponential windows emit a covariance every p_iEmitInterval samples
+    * once the first window is filled; 0 emits once per estimation samples.
+    *
+    * @param[in] p_eMode            window mode
+    * @param[in] p_iEmitInterval    samples between two emitted covariances (sliding and exponential only)
+    */
+    void setWindowMode(WindowMode p_eMode, qint32 p_iEmitInterval = 0);
+
+    //=========================================================================================================
+    /**
+    * Accumulate in single instead of double precision. Halves memory traffic of the rank updates, at the cost of
+    * accuracy for very long windows.
+    *
+    * @param[in] p_bFloat   true for float accumulation
+    */
+    void setFloatAccumulation(bool p_bFloat);
+
+    //=========================================================================================================
+    /**
+    * Sets the channels the covariance is estimated for. Only these rows enter the outer products, the emitted
+    * covariance keeps the full channel dimension with zeros for all other channels. Default are all MEG and EEG
+    * channels.
+    *
+    * @param[in] p_vecPicks     indices of the channels to estimate the covariance for
+    */
+    void setPicks(const RowVectorXi &p_vecPicks);
+
     //=========================================================================================================
     /**
     * Starts the RtCov by starting the producer's thread.
@@ -186,6 +226,22 @@ protected:
     virtual void run();
 
 private:
+    //=========================================================================================================
+    /**
+    * The estimation loop, templated on the accumulation precision.
+    */
+    template<typename T>
+    void estimate();
+
+    //=========================================================================================================
+    /**
+    * Expands the covariance of the picked channels to the full channel dimension, regularizes and emits it.
+    *
+    * @param[in] p_matCov   covariance of the picked channels
+    * @param[in] p_iNFree   degrees of freedom
+    */
+    void emitCovariance(const MatrixXd &p_matCov, qint32 p_iNFree);
+
     QMutex      mutex;                  /**< Provides access serialization between threads*/
 
     quint32      m_iMaxSamples;         /**< Maximal amount of samples received, before covariance is estimated.*/
@@ -194,9 +250,15 @@ private:
 
     FiffInfo::SPtr  m_pFiffInfo;        /**< Holds the fiff measurement information. */
 
+    WindowMode  m_eWindowMode;          /**< Tumbling, sliding or exponential window. */
+    qint32      m_iEmitInterval;        /**< Samples between two emitted covariances, 0 = estimation samples. */
+    bool        m_bFloatAccumulation;   /**< Accumulate in single precision. */
+    RowVectorXi m_vecPicks;             /**< Channels the covariance is estimated for. */
+    bool        m_bSettingsChanged;     /**< Window, precision or picks changed -> restart the estimation. */
+
     bool        m_bIsRunning;           /**< Holds if real-time Covariance estimation is running.*/
 
-    CircularMatrixBuffer<double>::SPtr m_pRawMatrixBuffer;   /**< The Circular Raw Matrix Buffer. */
+    RingMatrixBuffer<double>::SPtr m_pRawMatrixBuffer;       /**< The Raw Matrix Ring Buffer. */
 };
 
 //*************************************************************************************************************
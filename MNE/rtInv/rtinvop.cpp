@@ -41,6 +41,8 @@
 
 #include "rtinvop.h"
 
+#include <utils/mnemath.h>
+
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -48,6 +50,7 @@
 //=============================================================================================================
 
 
+#include <QMutexLocker>
 #include <QDebug>
 
 
@@ -57,6 +60,7 @@
 //=============================================================================================================
 
 using namespace RTINVLIB;
+using namespace UTILSLIB;
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -65,8 +69,14 @@ using namespace RTINVLIB;
 
 RtInvOp::RtInvOp(FiffInfo::SPtr &p_pFiffInfo, MNEForwardSolution::SPtr &p_pFwd, QObject *parent)
 : QThread(parent)
+, m_bIsRunning(false)
+, m_bNoiseCovPending(false)
+, m_eSvdMethod(GramSvd)
+, m_iSvdRank(0)
 , m_pFiffInfo(p_pFiffInfo)
 , m_pFwd(p_pFwd)
+, m_bForwardCacheValid(false)
+, m_iMethods(FIFFV_MNE_MEG)
 {
     qRegisterMetaType<MNEInverseOperator::SPtr>("MNEInverseOperator::SPtr");
 }
@@ -84,13 +94,24 @@ RtInvOp::~RtInvOp()
 
 void RtInvOp::appendNoiseCov(FiffCov &p_noiseCov)
 {
-    mutex.lock();
-    //Use here a circular buffer
-    m_vecNoiseCov.push_back(p_noiseCov);
+    QMutexLocker locker(&mutex);
+    //Only the latest covariance matters, a pending older one is superseded
+    if(m_bNoiseCovPending)
+        qDebug() << "RtInvOp: superseding unprocessed noise covariance";
 
-    qDebug() << "RtInvOp m_vecNoiseCov" << m_vecNoiseCov.size();
+    m_noiseCov = p_noiseCov;
+    m_bNoiseCovPending = true;
+    m_qWaitNoiseCov.wakeOne();
+}
 
-    mutex.unlock();
+
+//*************************************************************************************************************
+
+void RtInvOp::setSvdMethod(SvdMethod p_eMethod, qint32 p_iRank)
+{
+    QMutexLocker locker(&mutex);
+    m_eSvdMethod = p_eMethod;
+    m_iSvdRank = p_iRank;
 }
 
 
@@ -98,32 +119,212 @@ void RtInvOp::appendNoiseCov(FiffCov &p_noiseCov)
 
 bool RtInvOp::stop()
 {
+    mutex.lock();
     m_bIsRunning = false;
+    m_qWaitNoiseCov.wakeAll();
+    mutex.unlock();
+
     QThread::wait();
 
     return true;
 }
 
 
+//*************************************************************************************************************
+
+void RtInvOp::updateForwardCache(const QStringList &p_qListChNames)
+{
+    if(!m_bForwardCacheValid)
+    {
+        // Restrict forward solution as necessary for MEG
+        m_forwardMeg = m_pFwd->pick_types(true, false);
+    }
+
+    bool is_fixed_ori = m_forwardMeg.isFixedOrient();
+
+    //
+    // Pick the gain rows of the selected channels
+    //
+    QStringList fwd_ch_names;
+    for(qint32 i = 0; i < m_forwardMeg.info.chs.size(); ++i)
+        fwd_ch_names << m_forwardMeg.info.chs[i].ch_name;
+
+    RowVectorXi info_idx(p_qListChNames.size());
+    MatrixXd gain(p_qListChNames.size(), m_forwardMeg.sol->data.cols());
+    for(qint32 i = 0; i < p_qListChNames.size(); ++i)
+    {
+        gain.row(i) = m_forwardMeg.sol->data.row(fwd_ch_names.indexOf(p_qListChNames[i]));
+        info_idx[i] = m_pFiffInfo->ch_names.indexOf(p_qListChNames[i]);
+    }
+    m_gainInfo = m_pFiffInfo->pick_info(info_idx);
+
+    //
+    // Depth and orientation priors - limited to the MEG channels as in make_inverse_operator
+    //
+    m_pDepthPrior = FiffCov::SDPtr(new FiffCov(MNEForwardSolution::compute_depth_prior(gain, m_gainInfo, is_fixed_ori, 0.8, 10.0, defaultConstMatrixXd, true)));
+    m_pSourceCov = FiffCov::SDPtr(new FiffCov(*m_pDepthPrior));
+    if(!is_fixed_ori)
+    {
+        m_pOrientPrior = FiffCov::SDPtr(new FiffCov(m_forwardMeg.compute_orient_prior(0.2f)));
+        m_pSourceCov->data.array() *= m_pOrientPrior->data.array();
+    }
+
+    //
+    // Source weighting commutes with the whitening (diagonal from the right) -> apply it once
+    //
+    RowVectorXd source_std = m_pSourceCov->data.array().sqrt().transpose();
+    m_matWeightedGain = gain * source_std.asDiagonal();
+
+    //
+    // Methods
+    //
+    bool has_meg = false;
+    bool has_eeg = false;
+    for(qint32 i = 0; i < info_idx.size(); ++i)
+    {
+        QString ch_type = m_pFiffInfo->channel_type(info_idx[i]);
+        if (ch_type == "eeg")
+            has_eeg = true;
+        if ((ch_type == "mag") || (ch_type == "grad"))
+            has_meg = true;
+    }
+    if(has_eeg && has_meg)
+        m_iMethods = FIFFV_MNE_MEG_EEG;
+    else if(has_meg)
+        m_iMethods = FIFFV_MNE_MEG;
+    else
+        m_iMethods = FIFFV_MNE_EEG;
+
+    m_qListCacheChNames = p_qListChNames;
+    m_bForwardCacheValid = true;
+}
+
+
+//*************************************************************************************************************
+
+MNEInverseOperator::SPtr RtInvOp::refreshInverseOperator(const FiffCov &p_noiseCov)
+{
+    //
+    // Channel selection as in MNEForwardSolution::prepare_forward
+    //
+    if(!m_bForwardCacheValid)
+        m_forwardMeg = m_pFwd->pick_types(true, false);
+
+    QStringList ch_names;
+    for(qint32 i = 0; i < m_pFiffInfo->chs.size(); ++i)
+    {
+        const QString &t_sName = m_pFiffInfo->chs[i].ch_name;
+        if(!m_pFiffInfo->bads.contains(t_sName) && !p_noiseCov.bads.contains(t_sName) && m_forwardMeg.info.ch_names.contains(t_sName))
+            ch_names << t_sName;
+    }
+
+    if(!m_bForwardCacheValid || ch_names != m_qListCacheChNames)
+        this->updateForwardCache(ch_names);
+
+    //
+    // Whitener - the only noise covariance dependent part besides the scaling
+    //
+    FiffCov t_noiseCov = p_noiseCov.prepare_noise_cov(*m_pFiffInfo, ch_names);
+
+    qint32 n_nzero = 0;
+    VectorXd t_vecInvSqrtEig = VectorXd::Zero(t_noiseCov.eig.size());
+    for(qint32 i = 0; i < t_noiseCov.eig.size(); ++i)
+    {
+        if(t_noiseCov.eig[i] > 0)
+        {
+            t_vecInvSqrtEig[i] = 1.0 / sqrt(t_noiseCov.eig[i]);
+            ++n_nzero;
+        }
+    }
+    // Cols of eigvec are the eigenvectors
+    MatrixXd whitener = t_vecInvSqrtEig.asDiagonal() * t_noiseCov.eigvec;
+
+    MatrixXd gain = whitener * m_matWeightedGain;
+
+    //
+    // Adjusting Source Covariance matrix to make trace of G*R*G' equal to number of sensors.
+    //
+    double trace_GRGT = gain.squaredNorm();
+    double scaling_source_cov = (double)n_nzero / trace_GRGT;
+    gain *= sqrt(scaling_source_cov);
+
+    FiffCov::SDPtr p_source_cov(new FiffCov(*m_pSourceCov));
+    p_source_cov->data.array() *= scaling_source_cov;
+
+    //
+    // Decompose
+    //
+    mutex.lock();
+    SvdMethod t_eSvdMethod = m_eSvdMethod;
+    qint32 t_iSvdRank = m_iSvdRank;
+    mutex.unlock();
+
+    VectorXd p_sing;
+    MatrixXd t_U, t_V;
+    if(t_eSvdMethod == RandomizedSvd && t_iSvdRank > 0 && t_iSvdRank < gain.rows())
+        MNEMath::svd_randomized(gain, t_iSvdRank, p_sing, t_U, t_V);
+    else if(t_eSvdMethod == JacobiSvd || gain.rows() > gain.cols())
+    {
+        JacobiSVD<MatrixXd> svd(gain, ComputeThinU | ComputeThinV);
+        p_sing = svd.singularValues();
+        t_U = svd.matrixU();
+        t_V = svd.matrixV();
+    }
+    else
+        MNEMath::svd_gram(gain, p_sing, t_U, t_V);
+
+    MNEInverseOperator::SPtr t_pInvOp(new MNEInverseOperator());
+    t_pInvOp->eigen_fields = FiffNamedMatrix::SDPtr(new FiffNamedMatrix(t_U.cols(), t_U.rows(), defaultQStringList, ch_names, t_U.transpose()));
+    t_pInvOp->eigen_leads = FiffNamedMatrix::SDPtr(new FiffNamedMatrix(t_V.rows(), t_V.cols(), defaultQStringList, defaultQStringList, t_V));
+    t_pInvOp->sing = p_sing;
+    t_pInvOp->nave = 1;
+    t_pInvOp->depth_prior = m_pDepthPrior;
+    t_pInvOp->source_cov = p_source_cov;
+    t_pInvOp->noise_cov = FiffCov::SDPtr(new FiffCov(t_noiseCov));
+    t_pInvOp->orient_prior = m_pOrientPrior;
+    t_pInvOp->projs = m_pFiffInfo->projs;
+    t_pInvOp->eigen_leads_weighted = false;
+    t_pInvOp->source_ori = m_forwardMeg.source_ori;
+    t_pInvOp->mri_head_t = m_forwardMeg.mri_head_t;
+    t_pInvOp->methods = m_iMethods;
+    t_pInvOp->nsource = m_forwardMeg.nsource;
+    t_pInvOp->coord_frame = m_forwardMeg.coord_frame;
+    t_pInvOp->source_nn = m_forwardMeg.source_nn;
+    t_pInvOp->src = m_forwardMeg.src;
+    t_pInvOp->info = m_forwardMeg.info;
+    t_pInvOp->info.bads = m_pFiffInfo->bads;
+
+    return t_pInvOp;
+}
+
+
 //*************************************************************************************************************
 
 void RtInvOp::run()
 {
+    mutex.lock();
     m_bIsRunning = true;
+    mutex.unlock();
 
-    while(m_bIsRunning)
+    while(true)
     {
-        if(m_vecNoiseCov.size() > 0)
-        {
-            // Restrict forward solution as necessary for MEG
-            MNEForwardSolution t_forwardMeg = m_pFwd->pick_types(true, false);
+        mutex.lock();
+        while(m_bIsRunning && !m_bNoiseCovPending)
+            m_qWaitNoiseCov.wait(&mutex);
 
-            mutex.lock();
-            MNEInverseOperator::SPtr t_invOpMeg(new MNEInverseOperator(*m_pFiffInfo.data(), t_forwardMeg, m_vecNoiseCov[0], 0.2f, 0.8f));
-            m_vecNoiseCov.pop_front();
+        if(!m_bIsRunning)
+        {
             mutex.unlock();
-
-            emit invOperatorCalculated(t_invOpMeg);
+            break;
         }
+
+        //take the latest covariance; the ones arriving while computing are coalesced into the next run
+        FiffCov t_noiseCov = m_noiseCov;
+        m_bNoiseCovPending = false;
+        mutex.unlock();
+
+        MNEInverseOperator::SPtr t_invOpMeg = this->refreshInverseOperator(t_noiseCov);
+
+        emit invOperatorCalculated(t_invOpMeg);
     }
 }
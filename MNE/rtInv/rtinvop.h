@@ -67,7 +67,9 @@
 
 #include <QThread>
 #include <QMutex>
+#include <QWaitCondition>
 #include <QSharedPointer>
+#include <QStringList>
 
 
 //*************************************************************************************************************
@@ -110,6 +112,17 @@ public:
     typedef QSharedPointer<RtInvOp> SPtr;             /**< Shared pointer type for RtInvOp. */
     typedef QSharedPointer<const RtInvOp> ConstSPtr;  /**< Const shared pointer type for RtInvOp. */
 
+    //=========================================================================================================
+    /**
+    * Decomposition used for the whitened, weighted lead field
+    */
+    enum SvdMethod
+    {
+        JacobiSvd,      /**< Full Jacobi SVD, as make_inverse_operator. */
+        GramSvd,        /**< Eigen decomposition of the channel x channel Gram matrix (default). */
+        RandomizedSvd   /**< Randomized truncated SVD of a given rank. */
+    };
+
     //=========================================================================================================
     /**
     * Creates the real-time inverse operator estimation object
@@ -134,6 +147,15 @@ public:
     */
     void appendNoiseCov(FiffCov &p_NoiseCov);
 
+    //=========================================================================================================
+    /**
+    * Sets the decomposition of the whitened lead field.
+    *
+    * @param[in] p_eMethod  SVD method
+    * @param[in] p_iRank    Number of components for RandomizedSvd
+    */
+    void setSvdMethod(SvdMethod p_eMethod, qint32 p_iRank = 0);
+
     //=========================================================================================================
     /**
     * Stops the RtInv by stopping the producer's thread.
@@ -169,13 +191,49 @@ protected:
     virtual void run();
 
 private:
+    //=========================================================================================================
+    /**
+    * Computes everything which depends only on the forward solution and the channel selection: picked gain,
+    * depth and orientation priors and the gain weighted with the source standard deviations.
+    *
+    * @param[in] p_qListChNames     Channels used for the inverse operator
+    */
+    void updateForwardCache(const QStringList &p_qListChNames);
+
+    //=========================================================================================================
+    /**
+    * Creates the inverse operator for a new noise covariance using the forward cache. Equivalent to
+    * MNEInverseOperator::make_inverse_operator with loose = 0.2, depth = 0.8 on the MEG channels, but only the
+    * whitener, the source covariance scaling and the decomposition are recomputed.
+    *
+    * @param[in] p_noiseCov     Noise covariance
+    *
+    * @return the inverse operator
+    */
+    MNEInverseOperator::SPtr refreshInverseOperator(const FiffCov &p_noiseCov);
+
     QMutex      mutex;                  /**< Provides access serialization between threads. */
     bool        m_bIsRunning;           /**< Whether RtInv is running. */
 
-    QVector<FiffCov> m_vecNoiseCov;     /**< Noise covariance matrices. */
+    QWaitCondition m_qWaitNoiseCov;     /**< Wakes the thread when a noise covariance arrived. */
+    FiffCov     m_noiseCov;             /**< Latest noise covariance, older ones are superseded before they are processed. */
+    bool        m_bNoiseCovPending;     /**< Whether m_noiseCov has not been processed yet. */
+
+    SvdMethod   m_eSvdMethod;           /**< Decomposition of the whitened lead field. */
+    qint32      m_iSvdRank;             /**< Rank for the randomized SVD. */
 
     FiffInfo::SPtr m_pFiffInfo;         /**< The fiff measurement information. */
     MNEForwardSolution::SPtr m_pFwd;    /**< The forward solution. */
+
+    bool        m_bForwardCacheValid;   /**< Whether the cached forward pieces below match the channel selection. */
+    MNEForwardSolution m_forwardMeg;    /**< MEG part of the forward solution. */
+    QStringList m_qListCacheChNames;    /**< Channel selection of the cache. */
+    FiffInfo    m_gainInfo;             /**< Measurement info of the selected channels. */
+    MatrixXd    m_matWeightedGain;      /**< Picked gain, columns scaled with sqrt of the source covariance. */
+    FiffCov::SDPtr m_pDepthPrior;       /**< Depth weighting prior. */
+    FiffCov::SDPtr m_pOrientPrior;      /**< Loose orientation prior. */
+    FiffCov::SDPtr m_pSourceCov;        /**< Unscaled source covariance (depth x orientation prior). */
+    qint32      m_iMethods;             /**< FIFFV_MNE_MEG, FIFFV_MNE_EEG or FIFFV_MNE_MEG_EEG. */
 };
 
 //*************************************************************************************************************
@@ -69,9 +69,10 @@ using namespace FIFFLIB;
 // DEFINE MEMBER METHODS
 //=============================================================================================================
 
-RtNoise::RtNoise(qint32 p_iMaxSamples, FiffInfo::SPtr p_pFiffInfo, QObject *parent)
+RtNoise::RtNoise(qint32 p_iMaxSamples, FiffInfo::SPtr p_pFiffInfo, qint32 p_iNumAverages, QObject *parent)
 : QThread(parent)
 , m_iFFTlength(p_iMaxSamples)
+, m_iNumAverages(p_iNumAverages)
 , m_pFiffInfo(p_pFiffInfo)
 , m_bIsRunning(false)
 {
@@ -79,9 +80,6 @@ RtNoise::RtNoise(qint32 p_iMaxSamples, FiffInfo::SPtr p_pFiffInfo, QObject *pare
     //qRegisterMetaType<QVector<double>>("QVector<double>");
 
     m_Fs = m_pFiffInfo->sfreq;
-    ReadDone = true;
-
-    SendDataToBuffer = true;
 }
 
 
@@ -101,10 +99,9 @@ void RtNoise::append(const MatrixXd &p_DataSegment)
 //    if(m_pRawMatrixBuffer) // ToDo handle change buffersize
 
     if(!m_pRawMatrixBuffer)
-        m_pRawMatrixBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(120, p_DataSegment.rows(), p_DataSegment.cols()));
+        m_pRawMatrixBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(120, p_DataSegment.rows(), p_DataSegment.cols()));
 
-    if (SendDataToBuffer)
-        m_pRawMatrixBuffer->push(&p_DataSegment);
+    m_pRawMatrixBuffer->push(&p_DataSegment);
 }
 
 
@@ -116,6 +113,10 @@ bool RtNoise::start()
     if(this->isRunning())
         QThread::wait();
 
+    //The consumer thread is gone - drop stale data and the release of the last stop
+    if(m_pRawMatrixBuffer)
+        m_pRawMatrixBuffer->resetConsumer();
+
     m_bIsRunning = true;
     QThread::start();
 
@@ -129,9 +130,9 @@ bool RtNoise::stop()
 {
     m_bIsRunning = false;
 
-    m_pRawMatrixBuffer->releaseFromPop();
-
-    m_pRawMatrixBuffer->clear();
+    //Only release the consumer - clearing here would race with a push or pop still in flight
+    if(m_pRawMatrixBuffer)
+        m_pRawMatrixBuffer->releaseFromPop();
 
     return true;
 }
@@ -141,111 +142,30 @@ bool RtNoise::stop()
 
 void RtNoise::run()
 {
-    bool FirstStart = true;
+    MatrixXd block;
 
     while(m_bIsRunning)
     {
-        if(m_pRawMatrixBuffer)
+        //Timed pop - lets the loop notice a stop request instead of blocking in the buffer
+        if(m_pRawMatrixBuffer && m_pRawMatrixBuffer->tryPop(block, 100))
         {
-            MatrixXd block = m_pRawMatrixBuffer->pop();
-
-            if(FirstStart){
-                //init the circ buffer and parameters
-                NumOfBlocks = 60;
-                BlockSize =  block.cols();
-                Sensors =  block.rows();
-
-                CircBuf.resize(Sensors,NumOfBlocks*BlockSize);
-
-                BlockIndex = 0;
-                FirstStart = false;
+            //init the estimator with the first block - a new segment starts with every block
+            if(m_welchPsd.psd().rows() != block.rows())
+            {
+                //keep the averaged time span of m_iNumAverages half overlapping segments
+                qint32 t_iHop = qMin((qint32)block.cols(), m_iFFTlength);
+                qint32 t_iNumAverages = qMax(1, (qint32)((qint64)m_iNumAverages*(m_iFFTlength/2)/t_iHop));
+                m_welchPsd.init(block.rows(), m_iFFTlength, m_Fs, t_iNumAverages, t_iHop);
             }
-            //concate blocks
-            for (int i=0; i< Sensors; i++)
-                for (int j=0; j< BlockSize; j++)
-                    CircBuf(i,j+BlockIndex*BlockSize) = block(i,j);
-
-
-            BlockIndex ++;
-            if (BlockIndex >= NumOfBlocks){
-
-                //m_pRawMatrixBuffer.clear(); //empty the buffer
-
-                SendDataToBuffer = false;
-                //stop collect block and start to calculate the spectrum
-                BlockIndex = 0;
-
-                MatrixXd sum_psdx = MatrixXd::Zero(Sensors,m_iFFTlength/2+1);
-
-                int nb = floor(NumOfBlocks*BlockSize/m_iFFTlength)+1;
-                qDebug()<<"nb"<<nb<<"NumOfBlocks"<<NumOfBlocks<<"BlockSize"<<BlockSize;
-                MatrixXd t_mat(Sensors,m_iFFTlength);
-                MatrixXd t_psdx(Sensors,m_iFFTlength/2+1);
-                for (int n = 0; n<nb; n++){
-                    //collect a data block with data length of m_iFFTlength;
-                    if(n==nb-1)
-                    {
-                        for(qint32 ii=0; ii<Sensors; ii++)
-                        for(qint32 jj=0; jj<m_iFFTlength; jj++)
-                            if(jj+n*m_iFFTlength<NumOfBlocks*BlockSize)
-                                t_mat(ii,jj) = CircBuf(ii,jj+n*m_iFFTlength);
-                            else
-                                t_mat(ii,jj) = 0.0;
-
-                    }
-                    else
-                    {
-                        for(qint32 ii=0; ii<Sensors; ii++)
-                        for(qint32 jj=0; jj<m_iFFTlength; jj++)
-                            t_mat(ii,jj) = CircBuf(ii,jj+n*m_iFFTlength);
-                    }
-
-                    //FFT calculation by row
-                    for(qint32 i = 0; i < t_mat.rows(); i++){
-                        RowVectorXd data;
-
-                        data = t_mat.row(i);
-
-                        //zero-pad data to m_iFFTlength
-                        RowVectorXd t_dataZeroPad = RowVectorXd::Zero(m_iFFTlength);
-                        t_dataZeroPad.head(data.cols()) = data;
-
-                        //generate fft object
-                        Eigen::FFT<double> fft;
-                        fft.SetFlag(fft.HalfSpectrum);
-
-                        //fft-transform data sequence
-                        RowVectorXcd t_freqData(m_iFFTlength/2+1);
-                        fft.fwd(t_freqData,t_dataZeroPad);
-
-                        // calculate spectrum from FFT
-                        for(qint32 j=0; j<m_iFFTlength/2+1;j++)
-                        {
-                            double mag_abs = sqrt(t_freqData(j).real()* t_freqData(j).real() +  t_freqData(j).imag()*t_freqData(j).imag());
-                            double spower = (1.0/(m_Fs*m_iFFTlength))* mag_abs;
-                            if (j>0&&j<m_iFFTlength/2) spower = 2.0*spower;
-                            sum_psdx(i,j) = sum_psdx(i,j) + spower;
-                //            t_psdx(i,j) = 10.0*log10(sum_psdx(i,j)/ncount);
-                        }
-                     }//row computing is done
-                }//nb
 
+            //the estimate is refreshed with every block once the first segment is complete
+            if(m_welchPsd.append(block) > 0)
+            {
                 //DB-calculation
-                for(qint32 ii=0; ii<Sensors; ii++)
-                    for(qint32 jj=0; jj<m_iFFTlength/2+1; jj++)
-                        t_psdx(ii,jj) = 10.0*log10(sum_psdx(ii,jj)/nb);
+                MatrixXd t_psdx = 10.0*m_welchPsd.psd().array().log10();
 
-                qDebug()<<"Send spectrum to Noise Estimator";
                 emit SpecCalculated(t_psdx); //send back the spectrum result
-                if(m_pRawMatrixBuffer->size()>0)
-                    m_pRawMatrixBuffer->clear();
-
-                SendDataToBuffer = true;
             }
-
         }
-
     }
-
 }
-
@@ -59,7 +59,15 @@
 // Generics INCLUDES
 //=============================================================================================================
 
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Utils INCLUDES
+//=============================================================================================================
+
+#include <utils/welchpsd.h>
 
 
 //*************************************************************************************************************
@@ -78,7 +86,6 @@
 //=============================================================================================================
 
 #include <Eigen/Core>
-#include <unsupported/Eigen/FFT>
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -97,11 +104,15 @@ namespace RTINVLIB
 using namespace Eigen;
 using namespace IOBuffer;
 using namespace FIFFLIB;
+using namespace UTILSLIB;
 
 
 //=============================================================================================================
 /**
-* Real-time noise Spectrum estimation
+* Real-time noise Spectrum estimation. The spectrum is a Welch estimate (WelchPsd) with Hann windowed segments
+* of the FFT length. A new segment starts with every incoming block, so once the first segment is complete the
+* spectrum is emitted in dB with every block. The estimate spans the same time as numAverages half overlapping
+* segments.
 *
 * @brief Real-time Noise estimation
 */
@@ -116,11 +127,12 @@ public:
     /**
     * Creates the real-time covariance estimation object.
     *
-    * @param[in] p_iMaxSamples      Number of samples to use for each data chunk
+    * @param[in] p_iMaxSamples      FFT length, i.e. the number of samples of each Welch segment
     * @param[in] p_pFiffInfo        Associated Fiff Information
+    * @param[in] p_iNumAverages     Averaged time span in half overlapping segments (optional)
     * @param[in] parent     Parent QObject (optional)
     */
-    explicit RtNoise(qint32 p_iMaxSamples, FiffInfo::SPtr p_pFiffInfo, QObject *parent = 0);
+    explicit RtNoise(qint32 p_iMaxSamples, FiffInfo::SPtr p_pFiffInfo, qint32 p_iNumAverages = 8, QObject *parent = 0);
 
     //=========================================================================================================
     /**
@@ -190,28 +202,15 @@ private:
 
     bool        m_bIsRunning;           /**< Holds if real-time Covariance estimation is running.*/
 
-    CircularMatrixBuffer<double>::SPtr m_pRawMatrixBuffer;   /**< The Circular Raw Matrix Buffer. */
+    RingMatrixBuffer<double>::SPtr m_pRawMatrixBuffer;       /**< The Raw Matrix Ring Buffer. */
 
     double m_Fs;
 
     qint32 m_iFFTlength;
 
-protected:
-    int NumOfBlocks;
-    int BlockSize  ;
-    int Sensors    ;
-    int BlockIndex ;
-
-    MatrixXd CircBuf;
-
-public:
-    MatrixXd SpecData;
-    QMutex ReadMutex;
-
-    bool ReadDone;
-    bool CanRead;
-    bool SendDataToBuffer;
+    qint32 m_iNumAverages;              /**< Averaged time span in half overlapping segments. */
 
+    WelchPsd m_welchPsd;                /**< Streaming Welch estimator, initialized with the first block. */
 };
 
 //*************************************************************************************************************
@@ -43,6 +43,17 @@
 #include "filterdata.h"
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QList>
+#include <QPair>
+#include <QThread>
+#include <QtConcurrent>
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
@@ -120,3 +131,46 @@ RowVectorXd FilterData::applyFFTFilter(RowVectorXd& data)
     //cuts off ends at front and end and return result
     return t_filteredTime.segment(m_iFilterOrder/2+1,m_iFFTlength-m_iFilterOrder);
 }
+
+
+//*************************************************************************************************************
+
+MatrixXd FilterData::applyFFTFilter(const MatrixXd& data)
+{
+    //zero-pad data to m_iFFTlength, samples x channels so every channel is contiguous
+    MatrixXd t_matDataZeroPad = MatrixXd::Zero(m_iFFTlength, data.rows());
+    t_matDataZeroPad.topRows(data.cols()) = data.transpose();
+
+    //filtered channels, samples x channels as well - each thread writes its own columns
+    MatrixXd t_matFiltered(m_iFFTlength-m_iFilterOrder, data.rows());
+
+    //split the channels into one chunk per thread, the fft object and its plan are shared within a chunk
+    qint32 t_iNumChunks = qMax(1, qMin(QThread::idealThreadCount(), (int)data.rows()));
+    QList< QPair<qint32,qint32> > t_qListChunks;
+    for(qint32 i = 0; i < t_iNumChunks; ++i)
+        t_qListChunks.append(QPair<qint32,qint32>(i*data.rows()/t_iNumChunks, (i+1)*data.rows()/t_iNumChunks));
+
+    QtConcurrent::blockingMap(t_qListChunks, [this, &t_matDataZeroPad, &t_matFiltered](const QPair<qint32,qint32>& chunk) {
+        Eigen::FFT<double> fft;
+        fft.SetFlag(fft.HalfSpectrum);
+
+        RowVectorXcd t_freqData(m_iFFTlength/2+1);
+        VectorXd t_filteredTime(m_iFFTlength);
+
+        for(qint32 i = chunk.first; i < chunk.second; ++i) {
+            //fft-transform data sequence
+            fft.fwd(t_freqData.data(), t_matDataZeroPad.col(i).data(), m_iFFTlength);
+
+            //perform frequency-domain filtering
+            t_freqData = t_freqData.cwiseProduct(m_dFFTCoeffA);
+
+            //inverse-FFT
+            fft.inv(t_filteredTime.data(), t_freqData.data(), m_iFFTlength);
+
+            //cuts off ends at front and end
+            t_matFiltered.col(i) = t_filteredTime.segment(m_iFilterOrder/2+1,m_iFFTlength-m_iFilterOrder);
+        }
+    });
+
+    return t_matFiltered.transpose();
+}
@@ -42,6 +42,9 @@
 *
 *           e.g. FFT length=4096, NumFilterTaps=80 -> input sequence 4096-80=4016
 *
+*           For continuous real-time streams see OverlapSaveFilter, which cascades several FilterData objects and
+*           keeps the filter state between consecutive blocks.
+*
 *
 *           [1] http://en.wikipedia.org/wiki/Parks%E2%80%93McClellan_filter_design_algorithm
 *           [2] http://en.wikipedia.org/wiki/Overlap_add
@@ -63,7 +66,6 @@
 // Eigen INCLUDES
 //=============================================================================================================
 
-#include <Eigen/Core>
 #include <Eigen/Core>
 #include <Eigen/SparseCore>
 #include <unsupported/Eigen/FFT>
@@ -121,6 +123,14 @@ public:
 
     RowVectorXd applyFFTFilter(RowVectorXd& data);
 
+    /**
+     * @brief applyFFTFilter filters all rows of a channels x samples block, see applyFFTFilter(RowVectorXd&). The rows
+     *        are split into one chunk per thread, the rows of a chunk share one FFT plan.
+     * @param [in] data block with at most m_iFFTlength samples per row
+     * @return the filtered block, each row cut to m_iFFTlength-m_iFilterOrder samples
+     */
+    MatrixXd applyFFTFilter(const MatrixXd& data);
+
     int m_iFilterOrder;       /**< represents the order of the filter instance */
     int m_iFFTlength;        /**< represents the filter length */
 
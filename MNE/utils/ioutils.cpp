@@ -47,6 +47,31 @@
 //=============================================================================================================
 
 #include <QDataStream>
+#include <QtEndian>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <cstring>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// SIMD INCLUDES
+//=============================================================================================================
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define IOUTILS_HAVE_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if defined(IOUTILS_HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define IOUTILS_HAVE_AVX2
+    #include <immintrin.h>
+#endif
 
 
 //*************************************************************************************************************
@@ -66,6 +91,193 @@ using namespace Eigen;
 using namespace UTILSLIB;
 
 
+//*************************************************************************************************************
+//=============================================================================================================
+// BYTE SWAP KERNELS
+//=============================================================================================================
+
+namespace
+{
+
+typedef void (*SwapKernel)(const void *source, void *dest, qint64 count);
+
+//=============================================================================================================
+/**
+* Scalar tail/fallback. Goes through memcpy, since neither source nor dest has to be aligned.
+*/
+template<typename _Tp>
+void swapScalar(const char *source, char *dest, qint64 count)
+{
+    _Tp v;
+    for(qint64 i = 0; i < count; ++i) {
+        std::memcpy(&v, source + i*sizeof(_Tp), sizeof(_Tp));
+        v = qbswap<_Tp>(v);
+        std::memcpy(dest + i*sizeof(_Tp), &v, sizeof(_Tp));
+    }
+}
+
+void swap16Scalar(const void *source, void *dest, qint64 count)
+{
+    swapScalar<quint16>((const char*)source, (char*)dest, count);
+}
+
+void swap32Scalar(const void *source, void *dest, qint64 count)
+{
+    swapScalar<quint32>((const char*)source, (char*)dest, count);
+}
+
+void swap64Scalar(const void *source, void *dest, qint64 count)
+{
+    swapScalar<quint64>((const char*)source, (char*)dest, count);
+}
+
+
+#ifdef IOUTILS_HAVE_SSE2
+//=============================================================================================================
+/**
+* SSE2 has no byte shuffle, hence words are swapped with 16 bit lane shuffles followed by a byte swap within
+* each 16 bit lane.
+*/
+inline __m128i bswap16Sse2(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+inline __m128i bswap32Sse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+    return bswap16Sse2(v);
+}
+
+inline __m128i bswap64Sse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0,1,2,3));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0,1,2,3));
+    return bswap16Sse2(v);
+}
+
+template<int WIDTH, __m128i (*BSWAP)(__m128i)>
+void swapSse2(const void *source, void *dest, qint64 count)
+{
+    const char *src = (const char*)source;
+    char *dst = (char*)dest;
+    const qint64 perReg = 16/WIDTH;
+
+    qint64 i = 0;
+    for(; i + 4*perReg <= count; i += 4*perReg) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i*WIDTH));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i*WIDTH + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i*WIDTH + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i*WIDTH + 48));
+        _mm_storeu_si128((__m128i*)(dst + i*WIDTH),      BSWAP(a));
+        _mm_storeu_si128((__m128i*)(dst + i*WIDTH + 16), BSWAP(b));
+        _mm_storeu_si128((__m128i*)(dst + i*WIDTH + 32), BSWAP(c));
+        _mm_storeu_si128((__m128i*)(dst + i*WIDTH + 48), BSWAP(d));
+    }
+    for(; i + perReg <= count; i += perReg)
+        _mm_storeu_si128((__m128i*)(dst + i*WIDTH), BSWAP(_mm_loadu_si128((const __m128i*)(src + i*WIDTH))));
+
+    if(WIDTH == 2)
+        swap16Scalar(src + i*WIDTH, dst + i*WIDTH, count - i);
+    else if(WIDTH == 4)
+        swap32Scalar(src + i*WIDTH, dst + i*WIDTH, count - i);
+    else
+        swap64Scalar(src + i*WIDTH, dst + i*WIDTH, count - i);
+}
+#endif
+
+
+#ifdef IOUTILS_HAVE_AVX2
+//=============================================================================================================
+/**
+* AVX2 kernel, compiled for the avx2 target only and selected at runtime. One byte shuffle per 32 bytes.
+*/
+template<int WIDTH>
+__attribute__((target("avx2")))
+void swapAvx2(const void *source, void *dest, qint64 count)
+{
+    const char *src = (const char*)source;
+    char *dst = (char*)dest;
+    const qint64 perReg = 32/WIDTH;
+
+    const __m256i mask = WIDTH == 2 ? _mm256_setr_epi8( 1, 0, 3, 2, 5, 4, 7, 6, 9, 8,11,10,13,12,15,14,
+                                                        1, 0, 3, 2, 5, 4, 7, 6, 9, 8,11,10,13,12,15,14)
+                       : WIDTH == 4 ? _mm256_setr_epi8( 3, 2, 1, 0, 7, 6, 5, 4,11,10, 9, 8,15,14,13,12,
+                                                        3, 2, 1, 0, 7, 6, 5, 4,11,10, 9, 8,15,14,13,12)
+                                    : _mm256_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0,15,14,13,12,11,10, 9, 8,
+                                                        7, 6, 5, 4, 3, 2, 1, 0,15,14,13,12,11,10, 9, 8);
+
+    qint64 i = 0;
+    for(; i + 4*perReg <= count; i += 4*perReg) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i*WIDTH));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i*WIDTH + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + i*WIDTH + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + i*WIDTH + 96));
+        _mm256_storeu_si256((__m256i*)(dst + i*WIDTH),      _mm256_shuffle_epi8(a, mask));
+        _mm256_storeu_si256((__m256i*)(dst + i*WIDTH + 32), _mm256_shuffle_epi8(b, mask));
+        _mm256_storeu_si256((__m256i*)(dst + i*WIDTH + 64), _mm256_shuffle_epi8(c, mask));
+        _mm256_storeu_si256((__m256i*)(dst + i*WIDTH + 96), _mm256_shuffle_epi8(d, mask));
+    }
+    for(; i + perReg <= count; i += perReg)
+        _mm256_storeu_si256((__m256i*)(dst + i*WIDTH),
+                            _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i*WIDTH)), mask));
+
+    if(WIDTH == 2)
+        swap16Scalar(src + i*WIDTH, dst + i*WIDTH, count - i);
+    else if(WIDTH == 4)
+        swap32Scalar(src + i*WIDTH, dst + i*WIDTH, count - i);
+    else
+        swap64Scalar(src + i*WIDTH, dst + i*WIDTH, count - i);
+}
+
+bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+
+//=============================================================================================================
+/**
+* Kernel table, resolved once on first use.
+*/
+struct SwapKernels
+{
+    SwapKernels()
+    : swap16(&swap16Scalar)
+    , swap32(&swap32Scalar)
+    , swap64(&swap64Scalar)
+    {
+#ifdef IOUTILS_HAVE_SSE2
+        swap16 = &swapSse2<2, bswap16Sse2>;
+        swap32 = &swapSse2<4, bswap32Sse2>;
+        swap64 = &swapSse2<8, bswap64Sse2>;
+#endif
+#ifdef IOUTILS_HAVE_AVX2
+        if(cpuHasAvx2()) {
+            swap16 = &swapAvx2<2>;
+            swap32 = &swapAvx2<4>;
+            swap64 = &swapAvx2<8>;
+        }
+#endif
+    }
+
+    SwapKernel swap16;
+    SwapKernel swap32;
+    SwapKernel swap64;
+};
+
+const SwapKernels& swapKernels()
+{
+    static const SwapKernels kernels;
+    return kernels;
+}
+
+} // NAMESPACE
+
+
 //*************************************************************************************************************
 //=============================================================================================================
 // DEFINE MEMBER METHODS
@@ -236,3 +448,30 @@ void IOUtils::swap_doublep(double *source)
 
     return;
 }
+
+
+//*************************************************************************************************************
+
+void IOUtils::swap_16_copy(const void *source, void *dest, qint64 count)
+{
+    if(count > 0)
+        swapKernels().swap16(source, dest, count);
+}
+
+
+//*************************************************************************************************************
+
+void IOUtils::swap_32_copy(const void *source, void *dest, qint64 count)
+{
+    if(count > 0)
+        swapKernels().swap32(source, dest, count);
+}
+
+
+//*************************************************************************************************************
+
+void IOUtils::swap_64_copy(const void *source, void *dest, qint64 count)
+{
+    if(count > 0)
+        swapKernels().swap64(source, dest, count);
+}
@@ -194,6 +194,83 @@ public:
     * @return swapped double
     */
     static void swap_doublep(double *source);
+
+    //=========================================================================================================
+    /**
+    * Reverses the byte order of count consecutive 16 bit words. Source and destination may be the same buffer
+    * (in place conversion), otherwise they must not overlap. Neither of them has to be aligned.
+    * The kernel is picked once at runtime (AVX2, SSE2 or scalar), depending on what the CPU supports.
+    *
+    * @param[in] source         words to swap
+    * @param[out] dest          swapped words
+    * @param[in] count          number of words
+    */
+    static void swap_16_copy(const void *source, void *dest, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * Reverses the byte order of count consecutive 32 bit words. See swap_16_copy.
+    *
+    * @param[in] source         words to swap
+    * @param[out] dest          swapped words
+    * @param[in] count          number of words
+    */
+    static void swap_32_copy(const void *source, void *dest, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * Reverses the byte order of count consecutive 64 bit words. See swap_16_copy.
+    *
+    * @param[in] source         words to swap
+    * @param[out] dest          swapped words
+    * @param[in] count          number of words
+    */
+    static void swap_64_copy(const void *source, void *dest, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * swap short array in place
+    *
+    * @param[in, out] source    shorts to swap
+    * @param[in] count          number of elements
+    */
+    inline static void swap_short_array(qint16 *source, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * swap integer array in place
+    *
+    * @param[in, out] source    integers to swap
+    * @param[in] count          number of elements
+    */
+    inline static void swap_int_array(qint32 *source, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * swap long array in place
+    *
+    * @param[in, out] source    longs to swap
+    * @param[in] count          number of elements
+    */
+    inline static void swap_long_array(qint64 *source, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * swap float array in place
+    *
+    * @param[in, out] source    floats to swap
+    * @param[in] count          number of elements
+    */
+    inline static void swap_float_array(float *source, qint64 count);
+
+    //=========================================================================================================
+    /**
+    * swap double array in place
+    *
+    * @param[in, out] source    doubles to swap
+    * @param[in] count          number of elements
+    */
+    inline static void swap_double_array(double *source, qint64 count);
 };
 
 //*************************************************************************************************************
@@ -201,6 +278,43 @@ public:
 // INLINE DEFINITIONS
 //=============================================================================================================
 
+inline void IOUtils::swap_short_array(qint16 *source, qint64 count)
+{
+    swap_16_copy(source, source, count);
+}
+
+
+//*************************************************************************************************************
+
+inline void IOUtils::swap_int_array(qint32 *source, qint64 count)
+{
+    swap_32_copy(source, source, count);
+}
+
+
+//*************************************************************************************************************
+
+inline void IOUtils::swap_long_array(qint64 *source, qint64 count)
+{
+    swap_64_copy(source, source, count);
+}
+
+
+//*************************************************************************************************************
+
+inline void IOUtils::swap_float_array(float *source, qint64 count)
+{
+    swap_32_copy(source, source, count);
+}
+
+
+//*************************************************************************************************************
+
+inline void IOUtils::swap_double_array(double *source, qint64 count)
+{
+    swap_64_copy(source, source, count);
+}
+
 
 } // NAMESPACE
 
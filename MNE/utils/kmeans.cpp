@@ -59,6 +59,7 @@
 //=============================================================================================================
 
 #include <QDebug>
+#include <QVector>
 
 
 //*************************************************************************************************************
@@ -75,13 +76,30 @@ using namespace UTILSLIB;
 //=============================================================================================================
 
 KMeans::KMeans(QString distance, QString start, qint32 replicates, QString emptyact, bool online, qint32 maxit)
-: m_sDistance(distance)
-, m_sStart(start)
+: m_eDistance(SqEuclidean)
+, m_eStart(Sample)
 , m_iReps(replicates)
 , m_sEmptyact(emptyact)
 , m_iMaxit(maxit)
 , m_bOnline(online)
+, m_bSeeded(false)
+, m_iSeed(0)
 {
+    // Resolve the options once, the inner loops dispatch on the enums
+    if(distance.compare("cityblock") == 0)
+        m_eDistance = CityBlock;
+    else if(distance.compare("cosine") == 0)
+        m_eDistance = Cosine;
+    else if(distance.compare("correlation") == 0)
+        m_eDistance = Correlation;
+    else if(distance.compare("hamming") == 0)
+        m_eDistance = Hamming;
+
+    if(start.compare("uniform") == 0)
+        m_eStart = Uniform;
+    else if(start.compare("plus") == 0)
+        m_eStart = PlusPlus;
+
     // Assume one replicate
     if (m_iReps < 1)
         m_iReps = 1;
@@ -95,15 +113,15 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
     if (kClusters < 1)
         return false;
 
-    //Init random generator
-    srand ( time(NULL) );
+    //Init random generator - qrand keeps its state per thread, so concurrent objects don't interfere
+    qsrand(m_bSeeded ? m_iSeed : (quint32)time(NULL));
 
 // n points in p dimensional space
     k = kClusters;
     n = X.rows();
     p = X.cols();
 
-    if(m_sDistance.compare("cosine") == 0)
+    if(m_eDistance == Cosine)
     {
 //        Xnorm = sqrt(sum(X.^2, 2));
 //        if any(min(Xnorm) <= eps(max(Xnorm)))
@@ -113,7 +131,7 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
 //        end
 //        X = X ./ Xnorm(:,ones(1,p));
     }
-    else if(m_sDistance.compare("correlation")==0)
+    else if(m_eDistance == Correlation)
     {
         X.array() -= (X.rowwise().sum().array() / (double)p).replicate(1,p); //X - X.rowwise().sum();//.repmat(mean(X,2),1,p);
         MatrixXd Xnorm = (X.array().pow(2).rowwise().sum()).sqrt();//sqrt(sum(X.^2, 2));
@@ -134,9 +152,9 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
     // Start
     RowVectorXd Xmins;
     RowVectorXd Xmaxs;
-    if (m_sStart.compare("uniform") == 0)
+    if (m_eStart == Uniform)
     {
-        if (m_sDistance.compare("hamming") == 0)
+        if (m_eDistance == Hamming)
         {
             printf("Error: Uniform Start For Hamming\n");
             return false;
@@ -164,7 +182,7 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
 
     for(qint32 rep = 0; rep < m_iReps; ++rep)
     {
-        if (m_sStart.compare("uniform") == 0)
+        if (m_eStart == Uniform)
         {
             C = MatrixXd::Zero(k,p);
             for(qint32 i = 0; i < k; ++i)
@@ -174,14 +192,18 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
             // of the unit hypersphere.  Still need to center them for
             // 'correlation'.  (Re)normalization for 'cosine'/'correlation' is
             // done at each iteration.
-            if (m_sDistance.compare("correlation") == 0)
+            if (m_eDistance == Correlation)
                 C.array() -= (C.array().rowwise().sum()/p).replicate(1, p).array();
         }
-        else if (m_sStart.compare("sample") == 0)
+        else if (m_eStart == PlusPlus)
+        {
+            plusplus(X, C);
+        }
+        else
         {
             C = MatrixXd::Zero(k,p);
             for(qint32 i = 0; i < k; ++i)
-                C.block(i,0,1,p) = X.block(rand() % n, 0, 1, p);
+                C.block(i,0,1,p) = X.block(qrand() % n, 0, 1, p);
             // DEBUG
 //            C.block(0,0,1,p) = X.block(2, 0, 1, p);
 //            C.block(1,0,1,p) = X.block(7, 0, 1, p);
@@ -207,10 +229,8 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
             d[i] = D.row(i).minCoeff(&idx[i]);
 
         m = VectorXi::Zero(k);
-        for(qint32 i = 0; i < k; ++i)
-            for (qint32 j = 0; j < idx.rows(); ++j)
-                if(idx[j] == i)
-                    ++ m[i];
+        for (qint32 j = 0; j < idx.rows(); ++j)
+            ++ m[idx[j]];
 
         try // catch empty cluster errors and move on to next rep
         {
@@ -320,16 +340,21 @@ bool KMeans::calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C
 }
 
 
+//*************************************************************************************************************
+
+void KMeans::setSeed(quint32 p_iSeed)
+{
+    m_iSeed = p_iSeed;
+    m_bSeeded = true;
+}
+
+
 //*************************************************************************************************************
 
 bool KMeans::batchUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
 {
     // Every point moved, every cluster will need an update
     qint32 i = 0;
-    VectorXi moved(n);
-    for(i = 0; i < n; ++i)
-        moved[i] = i;
-
     VectorXi changed(k);
     for(i = 0; i < k; ++i)
         changed[i] = i;
@@ -338,8 +363,22 @@ bool KMeans::batchUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
 
     prevtotsumD = std::numeric_limits<double>::max();//max double
 
-
-    MatrixXd D = MatrixXd::Zero(X.rows(), k);
+    //
+    // For sqeuclidean and cityblock the batch phase keeps Elkan bounds on the metric distance (sqrt of
+    // sqeuclidean, cityblock as is): D holds a lower bound of the distance of every point to every centroid,
+    // which is lowered by the centroid drift, and d the exact distance to the own centroid. A point is only
+    // compared to centroids whose lower bound is below its own distance, and not at all if its own distance
+    // is below half the distance of its centroid to the closest other centroid. Single distances are taken
+    // on the transposed points so each one is a contiguous vector operation.
+    // For the other distances D holds the exact distances and the columns of changed clusters are updated.
+    //
+    const bool t_bBounds = hasMetric();
+    const double t_dInf = std::numeric_limits<double>::infinity();
+    MatrixXd D(n, k);
+    VectorXd drift = VectorXd::Zero(k);
+    MatrixXd Xt, Ct;
+    if(t_bBounds)
+        Xt = X.transpose();
 
     //
     // Begin phase one:  batch reassignments
@@ -350,17 +389,25 @@ bool KMeans::batchUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
     {
         ++iter;
 
-        // Calculate the new cluster centroids and counts, and update the
-        // distance from every point to those new cluster centroids
+        // Calculate the new cluster centroids and counts, and how far the centroids drifted
         MatrixXd C_new;
         VectorXi m_new;
         KMeans::gcentroids(X, idx, changed, C_new, m_new);
-        MatrixXd D_new = distfun(X, C_new);//, iter);
 
         for(qint32 i = 0; i < changed.rows(); ++i)
         {
+            if(t_bBounds)
+            {
+                if(m_new[i] > 0)
+                {
+                    RowVector2d t_vecDrift(distfun(C.row(changed[i]), C_new.row(i))(0,0), 0.0);
+                    toMetric(t_vecDrift);
+                    drift[changed[i]] = t_vecDrift[0];
+                }
+                else
+                    drift[changed[i]] = t_dInf;
+            }
             C.row(changed[i]) = C_new.row(i);
-            D.col(changed[i]) = D_new.col(i);
             m[changed[i]] = m_new[i];
         }
 
@@ -415,20 +462,55 @@ bool KMeans::batchUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
             }
         }
 
+        // Update the distances to the changed centroids: exact ones for the own centroid, lower bounds for the others
+        if(t_bBounds)
+        {
+            Ct = C.transpose();
+            if(iter == 1)
+            {
+                D = distfun(X, C);
+                for(qint32 i = 0; i < n; ++i)
+                    d[i] = D(i, idx[i]);
+                toMetric(D);
+            }
+            else
+            {
+                VectorXi isChanged = VectorXi::Zero(k);
+                for(qint32 j = 0; j < changed.rows(); ++j)
+                {
+                    isChanged[changed[j]] = 1;
+                    D.col(changed[j]).array() -= drift[changed[j]];
+                }
+                for(qint32 i = 0; i < n; ++i)
+                    if(isChanged[idx[i]])
+                        d[i] = pointdist(Xt, i, Ct, idx[i]);
+            }
+        }
+        else
+        {
+            MatrixXd C_changed(changed.rows(), p);
+            for(qint32 j = 0; j < changed.rows(); ++j)
+                C_changed.row(j) = C.row(changed[j]);
+            MatrixXd D_new = distfun(X, C_changed);//, iter);
+            for(qint32 j = 0; j < changed.rows(); ++j)
+                D.col(changed[j]) = D_new.col(j);
+            for(qint32 i = 0; i < n; ++i)
+                d[i] = D(i, idx[i]);
+        }
+
         // Compute the total sum of distances for the current configuration.
-        totsumD = 0;
-        for(qint32 i = 0; i < n; ++i)
-            totsumD += D.array()(idx[i]*n+i);//Colum Major
+        totsumD = d.sum();
         // Test for a cycle: if objective is not decreased, back out
         // the last step and move on to the single update phase
         if(prevtotsumD <= totsumD)
         {
             idx = previdx;
-            MatrixXd C_new;
-            VectorXi m_new;
             gcentroids(X, idx, changed, C_new, m_new);
-            C.block(0,0,k,C.cols()) = C_new;
-            m.block(0,0,k,1) = m_new;
+            for(qint32 i = 0; i < changed.rows(); ++i)
+            {
+                C.row(changed[i]) = C_new.row(i);
+                m[changed[i]] = m_new[i];
+            }
             --iter;
             break;
         }
@@ -441,39 +523,70 @@ bool KMeans::batchUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
         previdx = idx;
         prevtotsumD = totsumD;
 
-        VectorXi nidx(D.rows());
-        for(qint32 i = 0; i < D.rows(); ++i)
-            d[i] = D.row(i).minCoeff(&nidx[i]);
-
-        // Determine which points moved
-        VectorXi moved = VectorXi::Zero(nidx.rows());
+        VectorXi moved(n);
+        VectorXi nidx(n);
         qint32 count = 0;
-        for(qint32 i = 0; i < nidx.rows(); ++i)
+        if(t_bBounds)
         {
-            if(nidx[i] != previdx[i])
+            MatrixXd CC = distfun(C, C);
+            toMetric(CC);
+            CC.diagonal().fill(t_dInf);
+            VectorXd halfsep = 0.5 * CC.rowwise().minCoeff();
+
+            VectorXd upper = d;
+            toMetric(upper);
+
+            for(qint32 i = 0; i < n; ++i)
             {
-                moved[count] = i;
-                ++count;
+                qint32 a = idx[i];
+                D(i, a) = upper[i];
+                if(upper[i] <= halfsep[a])
+                    continue;
+
+                // Tighten the bounds which could beat the own centroid, ties in favor of not moving
+                qint32 t_iNew = a;
+                double t_dNew = upper[i];
+                for(qint32 j = 0; j < k; ++j)
+                {
+                    if(j != a && D(i,j) < t_dNew)
+                    {
+                        RowVector2d t_vecDist(pointdist(Xt, i, Ct, j), 0.0);
+                        toMetric(t_vecDist);
+                        D(i,j) = t_vecDist[0];
+                        if(D(i,j) < t_dNew)
+                        {
+                            t_dNew = D(i,j);
+                            t_iNew = j;
+                        }
+                    }
+                }
+
+                if(t_iNew != a)
+                {
+                    moved[count] = i;
+                    nidx[count] = t_iNew;
+                    d[i] = m_eDistance == SqEuclidean ? t_dNew*t_dNew : t_dNew;
+                    ++count;
+                }
             }
         }
-        moved.conservativeResize(count);
-
-        if (moved.rows() > 0)
+        else
         {
-            // Resolve ties in favor of not moving
-            VectorXi moved_new = VectorXi::Zero(moved.rows());
-            count = 0;
-            for(qint32 i = 0; i < moved.rows(); ++i)
+            for(qint32 i = 0; i < n; ++i)
             {
-                if(D.array()(previdx[moved[i]] * n + moved[i]) > d[moved[i]])
+                qint32 t_iMin;
+                double t_dMin = D.row(i).minCoeff(&t_iMin);
+                // Resolve ties in favor of not moving
+                if(D(i, previdx[i]) > t_dMin)
                 {
-                    moved_new[count] = moved[i];
+                    moved[count] = i;
+                    nidx[count] = t_iMin;
+                    d[i] = t_dMin;
                     ++count;
                 }
             }
-            moved_new.conservativeResize(count);
-            moved = moved_new;
         }
+        moved.conservativeResize(count);
 
         if (moved.rows() == 0)
         {
@@ -482,8 +595,7 @@ bool KMeans::batchUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
         }
 
         for(qint32 i = 0; i < moved.rows(); ++i)
-            if(moved[i] >= 0)
-                idx[ moved[i] ] = nidx[ moved[i] ];
+            idx[ moved[i] ] = nidx[i];
 
         // Find clusters that gained or lost members
         std::vector<int> tmp;
@@ -515,7 +627,7 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
     // Initialize some cluster information prior to phase two
     MatrixXd Xmid1;
     MatrixXd Xmid2;
-    if (m_sDistance.compare("cityblock") == 0)
+    if (m_eDistance == CityBlock)
     {
         Xmid1 = MatrixXd::Zero(k,p);
         Xmid2 = MatrixXd::Zero(k,p);
@@ -557,7 +669,7 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
             }
         }
     }
-    else if (m_sDistance.compare("hamming") == 0)
+    else if (m_eDistance == Hamming)
     {
 //    Xsum = zeros(k,p);
 //    for i = 1:k
@@ -600,7 +712,7 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
         // point will stay in its own cluster.  Happily, we get
         // Del(i,idx(i)) == 0 automatically for them.
 
-        if (m_sDistance.compare("sqeuclidean") == 0)
+        if (m_eDistance == SqEuclidean)
         {
             for(qint32 j = 0; j < changed.rows(); ++j)
             {
@@ -619,39 +731,31 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
 
                 Del.col(i) = ((double)m[i] / ((double)m[i] + sgn.cast<double>().array()));
 
-                Del.col(i).array() *= (X - C.row(i).replicate(n,1)).array().pow(2).rowwise().sum().array();
+                Del.col(i).array() *= (X.rowwise() - C.row(i)).rowwise().squaredNorm().array();
             }
         }
-        else if (m_sDistance.compare("cityblock") == 0)
+        else if (m_eDistance == CityBlock)
         {
             for(qint32 j = 0; j < changed.rows(); ++j)
             {
                 qint32 i = changed[j];
                 if (m(i) % 2 == 0) // this will never catch singleton clusters
                 {
-                    MatrixXd ldist = Xmid1.row(i).replicate(n,1) - X;
-                    MatrixXd rdist = X - Xmid2.row(i).replicate(n,1);
-                    VectorXd mbrs = VectorXd::Zero(idx.rows());
-
+                    ArrayXd sgn = ArrayXd::Ones(n); // -1 for members, 1 for nonmembers
                     for(qint32 l = 0; l < idx.rows(); ++l)
                         if(idx[l] == i)
-                            mbrs[l] = 1;
-                    MatrixXd sgn = ((-2*mbrs).array() + 1).replicate(1, p); // -1 for members, 1 for nonmembers
-                    rdist = sgn.array()*rdist.array(); ldist = sgn.array()*ldist.array();
+                            sgn[l] = -1;
 
-                    for(qint32 l = 0; l < idx.rows(); ++l)
-                    {
-                        double sum = 0;
-                        for(qint32 h = 0; h < rdist.cols(); ++h)
-                            sum += rdist(l,h) > ldist(l,h) ? rdist(l,h) < 0 ? 0 : rdist(l,h) : ldist(l,h) < 0 ? 0 : ldist(l,h);
-                        Del(l,i) = sum;
-                    }
+                    // sum over the coordinates of max(sgn*(X - Xmid2), sgn*(Xmid1 - X), 0)
+                    Del.col(i).setZero();
+                    for(qint32 h = 0; h < p; ++h)
+                        Del.col(i).array() += (sgn * (X.col(h).array() - Xmid2(i,h))).max(sgn * (Xmid1(i,h) - X.col(h).array())).max(0.0);
                 }
                 else
-                    Del.col(i) = ((X - C.row(i).replicate(n,1)).array().abs()).rowwise().sum();
+                    Del.col(i) = distfun(X, C.row(i));
             }
         }
-        else if (m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
+        else if (m_eDistance == Cosine || m_eDistance == Correlation)
         {
             // The points are normalized, centroids are not, so normalize them
             MatrixXd normC = C.array().pow(2).rowwise().sum().sqrt();
@@ -680,15 +784,11 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
                 Del.col(i) = 1 + sgn.cast<double>().array()*
                         (A - (B + 2 * sgn.cast<double>().array() * m[i] * XCi.array() + 1).sqrt());
 
-                std::cout << "Del.col(i)\n" << Del.col(i) << std::endl;
-
-
-
 //                Del(:,i) = 1 + sgn .*...
 //                      (m(i).*normC(i) - sqrt((m(i).*normC(i)).^2 + 2.*sgn.*m(i).*XCi + 1));
             }
         }
-        else if (m_sDistance.compare("hamming") == 0)
+        else if (m_eDistance == Hamming)
         {
 //            for i = changed
 //                if mod(m(i),2) == 0 % this will never catch singleton clusters
@@ -792,12 +892,12 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
         m( oidx ) = m( oidx ) - 1;
 
 
-        if (m_sDistance.compare("sqeuclidean") == 0)
+        if (m_eDistance == SqEuclidean)
         {
             C.row(nidx[0]) = C.row(nidx[0]).array() + (X.row(moved[0]) - C.row(nidx[0])).array() / m[nidx[0]];
             C.row(oidx) = C.row(oidx).array() - (X.row(moved[0]) - C.row(oidx)).array() / m[oidx];
         }
-        else if (m_sDistance.compare("cityblock") == 0)
+        else if (m_eDistance == CityBlock)
         {
             VectorXi onidx(2);
             onidx << oidx, nidx[0];//ToDo always right?
@@ -846,12 +946,12 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
                 }
             }
         }
-        else if (m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
+        else if (m_eDistance == Cosine || m_eDistance == Correlation)
         {
             C.row(nidx[0]).array() += (X.row(moved[0]) - C.row(nidx[0])).array() / m[nidx[0]];
             C.row(oidx).array() += (X.row(moved[0]) - C.row(oidx)).array() / m[oidx];
         }
-        else if (m_sDistance.compare("hamming") == 0)
+        else if (m_eDistance == Hamming)
         {
 //                % Update summed coords for points in each cluster.  New
 //                % centroid is the coord median.  All done component-wise.
@@ -874,48 +974,43 @@ bool KMeans::onlineUpdate(const MatrixXd& X, MatrixXd& C, VectorXi& idx)
 
 //*************************************************************************************************************
 //DISTFUN Calculate point to cluster centroid distances.
-MatrixXd KMeans::distfun(const MatrixXd& X, MatrixXd& C)//, qint32 iter)
+MatrixXd KMeans::distfun(const MatrixXd& X, const MatrixXd& C) const//, qint32 iter)
 {
-    MatrixXd D = MatrixXd::Zero(n,C.rows());
+    MatrixXd D(X.rows(),C.rows());
     qint32 nclusts = C.rows();
 
-    if (m_sDistance.compare("sqeuclidean") == 0)
+    switch(m_eDistance)
     {
-        for(qint32 i = 0; i < nclusts; ++i)
+        case SqEuclidean:
         {
-            D.col(i) = (X.col(0).array() - C(i,0)).pow(2);
-
-            for(qint32 j = 1; j < p; ++j)
-                D.col(i) = D.col(i).array() + (X.col(j).array() - C(i,j)).pow(2);
+            // |x|^2 + |c|^2 - 2 x c', the cross term is one matrix product
+            D.noalias() = -2.0 * X * C.transpose();
+            D.colwise() += X.rowwise().squaredNorm();
+            D.rowwise() += C.rowwise().squaredNorm().transpose();
+            D = D.cwiseMax(0.0);
+            break;
         }
-    }
-    else if (m_sDistance.compare("cityblock") == 0)
-    {
-        for(qint32 i = 0; i < nclusts; ++i)
+        case CityBlock:
         {
-            D.col(i) = (X.col(0).array() - C(i,0)).array().abs();
-            for(qint32 j = 1; j < p; ++j)
-            {
-                D.col(i).array() += (X.col(j).array() - C(i,j)).array().abs();
-            }
+            D.setZero();
+            for(qint32 i = 0; i < nclusts; ++i)
+                for(qint32 j = 0; j < p; ++j)
+                    D.col(i).array() += (X.col(j).array() - C(i,j)).abs();
+            break;
         }
-    }
-    else if (m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
-    {
-        // The points are normalized, centroids are not, so normalize them
-        MatrixXd normC = C.array().pow(2).rowwise().sum().sqrt();
-//        if any(normC < eps(class(normC))) % small relative to unit-length data points
-//            error('Zero cluster centroid created at iteration %d.',iter);
-        for (qint32 i = 0; i < nclusts; ++i)
+        case Cosine:
+        case Correlation:
         {
-            MatrixXd C_tmp = (C.row(i).array() / normC(i,0)).transpose();
-            D.col(i) = X * C_tmp;//max(1 - X * (C(i,:)./normC(i))', 0);
-            for(qint32 j = 0; j < D.rows(); ++j)
-                if(D(j,i) < 0)
-                    D(j,i) = 0;
+            // The points are normalized, centroids are not, so normalize them
+            VectorXd normC = C.rowwise().norm();
+//            if any(normC < eps(class(normC))) % small relative to unit-length data points
+//                error('Zero cluster centroid created at iteration %d.',iter);
+            D.noalias() = X * (C.array().colwise() / normC.array()).matrix().transpose();
+            D = (1.0 - D.array()).max(0.0);//max(1 - X * (C(i,:)./normC(i))', 0);
+            break;
         }
-    }
-//case 'hamming'
+        case Hamming:
+        {
 //    for i = 1:nclusts
 //        D(:,i) = abs(X(:,1) - C(i,1));
 //        for j = 2:p
@@ -924,11 +1019,70 @@ MatrixXd KMeans::distfun(const MatrixXd& X, MatrixXd& C)//, qint32 iter)
 //        D(:,i) = D(:,i) / p;
 //        % D(:,i) = sum(abs(X - C(repmat(i,n,1),:)), 2) / p;
 //    end
-//end
+            D.setZero();
+            break;
+        }
+    }
     return D;
 } // function
 
 
+//*************************************************************************************************************
+
+double KMeans::pointdist(const MatrixXd& Xt, qint32 i, const MatrixXd& Ct, qint32 j) const
+{
+    switch(m_eDistance)
+    {
+        case SqEuclidean:
+            return (Xt.col(i) - Ct.col(j)).squaredNorm();
+        case CityBlock:
+            return (Xt.col(i) - Ct.col(j)).cwiseAbs().sum();
+        default:
+            return distfun(Xt.col(i).transpose(), Ct.col(j).transpose())(0,0);
+    }
+}
+
+
+//*************************************************************************************************************
+
+void KMeans::plusplus(const MatrixXd& X, MatrixXd& C)
+{
+    C = MatrixXd::Zero(k,p);
+    C.row(0) = X.row(qrand() % n);
+
+    // Squared metric distance of every point to its closest chosen centroid
+    VectorXd minD = distfun(X, C.row(0)).col(0);
+    if(m_eDistance == CityBlock)
+        minD = minD.array().square();
+
+    for(qint32 i = 1; i < k; ++i)
+    {
+        double t_dSum = minD.sum();
+        qint32 t_iNext = qrand() % n;
+        if(t_dSum > 0)
+        {
+            double t_dTarget = t_dSum * ((double)qrand() / ((double)RAND_MAX + 1.0));
+            double t_dCum = 0;
+            for(qint32 j = 0; j < n; ++j)
+            {
+                t_dCum += minD[j];
+                if(t_dCum > t_dTarget)
+                {
+                    t_iNext = j;
+                    break;
+                }
+            }
+        }
+        C.row(i) = X.row(t_iNext);
+
+        VectorXd newD = distfun(X, C.row(i)).col(0);
+        if(m_eDistance == CityBlock)
+            newD = newD.array().square();
+        minD = minD.cwiseMin(newD);
+    }
+}
+
+
 //*************************************************************************************************************
 //GCENTROIDS Centroids and counts stratified by group.
 void KMeans::gcentroids(const MatrixXd& X, const VectorXi& index, const VectorXi& clusts,
@@ -936,75 +1090,78 @@ void KMeans::gcentroids(const MatrixXd& X, const VectorXi& index, const VectorXi
 {
     qint32 num = clusts.rows();
     centroids = MatrixXd::Zero(num,p);
-    centroids.fill(std::numeric_limits<double>::quiet_NaN());
     counts = VectorXi::Zero(num);
 
-    VectorXi members;
+    // Position of each cluster in clusts, -1 if not requested
+    VectorXi slot = VectorXi::Constant(k, -1);
+    for(qint32 i = 0; i < num; ++i)
+        slot[clusts[i]] = i;
 
-    qint32 c;
+    // Members of all requested clusters in a single pass
+    for(qint32 j = 0; j < index.rows(); ++j)
+        if(slot[index[j]] >= 0)
+            ++counts[slot[index[j]]];
 
-    for(qint32 i = 0; i < num; ++i)
+    switch(m_eDistance)
     {
-        c = 0;
-        members = VectorXi::Zero(index.rows());
-        for(qint32 j = 0; j < index.rows(); ++j)
+        case SqEuclidean:
+        case Cosine:
+        case Correlation:
         {
-            if(index[j] == clusts[i])
-            {
-                members[c] = j;
-                ++c;
-            }
+            for(qint32 j = 0; j < index.rows(); ++j)
+                if(slot[index[j]] >= 0)
+                    centroids.row(slot[index[j]]) += X.row(j); // unnormalized for cosine and correlation
+            for(qint32 i = 0; i < num; ++i)
+                if(counts[i] > 0)
+                    centroids.row(i) /= counts[i];
+            break;
         }
-        members.conservativeResize(c);
-        if (c > 0)
+        case CityBlock:
         {
-            counts[i] = c;
-            if(m_sDistance.compare("sqeuclidean") == 0)
+            // Separate out coords for points in i'th cluster,
+            // and use to compute a fast median, component-wise
+            QVector<MatrixXd> Xsorted(num);
+            VectorXi c = VectorXi::Zero(num);
+            for(qint32 i = 0; i < num; ++i)
+                Xsorted[i].resize(counts[i],p);
+            for(qint32 j = 0; j < index.rows(); ++j)
             {
-                //Initialize
-                if(members.rows() > 0)
-                    centroids.row(i) = RowVectorXd::Zero(centroids.cols());
-
-                for(qint32 j = 0; j < members.rows(); ++j)
-                    centroids.row(i).array() += X.row(members[j]).array() / counts[i];
+                qint32 i = slot[index[j]];
+                if(i >= 0)
+                    Xsorted[i].row(c[i]++) = X.row(j);
             }
-            else if(m_sDistance.compare("cityblock") == 0)
+
+            for(qint32 i = 0; i < num; ++i)
             {
-                // Separate out sorted coords for points in i'th cluster,
-                // and use to compute a fast median, component-wise
-                MatrixXd Xsorted(counts[i],p);
-                c = 0;
+                if(counts[i] == 0)
+                    continue;
 
-                for(qint32 j = 0; j < index.rows(); ++j)
+                // Only the median is needed, a partial sort is enough
+                qint32 nn = floor(0.5*(counts(i)))-1;
+                for(qint32 j = 0; j < p; ++j)
                 {
-                    if(index[j] == clusts[i])
-                    {
-                        Xsorted.row(c) = X.row(j);
-                        ++c;
-                    }
+                    double* first = Xsorted[i].col(j).data();
+                    std::nth_element(first, first+nn+1, first+counts[i]);
+                    if (counts[i] % 2 == 0)
+                        centroids(i,j) = .5 * (*std::max_element(first, first+nn+1) + first[nn+1]);
+                    else
+                        centroids(i,j) = first[nn+1];
                 }
-
-                for(qint32 j = 0; j < Xsorted.cols(); ++j)
-                    std::sort(Xsorted.col(j).data(),Xsorted.col(j).data()+Xsorted.rows());
-
-                qint32 nn = floor(0.5*(counts(i)))-1;
-                if (counts[i] % 2 == 0)
-                    centroids.row(i) = .5 * (Xsorted.row(nn) + Xsorted.row(nn+1));
-                else
-                    centroids.row(i) = Xsorted.row(nn+1);
             }
-            else if(m_sDistance.compare("cosine") == 0 || m_sDistance.compare("correlation") == 0)
-            {
-                for(qint32 j = 0; j < members.rows(); ++j)
-                    centroids.row(i).array() += X.row(members[j]).array() / counts[i]; // unnormalized
-            }
-//            else if(m_sDistance.compare("hamming") == 0)
-//            {
+            break;
+        }
+        case Hamming:
+        {
 //                % Compute a fast median for binary data, component-wise
 //                centroids(i,:) = .5*sign(2*sum(X(members,:), 1) - counts(i)) + .5;
-//            }
+            break;
         }
     }
+
+    // Empty clusters have no centroid
+    for(qint32 i = 0; i < num; ++i)
+        if(counts[i] == 0)
+            centroids.row(i).fill(std::numeric_limits<double>::quiet_NaN());
 }// function
 
 
@@ -1020,7 +1177,7 @@ double KMeans::unifrnd(double a, double b)
     double mu = a2+b2;
     double sig = b2-a2;
 
-    double r = mu + sig * (2.0* (rand() % 1000)/1000 -1.0);
+    double r = mu + sig * (2.0* (qrand() % 1000)/1000 -1.0);
 
     return r;
 }
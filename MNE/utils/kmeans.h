@@ -90,15 +90,37 @@ public:
     typedef QSharedPointer<const KMeans> ConstSPtr; /**< Const shared pointer type for KMeans. */
 
     //distance {'sqeuclidean','cityblock','cosine','correlation','hamming'};
-    //startNames = {'uniform','sample','cluster'};
+    //startNames = {'uniform','sample','cluster','plus'};
     //emptyactNames = {'error','drop','singleton'};
 
+    /**
+    * Distance measures. The string passed to the constructor is resolved once to one of these.
+    */
+    enum Distance
+    {
+        SqEuclidean,
+        CityBlock,
+        Cosine,
+        Correlation,
+        Hamming
+    };
+
+    /**
+    * Cluster initializations.
+    */
+    enum Start
+    {
+        Sample,     /**< k points drawn at random */
+        Uniform,    /**< k points drawn uniformly from the range of X */
+        PlusPlus    /**< k-means++: points drawn with a probability proportional to their squared distance to the closest chosen centroid */
+    };
+
     //=========================================================================================================
     /**
     * Constructs a KMeans algorithm object.
     *
     * @param[in] distance   (optional) K-Means distance measure: "sqeuclidean" (default), "cityblock" , "cosine", "correlation", "hamming"
-    * @param[in] start      (optional) Cluster initialization: "sample" (default), "uniform", "cluster"
+    * @param[in] start      (optional) Cluster initialization: "sample" (default), "uniform", "plus" (k-means++)
     * @param[in] replicates (optional) Number of K-Means replicates, which are generated. Best is returned.
     * @param[in] emptyact   (optional) What happens if a cluster wents empty: "error" (default), "drop", "singleton"
     * @param[in] online     (optional) If centroids should be updated during iterations: true (default), false
@@ -119,6 +141,15 @@ public:
     */
     bool calculate( MatrixXd X, qint32 kClusters, VectorXi& idx, MatrixXd& C, VectorXd& sumD, MatrixXd& D);
 
+    //=========================================================================================================
+    /**
+    * Seeds the random generator used for the initial centroids. Without a seed the current time is used.
+    * Independent KMeans objects running concurrently (e.g. one replicate each) should get distinct seeds.
+    *
+    * @param[in] p_iSeed    Seed of the random generator
+    */
+    void setSeed(quint32 p_iSeed);
+
 
 private:
     //=========================================================================================================
@@ -130,7 +161,47 @@ private:
     *
     * @return Cluster centroid distances
     */
-    MatrixXd distfun(const MatrixXd& X, MatrixXd& C);//, qint32 iter);
+    MatrixXd distfun(const MatrixXd& X, const MatrixXd& C) const;//, qint32 iter);
+
+    //=========================================================================================================
+    /**
+    * Calculate the distance of a single point to a single cluster centroid.
+    *
+    * @param[in] Xt     Transposed input data (cols = points)
+    * @param[in] i      Point
+    * @param[in] Ct     Transposed cluster centroids (cols = centroids)
+    * @param[in] j      Cluster
+    *
+    * @return Distance of point i to centroid j
+    */
+    double pointdist(const MatrixXd& Xt, qint32 i, const MatrixXd& Ct, qint32 j) const;
+
+    //=========================================================================================================
+    /**
+    * Whether the distance is, or is the square of, a metric, so that triangle inequality bounds can be used
+    * to skip distance evaluations (sqeuclidean and cityblock).
+    *
+    * @return true if bounds can be used
+    */
+    inline bool hasMetric() const;
+
+    //=========================================================================================================
+    /**
+    * Converts distfun distances into metric distances (square root for sqeuclidean) in place.
+    *
+    * @param[in, out] D     Distances
+    */
+    template<typename T>
+    inline void toMetric(T& D) const;
+
+    //=========================================================================================================
+    /**
+    * k-means++ seeding
+    *
+    * @param[in] X      Input data (rows = points; cols = p dimensional space)
+    * @param[out] C     Initial cluster centroids k x p
+    */
+    void plusplus(const MatrixXd& X, MatrixXd& C);
 
     //=========================================================================================================
     /**
@@ -182,12 +253,14 @@ private:
     double unifrnd(double a, double b);
 
 
-    QString m_sDistance;    /**< Distance measurement to use: "sqeuclidean" (default), "cityblock" , "cosine", "correlation", "hamming". */
-    QString m_sStart;       /**< Initialization to use: "sample" (default), "uniform", "cluster". */
+    Distance m_eDistance;   /**< Distance measurement to use: sqeuclidean (default), cityblock, cosine, correlation, hamming. */
+    Start m_eStart;         /**< Initialization to use: sample (default), uniform, k-means++. */
     qint32 m_iReps;         /**< Number of K-Means replicates, which should be generated. */
     QString m_sEmptyact;    /**< What should be done if a cluster wents empty: "error" (default), "drop", "singleton" */
     qint32 m_iMaxit;        /**< Maximal number of iterations per replicate */
     bool m_bOnline;         /**< If online update should be performed */
+    bool m_bSeeded;         /**< If a fixed seed was set */
+    quint32 m_iSeed;        /**< Seed of the random generator */
 
     qint32 emptyErrCnt;     /**< Counts the occurence of empty errors */
 
@@ -208,6 +281,26 @@ private:
 
 };
 
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool KMeans::hasMetric() const
+{
+    return m_eDistance == SqEuclidean || m_eDistance == CityBlock;
+}
+
+
+//*************************************************************************************************************
+
+template<typename T>
+inline void KMeans::toMetric(T& D) const
+{
+    if(m_eDistance == SqEuclidean)
+        D = D.array().sqrt();
+}
+
 } // NAMESPACE
 
 #endif // KMEANS_H
@@ -47,6 +47,7 @@
 //=============================================================================================================
 
 #include <iostream>
+#include <cmath>
 #include <algorithm>    // std::sort
 #include <vector>       // std::vector
 
@@ -438,3 +439,68 @@ MatrixXd MNEMath::rescale(const MatrixXd &data, const RowVectorXf &times, QPair<
 
     return data_out;
 }
+
+
+//*************************************************************************************************************
+
+void MNEMath::svd_gram(const MatrixXd& A, VectorXd& s, MatrixXd& U, MatrixXd& V, double tol)
+{
+    MatrixXd t_matGram(A.rows(), A.rows());
+    t_matGram.setZero();
+    t_matGram.selfadjointView<Lower>().rankUpdate(A);
+
+    SelfAdjointEigenSolver<MatrixXd> t_eig(t_matGram.selfadjointView<Lower>());
+
+    //eigenvalues are ascending -> reverse
+    s = t_eig.eigenvalues().reverse().cwiseMax(0.0).cwiseSqrt();
+    U = t_eig.eigenvectors().rowwise().reverse();
+
+    V.noalias() = A.transpose() * U;
+    double t_dThreshold = tol * (s.size() > 0 ? s[0] : 0.0);
+    for(qint32 i = 0; i < s.size(); ++i)
+    {
+        if(s[i] > t_dThreshold)
+            V.col(i) /= s[i];
+        else
+        {
+            s[i] = 0.0;
+            V.col(i).setZero();
+        }
+    }
+}
+
+
+//*************************************************************************************************************
+
+void MNEMath::svd_randomized(const MatrixXd& A, qint32 p_iRank, VectorXd& s, MatrixXd& U, MatrixXd& V, qint32 p_iOversampling, qint32 p_iPowerIterations)
+{
+    qint32 t_iSketch = std::min<qint32>(p_iRank + p_iOversampling, std::min<qint32>(A.rows(), A.cols()));
+    p_iRank = std::min(p_iRank, t_iSketch);
+
+    //Gaussian sketch via Box-Muller, fixed seed -> reproducible operators
+    MatrixXd t_matOmega(A.cols(), t_iSketch);
+    quint32 t_iSeed = 42u;
+    for(qint32 i = 0; i < t_matOmega.size(); ++i)
+    {
+        t_iSeed = 1664525u*t_iSeed + 1013904223u;
+        double u1 = (t_iSeed + 1.0) / 4294967297.0;
+        t_iSeed = 1664525u*t_iSeed + 1013904223u;
+        double u2 = t_iSeed / 4294967296.0;
+        t_matOmega.data()[i] = std::sqrt(-2.0*std::log(u1)) * std::cos(2.0*M_PI*u2);
+    }
+
+    MatrixXd t_matQ = (A * t_matOmega).householderQr().householderQ() * MatrixXd::Identity(A.rows(), t_iSketch);
+    for(qint32 k = 0; k < p_iPowerIterations; ++k)
+    {
+        MatrixXd t_matZ = (A.transpose() * t_matQ).householderQr().householderQ() * MatrixXd::Identity(A.cols(), t_iSketch);
+        t_matQ = (A * t_matZ).householderQr().householderQ() * MatrixXd::Identity(A.rows(), t_iSketch);
+    }
+
+    MatrixXd t_matB = t_matQ.transpose() * A;
+    MatrixXd t_matUb;
+    svd_gram(t_matB, s, t_matUb, V);
+
+    U.noalias() = t_matQ * t_matUb.leftCols(p_iRank);
+    s.conservativeResize(p_iRank);
+    V.conservativeResize(NoChange, p_iRank);
+}
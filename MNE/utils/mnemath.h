@@ -261,6 +261,36 @@ public:
     */
     static MatrixXd rescale(const MatrixXd &data, const RowVectorXf &times, QPair<QVariant,QVariant> baseline, QString mode);
 
+    //=========================================================================================================
+    /**
+    * Thin SVD A = U*diag(s)*V' of a wide matrix (rows << cols, e.g. a lead field) via the eigen decomposition of
+    * the small Gram matrix A*A'. Costs one rows x rows eigen decomposition plus two products instead of a Jacobi
+    * sweep over all columns. Singular values are sorted in descending order; columns of V belonging to singular
+    * values below tol*s_max are set to zero.
+    *
+    * @param[in] A      Matrix to decompose (rows <= cols)
+    * @param[out] s     Singular values
+    * @param[out] U     Left singular vectors (rows x rows)
+    * @param[out] V     Right singular vectors (cols x rows)
+    * @param[in] tol    Relative threshold for singular values considered zero
+    */
+    static void svd_gram(const MatrixXd& A, VectorXd& s, MatrixXd& U, MatrixXd& V, double tol = 1e-12);
+
+    //=========================================================================================================
+    /**
+    * Randomized truncated SVD (Halko et al.) of rank p_iRank. The range of A is captured by a Gaussian sketch
+    * with oversampling and power iterations, the small projected problem is solved with svd_gram.
+    *
+    * @param[in] A                  Matrix to decompose
+    * @param[in] p_iRank            Number of singular triplets to compute
+    * @param[out] s                 Singular values, descending
+    * @param[out] U                 Left singular vectors (rows x rank)
+    * @param[out] V                 Right singular vectors (cols x rank)
+    * @param[in] p_iOversampling    Additional sketch columns
+    * @param[in] p_iPowerIterations Number of power iterations, improves accuracy for slowly decaying spectra
+    */
+    static void svd_randomized(const MatrixXd& A, qint32 p_iRank, VectorXd& s, MatrixXd& U, MatrixXd& V, qint32 p_iOversampling = 10, qint32 p_iPowerIterations = 2);
+
     //=========================================================================================================
     /**
     * Sorts a vector (ascending order) in place and returns the track of the original indeces
@@ -45,6 +45,15 @@
 
 #include "adaptivemp.h"
 #include <vector>
+#include <limits>
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtConcurrent>
+#include <QThreadStorage>
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -55,409 +64,524 @@ using namespace UTILSLIB;
 
 //*************************************************************************************************************
 //=============================================================================================================
-// DEFINE MEMBER METHODS
+// SEARCH HELPERS
 //=============================================================================================================
 
-AdaptiveMp::AdaptiveMp()
-: it(0)
-, max_it(0)
-, signal_energy(0)
-, current_energy(0)
+namespace
 {
 
-}
+const qint32 MODULATIONS_PER_TASK = 8;      /**< Modulations of one scale searched by one task of the thread pool. */
+const qreal WINDOW_SUPPORT = 5.0;           /**< Envelopes are evaluated within +-5 scales, beyond they are < 1e-34. */
+const qreal WINDOW_BANDWIDTH = 3.0;         /**< Window spectra are cut at 3 N / scale bins, beyond they are < 1e-12. */
 
-//*************************************************************************************************************
+//=============================================================================================================
+/**
+* One scale of the dyadic search grid: the band of the spectrum of its circular, zero centred gauss window and the
+* modulations searched at this scale. The windows do not depend on the residuum and are built once per run.
+*/
+struct ScaleWindow
+{
+    qreal           scale;          /**< Scale of the window. */
+    VectorXcd       spectrum;       /**< Band of the window spectrum in FFT order, real valued since the window is symmetric. */
+    QList<qreal>    modulations;    /**< Modulations searched at this scale. */
+};
 
-//MP Algorithm of M. Gratkowski
-QList<GaborAtom> AdaptiveMp::matching_pursuit(MatrixXd signal, qint32 max_iterations, qreal epsilon)
+//=============================================================================================================
+/**
+* A chunk of modulations of one scale, searched over all translations and channels by one pool thread.
+*/
+struct SearchTask
 {
-    max_it = max_iterations;
-    Eigen::FFT<double> fft;
-    MatrixXd residuum = signal; //residuum initialised with signal
-    qint32 sample_count = signal.rows();
-    qint32 channel_count = signal.cols();
-    signal_energy = 0;//VectorXd::Zero(channel_count);
-    qreal residuum_energy = 0;//VectorXd residuum_energy = VectorXd::Zero(channel_count);
-    qreal energy_threshold = 0;//VectorXd energy_threshold = VectorXd::Zero(channel_count);
+    const ScaleWindow*  pWindow;        /**< Scale to search. */
+    qint32              iFirst;         /**< First modulation of the chunk. */
+    qint32              iLast;          /**< One past the last modulation of the chunk. */
+    const MatrixXd*     pResiduum;      /**< Current residuum, one channel per column. */
+    const MatrixXcd*    pSpectra;       /**< Spectra of the residuum channels. */
+};
 
-    //calculate signal_energy
-    for(qint32 channel = 0; channel < channel_count; channel++)
-    {
-        for(qint32 sample = 0; sample < sample_count; sample++)
-            signal_energy/*[channel]*/ += (signal(sample, channel) * signal(sample, channel));
+//=============================================================================================================
+/**
+* Best atom found by a search step.
+*/
+struct Candidate
+{
+    qreal scale;
+    qreal translation;
+    qreal modulation;
+    qreal gain;         /**< Sum of the squared scalar products over all channels, negative if invalid. */
+};
 
-        energy_threshold/*[channel]*/ = 0.01 * epsilon * signal_energy;//[channel];
-        residuum_energy/*[channel]*/ = signal_energy;//[channel];
-    }
+//=============================================================================================================
+/**
+* Atom without envelope (scale = N, translation = N/2) whose norm terms are precomputed once per run.
+*/
+struct PlainAtom
+{
+    qreal modulation;
+    qreal cc;           /**< Sum of cos^2(w n). */
+    qreal ss;           /**< Sum of sin^2(w n). */
+    qreal cs;           /**< Sum of cos(w n) sin(w n). */
+};
 
-    //TODO multichannel!! Not working yet: problem is energy_threshold-->when should i increase signal_channel? may change order of loops for that
-    //connecting atoms to the channel, thing to think about....
+//=============================================================================================================
+/**
+* Gives phases and scalar products of a real gabor atom e[n] cos(w n + phase) for every channel. With
+* P_c = sum_n r_c[n] e[n] exp(-i w n) the optimal phase is arg(P_c) and the scalar product with the normalized atom
+* is |P_c| / ||e[n] cos(w n + phase)||. The norm only depends on the three sums of e^2 cos^2, e^2 sin^2 and
+* e^2 cos sin, which all channels share.
+*
+* @return sum of the squared scalar products over all channels
+*/
+qreal phase_gain(const VectorXd &re, const VectorXd &im, qreal cc, qreal ss, qreal cs, VectorXd *phases, VectorXd *scalar_products)
+{
+    if(phases)
+        phases->resize(re.size());
+    if(scalar_products)
+        scalar_products->resize(re.size());
 
-    while(it < max_iterations && (energy_threshold/*[signal_channel]*/ < residuum_energy/*[signal_channel]*/ ))
+    qreal gain = 0;
+    for(qint32 chn = 0; chn < re.size(); chn++)
     {
-        //variables for dyadic sampling
-        qreal s = 1;                            //scale
-        qint32 j = 1;
-        qreal max_scalar_product = 0;             //inner product for choosing the best matching atom
-        qreal k = 0;                            //for modulation 2*pi*k/N
-        quint32 p = floor(sample_count / 2);      //translation
-        GaborAtom *gabor_Atom = new GaborAtom();
-        gabor_Atom->sample_count = sample_count;
-        gabor_Atom->energy = 0;
-        qreal phase = 0;
-
-        while(s < sample_count)
-        {
-            k = 0;                              //for modulation 2*pi*k/N
-            p = floor(sample_count / 2);         //translation
-            VectorXd envelope = GaborAtom::gauss_function(sample_count, s, p);
-            VectorXcd fft_envelope = RowVectorXcd::Zero(sample_count);
-            fft.fwd(fft_envelope, envelope);
-
-            while(k < sample_count/2)
-            {
-                p = floor(sample_count/2);
-                VectorXcd modulation = modulation_function(sample_count, k);
-                VectorXcd modulated_resid = VectorXcd::Zero(sample_count);
-                VectorXcd fft_modulated_resid = VectorXcd::Zero(sample_count);
-                VectorXcd fft_m_e_resid = VectorXcd::Zero(sample_count);
-                VectorXd corr_coeffs = VectorXd::Zero(sample_count);
-
-                //iteration for multichannel
-                for(qint32 chn = 0; chn < channel_count; chn++)
-                {
-                    quint32 max_index = 0;
-                    qreal maximum = 0;
-                    phase = 0;
-
-                    //complex correlation of signal and sinus-modulated gaussfunction
-                    for(qint32 l = 0; l< sample_count; l++)
-                        modulated_resid[l] = residuum(l, chn) * modulation[l];
-                    //modulated_resid = residuum.row(chn) * modulation;
-
-                    fft.fwd(fft_modulated_resid, modulated_resid);
-
-                    for( qint32 m = 0; m < sample_count; m++)
-                    fft_m_e_resid[m] = fft_modulated_resid[m] * conj(fft_envelope[m]);
-                    //fft_m_e_resid = fft_modulated_resid * conj(fft_envelope);
-
-                    fft.inv(corr_coeffs, fft_m_e_resid);
-                    maximum = corr_coeffs[0];
-
-                    //find index of maximum correlation-coefficient to use in translation
-                    for(qint32 i = 1; i < corr_coeffs.rows(); i++)
-                        if(maximum < corr_coeffs[i])
-                        {
-                            maximum = corr_coeffs[i];
-                            max_index = i;
-                        }
-
-                    //adapting translation p to create atomtranslation correctly ToDo: is this correct, think about it again
-                    if(max_index >= p) p = max_index - p + 1;
-                    else p = max_index + p;
-
-                    VectorXd atom_parameters = calculate_atom(sample_count, s, p, k, chn, residuum, RETURNPARAMETERS);
-
-                    if(abs(atom_parameters[4]) > abs(max_scalar_product)&& p < sample_count && p > 0)
-                    {
-                        //set highest scalarproduct, in comparison to best matching atom
-                        max_scalar_product             = atom_parameters[4];
-                        gabor_Atom->scale              = atom_parameters[0];
-                        gabor_Atom->translation        = atom_parameters[1];
-                        gabor_Atom->modulation         = atom_parameters[2];
-                        gabor_Atom->phase              = atom_parameters[3];
-                        gabor_Atom->max_scalar_product = max_scalar_product;
-                    }
+        qreal phase = atan2(im[chn], re[chn]);
+        if(phase < 0)
+            phase += 2 * PI;
+
+        qreal c = cos(phase);
+        qreal s = sin(phase);
+        qreal norm2 = c * c * cc + s * s * ss - 2 * c * s * cs;
+        qreal scalar_product = norm2 > 1e-12 * (cc + ss) ? sqrt((re[chn] * re[chn] + im[chn] * im[chn]) / norm2) : 0;
+
+        gain += scalar_product * scalar_product;
+        if(phases)
+            (*phases)[chn] = phase;
+        if(scalar_products)
+            (*scalar_products)[chn] = scalar_product;
+    }
+    return gain;
+}
 
-                }
-                k += pow(2.0,(-j))*sample_count/2;
+//=============================================================================================================
+/**
+* Evaluates the real gabor atom (scale, translation, modulation), as created by GaborAtom::create_real, against all
+* residuum channels at once.
+*
+* @return sum of the squared scalar products over all channels, -1 if the parameters are out of range
+*/
+qreal atom_gain(const MatrixXd &residuum, qreal scale, qreal translation, qreal modulation, VectorXd *phases = 0, VectorXd *scalar_products = 0)
+{
+    const qint32 sample_count = residuum.rows();
 
-            }
-            j++;
-            s = pow(2.0,j);
-        }
-        std::cout << "\n" << "===============" << " found parameters " << it + 1 << "===============" << ":\n\n"<<
-                     "scale: " << gabor_Atom->scale << " trans: " << gabor_Atom->translation <<
-                     " modu: " << gabor_Atom->modulation << " phase: " << gabor_Atom->phase << " sclr_prdct: " << gabor_Atom->max_scalar_product << "\n";
-
-        //replace atoms with s==N and p = floor(N/2) by such atoms that do not have an envelope
-        k = 0;
-        s = sample_count;
-        p = floor(sample_count / 2);
-        j = floor(log(sample_count) / log(2));
-        phase = 0;
-
-        for(qint32 chn = 0; chn < channel_count; ++chn)
-        {
-            while(k < sample_count / 2)
-            {
-                VectorXd parameters_no_envelope = calculate_atom(sample_count, s, p, k, chn, residuum, RETURNPARAMETERS);
+    if(scale <= 0 || scale > sample_count || translation < 0 || translation >= sample_count)
+        return -1;
 
-                if(abs(parameters_no_envelope[4]) > abs(max_scalar_product) && p < sample_count && p > 0)// && gaborAtom->scale == s && gaborAtom->translation == p)
-                {
-                    //set highest scalarproduct, in comparison to best matching atom
-                    max_scalar_product             = parameters_no_envelope[4];
-                    gabor_Atom->scale              = parameters_no_envelope[0];
-                    gabor_Atom->translation        = parameters_no_envelope[1];
-                    gabor_Atom->modulation         = parameters_no_envelope[2];
-                    gabor_Atom->phase              = parameters_no_envelope[3];
-                    gabor_Atom->max_scalar_product = max_scalar_product;
-                }
-                k += pow(2.0,(-j))*sample_count/2;
+    const bool has_envelope = scale != sample_count;
+    const qint32 first = has_envelope ? qMax(0, qint32(floor(translation - WINDOW_SUPPORT * scale))) : 0;
+    const qint32 last = has_envelope ? qMin(sample_count, qint32(ceil(translation + WINDOW_SUPPORT * scale)) + 1) : sample_count;
+    const qint32 length = last - first;
 
-            }
+    ArrayXd n = ArrayXd::LinSpaced(length, first, last - 1);
+    ArrayXd envelope = ArrayXd::Ones(length);
+    if(has_envelope)
+        envelope = (-PI * ((n - translation) / scale).square()).exp();
 
-        }
-        std::cout << "      after comparison to NoEnvelope " << ":\n"<< "scale: " << gabor_Atom->scale << " trans: " << gabor_Atom->translation <<
-                     " modu: " << gabor_Atom->modulation << " phase: " << gabor_Atom->phase << " sclr_prdct: " << gabor_Atom->max_scalar_product << "\n\n";
+    const qreal omega = 2 * PI * modulation / sample_count;
+    ArrayXd cos_part = envelope * (omega * n).cos();
+    ArrayXd sin_part = envelope * (omega * n).sin();
 
-        //Maximisation Simplex Algorithm implemented by Bozoa Jia, adapted to the MP Algorithm by Martin Henfling. Copyright (C) 2010 Botao Jia
-        //todo change to clean use of EIGEN, @present its mixed with Namespace std and <vector>
-        //iteration for multichannel
-        for(qint32 chn = 0; chn < channel_count; chn++)
-        {
-            //simplexfunction to find minimum of target among parameters s, p, k
-            std::vector<double> init;
-
-            init.push_back(gabor_Atom->scale);
-            init.push_back(gabor_Atom->translation);
-            init.push_back(gabor_Atom->modulation);
-
-            double tol = 1E8 * std::numeric_limits<double>::epsilon();
-            std::vector<std::vector<double> > x = std::vector<std::vector<double> >();
-            qint32 iterations = 1E3;
-            qint32 N = init.size();                     //space dimension
-
-            VectorXd atom_fxc_params = VectorXd::Zero(5); //initialisation for contraction coefficients
-
-            const qreal a=1.0, b=0.2, g=0.5, h=0.5;  //coefficients a = 1, b = 0.2, g = 0.5, h = 0.5
-                                                     //a: reflection  -> xr step away from worst siplex found
-                                                     //b: expansion   -> xe if better with a so go in this direction with b
-                                                     //g: contraction -> xc calc new worst point an bring closer to middle of simplex
-                                                     //h: full contraction to x1
-            std::vector<double> xcentroid_old(N,0);  //simplex center * (N+1)
-            std::vector<double> xcentroid_new(N,0);  //simplex center * (N+1)
-            std::vector<double> vf(N+1,0);           //f evaluated at simplex vertices
-            qint32 x1 = 0, xn = 0, xnp1 = 0;         //x1:   f(x1) = min { f(x1), f(x2)...f(x_{n+1} }
-                                                     //xnp1: f(xnp1) = max { f(x1), f(x2)...f(x_{n+1} }
-                                                     //xn:   f(xn)<f(xnp1) && f(xn)> all other f(x_i)
-            qint32 cnt = 0; //iteration step number
-
-            if(x.size()== 0) //if no initial simplex is specified
-            {
-                //construct the trial simplex
-                //based upon the initial guess parameters
-                std::vector<double> del( init );
-                std::transform(del.begin(), del.end(), del.begin(),
-                std::bind2nd( std::divides<double>() , 20) );//'20' is picked
-                                                     //assuming initial trail close to true
-
-                for(qint32 i = 0; i < N; ++i)
-                {
-                    std::vector<double> tmp( init );
-                    tmp[i] +=  del[i];
-                    x.push_back( tmp );
-                }
+    VectorXd re = residuum.middleRows(first, length).transpose() * cos_part.matrix();
+    VectorXd im = -(residuum.middleRows(first, length).transpose() * sin_part.matrix());
 
-                x.push_back(init);//x.size()=N+1, x[i].size()=N
+    return phase_gain(re, im, cos_part.square().sum(), sin_part.square().sum(), (cos_part * sin_part).sum(), phases, scalar_products);
+}
 
-                //xcentriod
-                std::transform(init.begin(), init.end(), xcentroid_old.begin(), std::bind2nd(std::multiplies<double>(), N+1) );
-            }//constructing the simplex finished
+QThreadStorage<Eigen::FFT<double>*> fft_storage;     /**< One FFT object per pool thread, keeps its plans across tasks and iterations. */
 
-            //optimization begins
-            for(cnt=0; cnt<iterations; ++cnt)
-            {
-                for(qint32 i=0; i < N+1; ++i)
-                {
-                    VectorXd atom_fx = VectorXd::Zero(sample_count);
+//=============================================================================================================
+/**
+* Searches a chunk of modulations of one scale over all translations. For modulation k the spectrum of the
+* modulated residuum r[n] exp(-i 2 pi k n / N) is the residuum spectrum shifted by k, so each channel costs one
+* product with the cached window band and one inverse FFT, which gives the correlation for every translation.
+* As the correlation is limited to the band of the window, an inverse FFT of band length samples it on a grid of
+* N / length translations, which is finer than a sixth of the scale. The translation with the highest energy
+* summed over the channels is evaluated exactly.
+*/
+Candidate search_scale(const SearchTask &task)
+{
+    const MatrixXd &residuum = *task.pResiduum;
+    const MatrixXcd &spectra = *task.pSpectra;
+    const ScaleWindow &window = *task.pWindow;
+    const qint32 sample_count = residuum.rows();
 
-                    if(gabor_Atom->scale == sample_count && gabor_Atom->translation == floor(sample_count / 2))
-                        atom_fx = calculate_atom(sample_count, sample_count, floor(sample_count / 2), x[i][2], chn, residuum, RETURNATOM);
+    const qint32 length = window.spectrum.size();
 
-                    else
-                        atom_fx = calculate_atom(sample_count, x[i][0], x[i][1], x[i][2], chn, residuum, RETURNATOM);
+    if(!fft_storage.hasLocalData())
+        fft_storage.setLocalData(new Eigen::FFT<double>());
+    Eigen::FFT<double> &fft = *fft_storage.localData();
 
-                    //create targetfunction of realGaborAtom and Residuum
-                    double target = 0;
-                    for(qint32 k = 0; k < atom_fx.rows(); k++)
-                    {
-                        target -=atom_fx[k]*residuum(k,0);
-                    }
+    VectorXcd shifted(sample_count);
+    VectorXcd modulated(sample_count);
+    VectorXcd band(length);
+    VectorXcd corr(length);
+    ArrayXd energy(length);
 
-                    vf[i] = target;
-                }
+    Candidate best = {window.scale, 0, 0, -1};
 
-                x1=0; xn=0; xnp1=0;//find index of max, second max, min of vf.
+    for(qint32 i = task.iFirst; i < task.iLast; i++)
+    {
+        const qreal k = window.modulations.at(i);
+        const qint32 shift = qint32(k);
+        const bool is_integer = k == shift;
 
-                for(quint32 i=0; i < vf.size(); ++i)
-                {
-                    if(vf[i]<vf[x1])      x1 = i;
-                    if(vf[i]>vf[xnp1])    xnp1 = i;
-                }
+        energy.setZero();
+        for(qint32 chn = 0; chn < residuum.cols(); chn++)
+        {
+            if(!is_integer)
+            {
+                for(qint32 n = 0; n < sample_count; n++)
+                    modulated[n] = residuum(n, chn) * std::polar(1.0, -2 * PI * k * n / sample_count);
+                fft.fwd(shifted, modulated);
+            }
 
-                xn = x1;
+            for(qint32 b = 0; b < length; b++)
+            {
+                qint32 m = b < length / 2 ? b : b - length + sample_count;
+                band[b] = (is_integer ? spectra((m + shift) % sample_count, chn) : shifted[m]) * window.spectrum[b];
+            }
 
-                for(quint32 i=0; i<vf.size();++i) if(vf[i]<vf[xnp1] && vf[i]>vf[xn])  xn=i;
+            fft.inv(corr, band);
+            energy += corr.array().abs2();
+        }
 
-                //x1, xn, xnp1 are found
+        qint32 index = 0;
+        energy.maxCoeff(&index);
+        qint32 translation = qRound(qreal(index) * sample_count / length) % sample_count;
 
-                std::vector<double> xg(N, 0);//xg: centroid of the N best vertexes
+        qreal gain = atom_gain(residuum, window.scale, translation, k);
+        if(gain > best.gain)
+        {
+            best.translation = translation;
+            best.modulation = k;
+            best.gain = gain;
+        }
+    }
 
-                for(quint32 i=0; i<x.size(); ++i) if(i!=xnp1) std::transform(xg.begin(), xg.end(), x[i].begin(), xg.begin(), std::plus<double>() );
+    return best;
+}
 
-                std::transform(xg.begin(), xg.end(), x[xnp1].begin(), xcentroid_new.begin(), std::plus<double>());
-                std::transform(xg.begin(), xg.end(), xg.begin(), std::bind2nd(std::divides<double>(), N) );
-                //xg found, xcentroid_new updated
+//=============================================================================================================
+/**
+* Negative multichannel gain of an atom, minimized by the simplex. Atoms without envelope only vary their
+* modulation, as their scale and translation are fixed to N and N/2.
+*/
+struct AtomObjective
+{
+    const MatrixXd* pResiduum;
+    bool            bNoEnvelope;
 
-                //termination condition
-                double diff=0;          //calculate the difference of the simplex centers
+    qreal operator()(const VectorXd &x) const
+    {
+        const qint32 sample_count = pResiduum->rows();
+        if(bNoEnvelope)
+            return -atom_gain(*pResiduum, sample_count, floor(sample_count / 2), x[0]);
+        else
+            return -atom_gain(*pResiduum, x[0], qRound(x[1]), x[2]);
+    }
+};
 
-                //see if the difference is less than the termination criteria
-                for(qint32 i=0; i<N; ++i) diff += fabs(xcentroid_old[i]-xcentroid_new[i]);
+//=============================================================================================================
+/**
+* Nelder-Mead simplex, following the simplex of Botao Jia (Copyright (C) 2010 Botao Jia) as adapted to the MP
+* Algorithm by Martin Henfling, with function values kept along the vertices instead of being reevaluated.
+*
+* @return the best vertex found
+*/
+VectorXd simplex_minimize(const AtomObjective &f, const VectorXd &init, qint32 max_iterations = 1000)
+{
+    const qint32 dim = init.size();
+    const qreal a = 1.0, b = 0.2, g = 0.5, h = 0.5;     //reflection, expansion, contraction, full contraction
+    const qreal tol = 1E8 * std::numeric_limits<double>::epsilon();
+
+    //trial simplex around the initial guess, assuming the guess is close to the optimum
+    MatrixXd x(dim, dim + 1);
+    VectorXd fx(dim + 1);
+    for(qint32 i = 0; i <= dim; i++)
+    {
+        x.col(i) = init;
+        if(i < dim)
+            x(i, i) += init[i] != 0 ? init[i] / 20 : 1;
+        fx[i] = f(x.col(i));
+    }
 
-                if (diff/N < tol) break;              //terminate the optimizer
-                else xcentroid_old.swap(xcentroid_new); //update simplex center
+    //as in the original, the reference centroid is the initial guess, so the first step is always taken
+    VectorXd centroid_old = init * (dim + 1);
+    qint32 x1 = 0;
 
-                //reflection:
-                std::vector<double> xr(N,0);
+    for(qint32 cnt = 0; cnt < max_iterations; cnt++)
+    {
+        qint32 xnp1 = 0;
+        fx.minCoeff(&x1);
+        fx.maxCoeff(&xnp1);
 
-                for( qint32 i=0; i<N; ++i) xr[i]=xg[i]+a*(xg[i]-x[xnp1][i]);
-                //reflection, xr found
+        qint32 xn = x1;
+        for(qint32 i = 0; i <= dim; i++)
+            if(fx[i] < fx[xnp1] && fx[i] > fx[xn])
+                xn = i;
 
-                VectorXd atom_fxr = VectorXd::Zero(sample_count);
+        VectorXd centroid_new = x.rowwise().sum();
+        if((centroid_old - centroid_new).cwiseAbs().sum() / dim < tol)
+            break;
+        centroid_old = centroid_new;
 
-                if(gabor_Atom->scale == sample_count && gabor_Atom->translation == floor(sample_count / 2))
-                    atom_fxr = calculate_atom(sample_count, sample_count, floor(sample_count / 2), xr[2], chn, residuum, RETURNATOM);
+        VectorXd xg = (centroid_new - x.col(xnp1)) / dim;
 
-                else
-                    atom_fxr = calculate_atom(sample_count, xr[0], xr[1], xr[2], chn, residuum, RETURNATOM);
+        //reflection
+        VectorXd xr = xg + a * (xg - x.col(xnp1));
+        qreal fxr = f(xr);
 
-                //create targetfunction of realGaborAtom and Residuum
-                double fxr = 0;
-                for(qint32 k = 0; k < atom_fxr.rows(); k++) fxr -=atom_fxr[k]*residuum(k,chn);//ToDo: old residuum(k,0)
+        if(fx[x1] <= fxr && fxr <= fx[xn])
+        {
+            x.col(xnp1) = xr;
+            fx[xnp1] = fxr;
+        }
+        //expansion
+        else if(fxr < fx[x1])
+        {
+            VectorXd xe = xr + b * (xr - xg);
+            qreal fxe = f(xe);
+            x.col(xnp1) = fxe < fxr ? xe : xr;
+            fx[xnp1] = qMin(fxe, fxr);
+        }
+        //contraction
+        else
+        {
+            VectorXd xc = xg + g * (x.col(xnp1) - xg);
+            qreal fxc = f(xc);
+            if(fxc < fx[xnp1])
+            {
+                x.col(xnp1) = xc;
+                fx[xnp1] = fxc;
+            }
+            else
+            {
+                for(qint32 i = 0; i <= dim; i++)
+                {
+                    if(i == x1)
+                        continue;
+                    x.col(i) = x.col(x1) + h * (x.col(i) - x.col(x1));
+                    fx[i] = f(x.col(i));
+                }
+            }
+        }
+    }
 
-                //double fxr = target;//record function at xr
+    fx.minCoeff(&x1);
+    return x.col(x1);
+}
 
-                if(vf[x1]<=fxr && fxr<=vf[xn]) std::copy(xr.begin(), xr.end(), x[xnp1].begin());
+} // anonymous namespace
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
 
-                //expansion:
-                else if(fxr<vf[x1])
-                {
-                    std::vector<double> xe(N,0);
+AdaptiveMp::AdaptiveMp()
+: it(0)
+, max_it(0)
+, signal_energy(0)
+, current_energy(0)
+{
 
-                    for( qint32 i=0; i<N; ++i) xe[i]=xr[i]+b*(xr[i]-xg[i]);
+}
 
-                    VectorXd atom_fxe = VectorXd::Zero(sample_count);
+//*************************************************************************************************************
 
-                    if(gabor_Atom->scale == sample_count && gabor_Atom->translation == floor(sample_count / 2))
-                        atom_fxe = calculate_atom(sample_count, sample_count, floor(sample_count / 2), xe[2], chn, residuum, RETURNATOM);
+//MP Algorithm of M. Gratkowski
+QList<GaborAtom> AdaptiveMp::matching_pursuit(MatrixXd signal, qint32 max_iterations, qreal epsilon)
+{
+    it = 0;
+    max_it = max_iterations;
+    current_energy = 0;
+    atom_list.clear();
 
-                    else
-                        atom_fxe = calculate_atom(sample_count, xe[0], xe[1], xe[2], chn, residuum, RETURNATOM);
+    Eigen::FFT<double> fft;
+    MatrixXd residuum = signal; //residuum initialised with signal
+    qint32 sample_count = signal.rows();
+    qint32 channel_count = signal.cols();
+    signal_energy = residuum.squaredNorm();
+    qreal residuum_energy = signal_energy;
+    qreal energy_threshold = 0.01 * epsilon * signal_energy;
 
-                    //create targetfunction of realGaborAtom and Residuum
-                    double fxe = 0;
-                    for(qint32 k = 0; k < atom_fxe.rows(); k++) fxe -=atom_fxe[k]*residuum(k,chn);//ToDo: old residuum(k,0)
+    if(sample_count < 2 || channel_count == 0)
+    {
+        emit finished();
+        return atom_list;
+    }
 
-                    if( fxe < fxr ) std::copy(xe.begin(), xe.end(), x[xnp1].begin() );
-                    else std::copy(xr.begin(), xr.end(), x[xnp1].begin() );
-                }//expansion finished,  xe is not used outside the scope
+    //dyadic search grid, the gauss window of every scale is transformed once for the whole run
+    QList<ScaleWindow> windows;
+    VectorXcd gauss_spectrum;
+    qreal s = 1;
+    qint32 j = 1;
+    while(s < sample_count)
+    {
+        ScaleWindow window;
+        window.scale = s;
 
-                //contraction:
-                else if( fxr > vf[xn] )
-                {
-                    std::vector<double> xc(N,0);
+        VectorXd gauss(sample_count);
+        for(qint32 n = 0; n < sample_count; n++)
+        {
+            qreal t = qMin(n, sample_count - n) / s;
+            gauss[n] = exp(-PI * t * t);
+        }
+        fft.fwd(gauss_spectrum, gauss);
 
-                    for( qint32 i=0; i<N; ++i)
-                        xc[i]=xg[i]+g*(x[xnp1][i]-xg[i]);
+        //keep the band of the spectrum, rounded up to a power of two for the inverse FFT of the search
+        qint32 length = 1;
+        while(length < 2 * ceil(WINDOW_BANDWIDTH * sample_count / s) + 1 && length < sample_count)
+            length <<= 1;
+        length = qMin(length, sample_count);
 
-                    if(gabor_Atom->scale == sample_count && gabor_Atom->translation == floor(sample_count / 2))
-                        atom_fxc_params = AdaptiveMp::calculate_atom(sample_count, sample_count, floor(sample_count / 2), xc[2], chn, residuum, RETURNPARAMETERS);
+        window.spectrum.resize(length);
+        for(qint32 i = 0; i < length; i++)
+            window.spectrum[i] = gauss_spectrum[i < length / 2 ? i : i - length + sample_count];
 
-                    else
-                        atom_fxc_params = AdaptiveMp::calculate_atom(sample_count, xc[0], xc[1], xc[2], chn, residuum, RETURNPARAMETERS);
+        for(qreal k = 0; k < sample_count / 2; k += pow(2.0, -j) * sample_count / 2)
+            window.modulations.append(k);
 
-                    VectorXd atom_fxc = gabor_Atom->create_real(gabor_Atom->sample_count, atom_fxc_params[0], atom_fxc_params[1], atom_fxc_params[2], atom_fxc_params[3]);
+        windows.append(window);
+        j++;
+        s = pow(2.0, j);
+    }
 
-                    atom_fxc_params[4] = 0;
+    //the thread pool works on chunks of modulations of one scale, each chunk covers all translations and channels
+    MatrixXcd spectra(sample_count, channel_count);
 
-                    for(qint32 i = 0; i < sample_count; i++)
-                        atom_fxc_params[4] += atom_fxc[i] * residuum(i, chn);
+    QList<SearchTask> tasks;
+    for(qint32 i = 0; i < windows.size(); i++)
+    {
+        for(qint32 first = 0; first < windows.at(i).modulations.size(); first += MODULATIONS_PER_TASK)
+        {
+            SearchTask task = {&windows.at(i), first, qMin(first + MODULATIONS_PER_TASK, windows.at(i).modulations.size()), &residuum, &spectra};
+            tasks.append(task);
+        }
+    }
 
-                    //create targetfunction of realGaborAtom and Residuum
-                    double fxc = 0;
+    //atoms with s == N and p = floor(N/2) do not have an envelope, their inner products are spectrum entries
+    QList<PlainAtom> plain_atoms;
+    j = floor(log(sample_count) / log(2));
+    ArrayXd n = ArrayXd::LinSpaced(sample_count, 0, sample_count - 1);
+    for(qreal k = 0; k < sample_count / 2; k += pow(2.0, -j) * sample_count / 2)
+    {
+        ArrayXd cos_part = (2 * PI * k / sample_count * n).cos();
+        ArrayXd sin_part = (2 * PI * k / sample_count * n).sin();
+        PlainAtom plain = {k, cos_part.square().sum(), sin_part.square().sum(), (cos_part * sin_part).sum()};
+        plain_atoms.append(plain);
+    }
 
-                    for(qint32 k = 0; k < atom_fxc.rows(); k++)
-                        fxc -=atom_fxc[k]*residuum(k,chn);//ToDo: old residuum(k,0)
+    while(it < max_iterations && energy_threshold < residuum_energy)
+    {
+        VectorXcd channel_spectrum;
+        for(qint32 chn = 0; chn < channel_count; chn++)
+        {
+            fft.fwd(channel_spectrum, VectorXd(residuum.col(chn)));
+            spectra.col(chn) = channel_spectrum;
+        }
 
-                    if( fxc < vf[xnp1] )
-                        std::copy(xc.begin(), xc.end(), x[xnp1].begin() );
+        Candidate best = {0, 0, 0, -1};
 
-                    else
-                        for( quint32 i=0; i<x.size(); ++i )
-                            if( i!=x1 )
-                                for(qint32 j=0; j<N; ++j)
-                                    x[i][j] = x[x1][j] + h * ( x[i][j]-x[x1][j] );
-                }//contraction finished, xc is not used outside the scope
-            }//optimization is finished
+        QList<Candidate> candidates = QtConcurrent::blockingMapped<QList<Candidate> >(tasks, search_scale);
+        for(qint32 i = 0; i < candidates.size(); i++)
+            if(candidates.at(i).gain > best.gain)
+                best = candidates.at(i);
 
-            if(gabor_Atom->scale == sample_count && gabor_Atom->translation == floor(sample_count / 2))
-                atom_fxc_params = AdaptiveMp::calculate_atom(sample_count, sample_count, floor(sample_count / 2), x[x1][2], chn, residuum, RETURNPARAMETERS);
+        //compare to the atoms without envelope
+        for(qint32 i = 0; i < plain_atoms.size(); i++)
+        {
+            const PlainAtom &plain = plain_atoms.at(i);
+            const qint32 k = qint32(plain.modulation);
 
+            qreal gain = 0;
+            if(k == plain.modulation)
+                gain = phase_gain(spectra.row(k).real().transpose(), spectra.row(k).imag().transpose(), plain.cc, plain.ss, plain.cs, 0, 0);
             else
-                atom_fxc_params = AdaptiveMp::calculate_atom(sample_count, x[x1][0], x[x1][1], x[x1][2], chn, residuum, RETURNPARAMETERS);
+                gain = atom_gain(residuum, sample_count, floor(sample_count / 2), plain.modulation);
 
-            if(abs(atom_fxc_params[4]) > abs(max_scalar_product) /*&& atom_fxc_params[0] < sample_count && atom_fxc_params[0] > 0*/ && atom_fxc_params[1] < sample_count && atom_fxc_params[1] > 0)//ToDo: find a way to make the simplex not running out of bounds
+            if(gain > best.gain)
             {
-                max_scalar_product = atom_fxc_params[4];             //scalarProduct
-                gabor_Atom->scale              = atom_fxc_params[0];//scale
-                gabor_Atom->translation        = atom_fxc_params[1];//translation
-                gabor_Atom->modulation         = atom_fxc_params[2];//phase
-                gabor_Atom->phase              = atom_fxc_params[3];
-                gabor_Atom->max_scalar_product   = max_scalar_product;
+                Candidate candidate = {qreal(sample_count), floor(sample_count / 2), plain.modulation, gain};
+                best = candidate;
             }
+        }
 
-            if(cnt==iterations)//max number of iteration achieves before tol is satisfied
-                std::cout<<"Simplex Iteration limit of "<<iterations<<" achieved in channel " << chn << ", result may not be optimal";
+        if(best.gain <= 0)
+            break;
 
-        }//end Maximisation for channels Copyright (C) 2010 Botao Jia
+        //refine scale, translation and modulation with the simplex
+        AtomObjective objective = {&residuum, best.scale == sample_count};
+        VectorXd init;
+        if(objective.bNoEnvelope)
+        {
+            init.resize(1);
+            init << best.modulation;
+        }
+        else
+        {
+            init.resize(3);
+            init << best.scale, best.translation, best.modulation;
+        }
 
-        std::cout <<  "      after simplex optimization " << ":\n"<< "scale: " << gabor_Atom->scale << " trans: " << gabor_Atom->translation <<
-                      " modu: " << gabor_Atom->modulation << " phase: " << gabor_Atom->phase << " sclr_prdct: " << gabor_Atom->max_scalar_product << "\n\n";
+        VectorXd refined = simplex_minimize(objective, init);
+        qreal refined_gain = -objective(refined);
+        if(refined_gain > best.gain)
+        {
+            if(objective.bNoEnvelope)
+                best.modulation = refined[0];
+            else
+            {
+                best.scale = refined[0];
+                best.translation = qRound(refined[1]);
+                best.modulation = refined[2];
+            }
+            best.gain = refined_gain;
+        }
 
         //calc multichannel parameters phase and max_scalar_product
+        VectorXd phases;
+        VectorXd scalar_products;
+        atom_gain(residuum, best.scale, best.translation, best.modulation, &phases, &scalar_products);
+
+        GaborAtom gabor_Atom;
+        gabor_Atom.sample_count     = sample_count;
+        gabor_Atom.scale            = best.scale;
+        gabor_Atom.translation      = best.translation;
+        gabor_Atom.modulation       = best.modulation;
+        gabor_Atom.energy           = 0;
+
+        qint32 best_channel = 0;
+        scalar_products.maxCoeff(&best_channel);
+        gabor_Atom.phase = phases[best_channel];
+        gabor_Atom.max_scalar_product = scalar_products[best_channel];
+
         for(qint32 chn = 0; chn < channel_count; chn++)
         {
-            VectorXd channel_params = calculate_atom(sample_count, gabor_Atom->scale, gabor_Atom->translation, gabor_Atom->modulation, chn, residuum, RETURNPARAMETERS);
-            gabor_Atom->phase_list.append(channel_params[3]);
-            gabor_Atom->max_scalar_list.append(channel_params[4]);
+            gabor_Atom.phase_list.append(phases[chn]);
+            gabor_Atom.max_scalar_list.append(scalar_products[chn]);
 
             //substract best matching Atom from Residuum in each channel
-            VectorXd bestMatch = gabor_Atom->create_real(gabor_Atom->sample_count, gabor_Atom->scale, gabor_Atom->translation, gabor_Atom->modulation, gabor_Atom->phase_list.at(chn));
-
-            for(qint32 j = 0; j < gabor_Atom->sample_count; j++)
-            {
-                residuum(j,chn) -= gabor_Atom->max_scalar_list.at(chn) * bestMatch[j];
-                gabor_Atom->energy += (gabor_Atom->max_scalar_list.at(chn) * bestMatch[j]) * (gabor_Atom->max_scalar_list.at(chn) * bestMatch[j]);
-            }
-
-            gabor_Atom->residuum = residuum;
+            VectorXd bestMatch = gabor_Atom.create_real(sample_count, gabor_Atom.scale, gabor_Atom.translation, gabor_Atom.modulation, phases[chn]);
+            residuum.col(chn) -= scalar_products[chn] * bestMatch;
+            gabor_Atom.energy += scalar_products[chn] * scalar_products[chn];
         }
+        gabor_Atom.residuum = residuum;
 
-        residuum_energy -= gabor_Atom->energy;
-        current_energy += gabor_Atom->energy;
-
-        std::cout << "energy of residuum: " << residuum_energy << "\n";
-
-        atom_list.append(*gabor_Atom);
+        residuum_energy = residuum.squaredNorm();
+        current_energy += gabor_Atom.energy;
 
-        delete gabor_Atom;
+        atom_list.append(gabor_Atom);
         it++;
         send_result();
+    }//end iterations
 
-    }//end iterations    
     emit finished();
     return atom_list;
 }
@@ -477,7 +601,7 @@ VectorXcd AdaptiveMp::modulation_function(qint32 N, qreal k)
 
 //*************************************************************************************************************
 
-VectorXd AdaptiveMp::calculate_atom(qint32 sample_count, qreal scale, quint32 translation, qreal modulation, qint32 channel, MatrixXd residuum, ReturnValue return_value)
+VectorXd AdaptiveMp::calculate_atom(qint32 sample_count, qreal scale, quint32 translation, qreal modulation, qint32 channel, const MatrixXd &residuum, ReturnValue return_value)
 {
     GaborAtom *gabor_Atom = new GaborAtom();
     qreal phase = 0;
@@ -492,7 +616,7 @@ VectorXd AdaptiveMp::calculate_atom(qint32 sample_count, qreal scale, quint32 tr
 
     //calculate phase to create realGaborAtoms
     phase = std::arg(inner_product);
-    if (phase < 0) phase = 2 * PI - phase;
+    if (phase < 0) phase += 2 * PI;
     VectorXd real_gabor_atom = gabor_Atom->create_real(sample_count, scale, translation, modulation, phase);
 
     delete gabor_Atom;
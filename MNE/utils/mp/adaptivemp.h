@@ -152,9 +152,16 @@ public:
     *
     * running the MP Algorithm introduced by Mallat and Zhang
     *
-    * @param[in] signal    Matrix containing single or mulitchannel signals
+    * Each iteration searches the dyadic grid of scales and modulations. For every scale and modulation the
+    * correlation with all translations is one inverse FFT per channel against the gauss window spectrum of the
+    * scale, which is cached for the whole run. Chunks of the grid run in the global thread pool. The best atom
+    * maximizes the energy summed over all channels and is refined by a simplex. It shares scale, translation and
+    * modulation across the channels, while each channel has its own phase and scalar product. The decomposition
+    * stops after max_iterations or as soon as the residual energy drops below epsilon percent of the signal energy.
+    *
+    * @param[in] signal    Matrix containing single or mulitchannel signals, one channel per column
     * @param[in] max_it    maximum number of iterations of MP Algorithm
-    * @param[in] epsilon   threshold for number of iterations of MP Algorithm
+    * @param[in] epsilon   residual energy in percent of the signal energy at which the algorithm terminates
     *
     * @return result of MP Algorithm as QList of GaborAtoms
     */
@@ -193,7 +200,7 @@ public:
     *
     * @return depending on returnValue returning the real atom calculated or the manipulated parameters: scale, translation, modulation, phase, scalarproduct
     */
-    VectorXd calculate_atom(qint32 sampleCount, qreal scale, quint32 translation, qreal modulation, qint32 channel, MatrixXd residuum, ReturnValue return_value);
+    VectorXd calculate_atom(qint32 sampleCount, qreal scale, quint32 translation, qreal modulation, qint32 channel, const MatrixXd &residuum, ReturnValue return_value);
 
     //=========================================================================================================
 
@@ -0,0 +1,477 @@
+//=============================================================================================================
+/**
+* @file     fixdict.cpp
+* @author   Martin Henfling <martin.henfling@tu-ilmenau.de>
+*           Daniel Knobl <daniel.knobl@tu-ilmenau.de>
+*           Sebastian Krause <sebastian.krause@tu-ilmenau.de>
+*
+* @version  1.0
+* @date     October, 2014
+*
+* @section  LICENSE
+*
+* Copyright (C) 2014, Sebastian Krause, Daniel Knobl and Martin Henfling All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Implementation of the binary, memory mapped atom dictionaries.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fixdict.h"
+#include "atom.h"
+
+#include <utils/ioutils.h>
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QSaveFile>
+#include <QStringList>
+#include <QDebug>
+#include <QtXml/QDomDocument>
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+
+//*************************************************************************************************************
+//=============================================================================================================
+// FILE LAYOUT
+//=============================================================================================================
+
+namespace
+{
+
+const quint32 DICT_MAGIC        = 0x4d504443;   /**< "MPDC" */
+const quint32 DICT_VERSION      = 1;
+const quint32 DICT_BYTE_ORDER   = 0x01020304;   /**< Reads as 0x04030201 if the file has the other byte order. */
+const qint64  DICT_ALIGNMENT    = 64;           /**< Alignment of the parameter table and the atom block. */
+
+//=============================================================================================================
+/**
+* Header at the start of every binary dictionary, followed by the parameter table at paramOffset and the atoms
+* at atomOffset, both aligned to DICT_ALIGNMENT bytes.
+*/
+struct DictHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 byteOrder;
+    qint32  atomCount;
+    qint32  sampleCount;
+    qint32  paramCount;     /**< Number of doubles per atom in the parameter table. */
+    qint64  paramOffset;
+    qint64  atomOffset;
+};
+
+inline qint64 align(qint64 p_iOffset)
+{
+    return (p_iOffset + DICT_ALIGNMENT - 1) / DICT_ALIGNMENT * DICT_ALIGNMENT;
+}
+
+//=============================================================================================================
+/**
+* Swaps the byte order of a header read from a file with the other byte order.
+*/
+void swapHeader(DictHeader &p_header)
+{
+    IOUtils::swap_32_copy(&p_header.magic, &p_header.magic, 6);
+    IOUtils::swap_64_copy(&p_header.paramOffset, &p_header.paramOffset, 2);
+}
+
+//=============================================================================================================
+/**
+* Reads the header of a dictionary and checks it against the file size.
+*
+* @return true if the header is valid, p_bSwap tells whether the file has the other byte order
+*/
+bool readHeader(QFile &p_qFile, DictHeader &p_header, bool &p_bSwap)
+{
+    if(p_qFile.read(reinterpret_cast<char*>(&p_header), sizeof(DictHeader)) != sizeof(DictHeader))
+        return false;
+
+    p_bSwap = p_header.byteOrder != DICT_BYTE_ORDER;
+    if(p_bSwap)
+        swapHeader(p_header);
+
+    if(p_header.magic != DICT_MAGIC || p_header.byteOrder != DICT_BYTE_ORDER || p_header.version != DICT_VERSION)
+        return false;
+
+    const qint32 t_iParamCount = sizeof(FixDict::AtomParameters) / sizeof(double);
+    if(p_header.atomCount < 0 || p_header.sampleCount < 0 || p_header.paramCount != t_iParamCount)
+        return false;
+
+    return p_header.paramOffset + qint64(p_header.atomCount) * sizeof(FixDict::AtomParameters) <= p_header.atomOffset
+            && p_header.atomOffset + qint64(p_header.atomCount) * p_header.sampleCount * sizeof(float) <= p_qFile.size();
+}
+
+//=============================================================================================================
+/**
+* Parses the "scale: <s> modu: <m> phase: <p> chrip: <c>" line following an atom name of the text dictionaries.
+*/
+FixDict::AtomParameters parseParameterLine(const QString &p_sLine)
+{
+    FixDict::AtomParameters t_params = {0.0, 0.0, 0.0, 0.0, 0.0};
+
+    QStringList t_listTokens = p_sLine.simplified().split(' ');
+    for(qint32 i = 0; i + 1 < t_listTokens.size(); i += 2)
+    {
+        const QString &t_sKey = t_listTokens[i];
+        double t_dValue = t_listTokens[i+1].toDouble();
+        if(t_sKey == "scale:")
+            t_params.scale = t_dValue;
+        else if(t_sKey == "modu:")
+            t_params.modulation = t_dValue;
+        else if(t_sKey == "phase:")
+            t_params.phase = t_dValue;
+        else if(t_sKey == "chrip:" || t_sKey == "chirp:")
+            t_params.chirp = t_dValue;
+    }
+
+    return t_params;
+}
+
+//=============================================================================================================
+/**
+* Reads a sample based text dictionary of the dictionary editor.
+*/
+bool readTextDict(QFile &p_qFile, QList<VectorXf> &p_listAtoms, QVector<FixDict::AtomParameters> &p_vecParams)
+{
+    QVector<float> t_vecSamples;
+    bool t_bInAtom = false;
+    bool t_bExpectParams = false;
+
+    while(!p_qFile.atEnd())
+    {
+        QString t_sLine = QString::fromLatin1(p_qFile.readLine()).trimmed();
+
+        if(t_sLine.contains("_ATOM_"))
+        {
+            if(t_bInAtom)
+                p_listAtoms.append(Map<VectorXf>(t_vecSamples.data(), t_vecSamples.size()));
+            t_vecSamples.clear();
+
+            FixDict::AtomParameters t_params = {0.0, 0.0, 0.0, 0.0, 0.0};
+            p_vecParams.append(t_params);
+            t_bInAtom = true;
+            t_bExpectParams = true;
+            continue;
+        }
+
+        if(!t_bInAtom)
+            continue;
+
+        if(t_bExpectParams && t_sLine.startsWith("scale:"))
+        {
+            p_vecParams.last() = parseParameterLine(t_sLine);
+            t_bExpectParams = false;
+            continue;
+        }
+
+        bool t_bIsDouble = false;
+        float t_fSample = t_sLine.toFloat(&t_bIsDouble);
+        if(t_bIsDouble)
+            t_vecSamples.append(t_fSample);
+    }
+
+    if(t_bInAtom)
+        p_listAtoms.append(Map<VectorXf>(t_vecSamples.data(), t_vecSamples.size()));
+
+    return !p_listAtoms.isEmpty();
+}
+
+//=============================================================================================================
+/**
+* Reads an xml dictionary as written by FixDictMp::create_tree_dict (or its *.tbd input) and generates the atoms
+* from their parameters. Molecules contribute their atoms, molecules without atoms stand for themselves.
+*/
+bool readXmlDict(QFile &p_qFile, QList<VectorXf> &p_listAtoms, QVector<FixDict::AtomParameters> &p_vecParams)
+{
+    QDomDocument t_xmlDoc;
+    if(!t_xmlDoc.setContent(&p_qFile))
+        return false;
+
+    QDomElement t_root = t_xmlDoc.documentElement();
+    qint32 t_iSampleCount = t_root.attribute("sample_count").toInt();
+    if(t_iSampleCount <= 0)
+        return false;
+
+    QList<QDomElement> t_listElements;
+    QDomNodeList t_molecules = t_root.elementsByTagName("Molecule");
+    if(t_molecules.isEmpty())
+    {
+        QDomNodeList t_atoms = t_root.elementsByTagName("Atom");
+        for(qint32 i = 0; i < t_atoms.count(); ++i)
+            t_listElements.append(t_atoms.at(i).toElement());
+    }
+    else
+    {
+        for(qint32 i = 0; i < t_molecules.count(); ++i)
+        {
+            QDomElement t_molecule = t_molecules.at(i).toElement();
+            QDomNodeList t_atoms = t_molecule.elementsByTagName("Atom");
+            if(t_atoms.isEmpty())
+                t_listElements.append(t_molecule);
+            for(qint32 j = 0; j < t_atoms.count(); ++j)
+                t_listElements.append(t_atoms.at(j).toElement());
+        }
+    }
+
+    GaborAtom t_gaborAtom;
+    for(qint32 i = 0; i < t_listElements.size(); ++i)
+    {
+        const QDomElement &t_element = t_listElements[i];
+
+        FixDict::AtomParameters t_params;
+        t_params.scale          = t_element.attribute("scale").toDouble();
+        t_params.translation    = t_element.attribute("translation").toDouble();
+        t_params.modulation     = t_element.attribute("modulation").toDouble();
+        t_params.phase          = t_element.attribute("phase").toDouble();
+        t_params.chirp          = 0.0;
+
+        VectorXd t_vecAtom = t_gaborAtom.create_real(t_iSampleCount, t_params.scale, quint32(t_params.translation), t_params.modulation, t_params.phase);
+        p_listAtoms.append(t_vecAtom.cast<float>());
+        p_vecParams.append(t_params);
+    }
+
+    return !p_listAtoms.isEmpty();
+}
+
+} // anonymous namespace
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+FixDict::FixDict()
+: m_pMap(NULL)
+, m_pAtoms(NULL)
+, m_pParams(NULL)
+, m_iAtomCount(0)
+, m_iSampleCount(0)
+{
+}
+
+
+//*************************************************************************************************************
+
+FixDict::~FixDict()
+{
+    close();
+}
+
+
+//*************************************************************************************************************
+
+bool FixDict::open(const QString &p_sFileName)
+{
+    close();
+
+    m_qFile.setFileName(p_sFileName);
+    if(!m_qFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "FixDict::open - could not open" << p_sFileName;
+        return false;
+    }
+
+    DictHeader t_header;
+    bool t_bSwap = false;
+    if(!readHeader(m_qFile, t_header, t_bSwap))
+    {
+        qWarning() << "FixDict::open -" << p_sFileName << "is not a valid binary dictionary";
+        m_qFile.close();
+        return false;
+    }
+
+    const qint64 t_iParamValues = qint64(t_header.atomCount) * t_header.paramCount;
+    const qint64 t_iAtomValues = qint64(t_header.atomCount) * t_header.sampleCount;
+
+    if(!t_bSwap)
+        m_pMap = m_qFile.map(0, t_header.atomOffset + t_iAtomValues * sizeof(float));
+
+    if(m_pMap)
+    {
+        m_pParams = reinterpret_cast<const AtomParameters*>(m_pMap + t_header.paramOffset);
+        m_pAtoms = reinterpret_cast<const float*>(m_pMap + t_header.atomOffset);
+    }
+    else
+    {
+        // Other byte order or no mapping support - read the tables into memory
+        m_vecSwapParams.resize(t_iParamValues);
+        m_vecSwapAtoms.resize(t_iAtomValues);
+
+        bool t_bRead = m_qFile.seek(t_header.paramOffset)
+                && m_qFile.read(reinterpret_cast<char*>(m_vecSwapParams.data()), t_iParamValues * sizeof(double)) == qint64(t_iParamValues * sizeof(double))
+                && m_qFile.seek(t_header.atomOffset)
+                && m_qFile.read(reinterpret_cast<char*>(m_vecSwapAtoms.data()), t_iAtomValues * sizeof(float)) == qint64(t_iAtomValues * sizeof(float));
+        m_qFile.close();
+
+        if(!t_bRead)
+        {
+            qWarning() << "FixDict::open - could not read" << p_sFileName;
+            close();
+            return false;
+        }
+
+        if(t_bSwap)
+        {
+            IOUtils::swap_double_array(m_vecSwapParams.data(), t_iParamValues);
+            IOUtils::swap_float_array(m_vecSwapAtoms.data(), t_iAtomValues);
+        }
+
+        m_pParams = reinterpret_cast<const AtomParameters*>(m_vecSwapParams.constData());
+        m_pAtoms = m_vecSwapAtoms.constData();
+    }
+
+    m_iAtomCount = t_header.atomCount;
+    m_iSampleCount = t_header.sampleCount;
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void FixDict::close()
+{
+    if(m_pMap)
+        m_qFile.unmap(m_pMap);
+    if(m_qFile.isOpen())
+        m_qFile.close();
+
+    m_pMap = NULL;
+    m_vecSwapAtoms.clear();
+    m_vecSwapParams.clear();
+    m_pAtoms = NULL;
+    m_pParams = NULL;
+    m_iAtomCount = 0;
+    m_iSampleCount = 0;
+}
+
+
+//*************************************************************************************************************
+
+bool FixDict::isBinary(const QString &p_sFileName)
+{
+    QFile t_qFile(p_sFileName);
+    if(!t_qFile.open(QIODevice::ReadOnly))
+        return false;
+
+    DictHeader t_header;
+    bool t_bSwap = false;
+    return readHeader(t_qFile, t_header, t_bSwap);
+}
+
+
+//*************************************************************************************************************
+
+bool FixDict::write(const QString &p_sFileName, const MatrixXf &p_matAtoms, const QVector<AtomParameters> &p_vecParams)
+{
+    if(p_matAtoms.cols() != p_vecParams.size())
+        return false;
+
+    DictHeader t_header;
+    t_header.magic          = DICT_MAGIC;
+    t_header.version        = DICT_VERSION;
+    t_header.byteOrder      = DICT_BYTE_ORDER;
+    t_header.atomCount      = p_matAtoms.cols();
+    t_header.sampleCount    = p_matAtoms.rows();
+    t_header.paramCount     = sizeof(AtomParameters) / sizeof(double);
+    t_header.paramOffset    = align(sizeof(DictHeader));
+    t_header.atomOffset     = align(t_header.paramOffset + qint64(p_vecParams.size()) * sizeof(AtomParameters));
+
+    MatrixXf t_matAtoms = p_matAtoms;
+    for(qint32 i = 0; i < t_matAtoms.cols(); ++i)
+    {
+        float t_fNorm = t_matAtoms.col(i).norm();
+        if(t_fNorm > 0.0f)
+            t_matAtoms.col(i) /= t_fNorm;
+    }
+
+    QSaveFile t_qFile(p_sFileName);
+    if(!t_qFile.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray t_padding(DICT_ALIGNMENT, '\0');
+
+    t_qFile.write(reinterpret_cast<const char*>(&t_header), sizeof(DictHeader));
+    t_qFile.write(t_padding.constData(), t_header.paramOffset - sizeof(DictHeader));
+    t_qFile.write(reinterpret_cast<const char*>(p_vecParams.constData()), qint64(p_vecParams.size()) * sizeof(AtomParameters));
+    t_qFile.write(t_padding.constData(), t_header.atomOffset - t_header.paramOffset - qint64(p_vecParams.size()) * sizeof(AtomParameters));
+    t_qFile.write(reinterpret_cast<const char*>(t_matAtoms.data()), qint64(t_matAtoms.size()) * sizeof(float));
+
+    return t_qFile.commit();
+}
+
+
+//*************************************************************************************************************
+
+bool FixDict::convert(const QString &p_sTextDict, const QString &p_sBinDict)
+{
+    QFile t_qFile(p_sTextDict);
+    if(!t_qFile.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "FixDict::convert - could not open" << p_sTextDict;
+        return false;
+    }
+
+    QList<VectorXf> t_listAtoms;
+    QVector<AtomParameters> t_vecParams;
+
+    bool t_bRead = false;
+    if(t_qFile.peek(5) == "<?xml")
+        t_bRead = readXmlDict(t_qFile, t_listAtoms, t_vecParams);
+    else
+        t_bRead = readTextDict(t_qFile, t_listAtoms, t_vecParams);
+    t_qFile.close();
+
+    if(!t_bRead)
+    {
+        qWarning() << "FixDict::convert - no atoms found in" << p_sTextDict;
+        return false;
+    }
+
+    qint32 t_iSampleCount = 0;
+    for(qint32 i = 0; i < t_listAtoms.size(); ++i)
+        t_iSampleCount = qMax(t_iSampleCount, qint32(t_listAtoms[i].size()));
+
+    MatrixXf t_matAtoms = MatrixXf::Zero(t_iSampleCount, t_listAtoms.size());
+    for(qint32 i = 0; i < t_listAtoms.size(); ++i)
+    {
+        if(t_listAtoms[i].size() != t_iSampleCount)
+            qWarning() << "FixDict::convert - atom" << i << "has" << t_listAtoms[i].size() << "samples, zero padded to" << t_iSampleCount;
+        t_matAtoms.col(i).head(t_listAtoms[i].size()) = t_listAtoms[i];
+    }
+
+    return write(p_sBinDict, t_matAtoms, t_vecParams);
+}
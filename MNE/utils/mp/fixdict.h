@@ -0,0 +1,272 @@
+//=============================================================================================================
+/**
+* @file     fixdict.h
+* @author   Martin Henfling <martin.henfling@tu-ilmenau.de>
+*           Daniel Knobl <daniel.knobl@tu-ilmenau.de>
+*           Sebastian Krause <sebastian.krause@tu-ilmenau.de>
+*
+* @version  1.0
+* @date     October, 2014
+*
+* @section  LICENSE
+*
+* Copyright (C) 2014, Sebastian Krause, Daniel Knobl and Martin Henfling All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    FixDict class declaration, providing binary, memory mapped atom dictionaries for the
+*           Matching Pursuit Algorithm with precalculated atoms.
+*
+*/
+
+#ifndef FIXDICT_H
+#define FIXDICT_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Utils INCLUDES
+//=============================================================================================================
+
+#include <utils/utils_global.h>
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE UTILSLIB
+//=============================================================================================================
+
+namespace UTILSLIB
+{
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+//*************************************************************************************************************
+/**
+* Binary atom dictionary. The file holds a small header, a table with the parameters of every atom and all
+* atoms as one contiguous block of unit norm float samples, one atom after the other. Opening a dictionary maps
+* the file into memory, the atoms are then accessible as a sample_count x atom_count matrix without any parsing
+* or copying. Text dictionaries of the editor (*.dict, *.pdict) and the xml dictionaries written by
+* FixDictMp::create_tree_dict are converted with convert().
+*
+* @brief Binary, memory mapped atom dictionary
+*/
+class UTILSSHARED_EXPORT FixDict
+{
+public:
+    typedef QSharedPointer<FixDict> SPtr;               /**< Shared pointer type for FixDict. */
+    typedef QSharedPointer<const FixDict> ConstSPtr;    /**< Const shared pointer type for FixDict. */
+
+    //=========================================================================================================
+    /**
+    * Parameters of a single dictionary atom, stored as they are in the parameter table of the file.
+    */
+    struct AtomParameters
+    {
+        double scale;           /**< Scale of the atom. */
+        double translation;     /**< Translation of the atom within its samples. */
+        double modulation;      /**< Modulation of the atom, relative to the atom length. */
+        double phase;           /**< Phase of the atom. */
+        double chirp;           /**< Chirp of the atom, zero for gabor atoms. */
+    };
+
+    //=========================================================================================================
+    /**
+    * Constructs an empty dictionary.
+    */
+    FixDict();
+
+    //=========================================================================================================
+    /**
+    * Destroys the dictionary and unmaps the file.
+    */
+    ~FixDict();
+
+    //=========================================================================================================
+    /**
+    * Opens a binary dictionary and maps it into memory. If the dictionary was written on a machine with a
+    * different byte order it is read and swapped into memory instead.
+    *
+    * @param[in] p_sFileName    binary dictionary file
+    *
+    * @return true if the dictionary could be opened, false otherwise
+    */
+    bool open(const QString &p_sFileName);
+
+    //=========================================================================================================
+    /**
+    * Unmaps and closes the dictionary.
+    */
+    void close();
+
+    //=========================================================================================================
+    /**
+    * Returns whether a dictionary is open.
+    *
+    * @return true if a dictionary is open
+    */
+    inline bool isOpen() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of atoms.
+    *
+    * @return the number of atoms
+    */
+    inline qint32 atomCount() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of samples of each atom.
+    *
+    * @return the number of samples per atom
+    */
+    inline qint32 sampleCount() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the unit norm atoms, one atom per column.
+    *
+    * @return sample_count x atom_count map onto the dictionary
+    */
+    inline Map<const MatrixXf> atoms() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the parameters of an atom.
+    *
+    * @param[in] p_iAtom    atom index
+    *
+    * @return the parameters of the atom
+    */
+    inline const AtomParameters& parameters(qint32 p_iAtom) const;
+
+    //=========================================================================================================
+    /**
+    * Returns whether a file is a binary dictionary.
+    *
+    * @param[in] p_sFileName    file to check
+    *
+    * @return true if the file starts with the binary dictionary header
+    */
+    static bool isBinary(const QString &p_sFileName);
+
+    //=========================================================================================================
+    /**
+    * Writes a binary dictionary. The atoms are normalized to unit norm on the way.
+    *
+    * @param[in] p_sFileName    binary dictionary file to write
+    * @param[in] p_matAtoms     atoms, one atom per column
+    * @param[in] p_vecParams    parameters, one entry per atom
+    *
+    * @return true if the dictionary was written
+    */
+    static bool write(const QString &p_sFileName, const MatrixXf &p_matAtoms, const QVector<AtomParameters> &p_vecParams);
+
+    //=========================================================================================================
+    /**
+    * Converts a text dictionary into a binary one. Accepted are the sample based text dictionaries of the
+    * dictionary editor, where each atom is a "<name>_ATOM_<n>" line followed by its parameter line and its samples,
+    * and the xml dictionaries of FixDictMp::create_tree_dict, whose atoms are generated from their parameters.
+    * Atoms of different length are zero padded to the longest one.
+    *
+    * @param[in] p_sTextDict    text or xml dictionary to read
+    * @param[in] p_sBinDict     binary dictionary to write
+    *
+    * @return true if the conversion succeeded
+    */
+    static bool convert(const QString &p_sTextDict, const QString &p_sBinDict);
+
+private:
+    QFile               m_qFile;            /**< The dictionary file, kept open while it is mapped. */
+    uchar*              m_pMap;             /**< Start of the mapped file, NULL if the file is not mapped. */
+    QVector<float>      m_vecSwapAtoms;     /**< Byte swapped atoms, used if the file can not be mapped as it is. */
+    QVector<double>     m_vecSwapParams;    /**< Byte swapped parameter table, see m_vecSwapAtoms. */
+    const float*        m_pAtoms;           /**< The atoms, one after the other. */
+    const AtomParameters* m_pParams;        /**< The parameter table. */
+    qint32              m_iAtomCount;       /**< Number of atoms. */
+    qint32              m_iSampleCount;     /**< Number of samples per atom. */
+};
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool FixDict::isOpen() const
+{
+    return m_pAtoms != 0;
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 FixDict::atomCount() const
+{
+    return m_iAtomCount;
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 FixDict::sampleCount() const
+{
+    return m_iSampleCount;
+}
+
+
+//*************************************************************************************************************
+
+inline Map<const MatrixXf> FixDict::atoms() const
+{
+    return Map<const MatrixXf>(m_pAtoms, m_iSampleCount, m_iAtomCount);
+}
+
+
+//*************************************************************************************************************
+
+inline const FixDict::AtomParameters& FixDict::parameters(qint32 p_iAtom) const
+{
+    return m_pParams[p_iAtom];
+}
+
+}//NAMESPACE
+
+#endif // FIXDICT_H
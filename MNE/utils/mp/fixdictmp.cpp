@@ -45,6 +45,8 @@
 #include "fixdictmp.h"
 #include <vector>
 
+#include <QFileInfo>
+
 //*************************************************************************************************************
 //=============================================================================================================
 // USED NAMESPACES
@@ -71,340 +73,165 @@ qint32 FixDictMp::test()
 
 }
 
-// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+//*************************************************************************************************************
+
 QList<GaborAtom> FixDictMp::matching_pursuit(QFile &currentDict, VectorXd signalSamples, qint32 iterationsCount)
 {
-    GaborAtom* gabor_Atom = new GaborAtom;
-    QList<GaborAtom> result_list;
-    bool isDouble = false;
-
-    qint32 atomCount = 0;
-    qint32 bestCorrStartIndex;
-    qreal sample;
-    qreal bestCorrValue = 0;
-    qreal residuumEnergie = 0;
-
-    QString contents;
-    QString atomName;
-    QString bestCorrName;
-
-    QStringList bestAtom;
-    QList<qreal> atomSamples;
-    QList<QStringList> correlationList;
-    VectorXd originalSignalSamples;
-    VectorXd residuum;
-    VectorXd bestCorrAtomSamples;
-    VectorXd normBestCorrAtomSamples;
-
-    residuum(0);
-    bestCorrAtomSamples(0);
-    normBestCorrAtomSamples(0);
-    originalSignalSamples = signalSamples;
-
-    // reading dictionary and give samples and name to scalar function
-    if (currentDict.open (QIODevice::ReadOnly))
-    {
-        while(!currentDict.atEnd())
-        {
-            contents = currentDict.readLine();
-            if(contents.startsWith("atomcount"))
-            {
-                atomCount = contents.mid(12).toInt();
-                break;
-            }
-        }
-        qint32 i = 0;
-        while(!currentDict.atEnd())
-        {
-            while(!currentDict.atEnd())
-            {
-                if(contents.contains("_ATOM_"))
-                {
-                    atomName = contents;
-                    break;
-                }
-                contents = currentDict.readLine();
-            }
-
-            contents = "";
-            while(!contents.contains("_ATOM_"))
-            {
-                contents = currentDict.readLine();
-                sample = contents.toDouble(&isDouble);
-                if(isDouble)
-                    atomSamples.append(sample);
-                if(currentDict.atEnd())
-                    break;
-            }
-            correlationList.append(correlation(originalSignalSamples, atomSamples, atomName));
-
-            atomSamples.clear();
-        }
-        currentDict.close();
+    QString bin_dict = currentDict.fileName();
 
-        // find best matching atom in correlation list
-        for(qint32 i = 0; i < correlationList.length(); i++)
-        {
-            if(fabs(correlationList.at(i).at(2).toDouble()) > fabs(bestCorrValue))
-            {
-                bestCorrName =  correlationList.at(i).at(0);
-                bestCorrStartIndex = correlationList.at(i).at(1).toInt();
-                bestCorrValue = correlationList.at(i).at(2).toDouble();
-            }
-        }
-
-        // find the best matching in dictionary and save content (samples) to list
-        if (currentDict.open (QIODevice::ReadOnly))
-        {
-            bool hasFound = false;
-            qint32 j = 0;
-            while(!currentDict.atEnd() )
-            {
-                contents = currentDict.readLine();
-                if(QString::compare(contents, bestCorrName) == 0)
-                {
-                    contents = "";
-                    while(!contents.contains("_ATOM_"))
-                    {
-                        contents = currentDict.readLine();
-                        sample = contents.toDouble(&isDouble);
-                        if(isDouble)
-                        {
-                            bestCorrAtomSamples[j] = sample;
-                            j++;
-                        }
-                        if(currentDict.atEnd())
-                            break;
-                    }
-                    hasFound = true;
-                }
-                if(hasFound) break;
-            }
-        }
-        currentDict.close();
-
-        /*// Quadratische Normierung des Atoms auf den Betrag 1 und Multiplikation mit dem Skalarproduktkoeffizenten
-        //**************************** Im Moment weil Testwoerterbuecher nicht nomiert ***********************************
-
-        qreal normFacktorAtom = 0;
-        for(qint32 i = 0; i < bestCorrAtomSamples.rows(); i++)
-            normFacktorAtom += bestCorrAtomSamples[i]* bestCorrAtomSamples[i];
-        normFacktorAtom = sqrt(normFacktorAtom);
+    if(!FixDict::isBinary(bin_dict))
+    {
+        QFileInfo text_info(currentDict.fileName());
+        bin_dict = QString("%1/%2.bdict").arg(text_info.path()).arg(text_info.completeBaseName());
 
-        for(qint32 i = 0; i < bestCorrAtomSamples.rows(); i++)
-            normBestCorrAtomSamples[i] = (bestCorrAtomSamples[i] / normFacktorAtom) * bestCorrValue;
+        QFileInfo bin_info(bin_dict);
+        if(!bin_info.exists() || bin_info.lastModified() < text_info.lastModified() || !FixDict::isBinary(bin_dict))
+            if(!FixDict::convert(currentDict.fileName(), bin_dict))
+                return QList<GaborAtom>();
+    }
 
-        //**************************************************************************************************************
-        */
+    FixDict dict;
+    if(!dict.open(bin_dict))
+        return QList<GaborAtom>();
 
-        // Subtraktion des Atoms vom Signal
-        for(qint32 m = 0; m < normBestCorrAtomSamples.rows(); m++)
-        {
-            // TODO:
-            //signalSamples.append(0);
-            //signalSamples.prepend(0);
-        }
+    return matching_pursuit(dict, signalSamples, iterationsCount);
+}
 
-        residuum = signalSamples;
-        for(qint32 i = 0; i < normBestCorrAtomSamples.rows(); i++)
-        {
-            residuum[normBestCorrAtomSamples.rows() + i + bestCorrStartIndex] = signalSamples[normBestCorrAtomSamples.rows() + i + bestCorrStartIndex] - normBestCorrAtomSamples[i];
-            //residuum.removeAt(normBestCorrAtomSamples.rows() + i + bestCorrStartIndex + 1);
-        }
 
-        // Loescht die Nullen wieder
-        for(qint32 j = 0; j < normBestCorrAtomSamples.rows(); j++)
-        {
-            // TODO:
-            //residuum.removeAt(0);
-            //residuum.removeAt(residuum.rows() - 1);
-            //signalSamples.removeAt(0);
-            //signalSamples.removeAt(signalSamples.rows() - 1);
-        }
+//*************************************************************************************************************
 
-        iterationsCount++;
-
-        // Traegt das gefunden Atom in eine Liste ein
-        bestAtom.append(bestCorrName);
-        bestAtom.append(QString("%1").arg(bestCorrStartIndex));
-        bestAtom.append(QString("%1").arg(bestCorrValue));
-        QString newSignalString = "";
-        for(qint32 i = 0; i < normBestCorrAtomSamples.rows(); i++)
-            newSignalString.append(QString("%1/n").arg(normBestCorrAtomSamples[i]));
-
-        gabor_Atom->scale              = 0;//scale
-        gabor_Atom->translation        = 0;//translation
-        gabor_Atom->modulation         = 0;//phase
-        gabor_Atom->phase              = 0;
-        gabor_Atom->max_scalar_product = 0;
-
-        bestAtom.append(newSignalString);
-        result_list.append(*gabor_Atom);
-
-        /*ToDo
-        //***************** DEBUGGOUT **********************************************************************************
-        QFile newSignal("Matching-Pursuit-Toolbox/newSignal.txt");
-        if(!newSignal.exists())
-        {
-            if (newSignal.open(QIODevice::ReadWrite | QIODevice::Text))
-            newSignal.close();
-        }
-        else    newSignal.remove();
+QList<GaborAtom> FixDictMp::matching_pursuit(const FixDict &p_dict, const VectorXd &p_vecSignal, qint32 p_iMaxIterations, qreal p_dEpsilon)
+{
+    QList<GaborAtom> result_list;
 
-        if(!newSignal.exists())
-        {
-            if (newSignal.open(QIODevice::ReadWrite | QIODevice::Text))
-            newSignal.close();
-        }
+    const qint32 sample_count = p_vecSignal.size();
+    const qint32 atom_length = p_dict.sampleCount();
+    const qint32 atom_count = p_dict.atomCount();
 
-        if (newSignal.open (QIODevice::WriteOnly| QIODevice::Append))
-        {
-            QTextStream stream( &newSignal );
-            for(qint32 i = 0; i < residuum.rows(); i++)
-            {
-                QString temp = QString("%1").arg(residuum[i]);
-                stream << temp << "\n";
-            }
-        }
-        newSignal.close();
+    if(!p_dict.isOpen() || sample_count == 0 || atom_length == 0 || atom_count == 0)
+        return result_list;
 
-        //**************************************************************************************************************
+    Map<const MatrixXf> atoms = p_dict.atoms();
+    VectorXd residuum = p_vecSignal;
 
+    qreal signal_energy = residuum.squaredNorm();
+    qreal residuum_energy = signal_energy;
+    qreal energy_threshold = 0.01 * p_dEpsilon * signal_energy;
 
-        // Eintragen und Zeichnen der Ergebnisss in die Liste der UI
-        ui->tw_Results->setRowCount(iterationsCount);
-        QTableWidgetItem* atomNameItem = new QTableWidgetItem(bestCorrName);
+    //atoms of signal length are not shifted - all correlations are one matrix vector product
+    const bool is_aligned = atom_length == sample_count;
 
-        // Berechnet die Energie des Atoms mit dem NormFaktor des Signals
-        qreal normAtomEnergie = 0;
-        for(qint32 i = 0; i < normBestCorrAtomSamples.rows(); i++)
-            normAtomEnergie += normBestCorrAtomSamples[i] * normBestCorrAtomSamples[i];
+    //otherwise precompute the conjugated half spectra of all atoms for the cross-correlation and the cumulated
+    //atom energies, which give the energy of the part of a shifted atom that overlaps the signal
+    qint32 nfft = 1;
+    while(nfft < sample_count + atom_length - 1)
+        nfft <<= 1;
 
-        QTableWidgetItem* atomEnergieItem = new QTableWidgetItem(QString("%1").arg(normAtomEnergie / signalEnergie * 100));
+    FFT<float> fft;
+    fft.SetFlag(FFT<float>::HalfSpectrum);
 
-        //AtomWindow *atomWidget = new AtomWindow();
-        //atomWidget->update();
-        //ui->tw_Results->setItem(iterationsCount - 1, 1, atomWidget);
-        //atomWidget->update();
-        //QTableWidgetItem* atomItem = new QTableWidgetItem();
-        //atomItem->
+    MatrixXcf atom_spectra;
+    MatrixXf atom_energies;
+    VectorXf padded;
+    VectorXcf residuum_spectrum;
+    VectorXcf product;
+    VectorXf correlation;
 
-        ui->tw_Results->setItem(iterationsCount - 1, 0, atomNameItem);
-        ui->tw_Results->setItem(iterationsCount - 1, 2, atomEnergieItem);
+    if(!is_aligned)
+    {
+        atom_spectra.resize(nfft / 2 + 1, atom_count);
+        atom_energies.resize(atom_length + 1, atom_count);
+        padded = VectorXf::Zero(nfft);
+        residuum_spectrum.resize(nfft / 2 + 1);
+        product.resize(nfft / 2 + 1);
+        correlation.resize(nfft);
+
+        for(qint32 k = 0; k < atom_count; k++)
+        {
+            padded.head(atom_length) = atoms.col(k);
+            fft.fwd(atom_spectra.col(k).data(), padded.data(), nfft);
+            atom_spectra.col(k) = atom_spectra.col(k).conjugate();
 
+            atom_energies(0, k) = 0;
+            for(qint32 g = 0; g < atom_length; g++)
+                atom_energies(g + 1, k) = atom_energies(g, k) + atoms(g, k) * atoms(g, k);
+        }
+    }
 
-        ui->lb_IterationsProgressValue->setText(QString("%1").arg(iterationsCount));
-        for(qint32 i = 0; i < residuum.rows(); i++)
-            residuumEnergie += residuum[i] * residuum[i];
-        if(residuumEnergie == 0)    ui->lb_RestEnergieResiduumValue->setText("0%");
-        else    ui->lb_RestEnergieResiduumValue->setText(QString("%1%").arg(residuumEnergie / signalEnergie * 100));
+    while(result_list.length() < p_iMaxIterations && residuum_energy > energy_threshold)
+    {
+        qint32 best_atom = -1;
+        qint32 best_lag = 0;        //offset of the first atom sample within the signal, negative if it starts before
+        qreal best_gain = 0;        //energy removed from the residuum, corr^2 / energy of the overlapping atom part
 
-        // Ueberprueft die Abbruchkriterien
-        if(ui->chb_Iterations->isChecked() && ui->chb_ResEnergy->isChecked())
-        {
-            ui->progressBarCalc->setMaximum((1-sollEnergie)*100);
-            processValue = (1 - residuumEnergie / signalEnergie + sollEnergie)*100;
-            ui->progressBarCalc->setValue(processValue);
-            if(ui->sb_Iterations->value() <= iterationsCount)
-                ui->progressBarCalc->setValue(ui->progressBarCalc->maximum());
-
-            if(ui->sb_Iterations->value() > iterationsCount && sollEnergie < residuumEnergie)
-                residuum = mpCalc(currentDict, residuum, iterationsCount);
-        }
-        else if(ui->chb_Iterations->isChecked())
+        if(is_aligned)
         {
-            ui->progressBarCalc->setMaximum(ui->sb_Iterations->value());
-            processValue++;
-            ui->progressBarCalc->setValue(processValue);
-
-            if(ui->sb_Iterations->value() > iterationsCount)
-                residuum = mpCalc(currentDict, residuum, iterationsCount);
+            VectorXf corr = atoms.transpose() * residuum.cast<float>();
+            best_gain = corr.cwiseAbs2().maxCoeff(&best_atom);
         }
-        else if(ui->chb_ResEnergy->isChecked())
+        else
         {
-            ui->progressBarCalc->setMaximum((1-sollEnergie)*100);
-            processValue = (1 - residuumEnergie / signalEnergie + sollEnergie)*100;
-            ui->progressBarCalc->setValue(processValue);
-
-            if(sollEnergie < residuumEnergie)
-                residuum = mpCalc(currentDict, residuum, iterationsCount);
-        }*/
-    }
-    return result_list;
-}
-
+            padded.setZero();
+            padded.head(sample_count) = residuum.cast<float>();
+            fft.fwd(residuum_spectrum.data(), padded.data(), nfft);
 
-// calc scalarproduct of Atom and Signal
-QStringList FixDictMp::correlation(VectorXd signalSamples, QList<qreal> atomSamples, QString atomName)
-{
-    qreal sum = 0;
-    qint32 index = 0;
-    qreal maximum = 0;
-    //qreal sumAtom = 0;
+            for(qint32 k = 0; k < atom_count; k++)
+            {
+                product = residuum_spectrum.cwiseProduct(atom_spectra.col(k));
+                fft.inv(correlation.data(), product.data(), nfft);
 
-    VectorXd originalSignalList = signalSamples;
-    QList<qreal> tempList;
-    QList<qreal> scalarList;
-    QStringList resultList;
+                for(qint32 lag = 1 - atom_length; lag < sample_count; lag++)
+                {
+                    qint32 first = qMax(0, -lag);
+                    qint32 last = qMin(atom_length, sample_count - lag);
+                    float overlap_energy = atom_energies(last, k) - atom_energies(first, k);
+                    if(overlap_energy < 0.5f)
+                        continue;
+
+                    float corr = correlation[lag < 0 ? nfft + lag : lag];
+                    qreal gain = corr * corr / overlap_energy;
+                    if(gain > best_gain)
+                    {
+                        best_gain = gain;
+                        best_atom = k;
+                        best_lag = lag;
+                    }
+                }
+            }
+        }
 
-    resultList.clear();
-    tempList.clear();
+        if(best_atom < 0 || best_gain <= 0)
+            break;
 
-    /*// Quadratische Normierung des Atoms auf den Betrag 1
-    //**************************** Im Moment weil Testwoerterbuecher nicht nomiert ***************************************
+        //refine the coefficient in double precision on the overlapping part and subtract the atom
+        qint32 first = qMax(0, -best_lag);
+        qint32 last = qMin(atom_length, sample_count - best_lag);
+        VectorXd best_match = atoms.col(best_atom).segment(first, last - first).cast<double>();
 
-    for(qint32 i = 0; i < atomSamples.length(); i++)
-        sumAtom += atomSamples.at(i)* atomSamples.at(i);
-    sumAtom = sqrt(sumAtom);
+        qreal overlap_energy = best_match.squaredNorm();
+        qreal scalar_product = best_match.dot(residuum.segment(best_lag + first, last - first)) / overlap_energy;
 
-    for(qint32 i = 0; i < atomSamples.length(); i++)
-    {
-        qreal tempVarAtom = atomSamples.at(i) / sumAtom;
-        atomSamples.removeAt(i);
-        atomSamples.insert(i, tempVarAtom);
-    }
+        residuum.segment(best_lag + first, last - first) -= scalar_product * best_match;
 
-    // Fuellt das Signal vorne und hinten mit nullen auf damit Randwertproblem umgangen wird
-    for(qint32 l = 0; l < atomSamples.length() - 1; l++)
-    {
-        //signalSamples.append(0);
-        //signalSamples.prepend(0);
-    }
-    */
-    //******************************************************************************************************************
+        const FixDict::AtomParameters &params = p_dict.parameters(best_atom);
 
-    for(qint32 j = 0; j < originalSignalList.rows() + atomSamples.length() -1; j++)
-    {
-        // Inner Product des of Atom and Signal
-        for(qint32 g = 0; g < atomSamples.length(); g++)
-        {
-            tempList.append(signalSamples[g + j] * atomSamples.at(g));
-            sum += tempList.at(g);
-        }
-        scalarList.append(sum);
-        tempList.clear();
-        sum = 0;
-    }
+        GaborAtom gabor_Atom;
+        gabor_Atom.sample_count         = sample_count;
+        gabor_Atom.scale                = params.scale;
+        gabor_Atom.translation          = qint32(params.translation) + best_lag;
+        gabor_Atom.modulation           = params.modulation * sample_count / atom_length;
+        gabor_Atom.phase                = params.phase;
+        gabor_Atom.max_scalar_product   = scalar_product;
+        gabor_Atom.energy               = scalar_product * scalar_product * overlap_energy;
+        gabor_Atom.residuum             = residuum;
+        gabor_Atom.phase_list.append(params.phase);
+        gabor_Atom.max_scalar_list.append(scalar_product);
 
-    //find Maximum and Index of Scalarproduct
-    for(qint32 k = 0; k < scalarList.length(); k++)
-    {
-        if(fabs(maximum) < fabs(scalarList.at(k)))
-        {
-            maximum = scalarList.at(k);
-            index = k;
-        }
+        residuum_energy = residuum.squaredNorm();
+        result_list.append(gabor_Atom);
     }
 
-    // List of Atomname, Index and max correlation coefficient
-    resultList.append(atomName);
-    resultList.append(QString("%1").arg(index -atomSamples.length() + 1));     // for translation
-    resultList.append(QString("%1").arg(maximum)); //for scaling
-
-    return resultList;
-    // die Stelle, an der die Korrelation am groessten ist ergibt sich aus:
-    // dem Index des hoechsten Korrelationswertes minus die halbe Atomlaenge,
-
+    return result_list;
 }
 
 //******************************************************************************************************************
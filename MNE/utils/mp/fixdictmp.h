@@ -54,6 +54,7 @@
 //=============================================================================================================
 
 #include <utils/mp/atom.h>
+#include <utils/mp/fixdict.h>
 #include <utils/utils_global.h>
 
 //*************************************************************************************************************
@@ -119,9 +120,43 @@ public:
 
     qint32 test();
 
+    //=========================================================================================================
+    /**
+    * fixdictMp_matching_pursuit
+    *
+    * ### MP Algorithm ###
+    *
+    * runs the MP Algorithm on a dictionary file. Binary dictionaries are mapped directly, text and xml
+    * dictionaries are converted once to a binary dictionary next to them (<name>.bdict), which is reused as long
+    * as it is newer than the text dictionary.
+    *
+    * @param[in] currentDict        dictionary file
+    * @param[in] signalSamples      signal to decompose
+    * @param[in] iterationsCount    maximum number of iterations
+    *
+    * @return the chosen atoms, one per iteration
+    */
     QList<GaborAtom> matching_pursuit(QFile &currentDict, VectorXd signalSamples, qint32 iterationsCount);
 
-    QStringList correlation(VectorXd signalSamples, QList<qreal> atomSamples, QString atomName);
+    //=========================================================================================================
+    /**
+    * fixdictMp_matching_pursuit
+    *
+    * ### MP Algorithm ###
+    *
+    * runs the MP Algorithm on an opened binary dictionary. If atoms and signal have the same length all
+    * correlations of an iteration are a single matrix vector product, otherwise every atom is slid along the
+    * zero padded signal by an FFT cross-correlation against the precomputed atom spectra. Shifted atoms have to
+    * overlap the signal with at least half of their energy.
+    *
+    * @param[in] p_dict             opened binary dictionary
+    * @param[in] p_vecSignal        signal to decompose
+    * @param[in] p_iMaxIterations   maximum number of iterations
+    * @param[in] p_dEpsilon         residual energy in percent of the signal energy at which to stop
+    *
+    * @return the chosen atoms, one per iteration
+    */
+    QList<GaborAtom> matching_pursuit(const FixDict &p_dict, const VectorXd &p_vecSignal, qint32 p_iMaxIterations, qreal p_dEpsilon = 0);
 
     static void create_tree_dict(QString save_path);
     //=========================================================================================================
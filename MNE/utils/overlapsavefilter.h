@@ -0,0 +1,368 @@
+//=============================================================================================================
+/**
+* @file     overlapsavefilter.h
+* @author   Lorenz Esch <Lorenz.Esch@tu-ilmenau.de>;
+*           Florian Schlembach <florian.schlembach@tu-ilmenau.de>;
+*           Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>;
+*           Jens Haueisen <jens.haueisen@tu-ilmenau.de>
+* @version  1.0
+* @date     February, 2014
+*
+* @section  LICENSE
+*
+* Copyright (C) 2014, Lorenz Esch, Florian Schlembach, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    OverlapSaveFilter class declaration.
+*
+*/
+
+#ifndef OVERLAPSAVEFILTER_H
+#define OVERLAPSAVEFILTER_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "utils_global.h"
+#include "filterdata.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Qt INCLUDES
+//=============================================================================================================
+
+#include <QList>
+#include <QSharedPointer>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE UTILSLIB
+//=============================================================================================================
+
+namespace UTILSLIB
+{
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+* Streaming multichannel FIR filtering with the overlap-save method. A cascade of FIR filters is combined into a
+* single frequency response, the FFT plan, the response and all work buffers are set up once in init. Each call of
+* filter processes a whole channels x samples block, the last taps-1 input samples of every channel are kept for
+* the next block, so consecutive real-time buffers are filtered without edge transients.
+* The output is causal, i.e. a linear phase cascade delays the data by delay() samples.
+* The work buffers store the samples time major, so every channel is contiguous and transformed in place.
+*
+* @brief Streaming overlap-save FIR filter bank
+*/
+template<typename _Tp>
+class OverlapSaveFilter
+{
+public:
+    typedef QSharedPointer<OverlapSaveFilter> SPtr;            /**< Shared pointer type for OverlapSaveFilter. */
+    typedef QSharedPointer<const OverlapSaveFilter> ConstSPtr; /**< Const shared pointer type for OverlapSaveFilter. */
+
+    typedef Matrix<_Tp, Dynamic, Dynamic> MatrixT;                      /**< Data matrix type. */
+    typedef Matrix<_Tp, Dynamic, 1> VectorT;                            /**< Real vector type. */
+    typedef Matrix<std::complex<_Tp>, Dynamic, Dynamic> MatrixCT;       /**< Spectrum matrix type. */
+    typedef Matrix<std::complex<_Tp>, Dynamic, 1> VectorCT;             /**< Frequency response type. */
+
+    //=========================================================================================================
+    /**
+    * Constructs an uninitialized filter, see init.
+    */
+    OverlapSaveFilter();
+
+    //=========================================================================================================
+    /**
+    * Constructs the filter, see init.
+    *
+    * @param[in] p_qListFilters     Filters to cascade, their forward coefficients m_dCoeffA are used
+    * @param[in] p_iNumChannels     Number of channels
+    * @param[in] p_iBlockSize       Expected number of samples per block, determines the FFT length
+    */
+    OverlapSaveFilter(const QList<FilterData> &p_qListFilters, qint32 p_iNumChannels, qint32 p_iBlockSize);
+
+    //=========================================================================================================
+    /**
+    * Combines the filters, sets up FFT plan and buffers and clears the filter state.
+    *
+    * @param[in] p_qListFilters     Filters to cascade, their forward coefficients m_dCoeffA are used
+    * @param[in] p_iNumChannels     Number of channels
+    * @param[in] p_iBlockSize       Expected number of samples per block, determines the FFT length
+    */
+    void init(const QList<FilterData> &p_qListFilters, qint32 p_iNumChannels, qint32 p_iBlockSize);
+
+    //=========================================================================================================
+    /**
+    * Combines the coefficient sets, sets up FFT plan and buffers and clears the filter state.
+    *
+    * @param[in] p_qListCoeffs      FIR coefficient sets to cascade
+    * @param[in] p_iNumChannels     Number of channels
+    * @param[in] p_iBlockSize       Expected number of samples per block, determines the FFT length
+    */
+    void init(const QList<RowVectorXd> &p_qListCoeffs, qint32 p_iNumChannels, qint32 p_iBlockSize);
+
+    //=========================================================================================================
+    /**
+    * Filters the next block of the stream. Blocks may have any length, longer blocks than the one given to init
+    * are processed in several FFT frames.
+    *
+    * @param[in] p_matData      Data block, channels x samples
+    * @param[out] p_matOut      Filtered block, channels x samples
+    *
+    * @return true if the block was filtered, false if the number of channels does not match
+    */
+    bool filter(const MatrixT &p_matData, MatrixT &p_matOut);
+
+    //=========================================================================================================
+    /**
+    * Clears the filter state, the next block is filtered as if preceded by zeros.
+    */
+    void reset();
+
+    //=========================================================================================================
+    /**
+    * Returns the group delay of a linear phase cascade.
+    *
+    * @return the delay in samples
+    */
+    inline qint32 delay() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of taps of the combined filter.
+    *
+    * @return the number of taps
+    */
+    inline qint32 numTaps() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the FFT length.
+    *
+    * @return the FFT length
+    */
+    inline qint32 fftLength() const;
+
+private:
+    Eigen::FFT<_Tp> m_fft;          /**< FFT object, keeps the plan of the FFT length. */
+    VectorCT    m_vecResponse;      /**< Frequency response of the cascade, half spectrum. */
+    MatrixT     m_matFrame;         /**< Input frame: taps-1 history samples followed by the new samples, samples x channels. */
+    MatrixT     m_matFrameOut;      /**< Circularly convolved frame, samples x channels. */
+    MatrixCT    m_matSpectrum;      /**< Spectrum of the frame, bins x channels. */
+    qint32      m_iNumChannels;     /**< Number of channels. */
+    qint32      m_iNumTaps;         /**< Number of taps of the combined filter. */
+    qint32      m_iFFTLength;       /**< FFT length. */
+    qint32      m_iStep;            /**< New samples per frame. */
+};
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+template<typename _Tp>
+OverlapSaveFilter<_Tp>::OverlapSaveFilter()
+: m_iNumChannels(0)
+, m_iNumTaps(0)
+, m_iFFTLength(0)
+, m_iStep(0)
+{
+    m_fft.SetFlag(m_fft.HalfSpectrum);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+OverlapSaveFilter<_Tp>::OverlapSaveFilter(const QList<FilterData> &p_qListFilters, qint32 p_iNumChannels, qint32 p_iBlockSize)
+{
+    m_fft.SetFlag(m_fft.HalfSpectrum);
+    init(p_qListFilters, p_iNumChannels, p_iBlockSize);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+void OverlapSaveFilter<_Tp>::init(const QList<FilterData> &p_qListFilters, qint32 p_iNumChannels, qint32 p_iBlockSize)
+{
+    QList<RowVectorXd> t_qListCoeffs;
+    for(qint32 i = 0; i < p_qListFilters.size(); ++i)
+        t_qListCoeffs.append(p_qListFilters[i].m_dCoeffA);
+
+    init(t_qListCoeffs, p_iNumChannels, p_iBlockSize);
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+void OverlapSaveFilter<_Tp>::init(const QList<RowVectorXd> &p_qListCoeffs, qint32 p_iNumChannels, qint32 p_iBlockSize)
+{
+    m_iNumChannels = p_iNumChannels;
+
+    //The cascade is as long as the sum of its parts minus the overlaps
+    m_iNumTaps = 1;
+    for(qint32 i = 0; i < p_qListCoeffs.size(); ++i)
+        m_iNumTaps += qMax((qint32)p_qListCoeffs[i].cols(), 1) - 1;
+
+    //Smallest power of 2 which takes the history and a whole block
+    m_iFFTLength = 2;
+    while(m_iFFTLength < m_iNumTaps - 1 + qMax(p_iBlockSize, m_iNumTaps))
+        m_iFFTLength *= 2;
+    m_iStep = m_iFFTLength - m_iNumTaps + 1;
+
+    qint32 t_iNumBins = m_iFFTLength/2 + 1;
+
+    //Multiply the responses of all filters, an empty cascade passes the data unchanged
+    m_vecResponse = VectorCT::Ones(t_iNumBins);
+    VectorT t_vecCoeffZeroPad(m_iFFTLength);
+    VectorCT t_vecCoeffFreq(t_iNumBins);
+    for(qint32 i = 0; i < p_qListCoeffs.size(); ++i)
+    {
+        if(p_qListCoeffs[i].cols() == 0)
+            continue;
+
+        t_vecCoeffZeroPad.setZero();
+        t_vecCoeffZeroPad.head(p_qListCoeffs[i].cols()) = p_qListCoeffs[i].transpose().template cast<_Tp>();
+        m_fft.fwd(t_vecCoeffFreq.data(), t_vecCoeffZeroPad.data(), m_iFFTLength);
+        m_vecResponse = m_vecResponse.cwiseProduct(t_vecCoeffFreq);
+    }
+
+    m_matFrame.resize(m_iFFTLength, m_iNumChannels);
+    m_matFrameOut.resize(m_iFFTLength, m_iNumChannels);
+    m_matSpectrum.resize(t_iNumBins, m_iNumChannels);
+
+    reset();
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+bool OverlapSaveFilter<_Tp>::filter(const MatrixT &p_matData, MatrixT &p_matOut)
+{
+    if(m_iFFTLength == 0 || p_matData.rows() != m_iNumChannels)
+        return false;
+
+    p_matOut.resize(p_matData.rows(), p_matData.cols());
+
+    const qint32 t_iHistory = m_iNumTaps - 1;
+    qint32 t_iCol = 0;
+
+    while(t_iCol < p_matData.cols())
+    {
+        qint32 t_iNum = qMin(m_iStep, (qint32)p_matData.cols() - t_iCol);
+
+        //Samples behind the new ones only affect outputs which are dropped
+        m_matFrame.middleRows(t_iHistory, t_iNum) = p_matData.middleCols(t_iCol, t_iNum).transpose();
+
+        for(qint32 i = 0; i < m_iNumChannels; ++i)
+        {
+            m_fft.fwd(m_matSpectrum.col(i).data(), m_matFrame.col(i).data(), m_iFFTLength);
+            m_matSpectrum.col(i) = m_matSpectrum.col(i).cwiseProduct(m_vecResponse);
+            m_fft.inv(m_matFrameOut.col(i).data(), m_matSpectrum.col(i).data(), m_iFFTLength);
+        }
+
+        //The first taps-1 samples of the frame are wrapped around, the others are the linear convolution
+        p_matOut.middleCols(t_iCol, t_iNum) = m_matFrameOut.middleRows(t_iHistory, t_iNum).transpose();
+
+        //Keep the last taps-1 input samples as history of the next frame
+        if(t_iHistory > 0)
+            m_matFrame.topRows(t_iHistory) = m_matFrame.middleRows(t_iNum, t_iHistory).eval();
+
+        t_iCol += t_iNum;
+    }
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+void OverlapSaveFilter<_Tp>::reset()
+{
+    m_matFrame.setZero();
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline qint32 OverlapSaveFilter<_Tp>::delay() const
+{
+    return (m_iNumTaps - 1)/2;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline qint32 OverlapSaveFilter<_Tp>::numTaps() const
+{
+    return m_iNumTaps;
+}
+
+
+//*************************************************************************************************************
+
+template<typename _Tp>
+inline qint32 OverlapSaveFilter<_Tp>::fftLength() const
+{
+    return m_iFFTLength;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// TYPEDEF
+//=============================================================================================================
+
+typedef OverlapSaveFilter<float>        OverlapSaveFilterf;     /**< Single precision OverlapSaveFilter.*/
+typedef OverlapSaveFilter<double>       OverlapSaveFilterd;     /**< Double precision OverlapSaveFilter.*/
+
+} // NAMESPACE
+
+#endif // OVERLAPSAVEFILTER_H
@@ -38,7 +38,7 @@ include(../../mne-cpp.pri)
 TEMPLATE = lib
 
 QT       -= gui
-QT       += xml
+QT       += xml concurrent
 
 DEFINES += UTILS_LIBRARY
 
@@ -64,6 +64,7 @@ win32 {
 
 SOURCES += \
     kmeans.cpp \
+    welchpsd.cpp \
     mnemath.cpp \
     ioutils.cpp \
     asaelc.cpp \
@@ -71,10 +72,13 @@ SOURCES += \
     filterdata.cpp \
     mp/adaptivemp.cpp \
     mp/atom.cpp \
+    mp/fixdict.cpp \
     mp/fixdictmp.cpp
 
 HEADERS += \
     kmeans.h\
+    welchpsd.h \
+    overlapsavefilter.h \
     utils_global.h \
     mnemath.h \
     ioutils.h \
@@ -83,6 +87,7 @@ HEADERS += \
     filterdata.h \
     mp/adaptivemp.h \
     mp/atom.h \
+    mp/fixdict.h \
     mp/fixdictmp.h
 
 INCLUDEPATH += $${EIGEN_INCLUDE_DIR}
@@ -0,0 +1,192 @@
+//=============================================================================================================
+/**
+* @file     welchpsd.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>;
+* @version  1.0
+* @date     July, 2012
+*
+* @section  LICENSE
+*
+* Copyright (C) 2012, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Implementation of the WelchPsd class
+*
+*/
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "welchpsd.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <math.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+WelchPsd::WelchPsd()
+: m_iNumChannels(0)
+, m_iSegmentLength(0)
+, m_iHop(0)
+, m_iPos(0)
+, m_iDue(0)
+, m_iNumAverages(0)
+, m_iNumSegments(0)
+, m_dSFreq(0)
+{
+    m_fft.SetFlag(m_fft.HalfSpectrum);
+}
+
+
+//*************************************************************************************************************
+
+WelchPsd::WelchPsd(qint32 p_iNumChannels, qint32 p_iSegmentLength, double p_dSFreq, qint32 p_iNumAverages, qint32 p_iHop)
+{
+    m_fft.SetFlag(m_fft.HalfSpectrum);
+    init(p_iNumChannels, p_iSegmentLength, p_dSFreq, p_iNumAverages, p_iHop);
+}
+
+
+//*************************************************************************************************************
+
+void WelchPsd::init(qint32 p_iNumChannels, qint32 p_iSegmentLength, double p_dSFreq, qint32 p_iNumAverages, qint32 p_iHop)
+{
+    m_iNumChannels = p_iNumChannels;
+    m_iSegmentLength = p_iSegmentLength;
+    m_iHop = p_iHop > 0 ? qMin(p_iHop, p_iSegmentLength) : qMax(p_iSegmentLength/2, 1);
+    m_iNumAverages = p_iNumAverages;
+    m_dSFreq = p_dSFreq;
+
+    qint32 t_iNumBins = m_iSegmentLength/2 + 1;
+
+    //Periodic Hann window
+    m_vecWindow.resize(m_iSegmentLength);
+    for(qint32 i = 0; i < m_iSegmentLength; ++i)
+        m_vecWindow[i] = 0.5 - 0.5*cos(2.0*M_PI*i/m_iSegmentLength);
+
+    //|X|^2 / (fs * sum(w^2)), all bins but DC and Nyquist are folded onto the positive frequencies
+    m_vecBinScale = VectorXd::Constant(t_iNumBins, 2.0/(m_dSFreq*m_vecWindow.squaredNorm()));
+    m_vecBinScale[0] *= 0.5;
+    if(m_iSegmentLength % 2 == 0)
+        m_vecBinScale[t_iNumBins - 1] *= 0.5;
+
+    m_matSegment.resize(m_iSegmentLength, m_iNumChannels);
+    m_matWindowed.resize(m_iSegmentLength, m_iNumChannels);
+    m_matSpectrum.resize(t_iNumBins, m_iNumChannels);
+
+    //Plan the segment length once, later transforms reuse it
+    m_fft.fwd(m_matSpectrum.col(0).data(), m_matWindowed.col(0).data(), m_iSegmentLength);
+
+    reset();
+}
+
+
+//*************************************************************************************************************
+
+qint32 WelchPsd::append(const MatrixXd &p_matData)
+{
+    if(m_iSegmentLength <= 0 || p_matData.rows() != m_iNumChannels)
+        return 0;
+
+    qint32 t_iNumSegments = 0;
+    qint32 t_iCol = 0;
+
+    while(t_iCol < p_matData.cols())
+    {
+        //copy up to the next due segment or the ring end, whichever comes first
+        qint32 t_iNum = qMin(qMin(m_iDue, m_iSegmentLength - m_iPos), (qint32)p_matData.cols() - t_iCol);
+        m_matSegment.middleRows(m_iPos, t_iNum) = p_matData.middleCols(t_iCol, t_iNum).transpose();
+        m_iPos = (m_iPos + t_iNum) % m_iSegmentLength;
+        m_iDue -= t_iNum;
+        t_iCol += t_iNum;
+
+        if(m_iDue == 0)
+        {
+            processSegment();
+            ++t_iNumSegments;
+
+            //the overlap stays in the ring
+            m_iDue = m_iHop;
+        }
+    }
+
+    return t_iNumSegments;
+}
+
+
+//*************************************************************************************************************
+
+void WelchPsd::reset()
+{
+    m_iPos = 0;
+    m_iDue = m_iSegmentLength;
+    m_iNumSegments = 0;
+    m_matPsd = MatrixXd::Zero(m_iNumChannels, m_iSegmentLength/2 + 1);
+}
+
+
+//*************************************************************************************************************
+
+VectorXd WelchPsd::frequencies() const
+{
+    return VectorXd::LinSpaced(m_iSegmentLength/2 + 1, 0, (m_iSegmentLength/2)*m_dSFreq/m_iSegmentLength);
+}
+
+
+//*************************************************************************************************************
+
+void WelchPsd::processSegment()
+{
+    //the oldest sample is at the ring position
+    qint32 t_iTail = m_iSegmentLength - m_iPos;
+    m_matWindowed.topRows(t_iTail).noalias() = m_vecWindow.head(t_iTail).asDiagonal()*m_matSegment.bottomRows(t_iTail);
+    if(m_iPos > 0)
+        m_matWindowed.bottomRows(m_iPos).noalias() = m_vecWindow.tail(m_iPos).asDiagonal()*m_matSegment.topRows(m_iPos);
+
+    for(qint32 i = 0; i < m_iNumChannels; ++i)
+        m_fft.fwd(m_matSpectrum.col(i).data(), m_matWindowed.col(i).data(), m_iSegmentLength);
+
+    ++m_iNumSegments;
+    double t_dWeight = 1.0/(m_iNumAverages > 0 ? qMin(m_iNumSegments, m_iNumAverages) : m_iNumSegments);
+
+    m_matPsd += t_dWeight*((m_vecBinScale.asDiagonal()*m_matSpectrum.cwiseAbs2()).transpose() - m_matPsd);
+}
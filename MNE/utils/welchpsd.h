@@ -0,0 +1,231 @@
+//=============================================================================================================
+/**
+* @file     welchpsd.h
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     July, 2012
+*
+* @section  LICENSE
+*
+* Copyright (C) 2012, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    WelchPsd class declaration.
+*
+*/
+
+
+#ifndef WELCHPSD_H
+#define WELCHPSD_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "utils_global.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Qt INCLUDES
+//=============================================================================================================
+
+#include <QSharedPointer>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE UTILSLIB
+//=============================================================================================================
+
+namespace UTILSLIB
+{
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+* Streaming multichannel power spectral density estimation after Welch. Incoming data is collected into
+* Hann windowed segments, 50% overlap by default. A new segment starts every hop samples, it is transformed right
+* away and averaged into the spectrum, so the estimate is refreshed every hop samples instead of after a fixed
+* amount of data. The FFT plan, the window and all work buffers are set up once in init. The segment buffer is a
+* ring of the last segment length samples, stored time major so every channel is contiguous; a small hop does
+* not shift the buffer. The channels are transformed one after the other with the shared,
+* cached plan; Eigen's FFT has no batched real transform.
+* The first numAverages segments are averaged with equal weights, later segments replace the oldest
+* contribution exponentially, i.e. the estimate follows the last numAverages segments.
+*
+* @brief Streaming multichannel Welch power spectral density
+*/
+class UTILSSHARED_EXPORT WelchPsd
+{
+public:
+    typedef QSharedPointer<WelchPsd> SPtr;            /**< Shared pointer type for WelchPsd. */
+    typedef QSharedPointer<const WelchPsd> ConstSPtr; /**< Const shared pointer type for WelchPsd. */
+
+    //=========================================================================================================
+    /**
+    * Constructs an uninitialized estimator, see init.
+    */
+    WelchPsd();
+
+    //=========================================================================================================
+    /**
+    * Constructs the estimator, see init.
+    *
+    * @param[in] p_iNumChannels     Number of channels
+    * @param[in] p_iSegmentLength   Segment and FFT length in samples
+    * @param[in] p_dSFreq           Sampling frequency in Hz
+    * @param[in] p_iNumAverages     (optional) Number of segments the estimate averages over, 0 averages all segments
+    * @param[in] p_iHop             (optional) Samples between the starts of two segments, 0 for half the segment length
+    */
+    WelchPsd(qint32 p_iNumChannels, qint32 p_iSegmentLength, double p_dSFreq, qint32 p_iNumAverages = 8, qint32 p_iHop = 0);
+
+    //=========================================================================================================
+    /**
+    * Sets up window, FFT plan and buffers and drops the current estimate.
+    *
+    * @param[in] p_iNumChannels     Number of channels
+    * @param[in] p_iSegmentLength   Segment and FFT length in samples
+    * @param[in] p_dSFreq           Sampling frequency in Hz
+    * @param[in] p_iNumAverages     (optional) Number of segments the estimate averages over, 0 averages all segments
+    * @param[in] p_iHop             (optional) Samples between the starts of two segments, 0 for half the segment length
+    */
+    void init(qint32 p_iNumChannels, qint32 p_iSegmentLength, double p_dSFreq, qint32 p_iNumAverages = 8, qint32 p_iHop = 0);
+
+    //=========================================================================================================
+    /**
+    * Appends data of any length and updates the estimate for every segment completed by it.
+    *
+    * @param[in] p_matData  Data block, channels x samples
+    *
+    * @return the number of segments completed by this block
+    */
+    qint32 append(const MatrixXd &p_matData);
+
+    //=========================================================================================================
+    /**
+    * Drops the collected data and the current estimate.
+    */
+    void reset();
+
+    //=========================================================================================================
+    /**
+    * Returns the one sided power spectral density, unit^2/Hz.
+    *
+    * @return the spectrum, channels x (segment length/2 + 1) frequency bins
+    */
+    inline const MatrixXd& psd() const;
+
+    //=========================================================================================================
+    /**
+    * Returns whether at least one segment went into the estimate.
+    *
+    * @return true if an estimate is available
+    */
+    inline bool hasEstimate() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the number of segments processed since init or reset.
+    *
+    * @return the number of segments
+    */
+    inline qint32 segmentCount() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the frequencies of the spectrum bins.
+    *
+    * @return the bin frequencies in Hz
+    */
+    VectorXd frequencies() const;
+
+private:
+    //=========================================================================================================
+    /**
+    * Transforms the buffered segment and averages it into the estimate.
+    */
+    void processSegment();
+
+    Eigen::FFT<double>  m_fft;          /**< FFT object, keeps the plan of the segment length. */
+    VectorXd    m_vecWindow;            /**< Hann window. */
+    VectorXd    m_vecBinScale;          /**< Scale of each bin: window power, sampling frequency and one sided folding. */
+    MatrixXd    m_matSegment;           /**< Ring of the last segment length samples, samples x channels. */
+    MatrixXd    m_matWindowed;          /**< Windowed segment, samples x channels. */
+    MatrixXcd   m_matSpectrum;          /**< Spectrum of the windowed segment, bins x channels. */
+    MatrixXd    m_matPsd;               /**< The estimate, channels x bins. */
+    qint32      m_iNumChannels;         /**< Number of channels. */
+    qint32      m_iSegmentLength;       /**< Segment length. */
+    qint32      m_iHop;                 /**< Samples between the starts of two segments. */
+    qint32      m_iPos;                 /**< Ring position of the next sample, i.e. of the oldest sample once full. */
+    qint32      m_iDue;                 /**< Samples still missing until the next segment is complete. */
+    qint32      m_iNumAverages;         /**< Number of segments the estimate averages over, 0 for all. */
+    qint32      m_iNumSegments;         /**< Segments processed so far. */
+    double      m_dSFreq;               /**< Sampling frequency. */
+};
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline const MatrixXd& WelchPsd::psd() const
+{
+    return m_matPsd;
+}
+
+
+//*************************************************************************************************************
+
+inline bool WelchPsd::hasEstimate() const
+{
+    return m_iNumSegments > 0;
+}
+
+
+//*************************************************************************************************************
+
+inline qint32 WelchPsd::segmentCount() const
+{
+    return m_iNumSegments;
+}
+
+} // NAMESPACE
+
+#endif // WELCHPSD_H
@@ -137,9 +137,10 @@ void FiffProducer::run()
 //    for(qint32 i = 0; i < nchan; ++i)
 //        inv_calsMat.insert(i, i) = 1.0f/m_pFiffSimulator->m_RawInfo.info.chs[i].cal;
 
-    //Not good cause production time is not accurate
-    //loading and thread sleep is longer than thread sleep time - better to have a extra loading thread
-    // ToDo restructure this producer as laoding buffer --> and thread sleep to simulator buffer
+    //
+    // This thread only prefetches: it decodes ahead until the prefetch queue is full. The pacing is done by
+    // FiffSimulator::run on the monotonic clock, so decoding time does not show up in the emission times.
+    //
     fiff_int_t t_iDiff;
     bool t_bRestart = false;
 
@@ -193,8 +194,9 @@ void FiffProducer::run()
             first += quantum;
         }
 
-        // call blocks until there is free space in the buffer
-        m_pFiffSimulator->m_pRawMatrixBuffer->push(&tmp);
+        // wait until there is free space in the prefetch queue, but stay responsive to stop()
+        while(m_bIsRunning && !m_pFiffSimulator->m_pRawMatrixBuffer->tryPush(&tmp, 100))
+            ;
     }
 
     // close datastream in this thread
@@ -42,6 +42,7 @@
 #include "fiffsimulator.h"
 #include "fiffproducer.h"
 #include <stdlib.h>
+#include <math.h>
 
 
 //*************************************************************************************************************
@@ -71,6 +72,7 @@
 #include <QFile>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QElapsedTimer>
 
 
 //*************************************************************************************************************
@@ -92,6 +94,7 @@ const QString FiffSimulator::Commands::GETBUFSIZE   = "getbufsize";
 const QString FiffSimulator::Commands::ACCEL        = "accel";
 const QString FiffSimulator::Commands::GETACCEL     = "getaccel";
 const QString FiffSimulator::Commands::SIMFILE      = "simfile";
+const QString FiffSimulator::Commands::SIMSTATS     = "simstats";
 
 
 //*************************************************************************************************************
@@ -107,8 +110,11 @@ FiffSimulator::FiffSimulator()
 , m_AccelerationFactor(1.0)
 , m_TrueSamplingRate(0.0)
 , m_pRawMatrixBuffer(NULL)
+, m_dSumLateness(0.0)
+, m_dSumSqLateness(0.0)
 , m_bIsRunning(false)
 {
+    resetPacingStatistics(0.0);
     this->init();
 }
 
@@ -279,6 +285,74 @@ void FiffSimulator::comSimfile(Command p_command)
 }
 
 
+//*************************************************************************************************************
+
+void FiffSimulator::comSimstats(Command p_command)
+{
+    m_qMutexStatistics.lock();
+    PacingStatistics t_stats = m_pacingStatistics;
+    m_qMutexStatistics.unlock();
+
+    if(m_pRawMatrixBuffer)
+        t_stats.iPrefetched = m_pRawMatrixBuffer->count();
+
+    if(p_command.isJson())
+    {
+        QJsonObject t_qJsonObjectRoot;
+        t_qJsonObjectRoot.insert("emitted", QJsonValue((double)t_stats.iEmitted));
+        t_qJsonObjectRoot.insert("underruns", QJsonValue((double)t_stats.iUnderruns));
+        t_qJsonObjectRoot.insert("resyncs", QJsonValue((double)t_stats.iResyncs));
+        t_qJsonObjectRoot.insert("mean_lateness_us", QJsonValue(t_stats.dMeanLatenessUs));
+        t_qJsonObjectRoot.insert("jitter_us", QJsonValue(t_stats.dRmsJitterUs));
+        t_qJsonObjectRoot.insert("max_lateness_us", QJsonValue(t_stats.dMaxLatenessUs));
+        t_qJsonObjectRoot.insert("drift_us", QJsonValue(t_stats.dDriftUs));
+        t_qJsonObjectRoot.insert("effective_rate", QJsonValue(t_stats.dEffectiveRate));
+        t_qJsonObjectRoot.insert("nominal_rate", QJsonValue(t_stats.dNominalRate));
+        t_qJsonObjectRoot.insert("prefetched", QJsonValue((double)t_stats.iPrefetched));
+        QJsonDocument p_qJsonDocument(t_qJsonObjectRoot);
+
+        m_commandManager[Commands::SIMSTATS].reply(p_qJsonDocument.toJson());
+    }
+    else
+    {
+        QString str;
+        str.append(QString("\temitted buffers:\t%1\n").arg(t_stats.iEmitted));
+        str.append(QString("\tprefetch underruns:\t%1\n").arg(t_stats.iUnderruns));
+        str.append(QString("\tschedule resyncs:\t%1\n").arg(t_stats.iResyncs));
+        str.append(QString("\tmean lateness:\t\t%1 us\n").arg(t_stats.dMeanLatenessUs, 0, 'f', 1));
+        str.append(QString("\tjitter (std):\t\t%1 us\n").arg(t_stats.dRmsJitterUs, 0, 'f', 1));
+        str.append(QString("\tmax lateness:\t\t%1 us\n").arg(t_stats.dMaxLatenessUs, 0, 'f', 1));
+        str.append(QString("\tdrift:\t\t\t%1 us\n").arg(t_stats.dDriftUs, 0, 'f', 1));
+        str.append(QString("\teffective rate:\t\t%1 Hz (nominal %2 Hz)\n").arg(t_stats.dEffectiveRate, 0, 'f', 3).arg(t_stats.dNominalRate, 0, 'f', 3));
+        str.append(QString("\tprefetched buffers:\t%1\n\n").arg(t_stats.iPrefetched));
+
+        m_commandManager[Commands::SIMSTATS].reply(str);
+    }
+}
+
+
+//*************************************************************************************************************
+
+void FiffSimulator::resetPacingStatistics(double p_dNominalRate)
+{
+    QMutexLocker t_locker(&m_qMutexStatistics);
+
+    m_pacingStatistics.iEmitted = 0;
+    m_pacingStatistics.iUnderruns = 0;
+    m_pacingStatistics.iResyncs = 0;
+    m_pacingStatistics.dMeanLatenessUs = 0.0;
+    m_pacingStatistics.dRmsJitterUs = 0.0;
+    m_pacingStatistics.dMaxLatenessUs = 0.0;
+    m_pacingStatistics.dDriftUs = 0.0;
+    m_pacingStatistics.dEffectiveRate = 0.0;
+    m_pacingStatistics.dNominalRate = p_dNominalRate;
+    m_pacingStatistics.iPrefetched = 0;
+
+    m_dSumLateness = 0.0;
+    m_dSumSqLateness = 0.0;
+}
+
+
 //*************************************************************************************************************
 
 void FiffSimulator::connectCommandManager()
@@ -289,6 +363,7 @@ void FiffSimulator::connectCommandManager()
     QObject::connect(&m_commandManager[Commands::ACCEL], &Command::executed, this, &FiffSimulator::comAccel);
     QObject::connect(&m_commandManager[Commands::GETACCEL], &Command::executed, this, &FiffSimulator::comGetAccel);
     QObject::connect(&m_commandManager[Commands::SIMFILE], &Command::executed, this, &FiffSimulator::comSimfile);
+    QObject::connect(&m_commandManager[Commands::SIMSTATS], &Command::executed, this, &FiffSimulator::comSimstats);
 }
 
 
@@ -347,7 +422,7 @@ void FiffSimulator::init()
     m_pRawMatrixBuffer = NULL;
 
     if(!m_RawInfo.isEmpty())
-        m_pRawMatrixBuffer = new RawMatrixBuffer(RAW_BUFFFER_SIZE, m_RawInfo.info.nchan, this->m_uiBufferSampleSize);
+        m_pRawMatrixBuffer = new _float_RingMatrixBuffer(RAW_BUFFFER_SIZE, m_RawInfo.info.nchan, this->m_uiBufferSampleSize);
 }
 
 
@@ -405,6 +480,7 @@ bool FiffSimulator::readRawInfo()
         {
             printf("Error: Not able to read raw info!\n");
             m_RawInfo.clear();
+            mutex.unlock();
             return false;
         }
 
@@ -499,7 +575,7 @@ bool FiffSimulator::readRawInfo()
         //
         if(m_pRawMatrixBuffer)
             delete m_pRawMatrixBuffer;
-        m_pRawMatrixBuffer = new RawMatrixBuffer(10, m_RawInfo.info.nchan, m_uiBufferSampleSize);
+        m_pRawMatrixBuffer = new _float_RingMatrixBuffer(RAW_BUFFFER_SIZE, m_RawInfo.info.nchan, m_uiBufferSampleSize);
 
         mutex.unlock();
     }
@@ -514,20 +590,78 @@ void FiffSimulator::run()
 {
     m_bIsRunning = true;
 
-    float t_fSamplingFrequency = m_RawInfo.info.sfreq;
-    float t_fBuffSampleSize = (float)m_uiBufferSampleSize;
+    const double t_dSamplingFrequency = m_RawInfo.info.sfreq; // already includes the acceleration factor
+    const double t_dPeriodNs = ((double)m_uiBufferSampleSize/t_dSamplingFrequency)*1e9;
+
+    //If the schedule is lagging more than this, it is re-anchored instead of bursting out the backlog
+    const qint64 t_iMaxLatenessNs = (qint64)(10.0*t_dPeriodNs);
+
+    resetPacingStatistics(t_dSamplingFrequency);
 
-    quint32 uiSamplePeriod = (unsigned int) ((t_fBuffSampleSize/t_fSamplingFrequency)*1000000.0f);
+    //
+    // Monotonic clock scheduler: buffer k is due at t0 + k * period. Deadlines are derived from k instead of
+    // accumulating sleeps, so wake up and emission delays do not add up to a drift.
+    //
+    QElapsedTimer t_timer;
+    t_timer.start();
 
-//    quint32 count = 0;
+    qint64 t_iAnchorNs = 0;
+    qint64 k = 0;
 
     while(m_bIsRunning)
     {
-        QSharedPointer<Eigen::MatrixXf> t_pRawBuffer(new Eigen::MatrixXf(m_pRawMatrixBuffer->pop()));
-//        ++count;
-//        printf("%d raw buffer (%d x %d) generated\r\n", count, t_pRawBuffer->rows(), t_pRawBuffer->cols());
+        //
+        // Take the next prefetched buffer; FiffProducer keeps the queue filled
+        //
+        QSharedPointer<Eigen::MatrixXf> t_pRawBuffer(new Eigen::MatrixXf(m_RawInfo.info.nchan, m_uiBufferSampleSize));
+        if(!m_pRawMatrixBuffer->tryPop(*t_pRawBuffer, 100))
+            continue;
+
+        qint64 t_iDeadlineNs = t_iAnchorNs + (qint64)(k*t_dPeriodNs);
+        bool t_bUnderrun = t_timer.nsecsElapsed() > t_iDeadlineNs;
+
+        //
+        // Sleep coarse until shortly before the deadline, then yield for the remainder
+        //
+        qint64 t_iRemainingNs = t_iDeadlineNs - t_timer.nsecsElapsed();
+        if(t_iRemainingNs > 2000000)
+            usleep((t_iRemainingNs - 1000000)/1000);
+        while(t_timer.nsecsElapsed() < t_iDeadlineNs)
+            QThread::yieldCurrentThread();
+
+        qint64 t_iEmitNs = t_timer.nsecsElapsed();
 
         emit remitRawBuffer(t_pRawBuffer);
-        usleep(uiSamplePeriod);
+
+        //
+        // Statistics
+        //
+        double t_dLatenessUs = (t_iEmitNs - t_iDeadlineNs)/1000.0;
+
+        m_qMutexStatistics.lock();
+        ++m_pacingStatistics.iEmitted;
+        if(t_bUnderrun)
+            ++m_pacingStatistics.iUnderruns;
+        m_dSumLateness += t_dLatenessUs;
+        m_dSumSqLateness += t_dLatenessUs*t_dLatenessUs;
+        double n = (double)m_pacingStatistics.iEmitted;
+        m_pacingStatistics.dMeanLatenessUs = m_dSumLateness/n;
+        m_pacingStatistics.dRmsJitterUs = sqrt(qMax(0.0, m_dSumSqLateness/n - m_pacingStatistics.dMeanLatenessUs*m_pacingStatistics.dMeanLatenessUs));
+        if(t_dLatenessUs > m_pacingStatistics.dMaxLatenessUs)
+            m_pacingStatistics.dMaxLatenessUs = t_dLatenessUs;
+        m_pacingStatistics.dDriftUs = t_dLatenessUs;
+        if(t_iEmitNs > 0)
+            m_pacingStatistics.dEffectiveRate = (n-1.0)*m_uiBufferSampleSize/(t_iEmitNs/1e9);
+        m_qMutexStatistics.unlock();
+
+        ++k;
+
+        if(t_iEmitNs - t_iDeadlineNs > t_iMaxLatenessNs)
+        {
+            t_iAnchorNs = t_iEmitNs - (qint64)(k*t_dPeriodNs) + (qint64)t_dPeriodNs;
+            m_qMutexStatistics.lock();
+            ++m_pacingStatistics.iResyncs;
+            m_qMutexStatistics.unlock();
+        }
     }
 }
@@ -52,6 +52,7 @@
 
 #include <fiff/fiff_raw_data.h>
 #include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 
 
 //*************************************************************************************************************
@@ -112,6 +113,26 @@ public:
         static const QString ACCEL;
         static const QString GETACCEL;
         static const QString SIMFILE;
+        static const QString SIMSTATS;
+    };
+
+    //=========================================================================================================
+    /**
+    * Pacing statistics of the buffer emission, lateness is measured against the ideal schedule
+    * t_k = k * bufsize / sfreq on the monotonic clock.
+    */
+    struct PacingStatistics
+    {
+        qint64 iEmitted;            /**< Number of emitted buffers. */
+        qint64 iUnderruns;          /**< Buffers which were not prefetched in time. */
+        qint64 iResyncs;            /**< Times the schedule was re-anchored after falling too far behind. */
+        double dMeanLatenessUs;     /**< Mean lateness [us]. */
+        double dRmsJitterUs;        /**< Standard deviation of the lateness [us]. */
+        double dMaxLatenessUs;      /**< Largest lateness [us]. */
+        double dDriftUs;            /**< Lateness of the last buffer [us], i.e. the accumulated drift. */
+        double dEffectiveRate;      /**< Emitted samples per second since start. */
+        double dNominalRate;        /**< Sampling rate incl. acceleration factor. */
+        qint32 iPrefetched;         /**< Decoded buffers ready in the prefetch queue. */
     };
 
     //=========================================================================================================
@@ -184,6 +205,22 @@ private:
     */
     void comSimfile(Command p_command);
 
+    //=========================================================================================================
+    /**
+    * Returns the pacing statistics (jitter, drift, underruns) of the running simulation
+    *
+    * @param[in] p_command  The simulation statistics command.
+    */
+    void comSimstats(Command p_command);
+
+    //=========================================================================================================
+    /**
+    * Resets the pacing statistics.
+    *
+    * @param[in] p_dNominalRate     Sampling rate incl. acceleration factor
+    */
+    void resetPacingStatistics(double p_dNominalRate);
+
     //////////
 
     //=========================================================================================================
@@ -203,7 +240,12 @@ private:
     float           m_AccelerationFactor;   /**< Acceleration factor to simulate different sampling rates. */
     float           m_TrueSamplingRate;     /**< The true sampling rate of the fif file. */
 
-    RawMatrixBuffer* m_pRawMatrixBuffer;    /**< The Circular Raw Matrix Buffer. */
+    _float_RingMatrixBuffer* m_pRawMatrixBuffer;   /**< Prefetch queue of decoded buffers between FiffProducer and the pacing thread. */
+
+    QMutex              m_qMutexStatistics;     /**< Guards the pacing statistics. */
+    PacingStatistics    m_pacingStatistics;     /**< Pacing statistics. */
+    double              m_dSumLateness;         /**< Sum of the lateness [us]. */
+    double              m_dSumSqLateness;       /**< Sum of the squared lateness [us^2]. */
 
     bool            m_bIsRunning;
 };
@@ -216,8 +216,9 @@ void ConnectorManager::connectActiveConnector()
         // connect command server and connector manager
 
         // connect connector manager and fiff stream server
+        // direct: encoding and fan out happen in the connector thread, the server's event loop adds no latency
         QObject::connect(   t_activeConnector, &IConnector::remitRawBuffer,
-                            this->m_pFiffStreamServer, &FiffStreamServer::forwardRawBuffer);
+                            this->m_pFiffStreamServer, &FiffStreamServer::forwardRawBuffer, Qt::DirectConnection);
     }
     else
     {
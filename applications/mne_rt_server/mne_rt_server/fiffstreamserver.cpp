@@ -43,6 +43,8 @@
 
 #include "mne_rt_server.h"
 
+#include <fiff/fiff_constants.h>
+
 
 //*************************************************************************************************************
 //=============================================================================================================
@@ -50,6 +52,7 @@
 //=============================================================================================================
 
 #include <stdlib.h>
+#include <chrono>
 
 
 //*************************************************************************************************************
@@ -69,6 +72,8 @@ using namespace FIFFLIB;
 FiffStreamServer::FiffStreamServer(QObject *parent)
 : QTcpServer(parent)
 , m_iNextClientId(0)
+, m_iQueueDepth(32)
+, m_eQueuePolicy(FiffStreamThread::DropOldest)
 {
 
 }
@@ -173,6 +178,80 @@ void FiffStreamServer::comStopAll(Command p_command)
 }
 
 
+//*************************************************************************************************************
+
+void FiffStreamServer::comLag(Command p_command)
+{
+    QString t_sOutput("");
+    t_sOutput.append("\tID\tAlias\tQueued\tMax\tSent\tDropped\tBytesToWrite\r\n");
+    QMap<qint32, FiffStreamThread*>::iterator i;
+    for (i = this->m_qClientList.begin(); i != this->m_qClientList.end(); ++i)
+    {
+        FiffStreamThread::SendStatistics t_stats = i.value()->getSendStatistics();
+        QString str = QString("\t%1\t%2\t%3\t%4\t%5\t%6\t%7\r\n").arg(i.key()).arg(i.value()->getAlias())
+                .arg(t_stats.iQueued).arg(t_stats.iMaxQueued).arg(t_stats.iSent).arg(t_stats.iDropped).arg(t_stats.iBytesToWrite);
+        t_sOutput.append(str);
+    }
+    t_sOutput.append("\n");
+    qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["lag"].reply(t_sOutput);
+
+    Q_UNUSED(p_command);
+}
+
+
+//*************************************************************************************************************
+
+void FiffStreamServer::comQueue(Command p_command)
+{
+    QString t_sOutput("");
+
+    if(p_command.pValues().size() < 3)
+    {
+        t_sOutput.append("\twarning: usage queue <ID/Alias|all> <depth> <drop|disconnect>\r\n\n");
+        qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["queue"].reply(t_sOutput);
+        return;
+    }
+
+    bool t_bIsInt;
+    qint32 t_iDepth = p_command.pValues()[1].toInt(&t_bIsInt);
+    QString t_sPolicy = p_command.pValues()[2].toString();
+
+    if(!t_bIsInt || t_iDepth < 1 || (t_sPolicy.compare("drop") != 0 && t_sPolicy.compare("disconnect") != 0))
+    {
+        t_sOutput.append("\twarning: depth has to be >= 1 and policy either 'drop' or 'disconnect'\r\n\n");
+        qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["queue"].reply(t_sOutput);
+        return;
+    }
+
+    FiffStreamThread::QueuePolicy t_ePolicy = t_sPolicy.compare("drop") == 0 ? FiffStreamThread::DropOldest : FiffStreamThread::Disconnect;
+
+    QString t_sAlias(p_command.pValues()[0].toString());
+    if(t_sAlias.compare("all") == 0)
+    {
+        m_iQueueDepth = t_iDepth;
+        m_eQueuePolicy = t_ePolicy;
+
+        QMap<qint32, FiffStreamThread*>::iterator i;
+        for (i = this->m_qClientList.begin(); i != this->m_qClientList.end(); ++i)
+            i.value()->setQueuePolicy(t_iDepth, t_ePolicy);
+
+        t_sOutput.append(QString("\tall FiffStreamClients: queue depth %1, policy %2\r\n\n").arg(t_iDepth).arg(t_sPolicy));
+    }
+    else
+    {
+        qint32 t_id = -1;
+        t_sOutput.append(parseToId(t_sAlias,t_id));
+
+        if(t_id != -1)
+        {
+            m_qClientList[t_id]->setQueuePolicy(t_iDepth, t_ePolicy);
+            t_sOutput.append(QString("\tFiffStreamClient (ID: %1): queue depth %2, policy %3\r\n\n").arg(t_id).arg(t_iDepth).arg(t_sPolicy));
+        }
+    }
+    qobject_cast<MNERTServer*>(this->parent())->getCommandManager()["queue"].reply(t_sOutput);
+}
+
+
 //*************************************************************************************************************
 
 void FiffStreamServer::connectCommands()
@@ -185,6 +264,8 @@ void FiffStreamServer::connectCommands()
     QObject::connect(&t_pMNERTServer->getCommandManager()["start"], &Command::executed, this, &FiffStreamServer::comStart);
     QObject::connect(&t_pMNERTServer->getCommandManager()["stop"], &Command::executed, this, &FiffStreamServer::comStop);
     QObject::connect(&t_pMNERTServer->getCommandManager()["stop-all"], &Command::executed, this, &FiffStreamServer::comStopAll);
+    QObject::connect(&t_pMNERTServer->getCommandManager()["lag"], &Command::executed, this, &FiffStreamServer::comLag);
+    QObject::connect(&t_pMNERTServer->getCommandManager()["queue"], &Command::executed, this, &FiffStreamServer::comQueue);
 
 //    t_pMNERTServer->getCommandManager().connectSlot(QString("clist"), this, &FiffStreamServer::comClist);
 //    t_pMNERTServer->getCommandManager().connectSlot(QString("measinfo"), this, &FiffStreamServer::comMeasinfo);
@@ -373,10 +454,37 @@ void FiffStreamServer::forwardMeasInfo(qint32 ID, FiffInfo p_fiffInfo)
 
 
 //*************************************************************************************************************
-//ToDo increase preformance --> try inline
+
 void FiffStreamServer::forwardRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData)
 {
-    emit remitRawBuffer(m_pMatRawData);
+    qint64 t_iTimestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    QMutexLocker t_locker(&m_qClientListMutex);
+
+    if(m_qClientList.isEmpty())
+        return;
+
+    //
+    // Encode once, all clients share the immutable block: time stamp tag followed by the data buffer tag.
+    // Clients which did not ask for time stamps skip the leading tag.
+    //
+    const qint32 t_iTimestampSize = 4*sizeof(qint32) + sizeof(qint64);
+
+    QSharedPointer<QByteArray> t_pBlock(new QByteArray);
+    t_pBlock->reserve(t_iTimestampSize + 4*sizeof(qint32) + m_pMatRawData->size()*sizeof(float));
+    {
+        FiffStream t_FiffStreamOut(t_pBlock.data(), QIODevice::WriteOnly);
+        t_FiffStreamOut << (qint32)FIFF_MNE_RT_TIMESTAMP;
+        t_FiffStreamOut << (qint32)FIFFT_LONG;
+        t_FiffStreamOut << (qint32)sizeof(qint64);
+        t_FiffStreamOut << (qint32)FIFFV_NEXT_SEQ;
+        t_FiffStreamOut << t_iTimestamp;
+        t_FiffStreamOut.write_float(FIFF_DATA_BUFFER,m_pMatRawData->data(),m_pMatRawData->rows()*m_pMatRawData->cols());
+    }
+
+    QMap<qint32, FiffStreamThread*>::const_iterator i;
+    for (i = m_qClientList.constBegin(); i != m_qClientList.constEnd(); ++i)
+        i.value()->sendRawBuffer(t_pBlock, t_iTimestampSize);
 }
 
 
@@ -386,7 +494,11 @@ void FiffStreamServer::incomingConnection(qintptr socketDescriptor)
 {
     FiffStreamThread* t_pStreamThread = new FiffStreamThread(m_iNextClientId, socketDescriptor, this);
 
+    t_pStreamThread->setQueuePolicy(m_iQueueDepth, m_eQueuePolicy);
+
+    m_qClientListMutex.lock();
     m_qClientList.insert(m_iNextClientId, t_pStreamThread);
+    m_qClientListMutex.unlock();
     ++m_iNextClientId;
 
     //when thread has finished it gets deleted
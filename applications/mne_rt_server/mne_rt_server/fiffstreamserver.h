@@ -41,6 +41,8 @@
 // MNE INCLUDES
 //=============================================================================================================
 
+#include "fiffstreamthread.h"
+
 #include <fiff/fiff_info.h>
 #include <rtCommand/commandmanager.h>
 
@@ -50,6 +52,7 @@
 // QT INCLUDES
 //=============================================================================================================
 
+#include <QMutex>
 #include <QStringList>
 #include <QTcpServer>
 
@@ -76,8 +79,6 @@ using namespace RTCOMMANDLIB;
 // FORWARD DECLARATIONS
 //=============================================================================================================
 
-class FiffStreamThread;
-
 //=============================================================================================================
 /**
 * DECLARE CLASS FiffStreamServer
@@ -123,6 +124,15 @@ public:
 
 //public slots: --> in Qt 5 not anymore declared as slot
     void forwardMeasInfo(qint32 ID, FiffInfo p_fiffInfo);
+
+    //=========================================================================================================
+    /**
+    * Encodes the raw buffer once into an immutable FIFF_DATA_BUFFER tag, preceded by a FIFF_MNE_RT_TIMESTAMP
+    * tag, and hands the shared encoded block to all clients. Connected directly to the active connector, i.e.
+    * runs in the connector's thread and does not wait for the server's event loop.
+    *
+    * @param[in] m_pMatRawData  The raw buffer
+    */
     void forwardRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData);
 
 signals:
@@ -132,7 +142,6 @@ signals:
     void stopMeasFiffStreamClient(qint32 ID);
 
     void remitMeasInfo(qint32 ID, FIFFLIB::FiffInfo p_fiffInfo);
-    void remitRawBuffer(QSharedPointer<Eigen::MatrixXf>);
 
     void closeFiffStreamServer();
 
@@ -181,11 +190,31 @@ private:
     */
     void comStopAll(Command p_command);
 
+    //=========================================================================================================
+    /**
+    * Prints and sends the send queue state of all clients
+    *
+    * @param[in] p_command  The lag command.
+    */
+    void comLag(Command p_command);
+
+    //=========================================================================================================
+    /**
+    * Sets queue depth and overflow policy of a client, or of all (present and future) clients
+    *
+    * @param[in] p_command  The queue command.
+    */
+    void comQueue(Command p_command);
+
     QByteArray parseToId(QString& p_sRawId, qint32& p_iParsedId);
 
     QMap<qint32, FiffStreamThread*> m_qClientList;
+    QMutex                          m_qClientListMutex; /**< Guards modifications of m_qClientList against the fan out in the connector thread. */
     qint32                          m_iNextClientId;
 
+    qint32                          m_iQueueDepth;      /**< Queue depth assigned to new clients. */
+    FiffStreamThread::QueuePolicy   m_eQueuePolicy;     /**< Overflow policy assigned to new clients. */
+
 };
 
 
@@ -60,6 +60,7 @@
 //=============================================================================================================
 
 #include <QtNetwork>
+#include <QtEndian>
 
 
 //*************************************************************************************************************
@@ -82,7 +83,16 @@ FiffStreamThread::FiffStreamThread(qint32 id, int socketDescriptor, QObject *par
 , m_iDataClientId(id)
 , m_sDataClientAlias(QString(""))
 , m_iSocketDescriptor(socketDescriptor)
+, m_iQueueDepth(32)
+, m_eQueuePolicy(DropOldest)
+, m_iQueuedRawBuffers(0)
+, m_iMaxQueuedRawBuffers(0)
+, m_iSentRawBuffers(0)
+, m_iDroppedRawBuffers(0)
+, m_iBytesToWrite(0)
+, m_bWakePending(false)
 , m_bIsSendingRawBuffer(false)
+, m_bSendTimestamps(false)
 , m_bIsRunning(false)
 {
 }
@@ -92,12 +102,17 @@ FiffStreamThread::FiffStreamThread(qint32 id, int socketDescriptor, QObject *par
 
 FiffStreamThread::~FiffStreamThread()
 {
-    //Remove from client list
+    //Remove from client list, afterwards no more raw buffers are fanned out to this client
     FiffStreamServer* t_pFiffStreamServer = qobject_cast<FiffStreamServer*>(this->parent());
     if(t_pFiffStreamServer)
+    {
+        t_pFiffStreamServer->m_qClientListMutex.lock();
         t_pFiffStreamServer->m_qClientList.remove(m_iDataClientId);
+        t_pFiffStreamServer->m_qClientListMutex.unlock();
+    }
 
     m_bIsRunning = false;
+    QThread::quit();
     QThread::wait();
 }
 
@@ -110,10 +125,13 @@ void FiffStreamThread::startMeas(qint32 ID)
     {
         qDebug() << "Activate raw buffer sending.";
 
-        m_qMutex.lock();
-        // ToDo send start meas
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QSharedPointer<QByteArray> t_pBlock(new QByteArray);
+        FiffStream t_FiffStreamOut(t_pBlock.data(), QIODevice::WriteOnly);
         t_FiffStreamOut.start_block(FIFFB_RAW_DATA);
+
+        post(t_pBlock, false);
+
+        m_qMutex.lock();
         m_bIsSendingRawBuffer = true;
         m_qMutex.unlock();
     }
@@ -129,11 +147,15 @@ void FiffStreamThread::stopMeas(qint32 ID)
     {
         qDebug() << "stop raw buffer sending.";
 
+        QSharedPointer<QByteArray> t_pBlock(new QByteArray);
         m_qMutex.lock();
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
-        t_FiffStreamOut.end_block(FIFFB_RAW_DATA);
         m_bIsSendingRawBuffer = false;
         m_qMutex.unlock();
+
+        FiffStream t_FiffStreamOut(t_pBlock.data(), QIODevice::WriteOnly);
+        t_FiffStreamOut.end_block(FIFFB_RAW_DATA);
+
+        post(t_pBlock, false);
     }
 }
 
@@ -164,6 +186,14 @@ void FiffStreamThread::parseCommand(FiffTag::SPtr p_pTag)
             printf("FiffStreamClient (ID %d): send client ID %d\r\n\n", m_iDataClientId, m_iDataClientId);
             writeClientId();
         }
+        else if(t_iCmd == MNE_RT_SET_TIMESTAMPS)
+        {
+            //
+            // Enable/Disable time stamps in front of raw buffers
+            //
+            m_bSendTimestamps = QString(p_pTag->mid(4, p_pTag->size()-4)).compare("1") == 0;
+            printf("FiffStreamClient (ID %d): time stamps %s\r\n\n", m_iDataClientId, m_bSendTimestamps ? "on" : "off");
+        }
         else
         {
             printf("FiffStreamClient (ID %d): unknown command\r\n\n", m_iDataClientId);
@@ -178,24 +208,97 @@ void FiffStreamThread::parseCommand(FiffTag::SPtr p_pTag)
 
 //*************************************************************************************************************
 
-void FiffStreamThread::sendRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData)
+void FiffStreamThread::setQueuePolicy(qint32 p_iDepth, QueuePolicy p_ePolicy)
 {
-    if(m_bIsSendingRawBuffer)
+    QMutexLocker t_locker(&m_qMutex);
+    m_iQueueDepth = p_iDepth > 0 ? p_iDepth : 1;
+    m_eQueuePolicy = p_ePolicy;
+}
+
+
+//*************************************************************************************************************
+
+FiffStreamThread::SendStatistics FiffStreamThread::getSendStatistics()
+{
+    QMutexLocker t_locker(&m_qMutex);
+    SendStatistics t_stats;
+    t_stats.iQueued = m_iQueuedRawBuffers;
+    t_stats.iMaxQueued = m_iMaxQueuedRawBuffers;
+    t_stats.iSent = m_iSentRawBuffers;
+    t_stats.iDropped = m_iDroppedRawBuffers;
+    t_stats.iBytesToWrite = m_iBytesToWrite;
+    return t_stats;
+}
+
+
+//*************************************************************************************************************
+
+void FiffStreamThread::post(const BlockConstSPtr& p_pBlock, bool p_bIsRawBuffer, qint32 p_iOffset)
+{
+    QMutexLocker t_locker(&m_qMutex);
+
+    if(p_bIsRawBuffer)
     {
-//        qDebug() << "Send RawBuffer to client";
+        //raw buffers which were on their way while sending got stopped
+        if(!m_bIsSendingRawBuffer)
+            return;
 
-        m_qMutex.lock();
+        if(m_iQueuedRawBuffers >= m_iQueueDepth)
+        {
+            if(m_eQueuePolicy == Disconnect)
+            {
+                if(m_bIsRunning)
+                    printf("FiffStreamClient (ID %d): lags more than %d buffers behind, disconnect\r\n\n", m_iDataClientId, m_iQueueDepth);
+                m_bIsRunning = false;
+                ++m_iDroppedRawBuffers;
+                QThread::quit();
+                return;
+            }
 
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
-        t_FiffStreamOut.write_float(FIFF_DATA_BUFFER,m_pMatRawData->data(),m_pMatRawData->rows()*m_pMatRawData->cols());
+            //
+            // Drop oldest raw buffer, control blocks stay in order
+            //
+            for(qint32 i = 0; i < m_qSendQueue.size(); ++i)
+            {
+                if(m_qSendQueue[i].bIsRawBuffer)
+                {
+                    m_qSendQueue.removeAt(i);
+                    --m_iQueuedRawBuffers;
+                    ++m_iDroppedRawBuffers;
+                    break;
+                }
+            }
+        }
 
-        m_qMutex.unlock();
+        ++m_iQueuedRawBuffers;
+        if(m_iQueuedRawBuffers > m_iMaxQueuedRawBuffers)
+            m_iMaxQueuedRawBuffers = m_iQueuedRawBuffers;
+    }
 
+    QueuedBlock t_block;
+    t_block.pBlock = p_pBlock;
+    t_block.iOffset = p_iOffset;
+    t_block.bIsRawBuffer = p_bIsRawBuffer;
+    m_qSendQueue.enqueue(t_block);
+
+    //
+    // One wake up per batch; the event loop drains everything queued until then
+    //
+    if(!m_bWakePending)
+    {
+        m_bWakePending = true;
+        t_locker.unlock();
+        emit blocksQueued();
     }
-//    else
-//    {
-//        qDebug() << "Send RawBuffer is not activated";
-//    }
+}
+
+
+//*************************************************************************************************************
+
+void FiffStreamThread::sendRawBuffer(const BlockConstSPtr& p_pRawBuffer, qint32 p_iTimestampSize)
+{
+    if(m_bIsSendingRawBuffer)
+        post(p_pRawBuffer, true, m_bSendTimestamps ? 0 : p_iTimestampSize);
 }
 
 
@@ -225,9 +328,8 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, FiffInfo p_fiffInfo)
 {
     if(ID == m_iDataClientId)
     {
-        m_qMutex.lock();
-
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QSharedPointer<QByteArray> t_pBlock(new QByteArray);
+        FiffStream t_FiffStreamOut(t_pBlock.data(), QIODevice::WriteOnly);
 
 //        qint32 init_info[2];
 //        init_info[0] = FIFF_MNE_RT_CLIENT_ID;
@@ -238,7 +340,8 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, FiffInfo p_fiffInfo)
 //FiffStream::start_writing_raw
 
         p_fiffInfo.writeToStream(&t_FiffStreamOut);
-        m_qMutex.unlock();
+
+        post(t_pBlock, false);
 
 //        qDebug() << "MeasInfo Blocksize: " << m_qSendBlock.size();
     }
@@ -249,9 +352,94 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, FiffInfo p_fiffInfo)
 
 void FiffStreamThread::writeClientId()
 {
-    FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+    QSharedPointer<QByteArray> t_pBlock(new QByteArray);
+    FiffStream t_FiffStreamOut(t_pBlock.data(), QIODevice::WriteOnly);
 
     t_FiffStreamOut.write_int(FIFF_MNE_RT_CLIENT_ID, &m_iDataClientId);
+
+    post(t_pBlock, false);
+}
+
+
+//*************************************************************************************************************
+
+void FiffStreamThread::writeQueued(QTcpSocket& p_qTcpSocket)
+{
+    //
+    // Blocks only move on to the socket while its write buffer is small; a stalled client therefore backs up in
+    // the bounded send queue instead of the unbounded socket buffer. bytesWritten calls in again for the rest.
+    //
+    const qint64 t_iMaxBytesToWrite = 4*1024*1024;
+
+    m_qMutex.lock();
+    m_bWakePending = false;
+    m_qMutex.unlock();
+
+    while(p_qTcpSocket.bytesToWrite() < t_iMaxBytesToWrite)
+    {
+        QueuedBlock t_block;
+        m_qMutex.lock();
+        if(!m_qSendQueue.isEmpty())
+        {
+            t_block = m_qSendQueue.dequeue();
+            if(t_block.bIsRawBuffer)
+            {
+                --m_iQueuedRawBuffers;
+                ++m_iSentRawBuffers;
+            }
+        }
+        m_qMutex.unlock();
+
+        if(t_block.pBlock.isNull())
+            break;
+
+        p_qTcpSocket.write(t_block.pBlock->constData() + t_block.iOffset, t_block.pBlock->size() - t_block.iOffset);
+    }
+
+    //hand it to the kernel right away instead of waiting for the next write notification
+    p_qTcpSocket.flush();
+
+    m_qMutex.lock();
+    m_iBytesToWrite = p_qTcpSocket.bytesToWrite();
+    m_qMutex.unlock();
+}
+
+
+//*************************************************************************************************************
+
+void FiffStreamThread::readTags(QTcpSocket& p_qTcpSocket)
+{
+    FiffStream t_FiffStreamIn(&p_qTcpSocket);
+
+    while(p_qTcpSocket.bytesAvailable() >= (int)sizeof(qint32)*4)
+    {
+        //
+        // Only consume a tag once it arrived completely, the rest follows with the next readyRead
+        //
+        QByteArray t_qByteArrayHeader = p_qTcpSocket.peek(sizeof(qint32)*4);
+        qint32 t_iSize = qFromBigEndian<qint32>((const uchar*)t_qByteArrayHeader.constData() + 2*sizeof(qint32));
+        if(t_iSize < 0)
+        {
+            printf("FiffStreamClient (ID %d): corrupted tag, disconnect\r\n\n", m_iDataClientId);
+            p_qTcpSocket.abort();
+            QThread::quit();
+            return;
+        }
+        if(p_qTcpSocket.bytesAvailable() < (qint64)sizeof(qint32)*4 + t_iSize)
+            break;
+
+        FiffTag::SPtr t_pTag;
+        FiffTag::read_tag_info(&t_FiffStreamIn, t_pTag, false);
+        FiffTag::read_tag_data(&t_FiffStreamIn, t_pTag);
+
+        //
+        // Parse the tag
+        //
+        if(t_pTag->kind == FIFF_MNE_RT_COMMAND)
+        {
+            parseCommand(t_pTag);
+        }
+    }
 }
 
 
@@ -302,8 +490,6 @@ void FiffStreamThread::run()
 
     connect(t_pParentServer, &FiffStreamServer::remitMeasInfo,
             this, &FiffStreamThread::sendMeasurementInfo);
-    connect(t_pParentServer, &FiffStreamServer::remitRawBuffer,
-            this, &FiffStreamThread::sendRawBuffer);
     connect(t_pParentServer, &FiffStreamServer::startMeasFiffStreamClient,
             this, &FiffStreamThread::startMeas);
     connect(t_pParentServer, &FiffStreamServer::stopMeasFiffStreamClient,
@@ -322,64 +508,33 @@ void FiffStreamThread::run()
                t_qTcpSocket.peerPort());
     }
 
-    FiffStream t_FiffStreamIn(&t_qTcpSocket);
-
-//    int i = 0;
-    while(t_qTcpSocket.state() != QAbstractSocket::UnconnectedState && m_bIsRunning)
-    {
-        //
-        // Write available data
-        //
-        m_qMutex.lock();
-        qint32 t_iBlockSize = m_qSendBlock.size();
-//        qDebug() << "data available" << t_iBlockSize;
-        if(t_iBlockSize > 0)
-        {
-            qint32 t_iBytesWritten = t_qTcpSocket.write(m_qSendBlock);
-//            qDebug() << ++i<< "[wrote bytes] " << t_iBytesWritten;
-            t_qTcpSocket.waitForBytesWritten();
-            if(t_iBytesWritten == t_iBlockSize)
-            {
-                m_qSendBlock.clear();
-            }
-            else
-            {
-                //we have to store bytes which were not written to the socket, due to writing limit
-                //m_qSendBlock = m_qSendBlock.mid(t_iBytesWritten, t_iBlockSize-t_iBytesWritten);
-                m_qSendBlock.remove(0,t_iBytesWritten); //higher performance then mid
-            }
-        }
-        m_qMutex.unlock();
-
-        //
-        // Read: Wait 10ms for incomming tag header, read and continue
-        //
-        t_qTcpSocket.waitForReadyRead(10);
-
-        if (t_qTcpSocket.bytesAvailable() >= (int)sizeof(qint32)*4)
-        {
-//            qDebug() << "goes to read bytes " ;
-            FiffTag::SPtr t_pTag;
-            FiffTag::read_tag_info(&t_FiffStreamIn, t_pTag, false);
-
-            //
-            // wait until tag size data are available and read the data
-            //
-            while (t_qTcpSocket.bytesAvailable() < t_pTag->size())
-            {
-                t_qTcpSocket.waitForReadyRead(10);
-            }
-            FiffTag::read_tag_data(&t_FiffStreamIn, t_pTag);
-
-            //
-            // Parse the tag
-            //
-            if(t_pTag->kind == FIFF_MNE_RT_COMMAND)
-            {
-                parseCommand(t_pTag);
-            }
-        }
-    }
+    //Small raw buffers must not wait for Nagle's algorithm
+    t_qTcpSocket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+    //
+    // Event driven I/O: the socket lives in this thread, the lambdas below are executed by this thread's event loop
+    //
+    connect(this, &FiffStreamThread::blocksQueued, &t_qTcpSocket, [&t_qTcpSocket, this](){
+        writeQueued(t_qTcpSocket);
+    }, Qt::QueuedConnection);
+    connect(&t_qTcpSocket, &QTcpSocket::bytesWritten, &t_qTcpSocket, [&t_qTcpSocket, this](){
+        writeQueued(t_qTcpSocket);
+    });
+    connect(&t_qTcpSocket, &QTcpSocket::readyRead, &t_qTcpSocket, [&t_qTcpSocket, this](){
+        readTags(t_qTcpSocket);
+    });
+    connect(&t_qTcpSocket, &QTcpSocket::disconnected, &t_qTcpSocket, [this](){
+        QThread::quit();
+    });
+
+    //anything which was posted before the connections were established
+    writeQueued(t_qTcpSocket);
+    readTags(t_qTcpSocket);
+
+    if(m_bIsRunning && t_qTcpSocket.state() != QAbstractSocket::UnconnectedState)
+        exec();
+
+    disconnect(this, &FiffStreamThread::blocksQueued, 0, 0);
 
     t_qTcpSocket.disconnectFromHost();
     if(t_qTcpSocket.state() != QAbstractSocket::UnconnectedState)
@@ -53,6 +53,7 @@
 #include <QThread>
 #include <QTcpSocket>
 #include <QMutex>
+#include <QQueue>
 #include <QSharedPointer>
 
 
@@ -81,10 +82,40 @@ class FiffStreamThread : public QThread
 {
     Q_OBJECT
 public:
+    typedef QSharedPointer<const QByteArray> BlockConstSPtr;   /**< Immutable, already encoded FIFF tag(s), shared between all clients. */
+
+    //=========================================================================================================
+    /**
+    * What to do when a client lags more than its queue depth behind.
+    */
+    enum QueuePolicy
+    {
+        DropOldest,     /**< Drop the oldest queued raw buffer. */
+        Disconnect      /**< Disconnect the client. */
+    };
+
+    //=========================================================================================================
+    /**
+    * Send queue state of a client.
+    */
+    struct SendStatistics
+    {
+        qint32 iQueued;         /**< Raw buffers currently waiting to be sent. */
+        qint32 iMaxQueued;      /**< Largest number of waiting raw buffers seen so far. */
+        qint64 iSent;           /**< Raw buffers handed to the socket. */
+        qint64 iDropped;        /**< Raw buffers dropped due to the queue depth. */
+        qint64 iBytesToWrite;   /**< Bytes pending in the socket write buffer. */
+    };
+
     FiffStreamThread(qint32 id, int socketDescriptor, QObject *parent);
 
     ~FiffStreamThread();
 
+    //=========================================================================================================
+    /**
+    * Runs the client's socket in this thread's event loop. Queued blocks are written as soon as they are posted
+    * or the socket accepts more data, incoming commands are parsed as soon as a complete tag arrived.
+    */
     void run();
 
     inline qint32 getID();
@@ -98,21 +129,102 @@ public:
 
     void writeClientId();
 
+    //=========================================================================================================
+    /**
+    * Sets the number of raw buffers which may wait for this client and what happens if it falls further behind.
+    *
+    * @param[in] p_iDepth   Maximal number of queued raw buffers (>= 1)
+    * @param[in] p_ePolicy  Overflow policy
+    */
+    void setQueuePolicy(qint32 p_iDepth, QueuePolicy p_ePolicy);
+
+    //=========================================================================================================
+    /**
+    * Returns the current send queue state of this client.
+    *
+    * @return the send statistics
+    */
+    SendStatistics getSendStatistics();
+
+    //=========================================================================================================
+    /**
+    * Queues an encoded raw buffer for this client, if it is set to accept raw buffers. Thread safe, called by
+    * FiffStreamServer from the connector's thread.
+    *
+    * @param[in] p_pRawBuffer       Encoded time stamp tag followed by the FIFF_DATA_BUFFER tag
+    * @param[in] p_iTimestampSize   Size of the leading time stamp tag, skipped unless the client requested
+    *                               time stamps
+    */
+    void sendRawBuffer(const BlockConstSPtr& p_pRawBuffer, qint32 p_iTimestampSize);
+
 //    void sendData(QTcpSocket& p_qTcpSocket);
 
 signals:
     void error(QTcpSocket::SocketError socketError);
 
+    //=========================================================================================================
+    /**
+    * Emitted when blocks were posted to an empty send queue; wakes up the client's event loop.
+    */
+    void blocksQueued();
+
 private:
     qint32 m_iDataClientId;
     QString m_sDataClientAlias;
 
     int m_iSocketDescriptor;
 
+    //=========================================================================================================
+    /**
+    * Queued block, control blocks (measurement info, block start/end, client id) are never dropped.
+    */
+    struct QueuedBlock
+    {
+        BlockConstSPtr pBlock;
+        qint32 iOffset;
+        bool bIsRawBuffer;
+    };
+
+    //=========================================================================================================
+    /**
+    * Appends an encoded block to the send queue and wakes up the event loop if the queue was empty.
+    *
+    * @param[in] p_pBlock       The encoded block
+    * @param[in] p_bIsRawBuffer Whether the block is a raw buffer, i.e. may be dropped
+    * @param[in] p_iOffset      Number of leading bytes of the block which are not sent
+    */
+    void post(const BlockConstSPtr& p_pBlock, bool p_bIsRawBuffer, qint32 p_iOffset = 0);
+
+    //=========================================================================================================
+    /**
+    * Moves queued blocks to the socket, as long as its write buffer is small.
+    *
+    * @param[in] p_qTcpSocket   The client socket
+    */
+    void writeQueued(QTcpSocket& p_qTcpSocket);
+
+    //=========================================================================================================
+    /**
+    * Reads and parses all complete tags available at the socket.
+    *
+    * @param[in] p_qTcpSocket   The client socket
+    */
+    void readTags(QTcpSocket& p_qTcpSocket);
+
     QMutex m_qMutex;
-    QByteArray m_qSendBlock;
+    QQueue<QueuedBlock> m_qSendQueue;   /**< Blocks waiting to be handed to the socket. */
+
+    qint32 m_iQueueDepth;               /**< Maximal number of queued raw buffers. */
+    QueuePolicy m_eQueuePolicy;         /**< Overflow policy. */
+    qint32 m_iQueuedRawBuffers;         /**< Raw buffers in m_qSendQueue. */
+    qint32 m_iMaxQueuedRawBuffers;      /**< High water mark of m_iQueuedRawBuffers. */
+    qint64 m_iSentRawBuffers;           /**< Raw buffers handed to the socket. */
+    qint64 m_iDroppedRawBuffers;        /**< Raw buffers dropped due to the queue depth. */
+    qint64 m_iBytesToWrite;             /**< Socket write backlog, updated by the send loop. */
+    bool m_bWakePending;                /**< A blocksQueued wake up is on its way to the event loop. */
 
     bool m_bIsSendingRawBuffer;
+    bool m_bSendTimestamps;             /**< Client requested FIFF_MNE_RT_TIMESTAMP tags in front of raw buffers. */
 
     bool m_bIsRunning;
 
@@ -120,7 +232,6 @@ private:
     void startMeas(qint32 ID);
     void stopMeas(qint32 ID);
     void sendMeasurementInfo(qint32 ID, FiffInfo p_fiffInfo);
-    void sendRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData);
     //void readToBuffer1();
 //    void readProc(QTcpSocket& p_qTcpSocket);
 };
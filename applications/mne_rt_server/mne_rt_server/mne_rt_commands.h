@@ -51,6 +51,7 @@ namespace RTSERVER
 
 #define MNE_RT_GET_CLIENT_ID        1       /**< Request client id at mne_rt_server */
 #define MNE_RT_SET_CLIENT_ALIAS     2       /**< Set client alias at mne_rt_server */
+#define MNE_RT_SET_TIMESTAMPS       3       /**< Enable ("1") or disable ("0") FIFF_MNE_RT_TIMESTAMP tags in front of raw buffers */
 
 } // NAMESPACE
 
@@ -332,6 +332,10 @@ void MNERTServer::init()
             "           \"description\": \"Prints and sends this list.\","
             "           \"parameters\": {}"
             "        },"
+            "       \"lag\": {"
+            "           \"description\": \"Prints and sends the send queue state (queued, max queued, sent and dropped raw buffers) of all FiffStreamClients.\","
+            "           \"parameters\": {}"
+            "        },"
             "       \"measinfo\": {"
             "           \"description\": \"Sends the measurement info to the specified FiffStreamClient.\","
             "           \"parameters\": {"
@@ -341,6 +345,23 @@ void MNERTServer::init()
             "               }"
             "           }"
             "       },"
+            "       \"queue\": {"
+            "           \"description\": \"Sets how many raw buffers may wait for a FiffStreamClient and whether the oldest is dropped or the client is disconnected when it lags further behind.\","
+            "           \"parameters\": {"
+            "               \"id\": {"
+            "                   \"description\": \"ID/Alias or all\","
+            "                   \"type\": \"QString\" "
+            "               },"
+            "               \"depth\": {"
+            "                   \"description\": \"Queue depth in raw buffers\","
+            "                   \"type\": \"int\" "
+            "               },"
+            "               \"policy\": {"
+            "                   \"description\": \"drop or disconnect\","
+            "                   \"type\": \"QString\" "
+            "               }"
+            "           }"
+            "        },"
             "       \"selcon\": {"
             "           \"description\": \"Selects a new connector, if a measurement is running it will be stopped.\","
             "           \"parameters\": {"
@@ -40,7 +40,7 @@ TEMPLATE = app
 QT += network concurrent
 QT -= gui
 
-CONFIG   += console
+CONFIG   += console c++11
 CONFIG   -= app_bundle
 
 TARGET = mne_rt_server
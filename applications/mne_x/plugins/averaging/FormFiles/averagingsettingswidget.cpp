@@ -89,5 +89,17 @@ AveragingSettingsWidget::AveragingSettingsWidget(Averaging *toolbox, QWidget *pa
     connect(m_pSpinBoxPostStimSamples, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), m_pAveragingToolbox, &Averaging::changePostStim);
     t_pGridLayout->addWidget(m_pSpinBoxPostStimSamples,3,2,1,1);
 
+    QLabel* t_pLabelStimCode = new QLabel;
+    t_pLabelStimCode->setText("Trigger Code (STI 014/101)");
+    t_pGridLayout->addWidget(t_pLabelStimCode,4,0,1,2);
+
+    m_pSpinBoxStimCode = new QSpinBox;
+    m_pSpinBoxStimCode->setMinimum(1);
+    m_pSpinBoxStimCode->setMaximum(65535);
+    m_pSpinBoxStimCode->setSingleStep(1);
+    m_pSpinBoxStimCode->setValue(m_pAveragingToolbox->m_iStimCode);
+    connect(m_pSpinBoxStimCode, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), m_pAveragingToolbox, &Averaging::changeStimCode);
+    t_pGridLayout->addWidget(m_pSpinBoxStimCode,4,2,1,1);
+
     this->setLayout(t_pGridLayout);
 }
@@ -58,6 +58,7 @@ private:
     QSpinBox* m_pSpinBoxNumAverages;
     QSpinBox* m_pSpinBoxPreStimSamples;
     QSpinBox* m_pSpinBoxPostStimSamples;
+    QSpinBox* m_pSpinBoxStimCode;
 };
 
 } // NAMESPACE
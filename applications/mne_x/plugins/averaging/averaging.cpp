@@ -76,13 +76,14 @@ using namespace XMEASLIB;
 Averaging::Averaging()
 : m_pAveragingInput(NULL)
 //, m_pAveragingOutput(NULL)
-, m_pAveragingBuffer(CircularMatrixBuffer<double>::SPtr())
+, m_pAveragingBuffer(RingMatrixBuffer<double>::SPtr())
 , m_bIsRunning(false)
 , m_bProcessData(false)
 , m_iPreStimSamples(400)
 , m_iPostStimSamples(750)
 , m_iNumAverages(10)
 , m_iStimChan(0)
+, m_iStimCode(1)
 , m_pAveragingWidget(AveragingSettingsWidget::SPtr())
 , m_pActionShowAdjustment(Q_NULLPTR)
 #ifdef DEBUG_AVERAGING
@@ -133,6 +134,7 @@ void Averaging::init()
     m_iPostStimSamples = settings.value(QString("Plugin/%1/postStimSamples").arg(this->getName()), 750).toInt();
     m_iNumAverages = settings.value(QString("Plugin/%1/numAverages").arg(this->getName()), 10).toInt();
     m_iStimChan = settings.value(QString("Plugin/%1/stimChannel").arg(this->getName()), 0).toInt();
+    m_iStimCode = settings.value(QString("Plugin/%1/stimCode").arg(this->getName()), 1).toInt();
 
     // Input
     m_pAveragingInput = PluginInputData<NewRealTimeMultiSampleArray>::create(this, "AveragingIn", "Averaging input data");
@@ -149,7 +151,7 @@ void Averaging::init()
 
     //Delete Buffer - will be initailzed with first incoming data
     if(!m_pAveragingBuffer.isNull())
-        m_pAveragingBuffer = CircularMatrixBuffer<double>::SPtr();
+        m_pAveragingBuffer = RingMatrixBuffer<double>::SPtr();
 }
 
 
@@ -165,6 +167,7 @@ void Averaging::unload()
     settings.setValue(QString("Plugin/%1/postStimSamples").arg(this->getName()), m_iPostStimSamples);
     settings.setValue(QString("Plugin/%1/numAverages").arg(this->getName()), m_iNumAverages);
     settings.setValue(QString("Plugin/%1/stimChannel").arg(this->getName()), m_iStimChan);
+    settings.setValue(QString("Plugin/%1/stimCode").arg(this->getName()), m_iStimCode);
 }
 
 
@@ -259,6 +262,18 @@ void Averaging::changeStimChannel(qint32 index)
 //    qDebug() << "Averaging::changeStimChannel(qint32 index)" << m_pAveragingWidget->m_pComboBoxChSelection->currentData().toInt();
 }
 
+
+//*************************************************************************************************************
+
+void Averaging::changeStimCode(qint32 code)
+{
+    QMutexLocker locker(&m_qMutex);
+    m_iStimCode = code;
+
+    //drop pending averages of the previous code
+    m_qVecEvokedData.clear();
+}
+
 //*************************************************************************************************************
 
 void Averaging::changePreStim(qint32 samples)
@@ -311,7 +326,7 @@ void Averaging::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
     {
         //Check if buffer initialized
         if(!m_pAveragingBuffer)
-            m_pAveragingBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
+            m_pAveragingBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
 
         //Fiff information
         if(!m_pFiffInfo)
@@ -334,13 +349,10 @@ void Averaging::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
 
         if(m_bProcessData)
         {
-            MatrixXd t_mat(pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize());
-
-            for(qint32 i = 0; i < pRTMSA->getMultiArraySize(); ++i)
-                t_mat.col(i) = pRTMSA->getMultiSampleArray()[i];
-
+            NewRealTimeMultiSampleArray::BlockConstSPtr t_pMat = pRTMSA->getMultiSampleArray();
 
 #ifdef DEBUG_AVERAGING
+            MatrixXd t_mat = *t_pMat;
             qsrand(time(NULL)+m_iTestCount);
 
             t_mat = MatrixXd::Zero(t_mat.rows(), t_mat.cols());
@@ -359,8 +371,11 @@ void Averaging::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
                 ++m_iTestCount2;
             }
             ++m_iTestCount;
-#endif
+
             m_pAveragingBuffer->push(&t_mat);
+#else
+            m_pAveragingBuffer->push(t_pMat.data());
+#endif
         }
     }
 }
@@ -372,14 +387,15 @@ void Averaging::appendEvoked(FiffEvoked::SPtr p_pEvoked)
 {
 //    qDebug() << "void Averaging::appendEvoked";// << p_pEvoked->comment;
 //    qDebug() << p_pEvoked->comment;
+    QMutexLocker locker(&m_qMutex);
     QString t_sStimulusChannel = m_pFiffInfo->chs[m_qListStimChs[m_iStimChan]].ch_name;
 
-    if(p_pEvoked->comment == t_sStimulusChannel)
+    //composite stimulus channels (STI 014) deliver one average per trigger code, tagged "<channel>:<code>" -> only
+    //the selected code goes to the output, otherwise the averages of different codes alternate in one display
+    if(p_pEvoked->comment == t_sStimulusChannel || p_pEvoked->comment == t_sStimulusChannel + QString(":%1").arg(m_iStimCode))
     {
 //        qDebug()<< "append" << p_pEvoked->comment << "=" << t_sStimulusChannel;
-        m_qMutex.lock();
         m_qVecEvokedData.push_back(p_pEvoked);
-        m_qMutex.unlock();
 //        qDebug() << "append after" << m_qVecEvokedData.size();
     }
 }
@@ -418,6 +434,8 @@ void Averaging::run()
 
     m_pRtAve->start();
 
+    MatrixXd rawSegment;
+
     while(true)
     {
         {
@@ -432,11 +450,10 @@ void Averaging::run()
             doProcessing = m_bProcessData;
         }
 
-        if(doProcessing)
+        //Timed pop - lets the loop notice a stop request instead of blocking in the buffer
+        if(doProcessing && m_pAveragingBuffer->tryPop(rawSegment, 100))
         {
             /* Dispatch the inputs */
-            MatrixXd rawSegment = m_pAveragingBuffer->pop();
-
             m_pRtAve->append(rawSegment);
 
             m_qMutex.lock();
@@ -45,7 +45,7 @@
 #include "averaging_global.h"
 
 #include <mne_x/Interfaces/IAlgorithm.h>
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 #include <xMeas/newrealtimemultisamplearray.h>
 #include <xMeas/realtimeevoked.h>
 #include <rtInv/rtave.h>
@@ -163,6 +163,14 @@ public:
 
     void changeStimChannel(qint32 index);
 
+    //=========================================================================================================
+    /**
+    * Selects the trigger code of a composite stimulus channel (STI 014, STI 101) whose average is published.
+    *
+    * @param[in] code   The trigger code
+    */
+    void changeStimCode(qint32 code);
+
     void changePreStim(qint32 samples);
 
     void changePostStim(qint32 samples);
@@ -200,7 +208,7 @@ private:
     FiffInfo::SPtr  m_pFiffInfo;        /**< Fiff measurement info.*/
     QList<qint32> m_qListStimChs;       /**< Stimulus channels.*/
 
-    CircularMatrixBuffer<double>::SPtr   m_pAveragingBuffer;      /**< Holds incoming data.*/
+    RingMatrixBuffer<double>::SPtr       m_pAveragingBuffer;      /**< Holds incoming data.*/
 
     bool m_bIsRunning;      /**< If source lab is running */
     bool m_bProcessData;    /**< If data should be received for processing */
@@ -213,6 +221,7 @@ private:
     qint32 m_iNumAverages;
 
     qint32 m_iStimChan;
+    qint32 m_iStimCode;     /**< Published trigger code of a composite stimulus channel.*/
 
     QVector<FiffEvoked::SPtr>   m_qVecEvokedData;   /**< Evoked data set */
 
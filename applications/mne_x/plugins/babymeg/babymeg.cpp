@@ -438,8 +438,7 @@ void BabyMEG::run()
             {
                 //std::cout << "matValue" << matValue.block(0,0,2,2) << std::endl;
                 //emit values
-                for(qint32 i = 0; i < matValue.cols(); ++i)
-                    m_pRTMSABabyMEG->data()->setValue(matValue.col(i).cast<double>());
+                m_pRTMSABabyMEG->data()->setValue(MatrixXd(matValue.cast<double>()));
             }
         }
     }
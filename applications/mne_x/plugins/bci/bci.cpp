@@ -408,12 +408,7 @@ void BCI::updateSensor(XMEASLIB::NewMeasurement::SPtr pMeasurement)
         // Only process data when fiff info has been initialised in run() method
         if(m_bProcessData)
         {
-            MatrixXd t_mat(pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize());
-
-            for(unsigned char i = 0; i < pRTMSA->getMultiArraySize(); ++i)
-                t_mat.col(i) = pRTMSA->getMultiSampleArray()[i];
-
-            m_pBCIBuffer_Sensor->push(&t_mat);
+            m_pBCIBuffer_Sensor->push(pRTMSA->getMultiSampleArray().data());
         }
     }
 }
@@ -454,9 +449,20 @@ void BCI::applyMeanCorrectionConcurrently(QPair<int, RowVectorXd> &chdata)
 
 //*************************************************************************************************************
 
-void BCI::applyFilterOperatorConcurrently(QPair<int, RowVectorXd> &chdata)
+void BCI::applyFilterOperator(QList< QPair<int,RowVectorXd> > &rows)
 {
-    chdata.second = m_filterOperator->applyFFTFilter(chdata.second);
+    if(rows.isEmpty())
+        return;
+
+    MatrixXd t_matRows(rows.size(), rows.at(0).second.cols());
+    for(int i = 0; i < rows.size(); i++)
+        t_matRows.row(i) = rows.at(i).second;
+
+    // Rows are filtered in one chunk per thread, each chunk shares one FFT plan
+    t_matRows = m_filterOperator->applyFFTFilter(t_matRows);
+
+    for(int i = 0; i < rows.size(); i++)
+        rows[i].second = t_matRows.row(i);
 }
 
 
@@ -708,19 +714,13 @@ void BCI::BCIOnSensorLevel()
                     m_bTriggerActivated = true;
                 }
 
-                // ----5---- Filter data in m_matSlidingWindowSensor concurrently using map()
+                // ----5---- Filter data in m_matSlidingWindowSensor
                 //cout<<"----5----"<<endl;
                 // TODO: work only on qlMatrixRows -> filteredRows doesnt need to be created -> more efficient
                 QList< QPair<int,RowVectorXd> > filteredRows = qlMatrixRows;
 
                 if(m_bUseFilter)
-                {
-                    QFuture<void> futureFilter = QtConcurrent::map(filteredRows,[this](QPair<int,RowVectorXd>& chdata) {
-                        applyFilterOperatorConcurrently(chdata);
-                    });
-
-                    futureFilter.waitForFinished();
-                }
+                    applyFilterOperator(filteredRows);
 
 //                    // Write data before and after filtering to debug file
 //                    for(int i=0; i<qlMatrixRows.size(); i++)
@@ -844,13 +844,7 @@ void BCI::BCIOnSensorLevel()
                 QList< QPair<int,RowVectorXd> > filteredRows = qlMatrixRows;
 
                 if(m_bUseFilter)
-                {
-                    QFuture<void> futureFilter = QtConcurrent::map(filteredRows,[this](QPair<int,RowVectorXd>& chdata) {
-                        applyFilterOperatorConcurrently(chdata);
-                    });
-
-                    futureFilter.waitForFinished();
-                }
+                    applyFilterOperator(filteredRows);
 
                 for(int i = 0; i<filteredRows.at(0).second.cols() ; i++)
                 {
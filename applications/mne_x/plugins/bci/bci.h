@@ -184,11 +184,11 @@ protected:
 
     //=========================================================================================================
     /**
-    * Calculates the filtered signal of chdata
+    * Filters all rows in one block with the filter operator
     *
-    * @param [in] chdata QPair with number of the row and the data samples as a RowVectorXd.
+    * @param [in, out] rows QList of QPairs with number of the row and the data samples as a RowVectorXd.
     */
-    void applyFilterOperatorConcurrently(QPair<int,RowVectorXd> &chdata);
+    void applyFilterOperator(QList< QPair<int,RowVectorXd> > &rows);
 
     //=========================================================================================================
     /**
@@ -72,7 +72,7 @@ Covariance::Covariance()
 , m_bProcessData(false)
 , m_pCovarianceInput(NULL)
 , m_pCovarianceOutput(NULL)
-, m_pCovarianceBuffer(CircularMatrixBuffer<double>::SPtr())
+, m_pCovarianceBuffer(RingMatrixBuffer<double>::SPtr())
 , m_iEstimationSamples(5000)
 {
     m_pActionShowAdjustment = new QAction(QIcon(":/images/covadjustments.png"), tr("Covariance Adjustments"),this);
@@ -126,7 +126,7 @@ void Covariance::init()
 
     //Delete Buffer - will be initailzed with first incoming data
     if(!m_pCovarianceBuffer.isNull())
-        m_pCovarianceBuffer = CircularMatrixBuffer<double>::SPtr();
+        m_pCovarianceBuffer = RingMatrixBuffer<double>::SPtr();
 }
 
 
@@ -219,7 +219,7 @@ void Covariance::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
     {
         //Check if buffer initialized
         if(!m_pCovarianceBuffer)
-            m_pCovarianceBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
+            m_pCovarianceBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
 
         //Fiff information
         if(!m_pFiffInfo)
@@ -231,12 +231,7 @@ void Covariance::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
 
         if(m_bProcessData)
         {
-            MatrixXd t_mat(pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize());
-
-            for(qint32 i = 0; i < pRTMSA->getMultiArraySize(); ++i)
-                t_mat.col(i) = pRTMSA->getMultiSampleArray()[i];
-
-            m_pCovarianceBuffer->push(&t_mat);
+            m_pCovarianceBuffer->push(pRTMSA->getMultiSampleArray().data());
         }
     }
 }
@@ -290,13 +285,13 @@ void Covariance::run()
     //
     m_bProcessData = true;
 
+    MatrixXd t_mat;
+
     while (m_bIsRunning)
     {
-        if(m_bProcessData)
+        //Timed pop - lets the loop notice a stop request instead of blocking in the buffer
+        if(m_bProcessData && m_pCovarianceBuffer->tryPop(t_mat, 100))
         {
-            /* Dispatch the inputs */
-            MatrixXd t_mat = m_pCovarianceBuffer->pop();
-
             //Add to covariance estimation
             m_pRtCov->append(t_mat);
 
@@ -45,7 +45,7 @@
 #include "covariance_global.h"
 
 #include <mne_x/Interfaces/IAlgorithm.h>
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 #include <xMeas/newrealtimemultisamplearray.h>
 #include <xMeas/realtimecov.h>
 #include <rtInv/rtcov.h>
@@ -178,7 +178,7 @@ private:
 
     FiffInfo::SPtr  m_pFiffInfo;                                /**< Fiff measurement info.*/
 
-    CircularMatrixBuffer<double>::SPtr   m_pCovarianceBuffer;   /**< Holds incoming data.*/
+    RingMatrixBuffer<double>::SPtr       m_pCovarianceBuffer;   /**< Holds incoming data.*/
 
     RtCov::SPtr m_pRtCov;                       /**< Real-time covariance. */
 
@@ -583,8 +583,7 @@ void EEGoSports::run()
             }
 
             //emit values to real time multi sample array
-            for(qint32 i = 0; i < matValue.cols(); ++i)
-                m_pRMTSA_EEGoSports->data()->setValue(matValue.col(i).cast<double>());
+            m_pRMTSA_EEGoSports->data()->setValue(MatrixXd(matValue.cast<double>()));
         }
     }
 
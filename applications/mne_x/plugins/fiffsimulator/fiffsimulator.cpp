@@ -405,7 +405,6 @@ void FiffSimulator::run()
 //        std::cout << "Mat Value\n" << matValue.row(306) << std::endl;
 
         //emit values
-        for(qint32 i = 0; i < matValue.cols(); ++i)
-            m_pRTMSA_FiffSimulator->data()->setValue(matValue.col(i).cast<double>());
+        m_pRTMSA_FiffSimulator->data()->setValue(MatrixXd(matValue.cast<double>()));
     }
 }
@@ -91,11 +91,16 @@ MNESetupWidget::MNESetupWidget(MNE* toolbox, QWidget *parent)
     else
         ui.m_qLabel_surfaceStat->setText("loaded");
 
+    ui.m_qDoubleSpinBox_SNR->setValue(m_pMNE->m_dSNR);
+    ui.m_qComboBox_Method->setCurrentText(m_pMNE->m_sMethod);
+
     connect(ui.m_qPushButton_About, &QPushButton::released, this, &MNESetupWidget::showAboutDialog);
     connect(ui.m_qPushButton_FwdFileDialog, &QPushButton::released, this, &MNESetupWidget::showFwdFileDialog);
     connect(ui.m_qPushButton_AtlasDirDialog, &QPushButton::released, this, &MNESetupWidget::showAtlasDirDialog);
     connect(ui.m_qPushButton_SurfaceDirDialog, &QPushButton::released, this, &MNESetupWidget::showSurfaceDirDialog);
     connect(ui.m_qPushButonStartClustering, &QPushButton::released, this, &MNESetupWidget::clusteringTriggered);
+    connect(ui.m_qDoubleSpinBox_SNR, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), this, &MNESetupWidget::snrChanged);
+    connect(ui.m_qComboBox_Method, static_cast<void (QComboBox::*)(const QString &)>(&QComboBox::currentIndexChanged), this, &MNESetupWidget::methodChanged);
 }
 
 
@@ -220,3 +225,19 @@ void MNESetupWidget::showSurfaceDirDialog()
         ui.m_qLabel_surfaceStat->setText("not loaded");
     }
 }
+
+
+//*************************************************************************************************************
+
+void MNESetupWidget::snrChanged(double p_dSNR)
+{
+    m_pMNE->setSNR(p_dSNR);
+}
+
+
+//*************************************************************************************************************
+
+void MNESetupWidget::methodChanged(const QString &p_sMethod)
+{
+    m_pMNE->setMethod(p_sMethod);
+}
@@ -149,6 +149,22 @@ private:
     */
     void showSurfaceDirDialog();
 
+    //=========================================================================================================
+    /**
+    * Forwards a changed SNR to the MNE plugin
+    *
+    * @param[in] p_dSNR     the new SNR
+    */
+    void snrChanged(double p_dSNR);
+
+    //=========================================================================================================
+    /**
+    * Forwards a changed inverse method to the MNE plugin
+    *
+    * @param[in] p_sMethod  the new method ("MNE" | "dSPM" | "sLORETA")
+    */
+    void methodChanged(const QString &p_sMethod);
+
 
     MNE* m_pMNE;            /**< Holds a pointer to corresponding DummyToolbox.*/
 
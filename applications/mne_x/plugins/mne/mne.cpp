@@ -50,6 +50,7 @@
 
 #include <QtCore/QtPlugin>
 #include <QtConcurrent>
+#include <QStandardPaths>
 #include <QDebug>
 
 
@@ -78,6 +79,8 @@ MNE::MNE()
 , m_sSurfaceDir("./MNE-sample-data/subjects/sample/surf")
 , m_iNumAverages(10)
 , m_iDownSample(4)
+, m_dSNR(3.0)
+, m_sMethod("dSPM")
 {
 
 }
@@ -184,7 +187,9 @@ void MNE::doClustering()
 
     m_qMutex.lock();
     m_bFinishedClustering = false;
-    m_pClusteredFwd = MNEForwardSolution::SPtr(new MNEForwardSolution(m_pFwd->cluster_forward_solution(*m_pAnnotationSet.data(), 40)));
+    MatrixXd t_D;
+    QString t_sCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/clusteredForward";
+    m_pClusteredFwd = MNEForwardSolution::SPtr(new MNEForwardSolution(m_pFwd->cluster_forward_solution(*m_pAnnotationSet.data(), 40, t_D, defaultCov, defaultInfo, t_sCacheDir)));
     m_qMutex.unlock();
 
     finishedClustering();
@@ -329,20 +334,47 @@ void MNE::updateRTE(XMEASLIB::NewMeasurement::SPtr pMeasurement)
 
 void MNE::updateInvOp(MNEInverseOperator::SPtr p_pInvOp)
 {
-    m_pInvOp = p_pInvOp;
+    QMutexLocker locker(&m_qMutex);
+
+    //one estimator per operator - the kernels it caches are only valid for this operator
+    if(p_pInvOp == m_pInvOp && m_pMinimumNorm)
+        return;
 
-    double snr = 3.0;
-    double lambda2 = 1.0 / pow(snr, 2); //ToDO estimate lambda using covariance
+    m_pInvOp = p_pInvOp;
 
-    QString method("dSPM"); //"MNE" | "dSPM" | "sLORETA"
+    double lambda2 = 1.0 / pow(m_dSNR, 2); //ToDO estimate lambda using covariance
 
-    m_qMutex.lock();
-    m_pMinimumNorm = MinimumNorm::SPtr(new MinimumNorm(*m_pInvOp.data(), lambda2, method));
+    m_pMinimumNorm = MinimumNorm::SPtr(new MinimumNorm(*m_pInvOp.data(), lambda2, m_sMethod));
+    m_pMinimumNorm->setKernelPrecision(MinimumNorm::SinglePrecision);
     //
     //   Set up the inverse according to the parameters
     //
     m_pMinimumNorm->doInverseSetup(m_iNumAverages,false);
-    m_qMutex.unlock();
+}
+
+
+//*************************************************************************************************************
+
+void MNE::setSNR(double p_dSNR)
+{
+    QMutexLocker locker(&m_qMutex);
+    m_dSNR = p_dSNR;
+
+    //only rescales the diagonal of the current kernel or hits the kernel cache
+    if(m_pMinimumNorm)
+        m_pMinimumNorm->setRegularization(1.0 / pow(m_dSNR, 2));
+}
+
+
+//*************************************************************************************************************
+
+void MNE::setMethod(const QString &p_sMethod)
+{
+    QMutexLocker locker(&m_qMutex);
+    m_sMethod = p_sMethod;
+
+    if(m_pMinimumNorm)
+        m_pMinimumNorm->setMethod(m_sMethod);
 }
 
 
@@ -419,8 +451,11 @@ void MNE::run()
                 float tmin = ((float)t_fiffEvoked.first) / t_fiffEvoked.info.sfreq;
                 float tstep = 1/t_fiffEvoked.info.sfreq;
 
+                //the kernel is applied in single precision
+                MatrixXf t_matData = t_fiffEvoked.data.cast<float>();
+
                 m_qMutex.lock();
-                MNESourceEstimate sourceEstimate = m_pMinimumNorm->calculateInverse(t_fiffEvoked.data, tmin, tstep);
+                MNESourceEstimate sourceEstimate = m_pMinimumNorm->calculateInverse(t_matData, tmin, tstep);
                 m_qMutex.unlock();
 
                 m_pRTSEOutput->data()->setValue(sourceEstimate);
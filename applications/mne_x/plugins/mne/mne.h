@@ -183,6 +183,24 @@ public:
     */
     void updateInvOp(MNEInverseOperator::SPtr p_pInvOp);
 
+    //=========================================================================================================
+    /**
+    * Sets the SNR the regularization lambda2 = 1/SNR^2 is derived from. Applied to the current minimum norm
+    * estimator, kernels of already used settings come from its kernel cache.
+    *
+    * @param[in] p_dSNR     The signal to noise ratio
+    */
+    void setSNR(double p_dSNR);
+
+    //=========================================================================================================
+    /**
+    * Sets the inverse method. Applied to the current minimum norm estimator, kernels of already used settings
+    * come from its kernel cache.
+    *
+    * @param[in] p_sMethod  "MNE" | "dSPM" | "sLORETA"
+    */
+    void setMethod(const QString &p_sMethod);
+
 signals:
     //=========================================================================================================
     /**
@@ -239,7 +257,9 @@ private:
     RtInvOp::SPtr               m_pRtInvOp;         /**< Real-time inverse operator. */
     MNEInverseOperator::SPtr    m_pInvOp;           /**< The inverse operator. */
 
-    MinimumNorm::SPtr           m_pMinimumNorm;     /**< Minimum Norm Estimation. */
+    MinimumNorm::SPtr           m_pMinimumNorm;     /**< Minimum Norm Estimation of the current inverse operator. */
+    double                      m_dSNR;             /**< SNR the regularization is derived from. */
+    QString                     m_sMethod;          /**< Inverse method ("MNE" | "dSPM" | "sLORETA"). */
     qint32                      m_iDownSample;      /**< Sampling rate */
 
 //    RealTimeSourceEstimate::SPtr m_pRTSE_MNE; /**< Source Estimate output channel. */
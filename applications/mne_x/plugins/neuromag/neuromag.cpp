@@ -396,7 +396,6 @@ void Neuromag::run()
         matValue = m_pRawMatrixBuffer_In->pop();
 
         //emit values
-        for(qint32 i = 0; i < matValue.cols(); ++i)
-            m_pRTMSA_Neuromag->data()->setValue(matValue.col(i).cast<double>());
+        m_pRTMSA_Neuromag->data()->setValue(MatrixXd(matValue.cast<double>()));
     }
 }
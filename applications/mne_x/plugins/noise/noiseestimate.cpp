@@ -70,7 +70,7 @@ NoiseEstimate::NoiseEstimate()
 , m_bProcessData(false)
 , m_pRTMSAInput(NULL)
 , m_pFSOutput(NULL)
-, m_pBuffer(CircularMatrixBuffer<double>::SPtr())
+, m_pBuffer(RingMatrixBuffer<double>::SPtr())
 , m_Fs(600)
 , m_iFFTlength(16384)
 {
@@ -126,7 +126,7 @@ void NoiseEstimate::init()
 
     //Delete Buffer - will be initailzed with first incoming data
     if(!m_pBuffer.isNull())
-        m_pBuffer = CircularMatrixBuffer<double>::SPtr();
+        m_pBuffer = RingMatrixBuffer<double>::SPtr();
 }
 
 
@@ -234,7 +234,7 @@ void NoiseEstimate::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
     {
         //Check if buffer initialized
         if(!m_pBuffer)
-            m_pBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
+            m_pBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
 
         //Fiff information
         if(!m_pFiffInfo)
@@ -245,12 +245,7 @@ void NoiseEstimate::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
 
         if(m_bProcessData)
         {
-            MatrixXd t_mat(pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize());
-
-            for(qint32 i = 0; i < pRTMSA->getMultiArraySize(); ++i)
-                t_mat.col(i) = pRTMSA->getMultiSampleArray()[i];
-
-            m_pBuffer->push(&t_mat);
+            m_pBuffer->push(pRTMSA->getMultiSampleArray().data());
         }
     }
 }
@@ -259,12 +254,11 @@ void NoiseEstimate::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
 
 void NoiseEstimate::appendNoiseSpectrum(MatrixXd t_send)
 { 
-    qDebug()<<"Spectrum"<<t_send(0,1)<<t_send(0,2)<<t_send(0,3);
     mutex.lock();
+    //The spectrum is refreshed with every block - only the latest one is worth displaying
+    m_qVecSpecData.clear();
     m_qVecSpecData.push_back(t_send);
     mutex.unlock();
-    //m_pFSOutput->data()->setValue(t_send);
-    qDebug()<<"---------------------------------appendNoiseSpectrum--------------------------------";
 }
 
 
@@ -296,13 +290,13 @@ void NoiseEstimate::run()
 
     m_bProcessData = true;
 
+    MatrixXd t_mat;
+
     while (m_bIsRunning)
     {
-        if(m_bProcessData)
+        //Timed pop - lets the loop notice a stop request instead of blocking in the buffer
+        if(m_bProcessData && m_pBuffer->tryPop(t_mat, 100))
         {
-            /* Dispatch the inputs */
-            MatrixXd t_mat = m_pBuffer->pop();
-
             //ToDo: Implement your algorithm here
             m_pRtNoise->append(t_mat);
 
@@ -310,7 +304,6 @@ void NoiseEstimate::run()
            {
 
                mutex.lock();
-               qDebug()<<"%%%%%%%%%%%%%%%% send spectrum for display %%%%%%%%%%%%%%%%%%%";
                 //send spectrum to the output data
                m_pFSOutput->data()->setValue(m_qVecSpecData[0]);
                m_qVecSpecData.pop_front();
@@ -46,7 +46,7 @@
 #include "noiseestimate_global.h"
 
 #include <mne_x/Interfaces/IAlgorithm.h>
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 #include <xMeas/newrealtimemultisamplearray.h>
 #include <xMeas/frequencyspectrum.h>
 #include <rtInv/rtnoise.h>
@@ -192,7 +192,7 @@ private:
 
     FiffInfo::SPtr  m_pFiffInfo;                        /**< Fiff measurement info.*/
 
-    CircularMatrixBuffer<double>::SPtr   m_pBuffer;     /**< Holds incoming data.*/
+    RingMatrixBuffer<double>::SPtr       m_pBuffer;     /**< Holds incoming data.*/
 
     RtNoise::SPtr m_pRtNoise;                       /**< Real-time Noise Estimation. */
     //RtNoise * m_pRtNoise;                       /**< Real-time Noise Estimation. */
@@ -50,6 +50,7 @@
 
 #include <QtCore/QtPlugin>
 #include <QtConcurrent>
+#include <QStandardPaths>
 #include <QDebug>
 
 
@@ -171,7 +172,9 @@ void RapMusicToolbox::doClustering()
 
     m_qMutex.lock();
     m_bFinishedClustering = false;
-    m_pClusteredFwd = MNEForwardSolution::SPtr(new MNEForwardSolution(m_pFwd->cluster_forward_solution(*m_pAnnotationSet.data(), 40)));
+    MatrixXd t_D;
+    QString t_sCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/clusteredForward";
+    m_pClusteredFwd = MNEForwardSolution::SPtr(new MNEForwardSolution(m_pFwd->cluster_forward_solution(*m_pAnnotationSet.data(), 40, t_D, defaultCov, defaultInfo, t_sCacheDir)));
     m_qMutex.unlock();
 
     finishedClustering();
@@ -318,6 +321,9 @@ void RapMusicToolbox::run()
 
     m_pPwlRapMusic = RapMusic::SPtr(new RapMusic(*m_pClusteredFwd, false, numDipolePairs));
 
+    //consecutive evoked updates mostly find the same dipoles -> reuse projections and update the subspace
+    m_pPwlRapMusic->setStreaming(true);
+
     //
     // start processing data
     //
@@ -344,7 +350,7 @@ void RapMusicToolbox::run()
             {
                 m_qMutex.lock();
                 FiffEvoked t_fiffEvoked = m_qVecFiffEvoked[0];
-                m_pPwlRapMusic->setStcAttr(t_fiffEvoked.data.cols()/4.0,0.0);
+                m_pPwlRapMusic->setStcAttr(t_fiffEvoked.data.cols()/4.0,0.5); //overlapping windows -> incremental subspace updates
                 m_qVecFiffEvoked.pop_front();
                 m_qMutex.unlock();
 
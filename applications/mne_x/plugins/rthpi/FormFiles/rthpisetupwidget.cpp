@@ -73,6 +73,13 @@ RtHpiSetupWidget::RtHpiSetupWidget(RtHpi* toolbox, QWidget *parent)
     ui.setupUi(this);
 
     connect(ui.m_qPushButton_About, SIGNAL(released()), this, SLOT(showAboutDialog()));
+
+    QStringList t_qListFreqs;
+    for(qint32 i = 0; i < m_pRtHpi->m_vecHpiFreqs.size(); ++i)
+        t_qListFreqs << QString::number(m_pRtHpi->m_vecHpiFreqs[i]);
+    ui.m_qLineEdit_HpiFreqs->setText(t_qListFreqs.join(" "));
+
+    connect(ui.m_qLineEdit_HpiFreqs, &QLineEdit::editingFinished, this, &RtHpiSetupWidget::chgHpiFreqs);
 }
 
 
@@ -91,3 +98,23 @@ void RtHpiSetupWidget::showAboutDialog()
     RtHpiAboutWidget aboutDialog(this);
     aboutDialog.exec();
 }
+
+
+//*************************************************************************************************************
+
+void RtHpiSetupWidget::chgHpiFreqs()
+{
+    QStringList t_qListFreqs = ui.m_qLineEdit_HpiFreqs->text().split(" ", QString::SkipEmptyParts);
+
+    QVector<double> t_vecFreqs;
+    for(qint32 i = 0; i < t_qListFreqs.size(); ++i)
+    {
+        bool t_bOk = false;
+        double t_dFreq = t_qListFreqs[i].toDouble(&t_bOk);
+        if(t_bOk && t_dFreq > 0)
+            t_vecFreqs.append(t_dFreq);
+    }
+
+    //Takes effect with the next start
+    m_pRtHpi->m_vecHpiFreqs = t_vecFreqs;
+}
@@ -113,6 +113,13 @@ private slots:
     */
     void showAboutDialog();
 
+    //=========================================================================================================
+    /**
+    * Reads the HPI frequencies of the line edit and passes them to the RtHpi.
+    *
+    */
+    void chgHpiFreqs();
+
 private:
 
     RtHpi* m_pRtHpi;	/**< Holds a pointer to corresponding RtHpi.*/
@@ -0,0 +1,431 @@
+//=============================================================================================================
+/**
+* @file     hpifit.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     February, 2013
+*
+* @section  LICENSE
+*
+* Copyright (C) 2013, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Contains the implementation of the HpiFit class.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "hpifit.h"
+
+#include <fiff/fiff_constants.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtCore/qmath.h>
+#include <QMap>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace RtHpiPlugin;
+using namespace FIFFLIB;
+using namespace Eigen;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+HpiFit::HpiFit()
+: m_iNumCoils(0)
+, m_iWindow(0)
+, m_dGofThres(0.95)
+, m_bInitialized(false)
+{
+}
+
+
+//*************************************************************************************************************
+
+bool HpiFit::init(const FiffInfo &p_fiffInfo, const QVector<double> &p_vecFreqs, qint32 p_iWindow)
+{
+    m_bInitialized = false;
+
+    m_iNumCoils = p_vecFreqs.size();
+    m_iWindow = p_iWindow;
+
+    if(m_iNumCoils == 0 || m_iWindow < 2*m_iNumCoils + 1)
+        return false;
+
+    //
+    // Sensor model: planar gradiometers are integrated over their two loops 16.8 mm apart and scaled by the
+    // baseline, so that both sensor types enter the fit as field (differences) in Tesla. All other coils are
+    // treated as point magnetometers.
+    //
+    const double mu0_4pi = 1e-7;
+    const double baseline = 0.0168;
+
+    m_vecPicks.clear();
+    QList<qint32> t_qListPointSensor;
+    QList<double> t_qListPointWeight;
+    QList<Vector3d> t_qListPointPos;
+    QList<Vector3d> t_qListPointNormal;
+    QList<double> t_qListChScale;
+
+    for(qint32 i = 0; i < p_fiffInfo.chs.size(); ++i)
+    {
+        const FiffChInfo &t_ch = p_fiffInfo.chs[i];
+        if(t_ch.kind != FIFFV_MEG_CH || p_fiffInfo.bads.contains(t_ch.ch_name))
+            continue;
+
+        qint32 t_iSensor = m_vecPicks.size();
+        m_vecPicks.append(i);
+
+        Vector3d r0 = t_ch.coil_trans.block(0,3,3,1);
+        Vector3d ex = t_ch.coil_trans.block(0,0,3,1);
+        Vector3d ez = t_ch.coil_trans.block(0,2,3,1);
+
+        if(t_ch.coil_type == FIFFV_COIL_VV_PLANAR_T1 || t_ch.coil_type == FIFFV_COIL_VV_PLANAR_T2 || t_ch.coil_type == FIFFV_COIL_VV_PLANAR_T3)
+        {
+            t_qListChScale.append(baseline);
+
+            t_qListPointPos.append(r0 + 0.5*baseline*ex);
+            t_qListPointNormal.append(ez);
+            t_qListPointWeight.append(mu0_4pi);
+            t_qListPointSensor.append(t_iSensor);
+
+            t_qListPointPos.append(r0 - 0.5*baseline*ex);
+            t_qListPointNormal.append(ez);
+            t_qListPointWeight.append(-mu0_4pi);
+            t_qListPointSensor.append(t_iSensor);
+        }
+        else
+        {
+            t_qListChScale.append(1.0);
+
+            t_qListPointPos.append(r0);
+            t_qListPointNormal.append(ez);
+            t_qListPointWeight.append(mu0_4pi);
+            t_qListPointSensor.append(t_iSensor);
+        }
+    }
+
+    if(m_vecPicks.size() < 3*m_iNumCoils)
+        return false;
+
+    qint32 t_iNumPoints = t_qListPointPos.size();
+    m_matPointPos.resize(t_iNumPoints, 3);
+    m_matPointNormal.resize(t_iNumPoints, 3);
+    m_vecPointWeight.resize(t_iNumPoints);
+    m_vecPointSensor.resize(t_iNumPoints);
+    for(qint32 p = 0; p < t_iNumPoints; ++p)
+    {
+        m_matPointPos.row(p) = t_qListPointPos[p].transpose();
+        m_matPointNormal.row(p) = t_qListPointNormal[p].transpose();
+        m_vecPointWeight[p] = t_qListPointWeight[p];
+        m_vecPointSensor[p] = t_qListPointSensor[p];
+    }
+
+    m_vecChScale.resize(m_vecPicks.size());
+    for(qint32 i = 0; i < m_vecPicks.size(); ++i)
+        m_vecChScale[i] = t_qListChScale[i];
+
+    //
+    // Demodulation: least squares fit of cos and sin at each HPI frequency plus a constant offset
+    //
+    MatrixXd t_matRef(m_iWindow, 2*m_iNumCoils + 1);
+    for(qint32 k = 0; k < m_iWindow; ++k)
+    {
+        double t = k / p_fiffInfo.sfreq;
+        for(qint32 i = 0; i < m_iNumCoils; ++i)
+        {
+            t_matRef(k, 2*i) = cos(2*M_PI*p_vecFreqs[i]*t);
+            t_matRef(k, 2*i+1) = sin(2*M_PI*p_vecFreqs[i]*t);
+        }
+        t_matRef(k, 2*m_iNumCoils) = 1.0;
+    }
+    m_matDemod = (t_matRef.transpose()*t_matRef).ldlt().solve(t_matRef.transpose());
+
+    //
+    // Digitized HPI coils, ordered by their number
+    //
+    QMap<qint32, Vector3d> t_qMapHpi;
+    for(qint32 i = 0; i < p_fiffInfo.dig.size(); ++i)
+        if(p_fiffInfo.dig[i].kind == FIFFV_POINT_HPI)
+            t_qMapHpi.insert(p_fiffInfo.dig[i].ident, Vector3d(p_fiffInfo.dig[i].r[0], p_fiffInfo.dig[i].r[1], p_fiffInfo.dig[i].r[2]));
+
+    m_matHeadCoils.resize(qMin(t_qMapHpi.size(), m_iNumCoils), 3);
+    QMap<qint32, Vector3d>::const_iterator it = t_qMapHpi.constBegin();
+    for(qint32 i = 0; i < m_matHeadCoils.rows(); ++i, ++it)
+        m_matHeadCoils.row(i) = it.value().transpose();
+
+    //
+    // Cold start: digitized positions in device coordinates, coils without a digitized position start in front
+    // of the device origin
+    //
+    m_matDevCoilsInit.resize(m_iNumCoils, 3);
+    for(qint32 i = 0; i < m_iNumCoils; ++i)
+    {
+        if(i < m_matHeadCoils.rows())
+        {
+            Vector3d r = m_matHeadCoils.row(i).transpose();
+            if(!p_fiffInfo.dev_head_t.isEmpty())
+                r = p_fiffInfo.dev_head_t.invtrans.block(0,0,3,3).cast<double>()*r + p_fiffInfo.dev_head_t.invtrans.block(0,3,3,1).cast<double>();
+            m_matDevCoilsInit.row(i) = r.transpose();
+        }
+        else
+            m_matDevCoilsInit.row(i) << 0.0, 0.0, 0.04;
+    }
+
+    reset();
+
+    m_bInitialized = true;
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+bool HpiFit::fit(const MatrixXd &p_matData, FiffCoordTrans &p_devHeadT, MatrixX3d &p_matCoils, VectorXd &p_vecGof)
+{
+    if(!m_bInitialized || p_matData.cols() != m_iWindow)
+        return false;
+
+    //
+    // Lock-in: cos and sin amplitudes of every coil at every sensor
+    //
+    MatrixXd t_matMeg(m_vecPicks.size(), m_iWindow);
+    for(qint32 i = 0; i < m_vecPicks.size(); ++i)
+        t_matMeg.row(i) = m_vecChScale[i]*p_matData.row(m_vecPicks[i]);
+
+    MatrixXd t_matCoefs = t_matMeg*m_matDemod.transpose();
+
+    //
+    // Dipole fit of each coil topography
+    //
+    p_matCoils.resize(m_iNumCoils, 3);
+    p_vecGof.resize(m_iNumCoils);
+
+    for(qint32 i = 0; i < m_iNumCoils; ++i)
+    {
+        // The coil signal is in phase at all sensors, its topography is the dominant direction of the cos/sin pair
+        MatrixX2d t_matCosSin = t_matCoefs.middleCols(2*i, 2);
+        SelfAdjointEigenSolver<Matrix2d> t_eigSolver(t_matCosSin.transpose()*t_matCosSin);
+        VectorXd t_vecTopo = t_matCosSin*t_eigSolver.eigenvectors().col(1);
+
+        bool t_bWarm = m_vecLastGof[i] >= m_dGofThres;
+        Vector3d t_vecPos = t_bWarm ? m_matDevCoils.row(i).transpose() : m_matDevCoilsInit.row(i).transpose();
+        double t_dGof = fitDipole(t_vecTopo, t_vecPos);
+
+        // Lost track, e.g. after a fast movement -> start over from the digitized position
+        if(t_bWarm && t_dGof < m_dGofThres)
+        {
+            Vector3d t_vecPosCold = m_matDevCoilsInit.row(i).transpose();
+            double t_dGofCold = fitDipole(t_vecTopo, t_vecPosCold);
+            if(t_dGofCold > t_dGof)
+            {
+                t_vecPos = t_vecPosCold;
+                t_dGof = t_dGofCold;
+            }
+        }
+
+        m_matDevCoils.row(i) = t_vecPos.transpose();
+        m_vecLastGof[i] = t_dGof;
+    }
+
+    p_matCoils = m_matDevCoils;
+    p_vecGof = m_vecLastGof;
+
+    //
+    // Device to head transform: rigid least squares fit (Kabsch) of the good coils to the digitized ones
+    //
+    QVector<qint32> t_vecGood;
+    for(qint32 i = 0; i < m_matHeadCoils.rows(); ++i)
+        if(m_vecLastGof[i] >= m_dGofThres)
+            t_vecGood.append(i);
+
+    if(t_vecGood.size() < 3)
+        return false;
+
+    MatrixX3d t_matDev(t_vecGood.size(), 3);
+    MatrixX3d t_matHead(t_vecGood.size(), 3);
+    for(qint32 i = 0; i < t_vecGood.size(); ++i)
+    {
+        t_matDev.row(i) = m_matDevCoils.row(t_vecGood[i]);
+        t_matHead.row(i) = m_matHeadCoils.row(t_vecGood[i]);
+    }
+
+    RowVector3d t_vecDevMean = t_matDev.colwise().mean();
+    RowVector3d t_vecHeadMean = t_matHead.colwise().mean();
+    t_matDev.rowwise() -= t_vecDevMean;
+    t_matHead.rowwise() -= t_vecHeadMean;
+
+    JacobiSVD<Matrix3d> t_svd(t_matDev.transpose()*t_matHead, ComputeFullU | ComputeFullV);
+    Matrix3d t_matReflect = Matrix3d::Identity();
+    t_matReflect(2,2) = (t_svd.matrixV()*t_svd.matrixU().transpose()).determinant() < 0 ? -1.0 : 1.0;
+
+    Matrix3d t_matRot = t_svd.matrixV()*t_matReflect*t_svd.matrixU().transpose();
+    Vector3d t_vecTrans = t_vecHeadMean.transpose() - t_matRot*t_vecDevMean.transpose();
+
+    Matrix4d t_matTrans = Matrix4d::Identity();
+    t_matTrans.block(0,0,3,3) = t_matRot;
+    t_matTrans.block(0,3,3,1) = t_vecTrans;
+
+    p_devHeadT.from = FIFFV_COORD_DEVICE;
+    p_devHeadT.to = FIFFV_COORD_HEAD;
+    p_devHeadT.trans = t_matTrans.cast<float>();
+    p_devHeadT.invtrans = t_matTrans.inverse().cast<float>();
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+
+void HpiFit::reset()
+{
+    m_matDevCoils = m_matDevCoilsInit;
+    m_vecLastGof = VectorXd::Zero(m_iNumCoils);
+}
+
+
+//*************************************************************************************************************
+
+void HpiFit::leadField(const Vector3d &p_vecPos, MatrixX3d &p_matLead) const
+{
+    // Field of a magnetic dipole along the point normals n: mu0/4pi * (3 (n.R) R / |R|^5 - n / |R|^3)
+    ArrayXd Rx = m_matPointPos.col(0).array() - p_vecPos[0];
+    ArrayXd Ry = m_matPointPos.col(1).array() - p_vecPos[1];
+    ArrayXd Rz = m_matPointPos.col(2).array() - p_vecPos[2];
+
+    ArrayXd r2 = Rx.square() + Ry.square() + Rz.square();
+    ArrayXd w_r3 = m_vecPointWeight.array()/(r2*r2.sqrt());
+    ArrayXd a = 3.0*w_r3*(m_matPointNormal.col(0).array()*Rx + m_matPointNormal.col(1).array()*Ry + m_matPointNormal.col(2).array()*Rz)/r2;
+
+    MatrixX3d t_matPointLead(m_matPointPos.rows(), 3);
+    t_matPointLead.col(0) = (a*Rx - w_r3*m_matPointNormal.col(0).array()).matrix();
+    t_matPointLead.col(1) = (a*Ry - w_r3*m_matPointNormal.col(1).array()).matrix();
+    t_matPointLead.col(2) = (a*Rz - w_r3*m_matPointNormal.col(2).array()).matrix();
+
+    p_matLead.setZero(m_vecPicks.size(), 3);
+    for(qint32 p = 0; p < m_vecPointSensor.size(); ++p)
+        p_matLead.row(m_vecPointSensor[p]) += t_matPointLead.row(p);
+}
+
+
+//*************************************************************************************************************
+
+void HpiFit::residual(const VectorXd &p_vecTopo, const Vector3d &p_vecPos, VectorXd &p_vecRes) const
+{
+    MatrixX3d t_matLead;
+    leadField(p_vecPos, t_matLead);
+
+    Vector3d t_vecMoment = (t_matLead.transpose()*t_matLead).ldlt().solve(t_matLead.transpose()*p_vecTopo);
+    p_vecRes = p_vecTopo - t_matLead*t_vecMoment;
+}
+
+
+//*************************************************************************************************************
+
+double HpiFit::fitDipole(const VectorXd &p_vecTopo, Vector3d &p_vecPos) const
+{
+    const qint32 MaxIter = 30;
+    const double h = 1e-6;          // Finite difference step [m]
+    const double StepTol = 1e-7;    // Convergence: position change below 0.1 um
+
+    double t_dTopoNorm = p_vecTopo.squaredNorm();
+    if(t_dTopoNorm <= 0)
+        return 0;
+
+    VectorXd t_vecRes, t_vecResTest;
+    residual(p_vecTopo, p_vecPos, t_vecRes);
+    double t_dCost = t_vecRes.squaredNorm();
+
+    MatrixX3d t_matJac(p_vecTopo.size(), 3);
+    double lambda = 1e-3;
+
+    for(qint32 iter = 0; iter < MaxIter; ++iter)
+    {
+        // Jacobian of the variable projection residual
+        for(qint32 k = 0; k < 3; ++k)
+        {
+            Vector3d t_vecPosTest = p_vecPos;
+            t_vecPosTest[k] += h;
+            residual(p_vecTopo, t_vecPosTest, t_vecResTest);
+            t_matJac.col(k) = (t_vecResTest - t_vecRes)/h;
+        }
+
+        Matrix3d JtJ = t_matJac.transpose()*t_matJac;
+        Vector3d Jtr = t_matJac.transpose()*t_vecRes;
+
+        bool t_bImproved = false;
+        double t_dStep = 0;
+        while(lambda < 1e10)
+        {
+            Matrix3d t_matSys = JtJ;
+            t_matSys.diagonal() += lambda*JtJ.diagonal();
+
+            Vector3d t_vecDelta = -t_matSys.ldlt().solve(Jtr);
+            Vector3d t_vecPosTest = p_vecPos + t_vecDelta;
+            residual(p_vecTopo, t_vecPosTest, t_vecResTest);
+            double t_dCostTest = t_vecResTest.squaredNorm();
+
+            if(t_dCostTest < t_dCost)
+            {
+                p_vecPos = t_vecPosTest;
+                t_vecRes = t_vecResTest;
+                t_dCost = t_dCostTest;
+                t_dStep = t_vecDelta.norm();
+                lambda = qMax(lambda*0.1, 1e-9);
+                t_bImproved = true;
+                break;
+            }
+            lambda *= 10;
+        }
+
+        if(!t_bImproved || t_dStep < StepTol)
+            break;
+    }
+
+    return 1.0 - t_dCost/t_dTopoNorm;
+}
@@ -0,0 +1,203 @@
+//=============================================================================================================
+/**
+* @file     hpifit.h
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     February, 2013
+*
+* @section  LICENSE
+*
+* Copyright (C) 2013, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Contains the declaration of the HpiFit class.
+*
+*/
+
+#ifndef HPIFIT_H
+#define HPIFIT_H
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// FIFF INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_coord_trans.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QVector>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE RtHpiPlugin
+//=============================================================================================================
+
+namespace RtHpiPlugin
+{
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+
+//=============================================================================================================
+/**
+* Continuous HPI coil localization. The coil signals of a data window are demodulated by a least squares fit
+* of a cosine and a sine at every HPI frequency (lock-in detection), the projector for this fit depends on the
+* window length only and is precomputed. Each coil topography is fitted by a magnetic dipole in free space,
+* the moment is solved linearly and the position by Levenberg-Marquardt, warm started from the previous fit.
+* The device to head transform is the least squares rigid transform between the fitted coil positions and the
+* digitized HPI points.
+*
+* @brief Continuous HPI coil localization.
+*/
+class HpiFit
+{
+public:
+    //=========================================================================================================
+    /**
+    * Constructs a HpiFit.
+    */
+    HpiFit();
+
+    //=========================================================================================================
+    /**
+    * Picks the MEG channels, sets up the sensor model and the demodulation projector.
+    *
+    * @param[in] p_fiffInfo     measurement info with channel positions and digitized HPI points.
+    * @param[in] p_vecFreqs     HPI frequencies in Hz, coil i is driven at p_vecFreqs[i].
+    * @param[in] p_iWindow      number of samples of the data windows passed to fit.
+    *
+    * @return true if the fit is ready, false if there are no MEG channels or no frequencies.
+    */
+    bool init(const FiffInfo &p_fiffInfo, const QVector<double> &p_vecFreqs, qint32 p_iWindow);
+
+    //=========================================================================================================
+    /**
+    * Localizes the HPI coils within a data window.
+    *
+    * @param[in] p_matData      data window, all channels x window samples.
+    * @param[out] p_devHeadT    device to head transform, only set if true is returned.
+    * @param[out] p_matCoils    fitted coil positions in device coordinates, one coil per row.
+    * @param[out] p_vecGof      goodness of fit of each coil.
+    *
+    * @return true if enough coils were localized to compute the device to head transform.
+    */
+    bool fit(const MatrixXd &p_matData, FiffCoordTrans &p_devHeadT, MatrixX3d &p_matCoils, VectorXd &p_vecGof);
+
+    //=========================================================================================================
+    /**
+    * Drops the previous coil positions, the next fit starts from the digitized positions again.
+    */
+    void reset();
+
+    //=========================================================================================================
+    /**
+    * Returns whether init succeeded.
+    *
+    * @return true if the fit is initialized.
+    */
+    inline bool isInitialized() const;
+
+private:
+    //=========================================================================================================
+    /**
+    * Computes the lead field of a unit magnetic dipole at p_vecPos.
+    *
+    * @param[in] p_vecPos       dipole position in device coordinates.
+    * @param[out] p_matLead     lead field, MEG channels x 3.
+    */
+    void leadField(const Vector3d &p_vecPos, MatrixX3d &p_matLead) const;
+
+    //=========================================================================================================
+    /**
+    * Fits the moment of a dipole at p_vecPos to a topography and returns the residual.
+    *
+    * @param[in] p_vecTopo      coil topography.
+    * @param[in] p_vecPos       dipole position in device coordinates.
+    * @param[out] p_vecRes      residual.
+    */
+    void residual(const VectorXd &p_vecTopo, const Vector3d &p_vecPos, VectorXd &p_vecRes) const;
+
+    //=========================================================================================================
+    /**
+    * Fits the position of a magnetic dipole to a coil topography.
+    *
+    * @param[in] p_vecTopo      coil topography.
+    * @param[in, out] p_vecPos  start position, fitted position on return.
+    *
+    * @return the goodness of fit.
+    */
+    double fitDipole(const VectorXd &p_vecTopo, Vector3d &p_vecPos) const;
+
+    QVector<qint32> m_vecPicks;     /**< Picked MEG channels. */
+    VectorXd    m_vecChScale;       /**< Scale of the picked channels, gradiometers are turned into field differences. */
+    MatrixX3d   m_matPointPos;      /**< Integration points of the sensors, device coordinates. */
+    MatrixX3d   m_matPointNormal;   /**< Normals of the integration points. */
+    VectorXd    m_vecPointWeight;   /**< Weights of the integration points. */
+    VectorXi    m_vecPointSensor;   /**< Picked channel each integration point belongs to. */
+    MatrixXd    m_matDemod;         /**< Demodulation projector, (2 * coils + 1) x window samples. */
+    MatrixX3d   m_matHeadCoils;     /**< Digitized HPI coil positions in head coordinates. */
+    MatrixX3d   m_matDevCoilsInit;  /**< Digitized HPI coil positions in device coordinates, start of a cold fit. */
+    MatrixX3d   m_matDevCoils;      /**< Last fitted coil positions in device coordinates. */
+    VectorXd    m_vecLastGof;       /**< Goodness of fit of the last fitted coil positions. */
+    qint32      m_iNumCoils;        /**< Number of HPI coils. */
+    qint32      m_iWindow;          /**< Window length in samples. */
+    double      m_dGofThres;        /**< Goodness of fit a coil needs to enter the transform and to warm start the next fit. */
+    bool        m_bInitialized;     /**< If init succeeded. */
+};
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool HpiFit::isInitialized() const
+{
+    return m_bInitialized;
+}
+
+} // NAMESPACE
+
+#endif // HPIFIT_H
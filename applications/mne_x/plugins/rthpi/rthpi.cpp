@@ -47,6 +47,8 @@
 //=============================================================================================================
 
 #include <QtCore/QtPlugin>
+#include <QtCore/qmath.h>
+#include <QSettings>
 #include <QDebug>
 
 
@@ -70,7 +72,8 @@ RtHpi::RtHpi()
 , m_bProcessData(false)
 , m_pRTMSAInput(NULL)
 , m_pRTMSAOutput(NULL)
-, m_pRtHpiBuffer(CircularMatrixBuffer<double>::SPtr())
+, m_pHpiOutput(NULL)
+, m_pRtHpiBuffer(RingMatrixBuffer<double>::SPtr())
 {
 }
 
@@ -100,6 +103,15 @@ QSharedPointer<IPlugin> RtHpi::clone() const
 
 void RtHpi::init()
 {
+    //
+    // Load Settings
+    //
+    QSettings settings;
+    QStringList t_qListFreqs = settings.value(QString("Plugin/%1/HpiFrequencies").arg(this->getName()), QString("154 158 162 166")).toString().split(" ", QString::SkipEmptyParts);
+    m_vecHpiFreqs.clear();
+    for(qint32 i = 0; i < t_qListFreqs.size(); ++i)
+        m_vecHpiFreqs.append(t_qListFreqs[i].toDouble());
+
     // Input
     m_pRTMSAInput = PluginInputData<NewRealTimeMultiSampleArray>::create(this, "Rt HPI In", "RT HPI input data");
     connect(m_pRTMSAInput.data(), &PluginInputConnector::notify, this, &RtHpi::update, Qt::DirectConnection);
@@ -112,12 +124,15 @@ void RtHpi::init()
     m_pRTMSAOutput->data()->setMultiArraySize(100);
     m_pRTMSAOutput->data()->setVisibility(true);
 
+    m_pHpiOutput = PluginOutputData<RealTimeHpi>::create(this, "Rt HPI Position", "RT HPI device to head transform");
+    m_outputConnectors.append(m_pHpiOutput);
+
     //init channels when fiff info is available
     connect(this, &RtHpi::fiffInfoAvailable, this, &RtHpi::initConnector);
 
     //Delete Buffer - will be initailzed with first incoming data
     if(!m_pRtHpiBuffer.isNull())
-        m_pRtHpiBuffer = CircularMatrixBuffer<double>::SPtr();
+        m_pRtHpiBuffer = RingMatrixBuffer<double>::SPtr();
 }
 
 
@@ -125,7 +140,15 @@ void RtHpi::init()
 
 void RtHpi::unload()
 {
+    //
+    // Store Settings
+    //
+    QStringList t_qListFreqs;
+    for(qint32 i = 0; i < m_vecHpiFreqs.size(); ++i)
+        t_qListFreqs << QString::number(m_vecHpiFreqs[i]);
 
+    QSettings settings;
+    settings.setValue(QString("Plugin/%1/HpiFrequencies").arg(this->getName()), t_qListFreqs.join(" "));
 }
 
 
@@ -134,8 +157,8 @@ void RtHpi::unload()
 void RtHpi::initConnector()
 {
     qDebug() << "void RtHpi::initConnector()";
-    if(m_pFiffInfo)
-        m_pRTMSAOutput->data()->initFromFiffInfo(m_pFiffInfo);
+    if(m_pFiffInfoOut)
+        m_pRTMSAOutput->data()->initFromFiffInfo(m_pFiffInfoOut);
 }
 
 
@@ -213,23 +236,20 @@ void RtHpi::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
     {
         //Check if buffer initialized
         if(!m_pRtHpiBuffer)
-            m_pRtHpiBuffer = CircularMatrixBuffer<double>::SPtr(new CircularMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
+            m_pRtHpiBuffer = RingMatrixBuffer<double>::SPtr(new RingMatrixBuffer<double>(64, pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize()));
 
         //Fiff information
         if(!m_pFiffInfo)
         {
+            //The output gets its own copy, the tracked head position must not alter the info of the input
+            m_pFiffInfoOut = FiffInfo::SPtr(new FiffInfo(*pRTMSA->info()));
             m_pFiffInfo = pRTMSA->info();
             emit fiffInfoAvailable();
         }
 
         if(m_bProcessData)
         {
-            MatrixXd t_mat(pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize());
-
-            for(qint32 i = 0; i < pRTMSA->getMultiArraySize(); ++i)
-                t_mat.col(i) = pRTMSA->getMultiSampleArray()[i];
-
-            m_pRtHpiBuffer->push(&t_mat);
+            m_pRtHpiBuffer->push(pRTMSA->getMultiSampleArray().data());
         }
     }
 }
@@ -246,20 +266,75 @@ void RtHpi::run()
     while(!m_pFiffInfo)
         msleep(10);// Wait for fiff Info
 
+    //
+    // Fit a 200 ms window at least 10 times a second
+    //
+    qint32 t_iWindow = qMax((qint32)(0.2*m_pFiffInfo->sfreq), 1);
+    qint32 t_iFitStep = qMax((qint32)qCeil(m_pFiffInfo->sfreq/10.0), 1);
+
+    HpiFit t_hpiFit;
+    bool t_bFit = t_hpiFit.init(*m_pFiffInfo, m_vecHpiFreqs, t_iWindow);
+    if(!t_bFit)
+        qWarning() << "RtHpi: HPI fit could not be initialized, data is passed through without head position tracking.";
+
+    MatrixXd t_matWindow;
+    qint32 t_iFilled = 0;
+    qint32 t_iSinceFit = 0;
+
+    FiffCoordTrans t_devHeadT;
+    MatrixX3d t_matCoils;
+    VectorXd t_vecGof;
+
     m_bProcessData = true;
 
+    MatrixXd t_mat;
+
     while (m_bIsRunning)
     {
-        if(m_bProcessData)
+        //Timed pop - lets the loop notice a stop request instead of blocking in the buffer
+        if(m_bProcessData && m_pRtHpiBuffer->tryPop(t_mat, 100))
         {
-            /* Dispatch the inputs */
-            MatrixXd t_mat = m_pRtHpiBuffer->pop();
-
-            //ToDo: Implement your algorithm here
-
-            for(qint32 i = 0; i < t_mat.cols(); ++i)
-                m_pRTMSAOutput->data()->setValue(t_mat.col(i));
+            if(t_bFit)
+            {
+                if(t_matWindow.rows() != t_mat.rows())
+                {
+                    t_matWindow = MatrixXd::Zero(t_mat.rows(), t_iWindow);
+                    t_iFilled = 0;
+                }
+
+                //Slide the window in steps of at most one fit interval, so large blocks are fitted several times
+                qint32 t_iCol = 0;
+                while(t_iCol < t_mat.cols())
+                {
+                    qint32 t_iNum = qMin(t_iFitStep - t_iSinceFit, (qint32)t_mat.cols() - t_iCol);
+
+                    if(t_iNum < t_iWindow)
+                    {
+                        t_matWindow.leftCols(t_iWindow - t_iNum) = t_matWindow.rightCols(t_iWindow - t_iNum).eval();
+                        t_matWindow.rightCols(t_iNum) = t_mat.middleCols(t_iCol, t_iNum);
+                    }
+                    else
+                        t_matWindow = t_mat.middleCols(t_iCol + t_iNum - t_iWindow, t_iWindow);
+
+                    t_iCol += t_iNum;
+                    t_iSinceFit += t_iNum;
+                    t_iFilled = qMin(t_iFilled + t_iNum, t_iWindow);
+
+                    if(t_iSinceFit >= t_iFitStep)
+                    {
+                        t_iSinceFit = 0;
+
+                        if(t_iFilled == t_iWindow && t_hpiFit.fit(t_matWindow, t_devHeadT, t_matCoils, t_vecGof))
+                        {
+                            //Downstream plugins (e.g. RtSss) pick the transform up with the next data block
+                            m_pFiffInfoOut->dev_head_t = t_devHeadT;
+                            m_pHpiOutput->data()->setValue(t_devHeadT, t_matCoils, t_vecGof);
+                        }
+                    }
+                }
+            }
+
+            m_pRTMSAOutput->data()->setValue(t_mat);
         }
     }
 }
-
@@ -43,10 +43,12 @@
 //=============================================================================================================
 
 #include "rthpi_global.h"
+#include "hpifit.h"
 
 #include <mne_x/Interfaces/IAlgorithm.h>
-#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
 #include <xMeas/newrealtimemultisamplearray.h>
+#include <xMeas/realtimehpi.h>
 
 
 //*************************************************************************************************************
@@ -104,6 +106,8 @@ class RTHPISHARED_EXPORT RtHpi : public IAlgorithm
     // Use the Q_INTERFACES() macro to tell Qt's meta-object system about the interfaces
     Q_INTERFACES(MNEX::IAlgorithm)
 
+    friend class RtHpiSetupWidget;
+
 public:
     //=========================================================================================================
     /**
@@ -164,11 +168,15 @@ private:
 
     PluginInputData<NewRealTimeMultiSampleArray>::SPtr   m_pRTMSAInput;      /**< The NewRealTimeMultiSampleArray of the RtHpi input.*/
     PluginOutputData<NewRealTimeMultiSampleArray>::SPtr  m_pRTMSAOutput;    /**< The NewRealTimeMultiSampleArray of the RtHpi output.*/
+    PluginOutputData<RealTimeHpi>::SPtr                  m_pHpiOutput;      /**< The device to head transform of the RtHpi output.*/
 
 
     FiffInfo::SPtr  m_pFiffInfo;                            /**< Fiff measurement info.*/
+    FiffInfo::SPtr  m_pFiffInfoOut;                         /**< Fiff measurement info of the output, carries the tracked device to head transform.*/
+
+    QVector<double> m_vecHpiFreqs;                          /**< HPI coil frequencies in Hz, coil i is driven at m_vecHpiFreqs[i].*/
 
-    CircularMatrixBuffer<double>::SPtr   m_pRtHpiBuffer;    /**< Holds incoming data.*/
+    RingMatrixBuffer<double>::SPtr       m_pRtHpiBuffer;    /**< Holds incoming data.*/
 
     bool m_bIsRunning;      /**< If source lab is running */
     bool m_bProcessData;    /**< If data should be received for processing */
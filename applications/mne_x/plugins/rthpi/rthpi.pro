@@ -74,12 +74,14 @@ DESTDIR = $${MNE_BINARY_DIR}/mne_x_plugins
 
 SOURCES += \
         rthpi.cpp \
+        hpifit.cpp \
         FormFiles/rthpisetupwidget.cpp \
         FormFiles/rthpiaboutwidget.cpp
 
 HEADERS += \
         rthpi.h\
         rthpi_global.h \
+        hpifit.h \
         FormFiles/rthpisetupwidget.h \
         FormFiles/rthpiaboutwidget.h
 
@@ -76,6 +76,7 @@ RtSss::RtSss()
 , m_bReceiveData(false)
 , m_bProcessData(false)
 {
+    m_matDevHeadT.setIdentity();
 }
 
 
@@ -253,13 +254,16 @@ void RtSss::update(XMEASLIB::NewMeasurement::SPtr pMeasurement)
         if(!m_pFiffInfo)
             m_pFiffInfo = pRTMSA->info();
 
-        if(m_bProcessData)
+        //Head position - applied by run() between two blocks
+        if(pRTMSA->info() && !pRTMSA->info()->dev_head_t.isEmpty())
         {
-            MatrixXd in_mat(pRTMSA->getNumChannels(), pRTMSA->getMultiArraySize());
-            for(unsigned char i = 0; i < pRTMSA->getMultiArraySize(); ++i)
-                in_mat.col(i) = pRTMSA->getMultiSampleArray()[i];
+            QMutexLocker locker(&m_qMutex);
+            m_matDevHeadT = pRTMSA->info()->dev_head_t.trans.cast<double>();
+        }
 
-            m_pRtSssBuffer->push(&in_mat);
+        if(m_bProcessData)
+        {
+            m_pRtSssBuffer->push(pRTMSA->getMultiSampleArray().data());
         }
     }
 }
@@ -356,20 +360,20 @@ void RtSss::run()
     qint32 cnt=0;
     qDebug() << "rtSSS started.....";
 
-    bool m_bIsHeadMov = true;
+    Matrix4d t_matDevHeadT;
 
     while(m_bIsRunning)
     {
-//        if (m_bIsHeadMov)
-//        {
+        // Rebuild the basis and its cached inverses only if the head moved beyond the threshold
+        m_qMutex.lock();
+        t_matDevHeadT = m_matDevHeadT;
+        m_qMutex.unlock();
+
+        if (rsss.updateHeadPosition(t_matDevHeadT))
+        {
             lineqn = rsss.buildLinearEqn();
             qDebug() << "rebuilt SSS linear equation .....";
-//            m_bIsHeadMov = false;
-//        }
-//        else
-//        {
-//            m_bIsHeadMov = true;
-//        }
+        }
 
         qint16 nrows = m_pRtSssBuffer->rows();
 
@@ -414,9 +418,9 @@ void RtSss::run()
                 }
 
             // Output to display
-            for(qint32 i = 0; i <in_mat.cols(); ++i)
-                m_pRTMSAOutput->data()->setValue(1e7 * in_mat.col(i));
-//                m_pRTMSAOutput->data()->setValue(1e-16 * in_mat.col(i));
+            in_mat *= 1e7;
+//            in_mat *= 1e-16;
+            m_pRTMSAOutput->data()->setValue(in_mat);
 
             cnt++;
             qDebug() << cnt;
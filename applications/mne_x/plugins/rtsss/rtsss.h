@@ -64,6 +64,7 @@
 //=============================================================================================================
 
 #include <QtWidgets>
+#include <QMutex>
 
 
 //*************************************************************************************************************
@@ -173,6 +174,9 @@ private:
 
     FiffInfo::SPtr              m_pFiffInfo;        /**< Fiff information. */
 
+    QMutex          m_qMutex;           /**< Guards m_matDevHeadT. */
+    Eigen::Matrix<double,4,4,Eigen::DontAlign> m_matDevHeadT;  /**< Latest device to head transform of the input, the SSS basis is rebuilt when it moves. */
+
     CircularMatrixBuffer<double>::SPtr m_pRtSssBuffer;   /**< Holds incoming rt server data.*/
 
     int LinRR, LoutRR, Lin, Lout;
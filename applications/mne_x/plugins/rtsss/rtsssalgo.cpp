@@ -42,8 +42,11 @@
 //#include "FormFiles/rtssssetupwidget.h"
 
 RtSssAlgo::RtSssAlgo()
+: HeadMovTransThres(0.002)
+, HeadMovRotThres(2.0)
 {
-
+    DevHeadT.setIdentity();
+    DevHeadTRef.setIdentity();
 }
 
 RtSssAlgo::~RtSssAlgo()
@@ -135,6 +138,19 @@ MatrixXd RtSssAlgo::buildLinearEqn()
 
     EqnARR = CoilScale.asDiagonal() * EqnARR;
     EqnA = CoilScale.asDiagonal() * EqnA;
+
+    // The pseudo-inverses and hat matrices only depend on the basis, which only changes with the head position.
+    // Cache them here instead of inverting for every block of data in getSSSRR/getSSSOLS.
+    // The pseudo-inverses are taken from a QR decomposition without ever forming A'A; the robust regression
+    // only needs them and the hat matrices A * pinv(A) for its low-rank updates, see sol_X_block().
+    EqnARRPinv = ColPivHouseholderQR<MatrixXd>(EqnARR).solve(MatrixXd::Identity(NumCoil, NumCoil));
+    EqnARRHat = EqnARR * EqnARRPinv;
+
+    EqnAPinv = ColPivHouseholderQR<MatrixXd>(EqnA).solve(MatrixXd::Identity(NumCoil, NumCoil));
+    EqnAHat = EqnA * EqnAPinv;
+
+    // OLS reconstruction of the internal signal in one step: SSSIn = EqnIn * pinv(EqnA)(1:NumBIn,:) * EqnB
+    SSSOLSOp = EqnIn * EqnAPinv.topRows(EqnIn.cols());
 //        std::cout << "pass 1" << std::endl;
 //        std::cout << "MEGData: " << MEGData.rows() << " x " << MEGData.cols() << std::endl;
 //    EqnB = CoilScale.asDiagonal() * MEGData;
@@ -178,6 +194,40 @@ void RtSssAlgo::setSSSParameter(QList<int> expansionOrder)
     LOutOLS = expansionOrder[3];
 }
 
+void RtSssAlgo::setHeadMovThreshold(double transThres, double rotThres)
+{
+    HeadMovTransThres = transThres;
+    HeadMovRotThres = rotThres;
+}
+
+// Follow the head with the expansion origin.
+// The origin is fixed relative to the head at the position it had for the initial device to head transform.
+// Returns true if the head moved further than the thresholds (m, deg) since the basis was last built,
+// the linear equation has then to be rebuilt with buildLinearEqn().
+bool RtSssAlgo::updateHeadPosition(const Matrix4d &devHeadT)
+{
+    double dTrans = (devHeadT.block(0,3,3,1) - DevHeadT.block(0,3,3,1)).norm();
+
+    // rotation angle of the relative rotation R_new * R_old'
+    Matrix3d RotRel = devHeadT.block(0,0,3,3) * DevHeadT.block(0,0,3,3).transpose();
+    double cosRot = qBound(-1.0, (RotRel.trace() - 1.0) / 2.0, 1.0);
+    double dRot = qAcos(cosRot) * 180.0 / M_PI;
+
+    if (dTrans < HeadMovTransThres && dRot < HeadMovRotThres)
+        return false;
+
+    DevHeadT = devHeadT;
+
+    // origin in head coordinates -> origin in device coordinates for the new head position
+    Vector4d OriginHead;
+    OriginHead << OriginRef, 1.0;
+    Origin = (DevHeadT.inverse() * DevHeadTRef * OriginHead).head(3);
+
+    qDebug() << "head moved by" << dTrans*1000 << "mm and" << dRot << "deg, SSS origin:" << Origin(0) << Origin(1) << Origin(2);
+
+    return true;
+}
+
 void RtSssAlgo::setMEGInfo(FiffInfo::SPtr fiffInfo)
 {
 
@@ -185,6 +235,14 @@ void RtSssAlgo::setMEGInfo(FiffInfo::SPtr fiffInfo)
     Origin.resize(3);
     Origin << 0.0, 0.0, 0.04;
 
+    // The origin above belongs to the head position at start up; keep it as the reference for head movements
+    OriginRef = Origin;
+    if (fiffInfo->dev_head_t.isEmpty())
+        DevHeadTRef.setIdentity();
+    else
+        DevHeadTRef = fiffInfo->dev_head_t.trans.cast<double>();
+    DevHeadT = DevHeadTRef;
+
 //    // Find the number of MEG channels
 //    qint32 nmegchan = 0;
 //    for (qint32 i=0; i<fiffInfo->nchan; ++i)
@@ -735,17 +793,15 @@ void RtSssAlgo::getSphereToCartesianVector()
 
 //QList<MatrixXd> RtSssAlgo::getSSSRR(MatrixXd EqnIn, MatrixXd EqnOut, MatrixXd EqnARR, MatrixXd EqnA, MatrixXd EqnB)
 //QList<MatrixXd> RtSssAlgo::getSSSRR(MatrixXd EqnB)
-MatrixXd RtSssAlgo::getSSSRR(MatrixXd EqnB)
+MatrixXd RtSssAlgo::getSSSRR(const MatrixXd &EqnB)
 {
-    int NumBIn, NumBOut, NumCoil, NumExp;
-    MatrixXd EqnRRInv, EqnInv, SSSIn, SSSOut, Weight; //, ErrRel;
-    VectorXd ErrRel;
+    int NumBIn, NumRow, NumExp, NumActive;
+    MatrixXd SSSIn, sol_X, sol_B, sol_WB, sol_Xnew;
+    ArrayXXd Weight, eqn_err, sol_W, sol_err;
+    ArrayXd eqn_scale0;
+    VectorXi active;
     double RR_K1, RR_K2, RR_K3;
-    double eqn_scale0, eqn_scale;
-    MatrixXd sol_X, sol_X_old, eqn_Y, eqn_D, temp_M, temp_N, sol_in, sol_out;
-    MatrixXd diagMat;
-    VectorXd eqn_err, weight_index;
-    QList<MatrixXd> RRsss;
+    double eqn_scale, sol_change;
 
 //  % error tolerance for robust regression
     double ErrTolRel = 1e-3;
@@ -753,127 +809,132 @@ MatrixXd RtSssAlgo::getSSSRR(MatrixXd EqnB)
 //  % weight threshold for robust regression
     double WeightThres = 1 - 1e-6;
 
+//  % maximum number of re-weighting iterations, usually converged after 3-6
+    int MaxIter = 20;
+
 //  % initialization
     NumBIn = EqnIn.cols();
-    NumBOut = EqnOut.cols();
-    NumCoil = EqnB.rows();
+    NumRow = EqnB.rows();
     NumExp = EqnB.cols();
 
-    EqnRRInv = (EqnARR.transpose() * EqnARR).inverse();
-    EqnInv = (EqnA.transpose() * EqnA).inverse();
-
-    SSSIn.setZero(NumCoil,NumExp);
-    SSSOut.setZero(NumCoil,NumExp);
-    Weight.setZero(NumCoil,NumExp);
-    ErrRel.setZero(NumExp);
     RR_K3 = 3;
     RR_K2 = 4.685;
     RR_K1 = qSqrt(1-qSqrt(3)/2) * RR_K2;
 
+//  % all samples of the block are solved at once, EqnARRPinv/EqnARRHat and EqnAPinv/EqnAHat are cached by buildLinearEqn()
+//  % solve OLS solution
+    sol_X = EqnARRPinv * EqnB;
+
+//  % scale linear equation
+    eqn_err = (EqnARR * sol_X - EqnB).array();
+    eqn_scale0 = (eqn_err.rowwise() - eqn_err.colwise().mean()).square().colwise().mean().sqrt().transpose();
     for(int i=0; i<NumExp; i++)
+        if(eqn_scale0(i) > 0)
+            eqn_err.col(i) = eqn_err.col(i).abs() / eqn_scale0(i);
+        else
+            eqn_err.col(i).setZero();
+
+//  % solve iteratively re-weighted least squares (Bi-Square) -- subspace
+//  % only samples which have not converged yet are carried on
+    Weight.setOnes(NumRow, NumExp);
+    active = VectorXi::LinSpaced(NumExp, 0, NumExp-1);
+    NumActive = NumExp;
+
+    for(int iter=0; iter<MaxIter && NumActive>0; iter++)
     {
-//      % solve OLS solution
-        sol_X = EqnRRInv * (EqnARR.transpose() * EqnB.col(i));
-//        std::cout << "sol_X ************************" << endl << sol_X.transpose() << endl;
-
-//      % scale linear equation
-        eqn_err = EqnARR * sol_X - EqnB.col(i);
-        eqn_scale0 = stdev(eqn_err);
-        eqn_err = eqn_err.cwiseAbs() / eqn_scale0;
-
-//      % solve iteratively re-weighted least squares (Bi-Square) -- subspace
-        sol_X_old.setConstant(sol_X.rows(), sol_X.cols(), 1e30);
-//        while (((sol_X-sol_X_old).norm() / sol_X.norm()) > ErrTolRel)
-        int cnt=0;
-        while (((sol_X.array()-sol_X_old.array()).matrix().norm() / sol_X.norm()) > ErrTolRel)
-//        for (int h=0; h<2; h++)
+        sol_B.resize(NumRow, NumActive);
+        sol_err.resize(NumRow, NumActive);
+        for(int j=0; j<NumActive; j++)
         {
-            cnt++;
-//            cout << "while cnt: " << cnt << endl;
-            sol_X_old = sol_X;
-//            Weight(:,i) = (eqn_err <= RR_K1) + (eqn_err > RR_K1 & eqn_err <= RR_K2) .* (1-(eqn_err-RR_K1).^2/(RR_K2-RR_K1)^2).^2;
-//            Weight.col(i) = eigen_LTE(eqn_err, RR_K1) + eigen_AND(eigen_GT(eqn_err, RR_K1),eigen_LTE(eqn_err, RR_K2));
-            Weight.col(i) = eigen_LTE(eqn_err,RR_K1).array() + eigen_AND(eigen_GT(eqn_err,RR_K1),eigen_LTE(eqn_err,RR_K2)).array() * (1 - ((eqn_err.array()-RR_K1).pow(2)) / pow(RR_K2-RR_K1,2) ).pow(2);
-//            std::cout << "Weight **************************" << endl << Weight.transpose() << endl;
-
-//          % weight_index = find(Weight(:,i) < WeightThres);
-            weight_index = eigen_LT_index(Weight.col(i), WeightThres);
-//            weight_index = eigen_LT_index_test(Weight.col(i), h);
-//            std:cout << "weight_index ********************* " << endl << weight_index << endl;
-
-//          % eqn_Y = EqnARR(weight_index,:);   eqn_D = Weight(weight_index,i) - 1;
-            eqn_Y.resize(weight_index.size(), EqnARR.cols());
-            eqn_D.resize(weight_index.size(),1);
-            for(int k=0; k<weight_index.size(); k++)
-            {
-                eqn_Y.row(k) = EqnARR.row(weight_index(k));
-//                std::cout << "eqn_Y: " << eqn_Y.rows() << " x " << eqn_Y.cols() << endl;
-//                std::cout << "eqn_D: "  << eqn_D.rows() << " x " << eqn_D.cols() << endl;
-                eqn_D(k) = Weight(weight_index(k),i) - 1;
-            }
-//              std::cout << "eqn_D: " << endl << eqn_D.transpose() << endl << endl;
-            temp_M = EqnARR.transpose() * (Weight.col(i).array() * EqnB.col(i).array()).matrix();
-//              std::cout << "temp_M: " << endl << temp_M.transpose() << endl << endl;
+            sol_B.col(j) = EqnB.col(active(j));
+            sol_err.col(j) = eqn_err.col(active(j));
+        }
 
-//            std::cout << "EqnRRInv: " << EqnRRInv.rows() << " x " << EqnRRInv.cols() << endl;
-//            std::cout << "eqn_Y: " << eqn_Y.rows() << " x " << eqn_Y.cols() << endl;
-//              std::cout << "EqnRRInv: " << endl << EqnRRInv.transpose() << endl << endl;
-//              std::cout << "eqn_Y: " << endl << eqn_Y.transpose() << endl << endl;
+//      % Weight = (eqn_err <= RR_K1) + (eqn_err > RR_K1 & eqn_err <= RR_K2) .* (1-(eqn_err-RR_K1).^2/(RR_K2-RR_K1)^2).^2;
+        sol_W = (sol_err <= RR_K1).select(1.0, (sol_err <= RR_K2).select((1 - (sol_err-RR_K1).square() / ((RR_K2-RR_K1)*(RR_K2-RR_K1))).square(), 0.0));
 
-            temp_N = EqnRRInv * eqn_Y.transpose();
-//              std::cout << "temp_N: " << endl << temp_N.transpose() << endl << endl;
+//      % temp_M = EqnARR' * (Weight.*EqnB); sol_X = EqnRRInv * temp_M - low-rank update of the down weighted coils
+        sol_WB = (sol_W * sol_B.array()).matrix();
+        sol_X_block(EqnARR, EqnARRPinv, EqnARRHat, sol_W, WeightThres, sol_WB, sol_Xnew);
 
+        sol_err = (EqnARR * sol_Xnew - sol_B).array().abs();
 
-//            diagMat = eqn_D.asDiagonal();
-//        std::cout << "diagMat ************************" << endl << diagMat.transpose() << endl;
-//            diagMat = 1 / diagMat.array();
-//        std::cout << "diagMat ************************" << endl << diagMat.transpose() << endl;
+        int NumStillActive = 0;
+        for(int j=0; j<NumActive; j++)
+        {
+            int i = active(j);
+            eqn_scale = qMin(eqn_scale0(i), RR_K3 * qSqrt((sol_W.col(j) * sol_err.col(j).square()).mean()));
+            if(eqn_scale > 0)
+                eqn_err.col(i) = sol_err.col(j) / eqn_scale;
+            else
+                eqn_err.col(i).setZero();
 
-            diagMat = (1 / eqn_D.array()).matrix().asDiagonal();
-//            cout << "diagMat ************************" << i+1 << endl << diagMat.rows() << " x" << diagMat.cols() << endl;
+            sol_change = (sol_Xnew.col(j) - sol_X.col(i)).norm() / sol_Xnew.col(j).norm();
+            sol_X.col(i) = sol_Xnew.col(j);
+            Weight.col(i) = sol_W.col(j);
 
-            sol_X = EqnRRInv * temp_M - temp_N * (diagMat + eqn_Y * temp_N).inverse() * (temp_N.transpose() * temp_M);
-            eqn_err = (EqnARR * sol_X - EqnB.col(i)).cwiseAbs();
-            eqn_scale = qMin(eqn_scale0, RR_K3 * qSqrt((Weight.col(i).array() * eqn_err.array() * eqn_err.array()).mean()));
-            eqn_err = eqn_err / eqn_scale;
-//             std::cout << "temp_M: " << endl << temp_M.transpose() << endl << endl;
+            if(sol_change > ErrTolRel)
+                active(NumStillActive++) = i;
+        }
+        NumActive = NumStillActive;
+    }
 
-//            std::cout << "(sol_X.array()-sol_X_old.array()).matrix().norm(): " << (sol_X.array()-sol_X_old.array()).matrix().norm() << endl << endl;
-//            std::cout << "sol_X.norm():  " << sol_X.norm()  << endl  << endl;
-//        std::cout << "sol_X ************************" << endl << sol_X.transpose() << endl << endl;
+//  % solve weighted SSS - full
+    sol_WB = (Weight * EqnB.array()).matrix();
+    sol_X_block(EqnA, EqnAPinv, EqnAHat, Weight, WeightThres, sol_WB, sol_X);
 
-        }
-//      % solve weighted SSS - full
-//      % eqn_Y = EqnA(weight_index,:); temp_M = EqnA' * (Weight(:,i).*EqnB(:,i)); temp_N = EqnInv * eqn_Y';
-        eqn_Y.resize(weight_index.size(), NumBIn+NumBOut);
-        for(int k=0; k<weight_index.size(); k++) eqn_Y.row(k) = EqnA.row(weight_index(k));
-        temp_M = EqnA.transpose() * (Weight.col(i).array() * EqnB.col(i).array()).matrix();
-        temp_N = EqnInv * eqn_Y.transpose();
+//  % recover internal MEG siganl
+    SSSIn = EqnIn * sol_X.topRows(NumBIn);
 
+    return SSSIn;
+}
 
-//      % sol_X = EqnInv * temp_M - temp_N * ((diag(1./eqn_D) + eqn_Y * temp_N); // \ (temp_N'*temp_M));
-//        diagMat = eqn_D.asDiagonal();
-//        diagMat = 1 / diagMat.array();
-        diagMat = (1 / eqn_D.array()).matrix().asDiagonal();
-        sol_X = EqnInv * temp_M - temp_N * (diagMat + eqn_Y * temp_N).inverse() * (temp_N.transpose() * temp_M);
+//%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+//% weighted least squares for a block of samples
+//%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+//% Solves (A' W A) X = A' W B for each column, W = diag(Weight(:,j)).
+//% All columns share the cached Pinv = inv(A'A) A' and Hat = A Pinv,
+//% the weights only enter through a Woodbury update of the coils with Weight < WeightThres:
+//% X0 = Pinv*WB;  X = X0 + Pinv(:,idx) * (diag(1/(1-w)) - Hat(idx,idx)) \ (A(idx,:)*X0)
+//%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+void RtSssAlgo::sol_X_block(const MatrixXd &A, const MatrixXd &Pinv, const MatrixXd &Hat, const ArrayXXd &Weight, double WeightThres, const MatrixXd &WB, MatrixXd &X)
+{
+    MatrixXd eqn_S;
+    VectorXd eqn_r;
+    VectorXi idx(Weight.rows());
 
-        ErrRel(i) = (EqnA * sol_X - EqnB.col(i)).norm() / EqnB.col(i).norm();
+    X = Pinv * WB;
 
-        sol_in = sol_X.block(0,0,NumBIn,1);
-        sol_out = sol_X.block(NumBIn,0,NumBOut,1);  // sol_X(NumBIn+1:NumBIn+NumBOut,1);
+    for(int j=0; j<WB.cols(); j++)
+    {
+        int k = 0;
+        for(int i=0; i<Weight.rows(); i++)
+            if(Weight(i,j) < WeightThres)
+                idx(k++) = i;
 
-//      % recover internal/external MEG siganl
-        SSSIn.col(i) = EqnIn * sol_in;
-        SSSOut.col(i) = EqnOut * sol_out;
+        if(k == 0)
+            continue;
 
-    }
-    RRsss.append(SSSIn);
-    RRsss.append(SSSOut);
-    RRsss.append(Weight);
-    RRsss.append(ErrRel);
+        eqn_S.resize(k,k);
+        eqn_r.resize(k);
+        for(int a=0; a<k; a++)
+        {
+            for(int b=0; b<k; b++)
+                eqn_S(a,b) = -Hat(idx(a),idx(b));
+            eqn_S(a,a) += 1 / (1 - Weight(idx(a),j));
+            eqn_r(a) = A.row(idx(a)).dot(X.col(j));
+        }
 
-//    return RRsss;
-    return SSSIn;
+        // eqn_S is positive definite as long as no weight is zero, fall back to LDLT otherwise
+        LLT<MatrixXd> eqn_llt(eqn_S);
+        if(eqn_llt.info() == Success)
+            eqn_r = eqn_llt.solve(eqn_r);
+        else
+            eqn_r = eqn_S.ldlt().solve(eqn_r);
+
+        for(int a=0; a<k; a++)
+            X.col(j) += eqn_r(a) * Pinv.col(idx(a));
+    }
 }
 
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -900,47 +961,11 @@ MatrixXd RtSssAlgo::getSSSRR(MatrixXd EqnB)
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 //QList<MatrixXd> RtSssAlgo::getSSSOLS(MatrixXd EqnIn, MatrixXd EqnOut, MatrixXd EqnA, MatrixXd EqnB)
 //QList<MatrixXd> RtSssAlgo::getSSSOLS(MatrixXd EqnB)
-MatrixXd RtSssAlgo::getSSSOLS(MatrixXd EqnB)
+MatrixXd RtSssAlgo::getSSSOLS(const MatrixXd &EqnB)
 {
-    int NumBIn, NumBOut, NumCoil, NumExp;
-    MatrixXd EqnRRInv, EqnInv, SSSIn, SSSOut;
-    MatrixXd sol_X, sol_in, sol_out;
-    VectorXd ErrRel;
-    QList<MatrixXd> OLSsss;
-
-//  % initialization
-    NumBIn = EqnIn.cols();
-    NumBOut = EqnOut.cols();
-    NumCoil = EqnB.rows();
-    NumExp = EqnB.cols();
-
-    EqnRRInv = (EqnA.transpose() * EqnA).inverse();
-    SSSIn.setZero(NumCoil,NumExp);
-    SSSOut.setZero(NumCoil,NumExp);
-    ErrRel.setZero(NumExp);
-
-    for (int i=0; i<NumExp; i++)
-    {
-//      % solve OLS solution
-        sol_X = EqnRRInv * (EqnA.transpose() * EqnB.col(i));
-
-        ErrRel(i) = (EqnA * sol_X - EqnB.col(i)).norm() / EqnB.col(i).norm();
-
-        sol_in = sol_X.block(0,0,NumBIn,1);
-
-        sol_out = sol_X.block(NumBIn,0, NumBOut,1);    // probably NumBIn+0 is correct.  Please debug !!!!
-
-//      % recover internal/external MEG siganl
-        SSSIn.col(i) = EqnIn * sol_in;
-        SSSOut.col(i) = EqnOut * sol_out;
-    }
-
-    OLSsss.append(SSSIn);
-    OLSsss.append(SSSOut);
-    OLSsss.append(ErrRel);
-
-//    return OLSsss;
-    return SSSIn;
+//  % solve OLS solution and recover internal MEG signal for all samples at once
+//  % SSSOLSOp = EqnIn * pinv(EqnA)(1:NumBIn,:) is cached by buildLinearEqn()
+    return SSSOLSOp * EqnB;
 }
 
 // Return number of meg channels
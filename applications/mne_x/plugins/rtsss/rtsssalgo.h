@@ -101,16 +101,18 @@ public:
 
 //    QList<MatrixXd> getSSSRR(MatrixXd EqnIn, MatrixXd EqnOut, MatrixXd EqnARR, MatrixXd EqnA, MatrixXd EqnB);
 //    QList<MatrixXd> getSSSRR(MatrixXd EqnB);
-    MatrixXd getSSSRR(MatrixXd EqnB);
+    MatrixXd getSSSRR(const MatrixXd &EqnB);
 
 //    QList<MatrixXd> getSSSOLS(MatrixXd EqnIn, MatrixXd EqnOut, MatrixXd EqnA, MatrixXd EqnB);
 //    QList<MatrixXd> getSSSOLS(MatrixXd EqnB);
-    MatrixXd getSSSOLS(MatrixXd EqnB);
+    MatrixXd getSSSOLS(const MatrixXd &EqnB);
 
     QList<MatrixXd> getLinEqn();
 
     void setMEGInfo(FiffInfo::SPtr fiffinfo);
     void setSSSParameter(QList<int>);
+    void setHeadMovThreshold(double transThres, double rotThres);
+    bool updateHeadPosition(const Matrix4d &devHeadT);
     qint32 getNumMEGChan();
     qint32 getNumMEGChanUsed();
     qint32 getNumMEGBadChan();
@@ -125,6 +127,7 @@ private:
     void getSSSBasis(VectorXd, VectorXd, VectorXd, qint32, qint32);
     void getCartesianToSpherCoordinate(VectorXd, VectorXd, VectorXd);
     void getSphereToCartesianVector();
+    static void sol_X_block(const MatrixXd &A, const MatrixXd &Pinv, const MatrixXd &Hat, const ArrayXXd &Weight, double WeightThres, const MatrixXd &WB, MatrixXd &X);
     int strmatch(char, char);
 
     qint32 NumMEGChan, NumCoil, NumBadCoil;
@@ -137,9 +140,12 @@ private:
     MatrixXd MEGData;
 
     qint32 LInRR, LOutRR, LInOLS, LOutOLS;
-    Vector3d Origin;
+    Vector3d Origin, OriginRef;
+    Matrix4d DevHeadT, DevHeadTRef;
+    double HeadMovTransThres, HeadMovRotThres;
     MatrixXd BInX, BInY, BInZ, BOutX, BOutY, BOutZ;
     MatrixXd EqnInRR, EqnOutRR, EqnIn, EqnOut, EqnARR, EqnA, EqnB;
+    MatrixXd EqnARRPinv, EqnARRHat, EqnAPinv, EqnAHat, SSSOLSOp;
 
     VectorXd R, PHI, THETA;
     VectorXd R_X, R_Y, R_Z;
@@ -47,6 +47,7 @@
 #include <xMeas/realtimeevoked.h>
 #include <xMeas/realtimecov.h>
 #include <xMeas/realtimesourceestimate.h>
+#include <xMeas/realtimehpi.h>
 
 
 //*************************************************************************************************************
@@ -164,6 +165,17 @@ bool PluginConnectorConnection::createConnection()
                 bConnected = true;
                 break;
             }
+
+            //Cast to RealTimeHpi
+            QSharedPointer< PluginOutputData<RealTimeHpi> > senderRTHPI = m_pSender->getOutputConnectors()[i].dynamicCast< PluginOutputData<RealTimeHpi> >();
+            QSharedPointer< PluginInputData<RealTimeHpi> > receiverRTHPI = m_pReceiver->getInputConnectors()[j].dynamicCast< PluginInputData<RealTimeHpi> >();
+            if(senderRTHPI && receiverRTHPI)
+            {
+                m_qHashConnections.insert(QPair<QString,QString>(m_pSender->getOutputConnectors()[i]->getName(), m_pReceiver->getInputConnectors()[j]->getName()), connect(m_pSender->getOutputConnectors()[i].data(), &PluginOutputConnector::notify,
+                        m_pReceiver->getInputConnectors()[j].data(), &PluginInputConnector::update, Qt::BlockingQueuedConnection));
+                bConnected = true;
+                break;
+            }
         }
 
         if(bConnected)
@@ -209,6 +221,11 @@ ConnectorDataType PluginConnectorConnection::getDataType(QSharedPointer<PluginCo
     if(RTSE_Out || RTSE_In)
         return ConnectorDataType::_RTSE;
 
+    QSharedPointer< PluginOutputData<XMEASLIB::RealTimeHpi> > RTHPI_Out = pPluginConnector.dynamicCast< PluginOutputData<XMEASLIB::RealTimeHpi> >();
+    QSharedPointer< PluginInputData<XMEASLIB::RealTimeHpi> > RTHPI_In = pPluginConnector.dynamicCast< PluginInputData<XMEASLIB::RealTimeHpi> >();
+    if(RTHPI_Out || RTHPI_In)
+        return ConnectorDataType::_RTHPI;
+
     QSharedPointer< PluginOutputData<XMEASLIB::NewNumeric> > Num_Out = pPluginConnector.dynamicCast< PluginOutputData<XMEASLIB::NewNumeric> >();
     QSharedPointer< PluginInputData<XMEASLIB::NewNumeric> > Num_In = pPluginConnector.dynamicCast< PluginInputData<XMEASLIB::NewNumeric> >();
     if(Num_Out || Num_In)
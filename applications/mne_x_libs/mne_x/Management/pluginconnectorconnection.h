@@ -78,6 +78,7 @@ enum ConnectorDataType
     _RTE,       /**< Real-Time Evoked */
     _RTC,       /**< Real-Time Covariance */
     _RTSE,      /**< Real-Time Source Estimate */
+    _RTHPI,     /**< Real-Time HPI head position */
     _None,      /**< None */
 };
 
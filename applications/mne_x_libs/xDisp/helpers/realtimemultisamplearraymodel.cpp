@@ -231,15 +231,15 @@ void RealTimeMultiSampleArrayModel::setSamplingInfo(float sps, int T, float dest
 
 //*************************************************************************************************************
 
-void RealTimeMultiSampleArrayModel::addData(const QVector<VectorXd> &data)
+void RealTimeMultiSampleArrayModel::addData(const MatrixXd &data)
 {
     //Downsampling ->ToDo make this more accurate
     qint32 i;
-    for(i = m_iCurrentSample; i < data.size(); i += m_iDownsampling)
-        m_dataCurrent.append(data[i]);
+    for(i = m_iCurrentSample; i < data.cols(); i += m_iDownsampling)
+        m_dataCurrent.append(data.col(i));
 
     //store for next buffer
-    m_iCurrentSample = i - data.size();
+    m_iCurrentSample = i - data.cols();
 
     //ToDo separate worker thread? ToDo 2000 -> size of screen
     if(m_dataCurrent.size() > m_iMaxSamples)
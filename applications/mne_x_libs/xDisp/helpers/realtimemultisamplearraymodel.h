@@ -163,11 +163,11 @@ public:
 
     //=========================================================================================================
     /**
-    * Adds multiple time points (QVector) for a channel set (VectorXd)
+    * Adds multiple time points (columns) for a channel set (rows)
     *
-    * @param[in] data       data to add (Time points of channel samples)
+    * @param[in] data       data block to add (channels x samples)
     */
-    void addData(const QVector<VectorXd> &data);
+    void addData(const MatrixXd &data);
 
     //=========================================================================================================
     /**
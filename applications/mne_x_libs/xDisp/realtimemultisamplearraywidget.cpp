@@ -234,7 +234,11 @@ void RealTimeMultiSampleArrayWidget::update(XMEASLIB::NewMeasurement::SPtr)
         }
     }
     else
-        m_pRTMSAModel->addData(m_pRTMSA->getMultiSampleArray());
+    {
+        NewRealTimeMultiSampleArray::BlockConstSPtr t_pMat = m_pRTMSA->getMultiSampleArray();
+        if(t_pMat)
+            m_pRTMSAModel->addData(*t_pMat);
+    }
 }
 
 
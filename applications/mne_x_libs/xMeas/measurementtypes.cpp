@@ -45,6 +45,7 @@
 #include "newrealtimemultisamplearray.h"
 #include "newnumeric.h"
 #include "realtimesourceestimate.h"
+#include "realtimehpi.h"
 
 
 //*************************************************************************************************************
@@ -75,4 +76,5 @@ void MeasurementTypes::registerTypes()
     qRegisterMetaType< NewRealTimeMultiSampleArray::SPtr >("NewRealTimeMultiSampleArray::SPtr");
     qRegisterMetaType< NewNumeric::SPtr >("NewNumeric::SPtr");
     qRegisterMetaType< RealTimeSourceEstimate::SPtr >("RealTimeSourceEstimate::SPtr");
+    qRegisterMetaType< RealTimeHpi::SPtr >("RealTimeHpi::SPtr");
 }
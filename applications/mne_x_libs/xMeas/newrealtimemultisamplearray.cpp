@@ -64,6 +64,7 @@ NewRealTimeMultiSampleArray::NewRealTimeMultiSampleArray(QObject *parent)
 : NewMeasurement(QMetaType::type("NewRealTimeMultiSampleArray::SPtr"), parent)
 , m_dSamplingRate(0)
 , m_iMultiArraySize(10)
+, m_iGatherCols(0)
 , m_bChInfoIsInit(false)
 {
 }
@@ -251,7 +252,11 @@ void NewRealTimeMultiSampleArray::setValue(VectorXd v)
     m_qMutex.lock();
     //check vector size
     if(v.size() != m_qListChInfo.size())
+    {
         qCritical() << "Error Occured in RealTimeMultiSampleArrayNew::setVector: Vector size does not matche the number of channels! ";
+        m_qMutex.unlock();
+        return;
+    }
 
     //ToDo
 //    //Check if maximum exceeded //ToDo speed this up
@@ -263,14 +268,86 @@ void NewRealTimeMultiSampleArray::setValue(VectorXd v)
 
     //Store
     m_vecValue = v;
-    m_matSamples.push_back(m_vecValue);
-    m_qMutex.unlock();
-    if(m_matSamples.size() >= m_iMultiArraySize)
+
+    if(m_matGather.rows() != v.size() || m_matGather.cols() != m_iMultiArraySize)
     {
-        emit notify();
-        m_qMutex.lock();
-        m_matSamples.clear();
+        m_matGather.resize(v.size(), m_iMultiArraySize);
+        m_iGatherCols = 0;
+    }
+
+    m_matGather.col(m_iGatherCols) = m_vecValue;
+    ++m_iGatherCols;
+
+    if(m_iGatherCols >= m_iMultiArraySize)
+        publishBlock();
+    else
+        m_qMutex.unlock();
+}
+
+
+//*************************************************************************************************************
+
+void NewRealTimeMultiSampleArray::setValue(const MatrixXd& mat)
+{
+    if(!m_bChInfoIsInit || mat.cols() == 0)
+        return;
+
+    m_qMutex.lock();
+    //check block size
+    if(mat.rows() != m_qListChInfo.size())
+    {
+        qCritical() << "Error Occured in RealTimeMultiSampleArrayNew::setValue: Block rows do not match the number of channels! ";
+        m_qMutex.unlock();
+        return;
+    }
+
+    m_vecValue = mat.col(mat.cols()-1);
+
+    //Fast path: block already has the multi array size -> hand it out as it is
+    if(m_iGatherCols == 0 && mat.cols() == m_iMultiArraySize)
+    {
+        m_pMatSamples = BlockConstSPtr(new MatrixXd(mat));
         m_qMutex.unlock();
+        emit notify();
+        return;
     }
+
+    //Gather the block column wise into multi array sized blocks
+    qint32 iCol = 0;
+    while(iCol < mat.cols())
+    {
+        if(m_matGather.rows() != mat.rows() || m_matGather.cols() != m_iMultiArraySize)
+        {
+            m_matGather.resize(mat.rows(), m_iMultiArraySize);
+            m_iGatherCols = 0;
+        }
+
+        qint32 iNumCols = qMin(m_iMultiArraySize - m_iGatherCols, (qint32)mat.cols() - iCol);
+        m_matGather.block(0, m_iGatherCols, mat.rows(), iNumCols) = mat.block(0, iCol, mat.rows(), iNumCols);
+        m_iGatherCols += iNumCols;
+        iCol += iNumCols;
+
+        if(m_iGatherCols >= m_iMultiArraySize)
+        {
+            publishBlock();
+            m_qMutex.lock();
+        }
+    }
+    m_qMutex.unlock();
 }
 
+
+//*************************************************************************************************************
+
+void NewRealTimeMultiSampleArray::publishBlock()
+{
+    //Hand the gathered block over to the observers - the next block is gathered into a new allocation, since the
+    //published one is shared by reference and must not change anymore
+    MatrixXd* pMatBlock = new MatrixXd();
+    pMatBlock->swap(m_matGather);
+    m_pMatSamples = BlockConstSPtr(pMatBlock);
+    m_iGatherCols = 0;
+    m_qMutex.unlock();
+
+    emit notify();
+}
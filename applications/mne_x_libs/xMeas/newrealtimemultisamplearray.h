@@ -90,6 +90,7 @@ class XMEASSHARED_EXPORT NewRealTimeMultiSampleArray : public NewMeasurement
 public:
     typedef QSharedPointer<NewRealTimeMultiSampleArray> SPtr;               /**< Shared pointer type for NewRealTimeMultiSampleArray. */
     typedef QSharedPointer<const NewRealTimeMultiSampleArray> ConstSPtr;    /**< Const shared pointer type for NewRealTimeMultiSampleArray. */
+    typedef QSharedPointer<const MatrixXd> BlockConstSPtr;                  /**< Shared pointer type for an immutable channel x sample block. */
 
     //=========================================================================================================
     /**
@@ -207,11 +208,12 @@ public:
 
     //=========================================================================================================
     /**
-    * Returns the gathered multi sample array.
+    * Returns the gathered multi sample array as an immutable channel x sample block. The block is shared by all
+    * observers which are notified about it, it is never modified after the notification.
     *
-    * @return the current multi sample array.
+    * @return the current multi sample array block (channels x samples).
     */
-    inline const QVector< VectorXd >& getMultiSampleArray();
+    inline BlockConstSPtr getMultiSampleArray() const;
 
     //=========================================================================================================
     /**
@@ -221,6 +223,15 @@ public:
     */
     virtual void setValue(VectorXd v);
 
+    //=========================================================================================================
+    /**
+    * Attaches a whole channel x sample block. Blocks which match the multi array size are handed out to the
+    * observers without further gathering, otherwise the columns are gathered until the multi array size is reached.
+    *
+    * @param [in] mat   the block (channels x samples) which is attached to the multi sample array.
+    */
+    virtual void setValue(const MatrixXd& mat);
+
     //=========================================================================================================
     /**
     * Returns the current value set.
@@ -231,6 +242,13 @@ public:
     virtual VectorXd getValue() const;
 
 private:
+    //=========================================================================================================
+    /**
+    * Publishes the gathered block and notifies the attached observers. The mutex has to be locked on entry and is
+    * unlocked on return.
+    */
+    void publishBlock();
+
     mutable QMutex              m_qMutex;           /**< Mutex to ensure thread safety */
 
     FiffInfo::SPtr              m_pFiffInfo_orig;   /**< Original Fiff Info if initialized by fiff info. */
@@ -238,8 +256,10 @@ private:
     QString                     m_sXMLLayoutFile;   /**< Layout file name. */
     double                      m_dSamplingRate;    /**< Sampling rate of the RealTimeSampleArray.*/
     VectorXd                    m_vecValue;         /**< The current attached sample vector.*/
-    qint32                      m_iMultiArraySize; /**< Sample size of the multi sample array.*/
-    QVector< VectorXd >         m_matSamples;       /**< The multi sample array.*/
+    qint32                      m_iMultiArraySize;  /**< Sample size of the multi sample array.*/
+    MatrixXd                    m_matGather;        /**< Block which gathers the incoming samples until the multi array size is reached.*/
+    qint32                      m_iGatherCols;      /**< Number of samples already gathered in m_matGather.*/
+    BlockConstSPtr              m_pMatSamples;      /**< The published multi sample array block.*/
     QList<RealTimeSampleArrayChInfo> m_qListChInfo; /**< Channel info list.*/
     bool                        m_bChInfoIsInit;    /**< If channel info is initialized.*/
 };
@@ -253,7 +273,8 @@ private:
 inline void NewRealTimeMultiSampleArray::clear()
 {
     QMutexLocker locker(&m_qMutex);
-    m_matSamples.clear();
+    m_iGatherCols = 0;
+    m_pMatSamples.clear();
 }
 
 
@@ -353,9 +374,10 @@ qint32 NewRealTimeMultiSampleArray::getMultiArraySize() const
 
 //*************************************************************************************************************
 
-inline const QVector< VectorXd >& NewRealTimeMultiSampleArray::getMultiSampleArray()
+inline NewRealTimeMultiSampleArray::BlockConstSPtr NewRealTimeMultiSampleArray::getMultiSampleArray() const
 {
-    return m_matSamples;
+    QMutexLocker locker(&m_qMutex);
+    return m_pMatSamples;
 }
 
 } // NAMESPACE
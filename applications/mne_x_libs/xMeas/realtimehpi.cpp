@@ -0,0 +1,112 @@
+//=============================================================================================================
+/**
+* @file     realtimehpi.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Contains the implementation of the RealTimeHpi class.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "realtimehpi.h"
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace XMEASLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+RealTimeHpi::RealTimeHpi(QObject *parent)
+: NewMeasurement(QMetaType::type("RealTimeHpi::SPtr"), parent)
+, m_pDevHeadT(new FiffCoordTrans)
+, m_bInitialized(false)
+{
+}
+
+
+//*************************************************************************************************************
+
+RealTimeHpi::~RealTimeHpi()
+{
+}
+
+
+//*************************************************************************************************************
+
+FiffCoordTrans::SPtr& RealTimeHpi::getValue()
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_pDevHeadT;
+}
+
+
+//*************************************************************************************************************
+
+MatrixX3d RealTimeHpi::getCoils() const
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_matCoils;
+}
+
+
+//*************************************************************************************************************
+
+VectorXd RealTimeHpi::getGof() const
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_vecGof;
+}
+
+
+//*************************************************************************************************************
+
+void RealTimeHpi::setValue(FiffCoordTrans& v, const MatrixX3d& p_matCoils, const VectorXd& p_vecGof)
+{
+    m_qMutex.lock();
+    //Store
+    *m_pDevHeadT = v;
+    m_matCoils = p_matCoils;
+    m_vecGof = p_vecGof;
+    m_bInitialized = true;
+    m_qMutex.unlock();
+
+    emit notify();
+}
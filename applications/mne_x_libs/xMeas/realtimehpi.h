@@ -0,0 +1,178 @@
+//=============================================================================================================
+/**
+* @file     realtimehpi.h
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Contains the declaration of the RealTimeHpi class.
+*
+*/
+
+#ifndef REALTIMEHPI_H
+#define REALTIMEHPI_H
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "xmeas_global.h"
+#include "newmeasurement.h"
+
+#include <fiff/fiff_coord_trans.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Qt INCLUDES
+//=============================================================================================================
+
+#include <QSharedPointer>
+#include <QMutex>
+#include <QMutexLocker>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINE NAMESPACE XMEASLIB
+//=============================================================================================================
+
+namespace XMEASLIB
+{
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+
+//=========================================================================================================
+/**
+* DECLARE CLASS RealTimeHpi
+*
+* @brief The RealTimeHpi class distributes the device to head transform of continuous head position tracking,
+* together with the fitted HPI coil positions it was derived from.
+*/
+class XMEASSHARED_EXPORT RealTimeHpi : public NewMeasurement
+{
+    Q_OBJECT
+public:
+    typedef QSharedPointer<RealTimeHpi> SPtr;               /**< Shared pointer type for RealTimeHpi. */
+    typedef QSharedPointer<const RealTimeHpi> ConstSPtr;    /**< Const shared pointer type for RealTimeHpi. */
+
+    //=========================================================================================================
+    /**
+    * Constructs a RealTimeHpi.
+    */
+    explicit RealTimeHpi(QObject *parent = 0);
+
+    //=========================================================================================================
+    /**
+    * Destroys the RealTimeHpi.
+    */
+    virtual ~RealTimeHpi();
+
+    //=========================================================================================================
+    /**
+    * New head position to distribute
+    *
+    * @param [in] v             the device to head transform which should be distributed.
+    * @param [in] p_matCoils    fitted HPI coil positions in device coordinates, one coil per row.
+    * @param [in] p_vecGof      goodness of fit of the coils.
+    */
+    virtual void setValue(FiffCoordTrans& v, const MatrixX3d& p_matCoils, const VectorXd& p_vecGof);
+
+    //=========================================================================================================
+    /**
+    * Returns the current value set.
+    * This method is inherited by Measurement.
+    *
+    * @return the last attached device to head transform.
+    */
+    virtual FiffCoordTrans::SPtr& getValue();
+
+    //=========================================================================================================
+    /**
+    * Returns the fitted HPI coil positions in device coordinates of the last value set.
+    *
+    * @return the coil positions, one coil per row.
+    */
+    MatrixX3d getCoils() const;
+
+    //=========================================================================================================
+    /**
+    * Returns the goodness of fit of the coils of the last value set.
+    *
+    * @return the goodness of fit of each coil.
+    */
+    VectorXd getGof() const;
+
+    //=========================================================================================================
+    /**
+    * Returns whether RealTimeHpi contains values
+    *
+    * @return whether RealTimeHpi contains values.
+    */
+    inline bool isInitialized() const;
+
+private:
+    mutable QMutex          m_qMutex;       /**< Mutex to ensure thread safety */
+    FiffCoordTrans::SPtr    m_pDevHeadT;    /**< Device to head transform */
+    MatrixX3d               m_matCoils;     /**< Fitted coil positions in device coordinates */
+    VectorXd                m_vecGof;       /**< Goodness of fit of the coils */
+    bool                    m_bInitialized; /**< If values are stored.*/
+};
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline bool RealTimeHpi::isInitialized() const
+{
+    QMutexLocker locker(&m_qMutex);
+    return m_bInitialized;
+}
+
+} // NAMESPACE
+
+Q_DECLARE_METATYPE(XMEASLIB::RealTimeHpi::SPtr)
+
+#endif // REALTIMEHPI_H
@@ -86,6 +86,7 @@ SOURCES += \
     measurementtypes.cpp \
     realtimeevoked.cpp \
     realtimecov.cpp \
+    realtimehpi.cpp \
     frequencyspectrum.cpp
 
 
@@ -100,6 +101,7 @@ HEADERS += \
     measurementtypes.h \
     realtimeevoked.h \
     realtimecov.h \
+    realtimehpi.h \
     frequencyspectrum.h
 
 
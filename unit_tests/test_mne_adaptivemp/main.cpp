@@ -0,0 +1,198 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Regression test of the adaptive matching pursuit on a known multichannel gabor atom.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/mp/atom.h>
+#include <utils/mp/adaptivemp.h>
+
+#include <stdio.h>
+#include <cstdlib>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define SAMPLE_COUNT    512
+#define CHANNEL_COUNT   3
+#define ITERATIONS      8
+
+
+//*************************************************************************************************************
+
+/**
+* Parameters of a simulated gabor atom, shared by all channels except for amplitude and phase.
+*/
+struct SimAtom
+{
+    qreal scale;
+    qint32 translation;
+    qreal modulation;
+    qreal amplitudes[CHANNEL_COUNT];
+    qreal phases[CHANNEL_COUNT];
+};
+
+
+//*************************************************************************************************************
+
+void addAtom(MatrixXd &p_matSignal, const SimAtom &p_atom)
+{
+    GaborAtom t_gaborAtom;
+    for(qint32 chn = 0; chn < CHANNEL_COUNT; chn++)
+        p_matSignal.col(chn) += p_atom.amplitudes[chn] * t_gaborAtom.create_real(SAMPLE_COUNT, p_atom.scale, p_atom.translation, p_atom.modulation, p_atom.phases[chn]);
+}
+
+
+//*************************************************************************************************************
+
+bool checkAtom(const GaborAtom &p_found, const SimAtom &p_atom, qreal p_dScaleTol, qint32 p_iTranslationTol, qreal p_dModulationTol, qreal p_dAmplitudeTol, const char* p_sName)
+{
+    bool t_bPassed = qAbs(p_found.scale - p_atom.scale) <= p_dScaleTol * p_atom.scale
+            && qAbs(p_found.translation - p_atom.translation) <= p_iTranslationTol
+            && qAbs(p_found.modulation - p_atom.modulation) <= p_dModulationTol
+            && p_found.max_scalar_list.size() == CHANNEL_COUNT;
+
+    //the scalar products carry the channel amplitudes, the sign goes into the phase
+    qreal t_dMaxAmpError = 0;
+    for(qint32 chn = 0; t_bPassed && chn < CHANNEL_COUNT; chn++)
+        t_dMaxAmpError = qMax(t_dMaxAmpError, qAbs(p_found.max_scalar_list.at(chn) - qAbs(p_atom.amplitudes[chn])) / qAbs(p_atom.amplitudes[chn]));
+    t_bPassed = t_bPassed && t_dMaxAmpError <= p_dAmplitudeTol;
+
+    printf("%-12s scale %7.3f (%5.1f), translation %4d (%4d), modulation %8.3f (%6.1f), amplitude error %8.2e %s\n",
+           p_sName, p_found.scale, p_atom.scale, p_found.translation, p_atom.translation, p_found.modulation, p_atom.modulation, t_dMaxAmpError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    std::srand(42);
+
+    //a dominant atom, off the dyadic grid of scales and modulations, a weaker one and a little noise
+    const SimAtom t_atomA = {45.0, 200, 60.3, {10.0, -6.0, 4.0}, {0.3, 1.2, 2.5}};
+    const SimAtom t_atomB = {16.0, 400, 150.0, {3.0, 2.0, -2.5}, {2.0, 0.1, 4.0}};
+
+    MatrixXd t_matSignal = 0.01 * MatrixXd::Random(SAMPLE_COUNT, CHANNEL_COUNT);
+    addAtom(t_matSignal, t_atomA);
+    addAtom(t_matSignal, t_atomB);
+
+    AdaptiveMp t_adaptiveMp;
+    QList<GaborAtom> t_qListAtoms = t_adaptiveMp.matching_pursuit(t_matSignal, ITERATIONS, 0.0);
+
+    if(t_qListAtoms.size() < 2)
+    {
+        printf("Only %d atoms found!\n", t_qListAtoms.size());
+        return 1;
+    }
+
+    bool t_bPassed = true;
+
+    //
+    // Parameters of the two simulated atoms
+    //
+    t_bPassed &= checkAtom(t_qListAtoms.at(0), t_atomA, 0.05, 1, 0.1, 0.02, "first atom");
+    t_bPassed &= checkAtom(t_qListAtoms.at(1), t_atomB, 0.1, 1, 0.25, 0.05, "second atom");
+
+    //
+    // Residual energy: decreases with every atom, by exactly the energy of that atom
+    //
+    qreal t_dEnergy = t_matSignal.squaredNorm();
+    qreal t_dMaxBalanceError = 0;
+    bool t_bMonotonic = true;
+    for(qint32 i = 0; i < t_qListAtoms.size(); i++)
+    {
+        qreal t_dResEnergy = t_qListAtoms.at(i).residuum.squaredNorm();
+        t_bMonotonic &= t_dResEnergy < t_dEnergy;
+        t_dMaxBalanceError = qMax(t_dMaxBalanceError, qAbs(t_dEnergy - t_qListAtoms.at(i).energy - t_dResEnergy) / t_matSignal.squaredNorm());
+        t_dEnergy = t_dResEnergy;
+    }
+
+    //the two atoms hold all but the noise
+    qreal t_dExplained = 1.0 - t_qListAtoms.at(1).residuum.squaredNorm() / t_matSignal.squaredNorm();
+
+    bool t_bEnergyPassed = t_bMonotonic && t_dMaxBalanceError < 1e-9 && t_dExplained > 0.99;
+    printf("residual     %d atoms, monotonic %s, energy balance error %8.2e, explained by two atoms %8.6f %s\n",
+           t_qListAtoms.size(), t_bMonotonic ? "yes" : "no", t_dMaxBalanceError, t_dExplained, t_bEnergyPassed ? "ok" : "FAILED");
+    t_bPassed &= t_bEnergyPassed;
+
+    return t_bPassed ? 0 : 1;
+}
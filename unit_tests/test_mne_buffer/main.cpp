@@ -0,0 +1,174 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     October, 2014
+*
+* @section  LICENSE
+*
+* Copyright (C) 2014, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Micro-benchmark of CircularMatrixBuffer against the lock-free RingMatrixBuffer.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <generics/circularmatrixbuffer.h>
+#include <generics/ringmatrixbuffer.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QFuture>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace IOBuffer;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define NUM_CHANNELS    400
+#define NUM_SAMPLES     100
+#define NUM_MATRICES    64
+#define NUM_ITERATIONS  20000
+
+
+//*************************************************************************************************************
+
+void produceCircular(CircularMatrixBuffer<double>* pBuffer, const MatrixXd* pMat)
+{
+    for(qint32 i = 0; i < NUM_ITERATIONS; ++i)
+        pBuffer->push(pMat);
+}
+
+
+//*************************************************************************************************************
+
+void produceRing(RingMatrixBuffer<double>* pBuffer, const MatrixXd* pMat)
+{
+    for(qint32 i = 0; i < NUM_ITERATIONS; ++i)
+        pBuffer->push(pMat);
+}
+
+
+//*************************************************************************************************************
+
+void printResult(const char* p_sName, qint64 p_iNsecs)
+{
+    double t_dSecs = p_iNsecs * 1e-9;
+    double t_dMBytes = (double)NUM_ITERATIONS * NUM_CHANNELS * NUM_SAMPLES * sizeof(double) / (1024.0*1024.0);
+    printf("%-24s %10.2f ms %10.2f us/matrix %10.1f MB/s\n", p_sName, t_dSecs * 1e3, p_iNsecs * 1e-3 / NUM_ITERATIONS, t_dMBytes / t_dSecs);
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    MatrixXd t_matIn = MatrixXd::Random(NUM_CHANNELS, NUM_SAMPLES);
+    QElapsedTimer t_timer;
+
+    printf("Producer/consumer benchmark: %d channels x %d samples, %d matrices\n\n", NUM_CHANNELS, NUM_SAMPLES, NUM_ITERATIONS);
+
+    //
+    // CircularMatrixBuffer - element wise copy, semaphore per element count
+    //
+    {
+        CircularMatrixBuffer<double> t_buffer(NUM_MATRICES, NUM_CHANNELS, NUM_SAMPLES);
+        MatrixXd t_matOut;
+
+        t_timer.start();
+        QFuture<void> t_future = QtConcurrent::run(produceCircular, &t_buffer, &t_matIn);
+        for(qint32 i = 0; i < NUM_ITERATIONS; ++i)
+            t_matOut = t_buffer.pop();
+        t_future.waitForFinished();
+        printResult("CircularMatrixBuffer", t_timer.nsecsElapsed());
+    }
+
+    //
+    // RingMatrixBuffer - lock-free, one memcpy per matrix, pop into preallocated matrix
+    //
+    {
+        RingMatrixBuffer<double> t_buffer(NUM_MATRICES, NUM_CHANNELS, NUM_SAMPLES);
+        MatrixXd t_matOut(NUM_CHANNELS, NUM_SAMPLES);
+
+        t_timer.start();
+        QFuture<void> t_future = QtConcurrent::run(produceRing, &t_buffer, &t_matIn);
+        for(qint32 i = 0; i < NUM_ITERATIONS; ++i)
+            t_buffer.pop(t_matOut);
+        t_future.waitForFinished();
+        printResult("RingMatrixBuffer", t_timer.nsecsElapsed());
+
+        if(!t_matOut.isApprox(t_matIn))
+        {
+            printf("RingMatrixBuffer returned corrupted data!\n");
+            return 1;
+        }
+    }
+
+    return 0;
+}
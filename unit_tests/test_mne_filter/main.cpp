@@ -0,0 +1,195 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Regression test of the streaming overlap-save filter against direct convolution.
+*
+*/
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/filterdata.h>
+#include <utils/overlapsavefilter.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QList>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define NUM_CHANNELS    16
+#define NUM_SAMPLES     6000
+#define BLOCK_SIZE      200
+
+
+//*************************************************************************************************************
+/**
+* Causal time domain convolution of each row with p_vecCoeffs, starting from a zero state.
+*/
+MatrixXd convolve(const MatrixXd &p_matData, const RowVectorXd &p_vecCoeffs)
+{
+    MatrixXd t_matOut = MatrixXd::Zero(p_matData.rows(), p_matData.cols());
+    for(qint32 n = 0; n < p_matData.cols(); ++n)
+        for(qint32 k = 0; k < p_vecCoeffs.cols() && k <= n; ++k)
+            t_matOut.col(n) += p_vecCoeffs[k]*p_matData.col(n - k);
+    return t_matOut;
+}
+
+
+//*************************************************************************************************************
+/**
+* Streams p_matData through p_filter in blocks of varying length.
+*/
+template<typename _Tp>
+Matrix<_Tp, Dynamic, Dynamic> stream(OverlapSaveFilter<_Tp> &p_filter, const Matrix<_Tp, Dynamic, Dynamic> &p_matData)
+{
+    const qint32 t_aBlockSizes[] = {BLOCK_SIZE, 37, BLOCK_SIZE, 1, 3*BLOCK_SIZE + 11, BLOCK_SIZE - 1};
+
+    Matrix<_Tp, Dynamic, Dynamic> t_matOut(p_matData.rows(), p_matData.cols());
+    Matrix<_Tp, Dynamic, Dynamic> t_matBlock;
+    qint32 t_iCol = 0;
+    for(qint32 i = 0; t_iCol < p_matData.cols(); ++i)
+    {
+        qint32 t_iNum = qMin(t_aBlockSizes[i % 6], (qint32)p_matData.cols() - t_iCol);
+        p_filter.filter(p_matData.middleCols(t_iCol, t_iNum), t_matBlock);
+        t_matOut.middleCols(t_iCol, t_iNum) = t_matBlock;
+        t_iCol += t_iNum;
+    }
+    return t_matOut;
+}
+
+
+//*************************************************************************************************************
+
+bool check(const char* p_sName, const MatrixXd &p_matResult, const MatrixXd &p_matReference, double p_dTol)
+{
+    double t_dRelError = (p_matResult - p_matReference).norm() / p_matReference.norm();
+    bool t_bPassed = t_dRelError < p_dTol;
+
+    printf("%-40s relative error %10.3e %s\n", p_sName, t_dRelError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    srand(42);
+    MatrixXd t_matData = MatrixXd::Random(NUM_CHANNELS, NUM_SAMPLES);
+
+    //
+    //   Band pass cascaded with a notch
+    //
+    QList<FilterData> t_qListFilters;
+    t_qListFilters << FilterData(QString("BPF"), FilterData::BPF, 80, 0.2, 0.2, 0.05, 512);
+    t_qListFilters << FilterData(QString("NOTCH"), FilterData::NOTCH, 64, 0.25, 0.05, 0.05, 512);
+
+    MatrixXd t_matReference = convolve(convolve(t_matData, t_qListFilters[0].m_dCoeffA), t_qListFilters[1].m_dCoeffA);
+
+    printf("Overlap-save filter: %d channels x %d samples\n\n", NUM_CHANNELS, NUM_SAMPLES);
+
+    bool t_bPassed = true;
+
+    //
+    //   Streaming, double and single precision
+    //
+    OverlapSaveFilterd t_filterDouble(t_qListFilters, NUM_CHANNELS, BLOCK_SIZE);
+    t_bPassed &= check("streamed cascade, double", stream(t_filterDouble, t_matData), t_matReference, 1e-10);
+
+    t_filterDouble.reset();
+    t_bPassed &= check("streamed cascade after reset, double", stream(t_filterDouble, t_matData), t_matReference, 1e-10);
+
+    OverlapSaveFilterf t_filterFloat(t_qListFilters, NUM_CHANNELS, BLOCK_SIZE);
+    MatrixXf t_matDataFloat = t_matData.cast<float>();
+    t_bPassed &= check("streamed cascade, float", stream(t_filterFloat, t_matDataFloat).cast<double>(), t_matReference, 1e-4);
+
+    //
+    //   Block filtering of FilterData against the single row version
+    //
+    FilterData t_filterData(QString("BPF"), FilterData::BPF, 80, 0.2, 0.2, 0.05, 512);
+    MatrixXd t_matWindow = t_matData.leftCols(512 - 80);
+    MatrixXd t_matRows(NUM_CHANNELS, 512 - 80);
+    for(qint32 i = 0; i < NUM_CHANNELS; ++i)
+    {
+        RowVectorXd t_vecRow = t_matWindow.row(i);
+        t_matRows.row(i) = t_filterData.applyFFTFilter(t_vecRow);
+    }
+    t_bPassed &= check("FilterData block against rows", t_filterData.applyFFTFilter(t_matWindow), t_matRows, 1e-12);
+
+    return t_bPassed ? 0 : 1;
+}
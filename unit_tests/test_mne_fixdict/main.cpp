@@ -0,0 +1,300 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Regression test of the binary, memory mapped matching pursuit dictionaries.
+*
+*/
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/mp/atom.h>
+#include <utils/mp/fixdict.h>
+#include <utils/mp/fixdictmp.h>
+
+#include <stdio.h>
+#include <string.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define SAMPLE_COUNT    64
+#define PARAM_COUNT     5       /**< Doubles per atom in the parameter table. */
+
+
+//*************************************************************************************************************
+
+bool check(const char* p_sName, bool p_bPassed)
+{
+    printf("%-48s %s\n", p_sName, p_bPassed ? "ok" : "FAILED");
+    return p_bPassed;
+}
+
+
+//*************************************************************************************************************
+/**
+* Reverses the bytes of p_iCount elements of p_iSize bytes each.
+*/
+void swapBytes(char* p_pData, qint32 p_iSize, qint64 p_iCount)
+{
+    for(qint64 i = 0; i < p_iCount; ++i, p_pData += p_iSize)
+        for(qint32 j = 0; j < p_iSize/2; ++j)
+            qSwap(p_pData[j], p_pData[p_iSize-1-j]);
+}
+
+
+//*************************************************************************************************************
+
+bool sameParameters(const FixDict::AtomParameters &p_a, const FixDict::AtomParameters &p_b)
+{
+    return p_a.scale == p_b.scale && p_a.translation == p_b.translation && p_a.modulation == p_b.modulation
+            && p_a.phase == p_b.phase && p_a.chirp == p_b.chirp;
+}
+
+
+//*************************************************************************************************************
+
+bool sameDictionary(const FixDict &p_dict, const MatrixXf &p_matAtoms, const QVector<FixDict::AtomParameters> &p_vecParams)
+{
+    if(!p_dict.isOpen() || p_dict.atomCount() != p_matAtoms.cols() || p_dict.sampleCount() != p_matAtoms.rows())
+        return false;
+
+    for(qint32 i = 0; i < p_vecParams.size(); ++i)
+        if(!sameParameters(p_dict.parameters(i), p_vecParams[i]))
+            return false;
+
+    return (p_dict.atoms() - p_matAtoms).cwiseAbs().maxCoeff() < 1e-6f;
+}
+
+
+//*************************************************************************************************************
+/**
+* Checks that the atoms found by the matching pursuit are p_a and p_b, shifted by p_iLagA and p_iLagB samples.
+*/
+bool recovered(const QList<GaborAtom> &p_listAtoms, const FixDict::AtomParameters &p_a, qint32 p_iLagA, const FixDict::AtomParameters &p_b, qint32 p_iLagB)
+{
+    if(p_listAtoms.size() < 2)
+        return false;
+
+    const GaborAtom &t_first = p_listAtoms[0];
+    const GaborAtom &t_second = p_listAtoms[1];
+
+    return t_first.scale == p_a.scale && t_first.modulation == p_a.modulation && t_first.translation == p_a.translation + p_iLagA
+            && t_second.scale == p_b.scale && t_second.modulation == p_b.modulation && t_second.translation == p_b.translation + p_iLagB;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QTemporaryDir t_tmpDir;
+    if(!t_tmpDir.isValid())
+    {
+        printf("Could not create a temporary directory!\n");
+        return 1;
+    }
+
+    bool t_bPassed = true;
+
+    //
+    //   Gabor dictionary: 4 scales x 16 translations x 16 modulations
+    //
+    const qreal t_aScales[] = {4, 8, 16, 32};
+    QVector<FixDict::AtomParameters> t_vecParams;
+    for(qint32 s = 0; s < 4; ++s)
+        for(qint32 t = 0; t < SAMPLE_COUNT; t += 4)
+            for(qint32 m = 0; m < SAMPLE_COUNT/2; m += 2)
+            {
+                FixDict::AtomParameters t_params = {t_aScales[s], double(t), double(m), 0.0, 0.0};
+                t_vecParams.append(t_params);
+            }
+
+    GaborAtom t_gaborAtom;
+    MatrixXf t_matAtoms(SAMPLE_COUNT, t_vecParams.size());
+    for(qint32 i = 0; i < t_vecParams.size(); ++i)
+        t_matAtoms.col(i) = t_gaborAtom.create_real(SAMPLE_COUNT, t_vecParams[i].scale, quint32(t_vecParams[i].translation), t_vecParams[i].modulation, t_vecParams[i].phase).cast<float>();
+
+    printf("FixDict: %d atoms x %d samples\n\n", t_vecParams.size(), SAMPLE_COUNT);
+
+    //
+    //   Write and reopen
+    //
+    QString t_sBinDict = t_tmpDir.path() + "/gabor.bin";
+    t_bPassed &= check("write", FixDict::write(t_sBinDict, t_matAtoms, t_vecParams));
+    t_bPassed &= check("isBinary", FixDict::isBinary(t_sBinDict));
+
+    FixDict t_dict;
+    t_bPassed &= check("open", t_dict.open(t_sBinDict));
+    t_bPassed &= check("atoms and parameters after reopening", sameDictionary(t_dict, t_matAtoms, t_vecParams));
+
+    //
+    //   Other byte order: swap header, parameter table and atoms of the written file
+    //
+    QFile t_qFile(t_sBinDict);
+    t_qFile.open(QIODevice::ReadOnly);
+    QByteArray t_bytes = t_qFile.readAll();
+    t_qFile.close();
+
+    //header: magic, version, byte order, atom count, sample count, param count (32 bit), param and atom offset (64 bit)
+    qint64 t_iParamOffset, t_iAtomOffset;
+    memcpy(&t_iParamOffset, t_bytes.constData() + 6*sizeof(quint32), sizeof(qint64));
+    memcpy(&t_iAtomOffset, t_bytes.constData() + 6*sizeof(quint32) + sizeof(qint64), sizeof(qint64));
+
+    swapBytes(t_bytes.data(), sizeof(quint32), 6);
+    swapBytes(t_bytes.data() + 6*sizeof(quint32), sizeof(qint64), 2);
+    swapBytes(t_bytes.data() + t_iParamOffset, sizeof(double), qint64(t_vecParams.size())*PARAM_COUNT);
+    swapBytes(t_bytes.data() + t_iAtomOffset, sizeof(float), qint64(t_matAtoms.size()));
+
+    QString t_sSwappedDict = t_tmpDir.path() + "/gabor_swapped.bin";
+    QFile t_qSwappedFile(t_sSwappedDict);
+    t_qSwappedFile.open(QIODevice::WriteOnly);
+    t_qSwappedFile.write(t_bytes);
+    t_qSwappedFile.close();
+
+    FixDict t_swappedDict;
+    t_bPassed &= check("open other byte order", t_swappedDict.open(t_sSwappedDict));
+    t_bPassed &= check("atoms and parameters of other byte order", sameDictionary(t_swappedDict, t_matAtoms, t_vecParams));
+
+    //
+    //   Text dictionary of the dictionary editor, atoms of different length
+    //
+    FixDict::AtomParameters t_textParams[2] = {{8.0, 0.0, 3.0, 0.5, 0.0}, {4.0, 0.0, 5.0, 0.0, 0.0}};
+    const qint32 t_aTextLengths[2] = {32, 40};
+
+    MatrixXf t_matTextAtoms = MatrixXf::Zero(40, 2);
+    QVector<FixDict::AtomParameters> t_vecTextParams;
+
+    QString t_sTextDict = t_tmpDir.path() + "/editor.dict";
+    QFile t_qTextFile(t_sTextDict);
+    t_qTextFile.open(QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream t_textStream(&t_qTextFile);
+    t_textStream.setRealNumberPrecision(9);
+    for(qint32 i = 0; i < 2; ++i)
+    {
+        VectorXd t_vecAtom = t_gaborAtom.create_real(t_aTextLengths[i], t_textParams[i].scale, t_aTextLengths[i]/2, t_textParams[i].modulation, t_textParams[i].phase);
+        t_matTextAtoms.col(i).head(t_aTextLengths[i]) = t_vecAtom.cast<float>();
+        t_vecTextParams.append(t_textParams[i]);
+
+        t_textStream << "editor_ATOM_" << i << "\n";
+        t_textStream << "scale: " << t_textParams[i].scale << " modu: " << t_textParams[i].modulation << " phase: " << t_textParams[i].phase << " chrip: " << t_textParams[i].chirp << "\n";
+        for(qint32 n = 0; n < t_vecAtom.size(); ++n)
+            t_textStream << t_vecAtom[n] << "\n";
+    }
+    t_textStream.flush();
+    t_qTextFile.close();
+
+    QString t_sConvertedDict = t_tmpDir.path() + "/editor.bin";
+    t_bPassed &= check("text dictionary is not binary", !FixDict::isBinary(t_sTextDict));
+    t_bPassed &= check("convert text dictionary", FixDict::convert(t_sTextDict, t_sConvertedDict));
+
+    FixDict t_convertedDict;
+    t_bPassed &= check("open converted dictionary", t_convertedDict.open(t_sConvertedDict));
+    t_bPassed &= check("converted atoms zero padded, parameters", sameDictionary(t_convertedDict, t_matTextAtoms, t_vecTextParams));
+
+    //
+    //   Matching pursuit on two known atoms, signal of atom length and a longer signal with shifted atoms
+    //
+    const qint32 t_iAtomA = 1*256 + 4*16 + 4;     // scale 8, translation 16, modulation 8
+    const qint32 t_iAtomB = 2*256 + 11*16 + 10;   // scale 16, translation 44, modulation 20
+
+    VectorXd t_vecSignal = 3.0*t_matAtoms.col(t_iAtomA).cast<double>() + 1.5*t_matAtoms.col(t_iAtomB).cast<double>();
+
+    FixDictMp t_fixDictMp;
+    QList<GaborAtom> t_listAtoms = t_fixDictMp.matching_pursuit(t_dict, t_vecSignal, 2);
+    t_bPassed &= check("matching pursuit recovers both atoms", recovered(t_listAtoms, t_vecParams[t_iAtomA], 0, t_vecParams[t_iAtomB], 0));
+
+    VectorXd t_vecLongSignal = VectorXd::Zero(2*SAMPLE_COUNT);
+    t_vecLongSignal.segment(20, SAMPLE_COUNT) += 3.0*t_matAtoms.col(t_iAtomA).cast<double>();
+    t_vecLongSignal.segment(50, SAMPLE_COUNT) += 1.5*t_matAtoms.col(t_iAtomB).cast<double>();
+
+    t_listAtoms = t_fixDictMp.matching_pursuit(t_dict, t_vecLongSignal, 2);
+
+    //the modulation is reported relative to the signal length
+    FixDict::AtomParameters t_paramsA = t_vecParams[t_iAtomA];
+    FixDict::AtomParameters t_paramsB = t_vecParams[t_iAtomB];
+    t_paramsA.modulation *= 2;
+    t_paramsB.modulation *= 2;
+    t_bPassed &= check("matching pursuit recovers both shifted atoms", recovered(t_listAtoms, t_paramsA, 20, t_paramsB, 50));
+
+    printf("\n%s\n", t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Accuracy regression test of the single precision minimum norm path against the double path.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_evoked.h>
+#include <mne/mne_inverse_operator.h>
+#include <mne/mne_sourceestimate.h>
+#include <inverse/minimumNorm/minimumnorm.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace INVERSELIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_REL_ERROR   1e-4
+
+
+//*************************************************************************************************************
+
+bool compare(MinimumNorm &p_minimumNorm, MinimumNorm::KernelMode p_eMode, const char* p_sMethod, const FiffEvoked &p_evoked, float p_fTmin, float p_fTstep)
+{
+    p_minimumNorm.setMethod(QString(p_sMethod));
+    p_minimumNorm.setKernelMode(p_eMode);
+
+    p_minimumNorm.setKernelPrecision(MinimumNorm::DoublePrecision);
+    MNESourceEstimate t_stcDouble = p_minimumNorm.calculateInverse(p_evoked.data, p_fTmin, p_fTstep);
+
+    p_minimumNorm.setKernelPrecision(MinimumNorm::SinglePrecision);
+    MatrixXf t_matDataF = p_evoked.data.cast<float>();
+    MNESourceEstimate t_stcFloat = p_minimumNorm.calculateInverse(t_matDataF, p_fTmin, p_fTstep);
+
+    if(t_stcDouble.isEmpty() || t_stcFloat.isEmpty() || t_stcDouble.data.rows() != t_stcFloat.data.rows() || t_stcDouble.data.cols() != t_stcFloat.data.cols())
+    {
+        printf("%-8s %-9s source estimates do not match in size!\n", p_sMethod, p_eMode == MinimumNorm::DenseKernel ? "dense" : "factored");
+        return false;
+    }
+
+    double t_dRelError = (t_stcFloat.data - t_stcDouble.data).norm() / t_stcDouble.data.norm();
+    double t_dMaxError = (t_stcFloat.data - t_stcDouble.data).cwiseAbs().maxCoeff() / t_stcDouble.data.cwiseAbs().maxCoeff();
+
+    bool t_bPassed = t_dRelError < MAX_REL_ERROR && t_dMaxError < MAX_REL_ERROR;
+    printf("%-8s %-9s relative error %10.3e, max error %10.3e %s\n", p_sMethod, p_eMode == MinimumNorm::DenseKernel ? "dense" : "factored", t_dRelError, t_dMaxError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile t_fileEvoked("./MNE-sample-data/MEG/sample/sample_audvis-ave.fif");
+    QFile t_fileInv("./MNE-sample-data/MEG/sample/sample_audvis-meg-eeg-oct-6-meg-eeg-inv.fif");
+
+    //
+    //   Read the data and the inverse operator
+    //
+    QPair<QVariant, QVariant> baseline(QVariant(), 0);
+    FiffEvoked t_evoked(t_fileEvoked, 0, baseline);
+    if(t_evoked.isEmpty())
+    {
+        printf("Could not read the evoked data!\n");
+        return 1;
+    }
+
+    MNEInverseOperator t_inverseOperator(t_fileInv);
+
+    if(!t_inverseOperator.check_ch_names(t_evoked.info))
+    {
+        printf("Channel name check failed!\n");
+        return 1;
+    }
+
+    float snr = 3.0f;
+    float lambda2 = 1.0f / (snr*snr);
+
+    MinimumNorm t_minimumNorm(t_inverseOperator, lambda2, QString("MNE"));
+    t_minimumNorm.doInverseSetup(t_evoked.nave, false);
+
+    FiffEvoked t_evokedPicked = t_evoked.pick_channels(t_minimumNorm.getPreparedInverseOperator().noise_cov->names);
+    float tmin = ((float)t_evokedPicked.first) / t_evokedPicked.info.sfreq;
+    float tstep = 1/t_evokedPicked.info.sfreq;
+
+    printf("Single against double precision inverse: %d channels x %d samples\n\n", (int)t_evokedPicked.data.rows(), (int)t_evokedPicked.data.cols());
+
+    //
+    //   Compare all methods for both kernel modes
+    //
+    const char* t_sMethods[] = {"MNE", "dSPM", "sLORETA"};
+    bool t_bPassed = true;
+    for(qint32 i = 0; i < 3; ++i)
+    {
+        t_bPassed &= compare(t_minimumNorm, MinimumNorm::DenseKernel, t_sMethods[i], t_evokedPicked, tmin, tstep);
+        t_bPassed &= compare(t_minimumNorm, MinimumNorm::FactoredKernel, t_sMethods[i], t_evokedPicked, tmin, tstep);
+    }
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Synthetic 306 channel test of the continuous HPI coil localization (HpiFit).
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_constants.h>
+#include <hpifit.h>
+
+#include <stdio.h>
+#include <cstdlib>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QtCore/qmath.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+using namespace RtHpiPlugin;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define N_LOCATIONS     102     /**< Sensor locations, each with a magnetometer and two planar gradiometers. */
+#define HELMET_RADIUS   0.13    /**< Radius of the synthetic helmet [m]. */
+#define BASELINE        0.0168  /**< Baseline of the planar gradiometers [m]. */
+#define SFREQ           1000.0
+#define WINDOW          200
+#define MAX_COIL_ERROR  1e-5    /**< 0.01 mm */
+#define MAX_ROT_ERROR   1e-4    /**< Frobenius norm of the rotation difference. */
+#define MIN_GOF         0.99
+
+
+//*************************************************************************************************************
+
+FiffInfo makeHelmet()
+{
+    FiffInfo t_info;
+    t_info.sfreq = SFREQ;
+
+    //Fibonacci points on the upper part of a sphere, the normal points outwards
+    const double t_dGolden = M_PI*(3.0 - sqrt(5.0));
+    for(qint32 l = 0; l < N_LOCATIONS; ++l)
+    {
+        double z = 1.0 - 1.2*(l + 0.5)/N_LOCATIONS;
+        double r = sqrt(1.0 - z*z);
+        Vector3d ez(r*cos(t_dGolden*l), r*sin(t_dGolden*l), z);
+        Vector3d ex = ez.unitOrthogonal();
+        Vector3d ey = ez.cross(ex);
+
+        for(qint32 k = 0; k < 3; ++k)
+        {
+            //planar gradiometers along ex and ey, a magnetometer
+            FiffChInfo t_ch;
+            t_ch.scanno = 3*l + k + 1;
+            t_ch.logno = t_ch.scanno;
+            t_ch.kind = FIFFV_MEG_CH;
+            t_ch.coord_frame = FIFFV_COORD_DEVICE;
+            t_ch.coil_type = k < 2 ? FIFFV_COIL_VV_PLANAR_T1 : FIFFV_COIL_VV_MAG_T3;
+            t_ch.ch_name = QString("MEG %1%2").arg(l + 1, 3, 10, QChar('0')).arg(k + 1);
+
+            t_ch.coil_trans = Matrix4d::Identity();
+            t_ch.coil_trans.block(0,0,3,1) = k == 1 ? ey : ex;
+            t_ch.coil_trans.block(0,1,3,1) = k == 1 ? Vector3d(-ex) : ey;
+            t_ch.coil_trans.block(0,2,3,1) = ez;
+            t_ch.coil_trans.block(0,3,3,1) = HELMET_RADIUS*ez;
+
+            t_info.chs.append(t_ch);
+            t_info.ch_names.append(t_ch.ch_name);
+        }
+    }
+
+    //a stim channel, which is not picked
+    FiffChInfo t_stim;
+    t_stim.kind = FIFFV_STIM_CH;
+    t_stim.ch_name = QString("STI 014");
+    t_info.chs.append(t_stim);
+    t_info.ch_names.append(t_stim.ch_name);
+
+    t_info.nchan = t_info.chs.size();
+
+    return t_info;
+}
+
+
+//*************************************************************************************************************
+
+Matrix4d makeTrans(double p_dRotX, double p_dRotZ, const Vector3d &p_vecTrans)
+{
+    Matrix4d t_matTrans = Matrix4d::Identity();
+    t_matTrans.block(0,0,3,3) = (AngleAxisd(p_dRotZ, Vector3d::UnitZ())*AngleAxisd(p_dRotX, Vector3d::UnitX())).toRotationMatrix();
+    t_matTrans.block(0,3,3,1) = p_vecTrans;
+    return t_matTrans;
+}
+
+
+//*************************************************************************************************************
+
+Vector3d dipoleField(const Vector3d &p_vecPos, const Vector3d &p_vecMoment, const Vector3d &p_vecDipole)
+{
+    //free space field of a magnetic dipole: mu0/4pi * (3 (m.R) R / |R|^5 - m / |R|^3)
+    Vector3d R = p_vecPos - p_vecDipole;
+    double r = R.norm();
+    return 1e-7*(3.0*p_vecMoment.dot(R)*R/pow(r, 5) - p_vecMoment/pow(r, 3));
+}
+
+
+//*************************************************************************************************************
+
+MatrixXd simulate(const FiffInfo &p_info, const MatrixX3d &p_matDevCoils, const QVector<double> &p_vecFreqs)
+{
+    //every coil oscillates at its own frequency with its own phase; the sensors see a DC offset, too
+    MatrixXd t_matData = MatrixXd::Zero(p_info.nchan, WINDOW);
+
+    for(qint32 c = 0; c < p_matDevCoils.rows(); ++c)
+    {
+        Vector3d t_vecMoment = Vector3d(0.3*c - 0.4, 0.5, 1.0).normalized()*1e-7;
+        Vector3d t_vecCoil = p_matDevCoils.row(c).transpose();
+        double t_dPhase = 0.7*c;
+
+        for(qint32 i = 0; i < p_info.nchan; ++i)
+        {
+            const FiffChInfo &t_ch = p_info.chs[i];
+            if(t_ch.kind != FIFFV_MEG_CH)
+                continue;
+
+            Vector3d r0 = t_ch.coil_trans.block(0,3,3,1);
+            Vector3d ex = t_ch.coil_trans.block(0,0,3,1);
+            Vector3d ez = t_ch.coil_trans.block(0,2,3,1);
+
+            double t_dAmp;
+            if(t_ch.coil_type == FIFFV_COIL_VV_MAG_T3)
+                t_dAmp = ez.dot(dipoleField(r0, t_vecMoment, t_vecCoil));
+            else
+                t_dAmp = ez.dot(dipoleField(r0 + 0.5*BASELINE*ex, t_vecMoment, t_vecCoil) - dipoleField(r0 - 0.5*BASELINE*ex, t_vecMoment, t_vecCoil))/BASELINE;
+
+            for(qint32 k = 0; k < WINDOW; ++k)
+                t_matData(i, k) += t_dAmp*cos(2*M_PI*p_vecFreqs[c]*k/SFREQ + t_dPhase);
+        }
+    }
+
+    //sensor offsets and white noise of 20 fT (magnetometers) or 20 fT/cm (gradiometers)
+    for(qint32 i = 0; i < p_info.nchan; ++i)
+    {
+        if(p_info.chs[i].kind != FIFFV_MEG_CH)
+            continue;
+        double t_dNoise = p_info.chs[i].coil_type == FIFFV_COIL_VV_MAG_T3 ? 2e-14 : 2e-12;
+        t_matData.row(i).array() += 1e-12*(i % 7) + t_dNoise*sqrt(3.0)*ArrayXd::Random(WINDOW).transpose();
+    }
+
+    return t_matData;
+}
+
+
+//*************************************************************************************************************
+
+bool testFit(HpiFit &p_hpiFit, const FiffInfo &p_info, const MatrixX3d &p_matHeadCoils, const QVector<double> &p_vecFreqs, const Matrix4d &p_matDevHead, const char* p_sName)
+{
+    //true coil positions in device coordinates
+    Matrix4d t_matHeadDev = p_matDevHead.inverse();
+    MatrixX3d t_matDevCoils(p_matHeadCoils.rows(), 3);
+    for(qint32 c = 0; c < p_matHeadCoils.rows(); ++c)
+        t_matDevCoils.row(c) = (t_matHeadDev.block(0,0,3,3)*p_matHeadCoils.row(c).transpose() + t_matHeadDev.block(0,3,3,1)).transpose();
+
+    MatrixXd t_matData = simulate(p_info, t_matDevCoils, p_vecFreqs);
+
+    FiffCoordTrans t_devHeadT;
+    MatrixX3d t_matCoils;
+    VectorXd t_vecGof;
+    bool t_bFitted = p_hpiFit.fit(t_matData, t_devHeadT, t_matCoils, t_vecGof);
+
+    double t_dCoilError = t_bFitted ? (t_matCoils - t_matDevCoils).rowwise().norm().maxCoeff() : 1.0;
+    double t_dMinGof = t_bFitted ? t_vecGof.minCoeff() : 0.0;
+
+    //the transform is stored in float
+    Matrix4d t_matFit = t_devHeadT.trans.cast<double>();
+    double t_dRotError = t_bFitted ? (t_matFit.block(0,0,3,3) - p_matDevHead.block(0,0,3,3)).norm() : 1.0;
+    double t_dTransError = t_bFitted ? (t_matFit.block(0,3,3,1) - p_matDevHead.block(0,3,3,1)).norm() : 1.0;
+
+    bool t_bPassed = t_bFitted
+            && t_devHeadT.from == FIFFV_COORD_DEVICE && t_devHeadT.to == FIFFV_COORD_HEAD
+            && t_dCoilError < MAX_COIL_ERROR && t_dMinGof > MIN_GOF
+            && t_dRotError < MAX_ROT_ERROR && t_dTransError < MAX_COIL_ERROR;
+
+    printf("%-10s coil error %8.2e m, min gof %8.6f, rotation error %8.2e, translation error %8.2e m %s\n", p_sName, t_dCoilError, t_dMinGof, t_dRotError, t_dTransError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    std::srand(42);
+
+    FiffInfo t_info = makeHelmet();
+
+    //four digitized HPI coils in head coordinates
+    MatrixX3d t_matHeadCoils(4, 3);
+    t_matHeadCoils <<  0.05,  0.05, 0.02,
+                      -0.05,  0.05, 0.02,
+                       0.06, -0.03, 0.04,
+                      -0.06, -0.03, 0.04;
+    for(qint32 c = 0; c < t_matHeadCoils.rows(); ++c)
+    {
+        FiffDigPoint t_point;
+        t_point.kind = FIFFV_POINT_HPI;
+        t_point.ident = c + 1;
+        t_point.coord_frame = FIFFV_COORD_HEAD;
+        for(qint32 k = 0; k < 3; ++k)
+            t_point.r[k] = t_matHeadCoils(c, k);
+        t_info.dig.append(t_point);
+    }
+
+    //the fit starts from a stale transform, 5 mm and a few degrees off
+    Matrix4d t_matDevHead = makeTrans(0.08, 0.05, Vector3d(0.001, 0.012, -0.04));
+    Matrix4d t_matStale = makeTrans(0.03, 0.0, Vector3d(0.004, 0.009, -0.042));
+    t_info.dev_head_t.from = FIFFV_COORD_DEVICE;
+    t_info.dev_head_t.to = FIFFV_COORD_HEAD;
+    t_info.dev_head_t.trans = t_matStale.cast<float>();
+    t_info.dev_head_t.invtrans = t_matStale.inverse().cast<float>();
+
+    QVector<double> t_vecFreqs;
+    t_vecFreqs << 293.0 << 307.0 << 314.0 << 321.0;
+
+    HpiFit t_hpiFit;
+    if(!t_hpiFit.init(t_info, t_vecFreqs, WINDOW))
+    {
+        printf("HpiFit::init failed!\n");
+        return 1;
+    }
+
+    bool t_bPassed = true;
+
+    //cold start from the stale transform, then warm starts while the head moves
+    t_bPassed &= testFit(t_hpiFit, t_info, t_matHeadCoils, t_vecFreqs, t_matDevHead, "cold");
+    t_bPassed &= testFit(t_hpiFit, t_info, t_matHeadCoils, t_vecFreqs, makeTrans(0.09, 0.04, Vector3d(0.002, 0.011, -0.039)), "moved");
+    t_bPassed &= testFit(t_hpiFit, t_info, t_matHeadCoils, t_vecFreqs, makeTrans(0.06, 0.07, Vector3d(-0.001, 0.015, -0.042)), "moved");
+
+    //after a reset the fit starts from the digitized positions again
+    t_hpiFit.reset();
+    t_bPassed &= testFit(t_hpiFit, t_info, t_matHeadCoils, t_vecFreqs, t_matDevHead, "reset");
+
+    return t_bPassed ? 0 : 1;
+}
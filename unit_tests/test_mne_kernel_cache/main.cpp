@@ -0,0 +1,188 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Regression test of the minimum norm kernel cache against MNEInverseOperator::assemble_kernel.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_evoked.h>
+#include <fs/label.h>
+#include <mne/mne_inverse_operator.h>
+#include <inverse/minimumNorm/minimumnorm.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FSLIB;
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace INVERSELIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_REL_ERROR   1e-6
+
+
+//*************************************************************************************************************
+
+double relError(const MatrixXd &p_matA, const MatrixXd &p_matRef)
+{
+    if(p_matA.rows() != p_matRef.rows() || p_matA.cols() != p_matRef.cols())
+        return 1.0;
+    if(p_matRef.size() == 0)
+        return 0.0;
+    return (p_matA - p_matRef).norm() / p_matRef.norm();
+}
+
+
+//*************************************************************************************************************
+
+bool compare(MinimumNorm &p_minimumNorm, MNEInverseOperator &p_inverseOperator, qint32 p_iNave, float p_fLambda2, const char* p_sMethod, const char* p_sPass)
+{
+    p_minimumNorm.setRegularization(p_fLambda2);
+    p_minimumNorm.setMethod(QString(p_sMethod));
+
+    MatrixXd t_matK = p_minimumNorm.getKernel();
+    SparseMatrix<double> t_noiseNorm = p_minimumNorm.getPreparedInverseOperator().noisenorm;
+
+    //
+    //   Reference: the full preparation and kernel assembly of MNEInverseOperator
+    //
+    QString t_sMethod(p_sMethod);
+    MNEInverseOperator t_inv = p_inverseOperator.prepare_inverse_operator(p_iNave, p_fLambda2, t_sMethod == "dSPM", t_sMethod == "sLORETA");
+    MatrixXd t_matKRef;
+    SparseMatrix<double> t_noiseNormRef;
+    QList<VectorXi> t_qListVertno;
+    Label t_label;
+    if(!t_inv.assemble_kernel(t_label, t_sMethod, false, t_matKRef, t_noiseNormRef, t_qListVertno))
+    {
+        printf("%-7s %-8s lambda2 %6.4f reference kernel could not be assembled!\n", p_sPass, p_sMethod, p_fLambda2);
+        return false;
+    }
+
+    double t_dKernelError = relError(t_matK, t_matKRef);
+
+    VectorXd t_vecNoiseNorm = t_noiseNorm.nonZeros() > 0 ? VectorXd(t_noiseNorm.diagonal()) : VectorXd();
+    VectorXd t_vecNoiseNormRef = t_noiseNormRef.nonZeros() > 0 ? VectorXd(t_noiseNormRef.diagonal()) : VectorXd();
+    double t_dNoiseNormError = relError(t_vecNoiseNorm, t_vecNoiseNormRef);
+
+    bool t_bPassed = t_dKernelError < MAX_REL_ERROR && t_dNoiseNormError < MAX_REL_ERROR;
+    printf("%-7s %-8s lambda2 %6.4f kernel error %10.3e, noise norm error %10.3e %s\n", p_sPass, p_sMethod, p_fLambda2, t_dKernelError, t_dNoiseNormError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile t_fileEvoked("./MNE-sample-data/MEG/sample/sample_audvis-ave.fif");
+    QFile t_fileInv("./MNE-sample-data/MEG/sample/sample_audvis-meg-eeg-oct-6-meg-eeg-inv.fif");
+
+    //
+    //   Read the data and the inverse operator
+    //
+    QPair<QVariant, QVariant> baseline(QVariant(), 0);
+    FiffEvoked t_evoked(t_fileEvoked, 0, baseline);
+    if(t_evoked.isEmpty())
+    {
+        printf("Could not read the evoked data!\n");
+        return 1;
+    }
+
+    MNEInverseOperator t_inverseOperator(t_fileInv);
+
+    //
+    //   All six settings fit into the cache -> the second pass is served from the cache only
+    //
+    MinimumNorm t_minimumNorm(t_inverseOperator, 1.0f/9.0f, QString("MNE"));
+    t_minimumNorm.setKernelCacheSize(6);
+    t_minimumNorm.doInverseSetup(t_evoked.nave, false);
+
+    const float t_fLambdas[] = {1.0f/9.0f, 1.0f};
+    const char* t_sMethods[] = {"MNE", "dSPM", "sLORETA"};
+    const char* t_sPasses[] = {"compute", "cached"};
+
+    bool t_bPassed = true;
+    for(qint32 p = 0; p < 2; ++p)
+        for(qint32 l = 0; l < 2; ++l)
+            for(qint32 m = 0; m < 3; ++m)
+                t_bPassed &= compare(t_minimumNorm, t_inverseOperator, t_evoked.nave, t_fLambdas[l], t_sMethods[m], t_sPasses[p]);
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,269 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Benchmark of the KMeans engine on the region gain matrices clustered by cluster_forward_solution.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fs/annotationset.h>
+#include <mne/mne.h>
+#include <utils/kmeans.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FSLIB;
+using namespace MNELIB;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define CLUSTER_SIZE    20
+#define SEED            42
+#define SUMD_TOLERANCE  0.05    /**< Allowed relative excess of the total sqeuclidean sum of distances over the Lloyd reference. */
+
+
+//*************************************************************************************************************
+/**
+* Reference Lloyd iteration which evaluates all point to centroid distances in every iteration.
+*/
+double lloyd(const MatrixXd &p_matX, qint32 p_iK, qint32 p_iMaxIt)
+{
+    qsrand(SEED);
+    const qint32 n = p_matX.rows();
+    MatrixXd C(p_iK, p_matX.cols());
+    for(qint32 i = 0; i < p_iK; ++i)
+        C.row(i) = p_matX.row(qrand() % n);
+
+    VectorXi idx = VectorXi::Constant(n, -1);
+    double t_dSumD = 0;
+    for(qint32 it = 0; it < p_iMaxIt; ++it)
+    {
+        bool t_bMoved = false;
+        t_dSumD = 0;
+        for(qint32 i = 0; i < n; ++i)
+        {
+            qint32 t_iMin;
+            t_dSumD += (C.rowwise() - p_matX.row(i)).rowwise().squaredNorm().minCoeff(&t_iMin);
+            if(t_iMin != idx[i])
+            {
+                idx[i] = t_iMin;
+                t_bMoved = true;
+            }
+        }
+        if(!t_bMoved)
+            break;
+
+        MatrixXd C_new = MatrixXd::Zero(p_iK, p_matX.cols());
+        VectorXi counts = VectorXi::Zero(p_iK);
+        for(qint32 i = 0; i < n; ++i)
+        {
+            C_new.row(idx[i]) += p_matX.row(i);
+            ++counts[idx[i]];
+        }
+        for(qint32 j = 0; j < p_iK; ++j)
+            if(counts[j] > 0)
+                C.row(j) = C_new.row(j) / counts[j];
+    }
+    return t_dSumD;
+}
+
+
+//*************************************************************************************************************
+
+/**
+* Clusters all regions and prints the timing. Returns false if any region failed, the total sum of distances is
+* returned in p_dSumD.
+*/
+bool run(const char* p_sName, const QList<MatrixXd> &p_qListRegions, const QString &p_sDistance, const QString &p_sStart, bool p_bOnline, double &p_dSumD)
+{
+    QElapsedTimer t_timer;
+    double t_dSumD = 0;
+    qint32 t_iFailed = 0;
+
+    t_timer.start();
+    for(qint32 r = 0; r < p_qListRegions.size(); ++r)
+    {
+        KMeans t_kMeans(p_sDistance, p_sStart, 1, QString("error"), p_bOnline);
+        t_kMeans.setSeed(SEED);
+
+        VectorXi idx;
+        MatrixXd ctrs, D;
+        VectorXd sumd;
+        qint32 nClusters = ceil((double)p_qListRegions[r].rows()/(double)CLUSTER_SIZE);
+        if(t_kMeans.calculate(p_qListRegions[r], nClusters, idx, ctrs, sumd, D))
+            t_dSumD += sumd.sum();
+        else
+            ++t_iFailed;
+    }
+    qint64 t_iNsecs = t_timer.nsecsElapsed();
+
+    printf("%-32s %10.2f ms   total sum of distances %14.6e   failed %d\n", p_sName, t_iNsecs * 1e-6, t_dSumD, t_iFailed);
+
+    p_dSumD = t_dSumD;
+    return t_iFailed == 0;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile t_fileFwd("./MNE-sample-data/MEG/sample/sample_audvis-meg-eeg-oct-6-fwd.fif");
+    AnnotationSet t_annotationSet("sample", 2, "aparc.a2009s", "./MNE-sample-data/subjects");
+
+    MNEForwardSolution t_Fwd(t_fileFwd);
+    if(t_Fwd.isEmpty() || t_annotationSet.size() < 2)
+    {
+        printf("Could not read the forward solution or the annotation!\n");
+        return 1;
+    }
+
+    //
+    //   Region gain matrices as cluster_forward_solution feeds them to KMeans: sources x sensors(x,y,z)
+    //
+    QList<MatrixXd> t_qListRegions;
+    qint32 t_iOffset = 0;
+    for(qint32 h = 0; h < t_Fwd.src.size(); ++h)
+    {
+        VectorXi t_vecLabelIds = t_annotationSet[h].getColortable().getLabelIds();
+        VectorXi t_vecVertexLabelIds = t_annotationSet[h].getLabelIds();
+
+        for(qint32 i = 0; i < t_vecLabelIds.size(); ++i)
+        {
+            if(t_vecLabelIds[i] == 0)
+                continue;
+
+            QList<qint32> t_qListSources;
+            for(qint32 j = 0; j < t_Fwd.src[h].vertno.size(); ++j)
+                if(t_vecVertexLabelIds[t_Fwd.src[h].vertno[j]] == t_vecLabelIds[i])
+                    t_qListSources.append(j);
+
+            if(t_qListSources.isEmpty())
+                continue;
+
+            qint32 nSens = t_Fwd.sol->data.rows();
+            MatrixXd t_matRegion(t_qListSources.size(), 3*nSens);
+            for(qint32 k = 0; k < t_qListSources.size(); ++k)
+                for(qint32 j = 0; j < nSens; ++j)
+                    t_matRegion.block(k, 3*j, 1, 3) = t_Fwd.sol->data.block(j, 3*(t_qListSources[k] + t_iOffset), 1, 3);
+
+            t_qListRegions.append(t_matRegion);
+        }
+        t_iOffset += t_Fwd.src[h].nuse;
+    }
+
+    qint32 t_iSources = 0;
+    for(qint32 r = 0; r < t_qListRegions.size(); ++r)
+        t_iSources += t_qListRegions[r].rows();
+    printf("KMeans benchmark: %d regions, %d sources, %d dimensions, cluster size %d\n\n", t_qListRegions.size(), t_iSources, (int)t_qListRegions[0].cols(), CLUSTER_SIZE);
+
+    //
+    //   Reference: full distance evaluation in every iteration
+    //
+    QElapsedTimer t_timer;
+    t_timer.start();
+    double t_dSumD = 0;
+    for(qint32 r = 0; r < t_qListRegions.size(); ++r)
+        t_dSumD += lloyd(t_qListRegions[r], ceil((double)t_qListRegions[r].rows()/(double)CLUSTER_SIZE), 100);
+    printf("%-32s %10.2f ms   total sum of distances %14.6e\n", "reference lloyd sqeuclidean", t_timer.nsecsElapsed() * 1e-6, t_dSumD);
+
+    //
+    //   KMeans with bounds, batch phase only and with online phase
+    //
+    bool t_bPassed = true;
+    double t_dRunSumD;
+
+    t_bPassed &= run("sqeuclidean sample batch", t_qListRegions, "sqeuclidean", "sample", false, t_dRunSumD);
+    t_bPassed &= t_dRunSumD <= (1.0 + SUMD_TOLERANCE)*t_dSumD;
+    t_bPassed &= run("sqeuclidean plus batch", t_qListRegions, "sqeuclidean", "plus", false, t_dRunSumD);
+    t_bPassed &= t_dRunSumD <= (1.0 + SUMD_TOLERANCE)*t_dSumD;
+    t_bPassed &= run("sqeuclidean sample", t_qListRegions, "sqeuclidean", "sample", true, t_dRunSumD);
+    t_bPassed &= t_dRunSumD <= (1.0 + SUMD_TOLERANCE)*t_dSumD;
+    t_bPassed &= run("sqeuclidean plus", t_qListRegions, "sqeuclidean", "plus", true, t_dRunSumD);
+    t_bPassed &= t_dRunSumD <= (1.0 + SUMD_TOLERANCE)*t_dSumD;
+
+    //cityblock minimizes a different objective, only failures count
+    t_bPassed &= run("cityblock sample batch", t_qListRegions, "cityblock", "sample", false, t_dRunSumD);
+    t_bPassed &= run("cityblock sample", t_qListRegions, "cityblock", "sample", true, t_dRunSumD);
+    t_bPassed &= run("cityblock plus", t_qListRegions, "cityblock", "plus", true, t_dRunSumD);
+
+    printf("\n%s\n", t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed ? 0 : 1;
+}
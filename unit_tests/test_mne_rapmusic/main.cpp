@@ -0,0 +1,195 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Regression test of the RAP MUSIC streaming mode against the regular localization.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fs/annotationset.h>
+#include <fiff/fiff_evoked.h>
+#include <mne/mne_forwardsolution.h>
+#include <mne/mne_sourceestimate.h>
+#include <inverse/rapMusic/rapmusic.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FSLIB;
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace INVERSELIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define NUM_DIPOLE_PAIRS    3
+#define WINDOW_SAMPLES      60
+#define WINDOW_OVERLAP      0.5f
+#define MAX_REL_ERROR       1e-6    /**< Exact projections: only the subspace computation differs. */
+#define MAX_REL_ERROR_REUSE 1e-2    /**< Reused projections may stem from a slightly different orientation. */
+
+
+//*************************************************************************************************************
+
+bool compare(const char* p_sName, const MNESourceEstimate &p_stc, const MNESourceEstimate &p_stcRef, double p_dTol)
+{
+    if(p_stc.isEmpty() || p_stcRef.isEmpty() || p_stc.data.rows() != p_stcRef.data.rows() || p_stc.data.cols() != p_stcRef.data.cols())
+    {
+        printf("%-36s source estimates do not match in size! FAILED\n", p_sName);
+        return false;
+    }
+
+    //the same dipole pairs: the same nonzero sources in every sample
+    qint32 t_iMismatches = 0;
+    for(qint32 t = 0; t < p_stcRef.data.cols(); ++t)
+        for(qint32 i = 0; i < p_stcRef.data.rows(); ++i)
+            if((p_stc.data(i, t) != 0.0) != (p_stcRef.data(i, t) != 0.0))
+                ++t_iMismatches;
+
+    double t_dMaxError = (p_stc.data - p_stcRef.data).cwiseAbs().maxCoeff() / p_stcRef.data.cwiseAbs().maxCoeff();
+
+    bool t_bPassed = t_iMismatches == 0 && t_dMaxError < p_dTol;
+    printf("%-36s %d mismatching sources, max error %10.3e %s\n", p_sName, t_iMismatches, t_dMaxError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile t_fileFwd("./MNE-sample-data/MEG/sample/sample_audvis-meg-eeg-oct-6-fwd.fif");
+    QFile t_fileEvoked("./MNE-sample-data/MEG/sample/sample_audvis-ave.fif");
+    AnnotationSet t_annotationSet("./MNE-sample-data/subjects/sample/label/lh.aparc.a2009s.annot", "./MNE-sample-data/subjects/sample/label/rh.aparc.a2009s.annot");
+
+    //
+    //   Read the data and the clustered forward solution
+    //
+    QPair<QVariant, QVariant> baseline(QVariant(), 0);
+    FiffEvoked t_evoked(t_fileEvoked, 0, baseline);
+    if(t_evoked.isEmpty())
+    {
+        printf("Could not read the evoked data!\n");
+        return 1;
+    }
+
+    MNEForwardSolution t_Fwd(t_fileFwd);
+    if(t_Fwd.isEmpty() || t_annotationSet.isEmpty())
+    {
+        printf("Could not read the forward solution or the atlas!\n");
+        return 1;
+    }
+
+    MNEForwardSolution t_clusteredFwd = t_Fwd.cluster_forward_solution(t_annotationSet, 40);
+    FiffEvoked t_evokedPicked = t_evoked.pick_channels(t_clusteredFwd.info.ch_names);
+
+    printf("RAP MUSIC streaming against regular mode: %d channels x %d samples, windows of %d samples with %.0f%% overlap\n\n",
+           (int)t_evokedPicked.data.rows(), (int)t_evokedPicked.data.cols(), WINDOW_SAMPLES, 100.0f*WINDOW_OVERLAP);
+
+    //
+    //   Regular localization of every window
+    //
+    RapMusic t_rapMusic(t_clusteredFwd, false, NUM_DIPOLE_PAIRS);
+    t_rapMusic.setStcAttr(WINDOW_SAMPLES, WINDOW_OVERLAP);
+    MNESourceEstimate t_stcRef = t_rapMusic.calculateInverse(t_evokedPicked);
+
+    //
+    //   Streaming: incremental scatter updates of the overlapping windows, projections only reused for
+    //   identical orientations
+    //
+    bool t_bPassed = true;
+
+    RapMusic t_rapMusicExact(t_clusteredFwd, false, NUM_DIPOLE_PAIRS);
+    t_rapMusicExact.setStcAttr(WINDOW_SAMPLES, WINDOW_OVERLAP);
+    t_rapMusicExact.setStreaming(true, 0.0);
+    t_bPassed &= compare("streaming, exact projections", t_rapMusicExact.calculateInverse(t_evokedPicked), t_stcRef, MAX_REL_ERROR);
+
+    //
+    //   Streaming with the default orientation tolerance for reusing projections
+    //
+    RapMusic t_rapMusicStreaming(t_clusteredFwd, false, NUM_DIPOLE_PAIRS);
+    t_rapMusicStreaming.setStcAttr(WINDOW_SAMPLES, WINDOW_OVERLAP);
+    t_rapMusicStreaming.setStreaming(true);
+    t_bPassed &= compare("streaming", t_rapMusicStreaming.calculateInverse(t_evokedPicked), t_stcRef, MAX_REL_ERROR_REUSE);
+
+    //a repeated call starts from the cached projections of the last window
+    t_bPassed &= compare("streaming, repeated call", t_rapMusicStreaming.calculateInverse(t_evokedPicked), t_stcRef, MAX_REL_ERROR_REUSE);
+
+    printf("\n%s\n", t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed ? 0 : 1;
+}
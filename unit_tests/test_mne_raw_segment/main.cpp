@@ -0,0 +1,352 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Test of the memory mapped raw segment reader against the tag by tag fallback.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QBuffer>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define SEGMENT_SEC         10.0f   /**< Length of the rewritten INT, FLOAT and PACK16 files. */
+#define WRITE_BUFFER_SIZE   997     /**< Samples per buffer of the rewritten files, off the grid of the original. */
+#define BENCHMARK_SEC       10.0f   /**< Segment length of the benchmark reads. */
+#define MAX_REL_ERROR       1e-12
+#define MIN_THROUGHPUT      1e9     /**< Bytes of raw buffers decoded per second, checked with --benchmark. */
+
+
+//*************************************************************************************************************
+
+double relError(const MatrixXd &p_matA, const MatrixXd &p_matRef)
+{
+    if(p_matA.rows() != p_matRef.rows() || p_matA.cols() != p_matRef.cols())
+        return 1.0;
+    if(p_matRef.norm() == 0)
+        return p_matA.norm();
+    return (p_matA - p_matRef).norm() / p_matRef.norm();
+}
+
+
+//*************************************************************************************************************
+/**
+* Rewrites the samples [p_iFrom, p_iTo] of p_raw as a raw file with data buffers of the given type. The stored
+* values are the uncalibrated integers of the original 16 bit data, so every type holds them exactly.
+*/
+bool writeRaw(const QString &p_sFileName, FiffRawData &p_raw, fiff_int_t p_iType, fiff_int_t p_iFrom, fiff_int_t p_iTo)
+{
+    QFile t_fileOut(p_sFileName);
+    MatrixXd cals;
+    FiffStream::SPtr outfid = FiffStream::start_writing_raw(t_fileOut, p_raw.info, cals);
+    outfid->write_int(FIFF_FIRST_SAMPLE, &p_iFrom);
+
+    RowVectorXd t_vecInvCals = p_raw.cals.cwiseInverse();
+    MatrixXd data, times;
+    for(fiff_int_t first = p_iFrom; first <= p_iTo; first += WRITE_BUFFER_SIZE)
+    {
+        fiff_int_t last = qMin(first + WRITE_BUFFER_SIZE - 1, p_iTo);
+        if(!p_raw.read_raw_segment(data, times, first, last))
+            return false;
+
+        MatrixXi t_matValues(data.rows(), data.cols());
+        for(qint32 s = 0; s < data.cols(); ++s)
+            for(qint32 c = 0; c < data.rows(); ++c)
+                t_matValues(c, s) = qRound(t_vecInvCals[c] * data(c, s));
+
+        switch(p_iType)
+        {
+            case FIFFT_INT:
+                outfid->write_int(FIFF_DATA_BUFFER, t_matValues.data(), t_matValues.size());
+                break;
+            case FIFFT_FLOAT:
+            {
+                MatrixXf t_matFloat = t_matValues.cast<float>();
+                outfid->write_float(FIFF_DATA_BUFFER, t_matFloat.data(), t_matFloat.size());
+                break;
+            }
+            case FIFFT_DAU_PACK16:
+                //there is no writer for 16 bit buffers, the tag is put together as write_int does it
+                *outfid << (qint32)FIFF_DATA_BUFFER;
+                *outfid << (qint32)FIFFT_DAU_PACK16;
+                *outfid << (qint32)(2 * t_matValues.size());
+                *outfid << (qint32)FIFFV_NEXT_SEQ;
+                for(qint32 i = 0; i < t_matValues.size(); ++i)
+                    *outfid << (qint16)t_matValues.data()[i];
+                break;
+            default:
+                return false;
+        }
+    }
+    outfid->finish_writing_raw();
+
+    return true;
+}
+
+
+//*************************************************************************************************************
+/**
+* Reads the same segment through the file mapping of p_rawMap and tag by tag from p_rawTag.
+*/
+bool compare(FiffRawData &p_rawMap, FiffRawData &p_rawTag, const char* p_sFormat, const char* p_sCase, fiff_int_t p_iFrom, fiff_int_t p_iTo, const RowVectorXi &p_vecSel = defaultRowVectorXi)
+{
+    MatrixXd t_matMap, t_matTag, t_matTimesMap, t_matTimesTag;
+    if(!p_rawMap.read_raw_segment(t_matMap, t_matTimesMap, p_iFrom, p_iTo, p_vecSel) || !p_rawTag.read_raw_segment(t_matTag, t_matTimesTag, p_iFrom, p_iTo, p_vecSel))
+    {
+        printf("%-8s %-26s segment could not be read FAILED\n", p_sFormat, p_sCase);
+        return false;
+    }
+
+    double t_dError = relError(t_matMap, t_matTag);
+    bool t_bPassed = t_matMap.cols() == p_iTo - p_iFrom + 1 && t_dError < MAX_REL_ERROR && t_matTimesMap == t_matTimesTag;
+    printf("%-8s %-26s samples %6d ... %6d, %3d rows, error %10.3e %s\n", p_sFormat, p_sCase, p_iFrom, p_iTo, (int)t_matMap.rows(), t_dError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+/**
+* Compares the mapped and the tag by tag reads of a raw file for whole channel sets, picks and the projection,
+* on segments which start, end and lie within buffers and straddle buffer boundaries.
+*/
+bool testFormat(const QString &p_sFileName, const char* p_sFormat)
+{
+    QFile t_fileMap(p_sFileName);
+    FiffRawData t_rawMap(t_fileMap);
+
+    //the same bytes from a device which can't be mapped
+    QFile t_fileBytes(p_sFileName);
+    if(!t_fileBytes.open(QIODevice::ReadOnly))
+    {
+        printf("%-8s could not open %s FAILED\n", p_sFormat, p_sFileName.toUtf8().constData());
+        return false;
+    }
+    QByteArray t_bytes = t_fileBytes.readAll();
+    t_fileBytes.close();
+    QBuffer t_buffer(&t_bytes);
+    FiffRawData t_rawTag(t_buffer);
+
+    if(t_rawMap.isEmpty() || t_rawTag.isEmpty() || t_rawMap.rawdir.size() < 5)
+    {
+        printf("%-8s could not set up %s FAILED\n", p_sFormat, p_sFileName.toUtf8().constData());
+        return false;
+    }
+
+    const fiff_int_t f = t_rawMap.first_samp;
+    const fiff_int_t n = t_rawMap.rawdir[0].nsamp;
+    printf("%-8s %d buffers of %d samples, type %d\n", p_sFormat, t_rawMap.rawdir.size(), n, t_rawMap.rawdir[0].ent.type);
+
+    //every third channel in reversed order
+    RowVectorXi t_vecSel((t_rawMap.info.nchan + 2) / 3);
+    for(qint32 i = 0; i < t_vecSel.size(); ++i)
+        t_vecSel[i] = t_rawMap.info.nchan - 1 - 3 * i;
+
+    bool t_bPassed = true;
+    for(qint32 p = 0; p < 2; ++p)
+    {
+        const char* t_sProj = p == 0 ? "" : ", projection";
+        if(p == 1)
+        {
+            t_rawMap.info.make_projector(t_rawMap.proj);
+            t_rawTag.info.make_projector(t_rawTag.proj);
+        }
+
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("across buffers%1").arg(t_sProj).toLatin1().constData(), f + n / 3, f + 4 * n + n / 2);
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("within a buffer%1").arg(t_sProj).toLatin1().constData(), f + n + 1, f + 2 * n - 2);
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("whole buffers%1").arg(t_sProj).toLatin1().constData(), f + n, f + 3 * n - 1);
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("straddling%1").arg(t_sProj).toLatin1().constData(), f + 2 * n - 1, f + 2 * n);
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("first sample%1").arg(t_sProj).toLatin1().constData(), f, f);
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("picks%1").arg(t_sProj).toLatin1().constData(), f + n / 3, f + 4 * n + n / 2, t_vecSel);
+        t_bPassed &= compare(t_rawMap, t_rawTag, p_sFormat, QString("picks, last sample%1").arg(t_sProj).toLatin1().constData(), t_rawMap.last_samp, t_rawMap.last_samp, t_vecSel);
+    }
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+/**
+* The rewritten files hold the same values as the original -> the mapped reads of both must agree.
+*/
+bool testRewritten(FiffRawData &p_raw, const QString &p_sFileName, const char* p_sFormat)
+{
+    QFile t_file(p_sFileName);
+    FiffRawData t_raw(t_file);
+
+    MatrixXd t_matData, t_matRef, times;
+    if(t_raw.isEmpty() || !t_raw.read_raw_segment(t_matData, times) || !p_raw.read_raw_segment(t_matRef, times, t_raw.first_samp, t_raw.last_samp))
+    {
+        printf("%-8s %-26s FAILED\n", p_sFormat, "against the original");
+        return false;
+    }
+
+    double t_dError = relError(t_matData, t_matRef);
+    bool t_bPassed = t_dError < MAX_REL_ERROR;
+    printf("%-8s %-26s samples %6d ... %6d, %3d rows, error %10.3e %s\n", p_sFormat, "against the original", t_raw.first_samp, t_raw.last_samp, (int)t_matData.rows(), t_dError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+/**
+* Reads the whole recording in segments and returns the bytes of raw buffers decoded per second.
+*/
+double throughput(FiffRawData &p_raw)
+{
+    fiff_int_t t_iSegment = (fiff_int_t)(BENCHMARK_SEC * p_raw.info.sfreq);
+    MatrixXd data, times;
+
+    QElapsedTimer t_timer;
+    t_timer.start();
+    for(fiff_int_t first = p_raw.first_samp; first <= p_raw.last_samp; first += t_iSegment)
+        p_raw.read_raw_segment(data, times, first, qMin(first + t_iSegment - 1, p_raw.last_samp));
+    qint64 t_iNsecs = t_timer.nsecsElapsed();
+
+    qint64 t_iBytes = 0;
+    for(qint32 k = 0; k < p_raw.rawdir.size(); ++k)
+        if(p_raw.rawdir[k].ent.kind != -1)
+            t_iBytes += p_raw.rawdir[k].ent.size;
+
+    return t_iBytes / (t_iNsecs * 1e-9);
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QString t_sFileRaw("./MNE-sample-data/MEG/sample/sample_audvis_raw.fif");
+    QFile t_fileRaw(t_sFileRaw);
+    FiffRawData raw(t_fileRaw);
+    if(raw.isEmpty())
+    {
+        printf("Could not read the raw data!\n");
+        return 1;
+    }
+
+    //
+    //   The original 16 bit buffers
+    //
+    bool t_bPassed = testFormat(t_sFileRaw, "original");
+
+    //
+    //   The same values rewritten in the other buffer types
+    //
+    fiff_int_t t_iTo = raw.first_samp + (fiff_int_t)(SEGMENT_SEC * raw.info.sfreq) - 1;
+    const fiff_int_t t_iTypes[] = {FIFFT_DAU_PACK16, FIFFT_INT, FIFFT_FLOAT};
+    const char* t_sFormats[] = {"pack16", "int", "float"};
+    for(qint32 i = 0; i < 3; ++i)
+    {
+        QString t_sFileName = QDir::temp().filePath(QString("test_mne_raw_segment_%1_raw.fif").arg(t_sFormats[i]));
+        if(!writeRaw(t_sFileName, raw, t_iTypes[i], raw.first_samp, t_iTo))
+        {
+            printf("%-8s could not be written FAILED\n", t_sFormats[i]);
+            t_bPassed = false;
+            continue;
+        }
+        t_bPassed &= testRewritten(raw, t_sFileName, t_sFormats[i]);
+        t_bPassed &= testFormat(t_sFileName, t_sFormats[i]);
+        QFile::remove(t_sFileName);
+    }
+
+    //
+    //   Throughput of the whole recording, warm page cache
+    //
+    throughput(raw);
+    double t_dThroughput = throughput(raw);
+    printf("\nmapped reads %.2f GB/s of raw buffers", t_dThroughput * 1e-9);
+
+    //wall-clock timing depends on build and host, it only counts when asked for
+    if(a.arguments().contains("--benchmark"))
+    {
+        bool t_bFast = t_dThroughput > MIN_THROUGHPUT;
+        printf(" %s", t_bFast ? "ok" : "FAILED");
+        t_bPassed &= t_bFast;
+    }
+    printf("\n");
+
+    return t_bPassed ? 0 : 1;
+}
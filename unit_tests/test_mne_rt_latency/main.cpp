@@ -0,0 +1,267 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     October, 2014
+*
+* @section  LICENSE
+*
+* Copyright (C) 2014, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Measures connector-to-client delivery latency of mne_rt_server using the FiffSimulator connector.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <rtClient/rtcmdclient.h>
+#include <rtClient/rtdataclient.h>
+#include <fiff/fiff_constants.h>
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_tag.h>
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QThread>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace RTCLIENTLIB;
+using namespace FIFFLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MNE_RT_SET_TIMESTAMPS   3       /**< see mne_rt_server/mne_rt_commands.h */
+#define NUM_WARMUP_BUFFERS      50
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Methods
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* Monotonic clock [ns]; on one host it is the same clock mne_rt_server stamps its buffers with.
+*/
+static qint64 monotonicNsecs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//*************************************************************************************************************
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if(sorted.empty())
+        return 0.0;
+    size_t idx = (size_t)(p*(sorted.size()-1) + 0.5);
+    return sorted[idx];
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* Connects to a local mne_rt_server, activates the FiffSimulator connector, asks for time stamped raw buffers and
+* reports the delay between the connector handing a buffer to the server and this client having read it.
+* Without a running server or without the FiffSimulator connector the benchmark is skipped and returns 0.
+*
+* Usage: test_mne_rt_latency [number of buffers = 2000]
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    qint32 t_iNumBuffers = argc > 1 ? QString(argv[1]).toInt() : 2000;
+    if(t_iNumBuffers <= 0)
+        t_iNumBuffers = 2000;
+
+    //time stamps are only comparable on the same host
+    QString t_sHost("127.0.0.1");
+
+    //
+    // Connect command and data client
+    //
+    RtCmdClient t_cmdClient;
+    t_cmdClient.connectToHost(t_sHost);
+    if(!t_cmdClient.waitForConnected(1000))
+    {
+        //a benchmark, not a failure - the unit tests run on machines without a server
+        printf("mne_rt_server is not running on %s - skipped\n", t_sHost.toUtf8().constData());
+        return 0;
+    }
+
+    RtDataClient t_dataClient;
+    t_dataClient.connectToHost(t_sHost);
+    t_dataClient.waitForConnected();
+
+    qint32 t_iClientId = t_dataClient.getClientId();
+    t_dataClient.setClientAlias("latency");
+
+    t_cmdClient.requestCommands();
+
+    //
+    // Select the simulator
+    //
+    QMap<qint32, QString> t_qMapConnectors;
+    t_cmdClient.requestConnectors(t_qMapConnectors);
+    qint32 t_iSimulatorId = -1;
+    QMap<qint32, QString>::const_iterator it;
+    for(it = t_qMapConnectors.constBegin(); it != t_qMapConnectors.constEnd(); ++it)
+        if(it.value().compare("Fiff File Simulator") == 0)
+            t_iSimulatorId = it.key();
+
+    if(t_iSimulatorId == -1)
+    {
+        printf("FiffSimulator connector not available - skipped\n");
+        t_dataClient.disconnectFromHost();
+        t_cmdClient.disconnectFromHost();
+        return 0;
+    }
+    t_cmdClient["selcon"].pValues()[0].setValue(t_iSimulatorId);
+    t_cmdClient["selcon"].send();
+
+    //
+    // Ask for time stamps in front of each raw buffer
+    //
+    {
+        FiffStream t_fiffStream(&t_dataClient);
+        t_fiffStream.write_rt_command(MNE_RT_SET_TIMESTAMPS, QString("1"));
+        t_dataClient.flush();
+    }
+
+    t_cmdClient["measinfo"].pValues()[0].setValue(t_iClientId);
+    t_cmdClient["measinfo"].send();
+    FiffInfo::SPtr t_pFiffInfo = t_dataClient.readInfo();
+
+    t_cmdClient["start"].pValues()[0].setValue(t_iClientId);
+    t_cmdClient["start"].send();
+
+    //
+    // Receive
+    //
+    printf("Receiving %d buffers (%d warm up)...\n", t_iNumBuffers, NUM_WARMUP_BUFFERS);
+
+    std::vector<double> t_vecLatency;
+    std::vector<double> t_vecInterval;
+    t_vecLatency.reserve(t_iNumBuffers);
+    t_vecInterval.reserve(t_iNumBuffers);
+
+    FiffStream t_fiffStream(&t_dataClient);
+    qint64 t_iStamp = -1;
+    qint64 t_iLastArrival = -1;
+    qint32 t_iNumSamples = 0;
+    qint32 t_iReceived = 0;
+
+    while(t_iReceived < t_iNumBuffers + NUM_WARMUP_BUFFERS)
+    {
+        FiffTag::SPtr t_pTag;
+        FiffTag::read_rt_tag(&t_fiffStream, t_pTag);
+        qint64 t_iNow = monotonicNsecs();
+
+        if(t_pTag->kind == FIFF_MNE_RT_TIMESTAMP)
+        {
+            t_iStamp = *(qint64*)t_pTag->data();
+        }
+        else if(t_pTag->kind == FIFF_DATA_BUFFER)
+        {
+            ++t_iReceived;
+            t_iNumSamples = (t_pTag->size()/4)/t_pFiffInfo->nchan;
+
+            if(t_iReceived > NUM_WARMUP_BUFFERS && t_iStamp >= 0)
+            {
+                t_vecLatency.push_back((t_iNow - t_iStamp)/1000.0);
+                if(t_iLastArrival >= 0)
+                    t_vecInterval.push_back((t_iNow - t_iLastArrival)/1000.0);
+            }
+            t_iLastArrival = t_iNow;
+            t_iStamp = -1;
+        }
+    }
+
+    t_cmdClient["stop"].pValues()[0].setValue(t_iClientId);
+    t_cmdClient["stop"].send();
+
+    t_dataClient.disconnectFromHost();
+    t_cmdClient.disconnectFromHost();
+
+    //
+    // Report
+    //
+    if(t_vecLatency.empty())
+    {
+        printf("No time stamped buffers received, does mne_rt_server support MNE_RT_SET_TIMESTAMPS?\n");
+        return 1;
+    }
+
+    double t_dMean = 0.0;
+    for(size_t i = 0; i < t_vecLatency.size(); ++i)
+        t_dMean += t_vecLatency[i];
+    t_dMean /= t_vecLatency.size();
+
+    std::sort(t_vecLatency.begin(), t_vecLatency.end());
+    std::sort(t_vecInterval.begin(), t_vecInterval.end());
+
+    double t_dPeriod = 1e6*t_iNumSamples/t_pFiffInfo->sfreq;
+
+    printf("\n%d buffers, %d channels x %d samples (nominal period %.1f us)\n", (int)t_vecLatency.size(), t_pFiffInfo->nchan, t_iNumSamples, t_dPeriod);
+    printf("connector -> client latency [us]:\tmean %.1f\tmedian %.1f\tp99 %.1f\tmax %.1f\n",
+           t_dMean, percentile(t_vecLatency, 0.5), percentile(t_vecLatency, 0.99), t_vecLatency.back());
+    printf("inter arrival time [us]:\t\tmin %.1f\tmedian %.1f\tp99 %.1f\tmax %.1f\n",
+           t_vecInterval.empty() ? 0.0 : t_vecInterval.front(), percentile(t_vecInterval, 0.5), percentile(t_vecInterval, 0.99), t_vecInterval.empty() ? 0.0 : t_vecInterval.back());
+
+    return 0;
+}
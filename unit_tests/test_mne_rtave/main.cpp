@@ -0,0 +1,481 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Synthetic test of the real-time averaging (RtAve) against epochs cut out of the same samples.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_evoked.h>
+#include <rtInv/rtave.h>
+
+#include <stdio.h>
+#include <cstdlib>
+#include <algorithm>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+using namespace RTINVLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define N_DATA_CHANNELS 3
+#define BLOCK_SIZE      100
+#define PRE_STIM        20
+#define POST_STIM       50
+#define MAX_ERROR       1e-10
+#define TIMEOUT_MS      10000
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// TYPEDEFS
+//=============================================================================================================
+
+typedef QPair<qint64, QString> Trigger;     /**< Sample of the rising edge and expected evoked comment. */
+
+
+//*************************************************************************************************************
+
+/**
+* Evoked responses emitted by the averaging thread.
+*/
+struct EvokedList
+{
+    QMutex mutex;
+    QList<FiffEvoked::SPtr> evoked;
+};
+
+
+//*************************************************************************************************************
+
+FiffInfo::SPtr makeInfo(const QStringList &p_qListStimNames)
+{
+    FiffInfo::SPtr t_pInfo(new FiffInfo);
+    t_pInfo->sfreq = 1000.0f;
+
+    for(qint32 i = 0; i < N_DATA_CHANNELS + p_qListStimNames.size(); ++i)
+    {
+        FiffChInfo t_ch;
+        t_ch.scanno = i + 1;
+        t_ch.logno = i + 1;
+        if(i < N_DATA_CHANNELS)
+        {
+            t_ch.kind = FIFFV_MEG_CH;
+            t_ch.ch_name = QString("MEG %1").arg(i + 1, 4, 10, QChar('0'));
+        }
+        else
+        {
+            t_ch.kind = FIFFV_STIM_CH;
+            t_ch.ch_name = p_qListStimNames[i - N_DATA_CHANNELS];
+        }
+        t_pInfo->chs.append(t_ch);
+        t_pInfo->ch_names.append(t_ch.ch_name);
+    }
+    t_pInfo->nchan = t_pInfo->chs.size();
+
+    return t_pInfo;
+}
+
+
+//*************************************************************************************************************
+
+MatrixXd makeRaw(qint32 p_iSamples, qint32 p_iStimChannels)
+{
+    //the first channel holds the sample index, so a misaligned epoch can not pass as a correct one
+    MatrixXd t_matRaw = MatrixXd::Zero(N_DATA_CHANNELS + p_iStimChannels, p_iSamples);
+    t_matRaw.row(0) = RowVectorXd::LinSpaced(p_iSamples, 0, p_iSamples - 1);
+    t_matRaw.middleRows(1, N_DATA_CHANNELS - 1) = MatrixXd::Random(N_DATA_CHANNELS - 1, p_iSamples);
+    return t_matRaw;
+}
+
+
+//*************************************************************************************************************
+
+void setPulse(MatrixXd &p_matRaw, qint32 p_iStimChannel, qint64 p_iSample, qint32 p_iWidth, double p_dValue)
+{
+    p_matRaw.block(N_DATA_CHANNELS + p_iStimChannel, p_iSample, 1, p_iWidth).setConstant(p_dValue);
+}
+
+
+//*************************************************************************************************************
+
+QList<FiffEvoked::SPtr> runAverager(RtAve &p_rtAve, const MatrixXd &p_matRaw, qint32 p_iExpected)
+{
+    EvokedList t_list;
+    QMetaObject::Connection t_connection = QObject::connect(&p_rtAve, &RtAve::evokedStim, [&t_list](FiffEvoked::SPtr p_pEvoked) {
+        QMutexLocker locker(&t_list.mutex);
+        t_list.evoked.append(p_pEvoked);
+    });
+
+    p_rtAve.start();
+    for(qint32 i = 0; i + BLOCK_SIZE <= p_matRaw.cols(); i += BLOCK_SIZE)
+        p_rtAve.append(p_matRaw.middleCols(i, BLOCK_SIZE));
+
+    //wait for the expected responses, then a little longer to catch surplus ones
+    QElapsedTimer t_timer;
+    t_timer.start();
+    while(t_timer.elapsed() < TIMEOUT_MS)
+    {
+        {
+            QMutexLocker locker(&t_list.mutex);
+            if(t_list.evoked.size() >= p_iExpected)
+                break;
+        }
+        QThread::msleep(10);
+    }
+    QThread::msleep(200);
+
+    p_rtAve.stop();
+    p_rtAve.wait();
+    QObject::disconnect(t_connection);
+
+    return t_list.evoked;
+}
+
+
+//*************************************************************************************************************
+
+MatrixXd epoch(const MatrixXd &p_matRaw, qint64 p_iSample)
+{
+    return p_matRaw.middleCols(p_iSample - PRE_STIM, PRE_STIM + POST_STIM);
+}
+
+
+//*************************************************************************************************************
+
+void slidingReference(const MatrixXd &p_matRaw, const QList<Trigger> &p_qListTriggers, qint32 p_iNumAverages, QList<MatrixXd> &p_qListAve, QStringList &p_qListComments)
+{
+    //mean of the last p_iNumAverages epochs of each stimulus, once the window is filled
+    QMap<QString, QList<MatrixXd> > t_qMapEpochs;
+    for(qint32 i = 0; i < p_qListTriggers.size(); ++i)
+    {
+        QList<MatrixXd> &t_qListEpochs = t_qMapEpochs[p_qListTriggers[i].second];
+        t_qListEpochs.append(epoch(p_matRaw, p_qListTriggers[i].first));
+        if(t_qListEpochs.size() > p_iNumAverages)
+            t_qListEpochs.removeFirst();
+
+        if(t_qListEpochs.size() == p_iNumAverages)
+        {
+            MatrixXd t_matMean = MatrixXd::Zero(p_matRaw.rows(), PRE_STIM + POST_STIM);
+            for(qint32 k = 0; k < t_qListEpochs.size(); ++k)
+                t_matMean += t_qListEpochs[k];
+            p_qListAve.append(t_matMean / p_iNumAverages);
+            p_qListComments.append(p_qListTriggers[i].second);
+        }
+    }
+}
+
+
+//*************************************************************************************************************
+
+void exponentialReference(const MatrixXd &p_matRaw, const QList<Trigger> &p_qListTriggers, double p_dAlpha, QList<MatrixXd> &p_qListAve, QStringList &p_qListComments)
+{
+    //ave_1 = e_1, ave_k = ave_(k-1) + alpha*(e_k - ave_(k-1))
+    QMap<QString, MatrixXd> t_qMapAve;
+    for(qint32 i = 0; i < p_qListTriggers.size(); ++i)
+    {
+        MatrixXd t_matEpoch = epoch(p_matRaw, p_qListTriggers[i].first);
+        if(!t_qMapAve.contains(p_qListTriggers[i].second))
+            t_qMapAve.insert(p_qListTriggers[i].second, t_matEpoch);
+        else
+            t_qMapAve[p_qListTriggers[i].second] = (1.0 - p_dAlpha) * t_qMapAve[p_qListTriggers[i].second] + p_dAlpha * t_matEpoch;
+
+        p_qListAve.append(t_qMapAve[p_qListTriggers[i].second]);
+        p_qListComments.append(p_qListTriggers[i].second);
+    }
+}
+
+
+//*************************************************************************************************************
+
+bool compare(const char* p_sName, const QList<FiffEvoked::SPtr> &p_qListEvoked, const QList<MatrixXd> &p_qListAve, const QStringList &p_qListComments)
+{
+    bool t_bPassed = p_qListEvoked.size() == p_qListAve.size();
+    double t_dMaxError = 0.0;
+
+    for(qint32 i = 0; t_bPassed && i < p_qListEvoked.size(); ++i)
+    {
+        if(p_qListEvoked[i]->comment != p_qListComments[i] || p_qListEvoked[i]->data.cols() != p_qListAve[i].cols())
+        {
+            t_bPassed = false;
+            break;
+        }
+        t_dMaxError = qMax(t_dMaxError, (p_qListEvoked[i]->data - p_qListAve[i]).cwiseAbs().maxCoeff());
+    }
+    t_bPassed = t_bPassed && t_dMaxError < MAX_ERROR;
+
+    printf("%-32s %3d of %3d responses, max error %10.3e %s\n", p_sName, p_qListEvoked.size(), p_qListAve.size(), t_dMaxError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+
+bool testSliding(const char* p_sName, const QStringList &p_qListStimNames, const MatrixXd &p_matRaw, QList<Trigger> p_qListTriggers, qint32 p_iNumAverages)
+{
+    std::sort(p_qListTriggers.begin(), p_qListTriggers.end());
+
+    RtAve t_rtAve(p_iNumAverages, PRE_STIM, POST_STIM, makeInfo(p_qListStimNames));
+
+    QList<MatrixXd> t_qListAve;
+    QStringList t_qListComments;
+    slidingReference(p_matRaw, p_qListTriggers, p_iNumAverages, t_qListAve, t_qListComments);
+    QList<FiffEvoked::SPtr> t_qListEvoked = runAverager(t_rtAve, p_matRaw, t_qListAve.size());
+
+    bool t_bPassed = compare(p_sName, t_qListEvoked, t_qListAve, t_qListComments);
+    for(qint32 i = 0; i < t_qListEvoked.size(); ++i)
+        t_bPassed &= t_qListEvoked[i]->nave == p_iNumAverages;
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+
+bool testSlidingWindow()
+{
+    //more than two turns of the epoch ring, so the periodic rebuild of the running sum is covered as well
+    QList<Trigger> t_qListTriggers;
+    MatrixXd t_matRaw = makeRaw(28*BLOCK_SIZE, 1);
+    for(qint32 k = 0; k < 20; ++k)
+    {
+        t_qListTriggers.append(Trigger(60 + 137*k, QString("STI 001")));
+        setPulse(t_matRaw, 0, t_qListTriggers.last().first, 3, 1.0);
+    }
+
+    return testSliding("sliding window, last 4 epochs", QStringList() << "STI 001", t_matRaw, t_qListTriggers, 4);
+}
+
+
+//*************************************************************************************************************
+
+bool testExponential(double p_dAlpha)
+{
+    const qint32 t_iNumAverages = 4;
+    QList<Trigger> t_qListTriggers;
+    MatrixXd t_matRaw = makeRaw(28*BLOCK_SIZE, 1);
+    for(qint32 k = 0; k < 20; ++k)
+    {
+        t_qListTriggers.append(Trigger(60 + 137*k, QString("STI 001")));
+        setPulse(t_matRaw, 0, t_qListTriggers.last().first, 3, 1.0);
+    }
+
+    RtAve t_rtAve(t_iNumAverages, PRE_STIM, POST_STIM, makeInfo(QStringList() << "STI 001"));
+    t_rtAve.setAveragingMode(RtAve::Exponential, p_dAlpha);
+
+    //alpha 0 selects the default weight, which matches the noise reduction of the sliding window
+    double t_dAlpha = p_dAlpha > 0.0 ? p_dAlpha : 2.0/(t_iNumAverages + 1.0);
+
+    QList<MatrixXd> t_qListAve;
+    QStringList t_qListComments;
+    exponentialReference(t_matRaw, t_qListTriggers, t_dAlpha, t_qListAve, t_qListComments);
+    QList<FiffEvoked::SPtr> t_qListEvoked = runAverager(t_rtAve, t_matRaw, t_qListAve.size());
+
+    QString t_sName = QString("exponential, alpha %1").arg(t_dAlpha, 0, 'f', 2);
+    bool t_bPassed = compare(t_sName.toUtf8().constData(), t_qListEvoked, t_qListAve, t_qListComments);
+
+    //the effective number of averages grows with the epochs seen up to (2-alpha)/alpha
+    qint32 t_iSteadyNave = (qint32)((2.0 - t_dAlpha)/t_dAlpha + 0.5);
+    for(qint32 i = 0; i < t_qListEvoked.size(); ++i)
+        t_bPassed &= t_qListEvoked[i]->nave == qMin(i + 1, t_iSteadyNave);
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+
+bool testRisingEdges()
+{
+    //one epoch per average, so every response has to be the epoch at exactly the edge sample
+    QList<Trigger> t_qListTriggers;
+    MatrixXd t_matRaw = makeRaw(10*BLOCK_SIZE, 1);
+
+    setPulse(t_matRaw, 0, 25, 1, 1.0);
+    t_qListTriggers.append(Trigger(25, QString("STI 001")));
+
+    //a level held high triggers once
+    setPulse(t_matRaw, 0, 163, 40, 1.0);
+    t_qListTriggers.append(Trigger(163, QString("STI 001")));
+
+    //a single stim line does not retrigger on a change between two positive levels
+    setPulse(t_matRaw, 0, 301, 5, 1.0);
+    setPulse(t_matRaw, 0, 306, 5, 2.0);
+    t_qListTriggers.append(Trigger(301, QString("STI 001")));
+
+    setPulse(t_matRaw, 0, 488, 3, 7.0);
+    t_qListTriggers.append(Trigger(488, QString("STI 001")));
+
+    setPulse(t_matRaw, 0, 640, 2, 1.0);
+    t_qListTriggers.append(Trigger(640, QString("STI 001")));
+
+    return testSliding("rising edges", QStringList() << "STI 001", t_matRaw, t_qListTriggers, 1);
+}
+
+
+//*************************************************************************************************************
+
+bool testCompositeRouting()
+{
+    //STI 014 routes by trigger code, STI 001 next to it is averaged on its own
+    QList<Trigger> t_qListTriggers;
+    MatrixXd t_matRaw = makeRaw(10*BLOCK_SIZE, 2);
+
+    const qint32 t_iSamples[] = {40, 130, 220, 310, 410, 500, 590, 680};
+    const qint32 t_iCodes[] = {1, 2, 5, 2, 1, 2, 1, 5};
+    for(qint32 k = 0; k < 8; ++k)
+    {
+        setPulse(t_matRaw, 0, t_iSamples[k], 5, t_iCodes[k]);
+        t_qListTriggers.append(Trigger(t_iSamples[k], QString("STI 014:%1").arg(t_iCodes[k])));
+    }
+
+    //a composite channel triggers on a change between two codes, too
+    setPulse(t_matRaw, 0, 315, 5, 5.0);
+    t_qListTriggers.append(Trigger(315, QString("STI 014:5")));
+
+    const qint32 t_iLineSamples[] = {85, 265, 445};
+    for(qint32 k = 0; k < 3; ++k)
+    {
+        setPulse(t_matRaw, 1, t_iLineSamples[k], 3, 1.0);
+        t_qListTriggers.append(Trigger(t_iLineSamples[k], QString("STI 001")));
+    }
+
+    return testSliding("composite code routing", QStringList() << "STI 014" << "STI 001", t_matRaw, t_qListTriggers, 2);
+}
+
+
+//*************************************************************************************************************
+
+bool testOverlappingEpochs()
+{
+    //triggers every 30 samples, epochs are 70 samples long
+    QList<Trigger> t_qListTriggers;
+    MatrixXd t_matRaw = makeRaw(10*BLOCK_SIZE, 1);
+    for(qint64 t_iSample = 30; t_iSample + POST_STIM <= t_matRaw.cols(); t_iSample += 30)
+    {
+        setPulse(t_matRaw, 0, t_iSample, 2, 1.0);
+        t_qListTriggers.append(Trigger(t_iSample, QString("STI 001")));
+    }
+
+    return testSliding("overlapping epochs", QStringList() << "STI 001", t_matRaw, t_qListTriggers, 3);
+}
+
+
+//*************************************************************************************************************
+
+bool testBlockBoundaries()
+{
+    //edges on the last and first sample of a block and pulses which are still high when the next block starts
+    QList<Trigger> t_qListTriggers;
+    MatrixXd t_matRaw = makeRaw(10*BLOCK_SIZE, 1);
+
+    const qint32 t_iSamples[] = {99, 101, 200, 299, 399, 500, 598, 699, 800};
+    const qint32 t_iWidths[] = {1, 1, 1, 5, 1, 3, 10, 1, 1};
+    for(qint32 k = 0; k < 9; ++k)
+    {
+        setPulse(t_matRaw, 0, t_iSamples[k], t_iWidths[k], 1.0);
+        t_qListTriggers.append(Trigger(t_iSamples[k], QString("STI 001")));
+    }
+
+    return testSliding("triggers at block boundaries", QStringList() << "STI 001", t_matRaw, t_qListTriggers, 1);
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    std::srand(42);
+
+    bool t_bPassed = true;
+
+    t_bPassed &= testSlidingWindow();
+    t_bPassed &= testExponential(0.0);
+    t_bPassed &= testExponential(0.1);
+
+    t_bPassed &= testRisingEdges();
+    t_bPassed &= testCompositeRouting();
+    t_bPassed &= testOverlappingEpochs();
+    t_bPassed &= testBlockBoundaries();
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Test of the real-time covariance (RtCov) windows against a batch FiffCov of the same samples.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_cov.h>
+#include <rtInv/rtcov.h>
+
+#include <stdio.h>
+#include <cstdlib>
+#include <cmath>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+using namespace RTINVLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define N_CHANNELS      8
+#define BLOCK_SIZE      100
+#define N_BLOCKS        50
+#define MAX_SAMPLES     1000
+#define EMIT_INTERVAL   200
+#define TIMEOUT_MS      10000
+
+
+//*************************************************************************************************************
+
+/**
+* Covariances emitted by the estimation thread.
+*/
+struct CovList
+{
+    QMutex mutex;
+    QList<FiffCov::SPtr> cov;
+};
+
+
+//*************************************************************************************************************
+
+FiffInfo::SPtr makeInfo()
+{
+    FiffInfo::SPtr t_pInfo(new FiffInfo);
+    t_pInfo->sfreq = 1000.0f;
+
+    //EEG channels and a stim channel, which is not picked
+    for(qint32 i = 0; i <= N_CHANNELS; ++i)
+    {
+        FiffChInfo t_ch;
+        t_ch.scanno = i + 1;
+        t_ch.logno = i + 1;
+        t_ch.kind = i < N_CHANNELS ? FIFFV_EEG_CH : FIFFV_STIM_CH;
+        t_ch.ch_name = i < N_CHANNELS ? QString("EEG %1").arg(i + 1, 3, 10, QChar('0')) : QString("STI 014");
+        t_pInfo->chs.append(t_ch);
+        t_pInfo->ch_names.append(t_ch.ch_name);
+    }
+    t_pInfo->nchan = t_pInfo->chs.size();
+
+    return t_pInfo;
+}
+
+
+//*************************************************************************************************************
+
+QList<MatrixXd> makeBlocks(bool p_bArtifact)
+{
+    //correlated channels with a large offset, so the centering matters
+    MatrixXd t_matMix = MatrixXd::Random(N_CHANNELS, N_CHANNELS);
+    VectorXd t_vecOffset = VectorXd::LinSpaced(N_CHANNELS, 1000.0, 2000.0);
+
+    QList<MatrixXd> t_qListBlocks;
+    for(qint32 b = 0; b < N_BLOCKS; ++b)
+    {
+        MatrixXd t_matBlock = MatrixXd::Zero(N_CHANNELS + 1, BLOCK_SIZE);
+        t_matBlock.topRows(N_CHANNELS) = (t_matMix * MatrixXd::Random(N_CHANNELS, BLOCK_SIZE)).colwise() + t_vecOffset;
+
+        //an artifact which enters and leaves the sliding window - the downdate cancels almost all of the scatter
+        if(p_bArtifact && (b == 20 || b == 21))
+            t_matBlock.topRows(N_CHANNELS) *= 1e6;
+
+        t_qListBlocks.append(t_matBlock);
+    }
+    return t_qListBlocks;
+}
+
+
+//*************************************************************************************************************
+
+MatrixXd batchCovariance(const QList<MatrixXd> &p_qListBlocks, qint32 p_iFirst, qint32 p_iLast, const VectorXd &p_vecBlockWeights, double &p_dWeight)
+{
+    //weighted covariance of the data rows of the blocks [p_iFirst, p_iLast], normalized by the total weight - 1
+    MatrixXd t_matX(N_CHANNELS, (p_iLast - p_iFirst + 1)*BLOCK_SIZE);
+    VectorXd t_vecW(t_matX.cols());
+    for(qint32 b = p_iFirst; b <= p_iLast; ++b)
+    {
+        t_matX.middleCols((b - p_iFirst)*BLOCK_SIZE, BLOCK_SIZE) = p_qListBlocks[b].topRows(N_CHANNELS);
+        t_vecW.segment((b - p_iFirst)*BLOCK_SIZE, BLOCK_SIZE).setConstant(p_vecBlockWeights[b - p_iFirst]);
+    }
+
+    p_dWeight = t_vecW.sum();
+    VectorXd t_vecMean = t_matX * t_vecW / p_dWeight;
+    MatrixXd t_matCentered = t_matX.colwise() - t_vecMean;
+
+    return t_matCentered * t_vecW.asDiagonal() * t_matCentered.transpose() / (p_dWeight - 1.0);
+}
+
+
+//*************************************************************************************************************
+
+FiffCov::SPtr batchFiffCov(const MatrixXd &p_matCov, double p_dWeight, const FiffInfo::SPtr &p_pInfo)
+{
+    //same layout and regularization as the emitted covariance
+    FiffCov::SPtr t_pCov(new FiffCov());
+    t_pCov->data = MatrixXd::Zero(p_pInfo->nchan, p_pInfo->nchan);
+    t_pCov->data.topLeftCorner(N_CHANNELS, N_CHANNELS) = p_matCov;
+    t_pCov->kind = FIFFV_MNE_NOISE_COV;
+    t_pCov->diag = false;
+    t_pCov->dim = t_pCov->data.rows();
+    t_pCov->names = p_pInfo->ch_names;
+    t_pCov->projs = p_pInfo->projs;
+    t_pCov->bads = p_pInfo->bads;
+    t_pCov->nfree = (qint32)p_dWeight;
+
+    *t_pCov.data() = t_pCov->regularize(*p_pInfo, 0.05, 0.05, 0.1, true);
+
+    return t_pCov;
+}
+
+
+//*************************************************************************************************************
+
+QList<FiffCov::SPtr> reference(RtCov::WindowMode p_eMode, const QList<MatrixXd> &p_qListBlocks, const FiffInfo::SPtr &p_pInfo)
+{
+    //replays the emission rules of the estimation loop on whole blocks
+    QList<FiffCov::SPtr> t_qListCov;
+    double t_dWeight = 0.0;
+    qint32 t_iFirst = 0;
+    qint32 t_iSinceEmit = 0;
+    const qint32 t_iWindowBlocks = MAX_SAMPLES / BLOCK_SIZE;
+    const double t_dDecay = std::exp(-(double)BLOCK_SIZE/MAX_SAMPLES);
+
+    for(qint32 b = 0; b < p_qListBlocks.size(); ++b)
+    {
+        t_iSinceEmit += BLOCK_SIZE;
+        switch(p_eMode)
+        {
+            case RtCov::Tumbling:
+                //disjoint windows, emitted once more than the estimation samples arrived
+                if((b - t_iFirst + 1)*BLOCK_SIZE > MAX_SAMPLES)
+                {
+                    MatrixXd t_matCov = batchCovariance(p_qListBlocks, t_iFirst, b, VectorXd::Ones(b - t_iFirst + 1), t_dWeight);
+                    t_qListCov.append(batchFiffCov(t_matCov, t_dWeight, p_pInfo));
+                    t_iFirst = b + 1;
+                }
+                break;
+
+            case RtCov::Sliding:
+                //the latest estimation samples
+                if(b + 1 >= t_iWindowBlocks && t_iSinceEmit >= EMIT_INTERVAL)
+                {
+                    MatrixXd t_matCov = batchCovariance(p_qListBlocks, b - t_iWindowBlocks + 1, b, VectorXd::Ones(t_iWindowBlocks), t_dWeight);
+                    t_qListCov.append(batchFiffCov(t_matCov, t_dWeight, p_pInfo));
+                    t_iSinceEmit = 0;
+                }
+                break;
+
+            case RtCov::Exponential:
+                //all samples so far, every block decays by exp(-block/estimation samples)
+                if((b + 1)*BLOCK_SIZE >= MAX_SAMPLES && t_iSinceEmit >= EMIT_INTERVAL)
+                {
+                    VectorXd t_vecWeights(b + 1);
+                    for(qint32 k = 0; k <= b; ++k)
+                        t_vecWeights[k] = std::pow(t_dDecay, b - k);
+                    MatrixXd t_matCov = batchCovariance(p_qListBlocks, 0, b, t_vecWeights, t_dWeight);
+                    t_qListCov.append(batchFiffCov(t_matCov, t_dWeight, p_pInfo));
+                    t_iSinceEmit = 0;
+                }
+                break;
+        }
+    }
+    return t_qListCov;
+}
+
+
+//*************************************************************************************************************
+
+QList<FiffCov::SPtr> runEstimation(RtCov &p_rtCov, const QList<MatrixXd> &p_qListBlocks, qint32 p_iExpected)
+{
+    CovList t_list;
+    QMetaObject::Connection t_connection = QObject::connect(&p_rtCov, &RtCov::covCalculated, [&t_list](FiffCov::SPtr p_pCov) {
+        QMutexLocker locker(&t_list.mutex);
+        t_list.cov.append(p_pCov);
+    });
+
+    p_rtCov.start();
+    for(qint32 b = 0; b < p_qListBlocks.size(); ++b)
+        p_rtCov.append(p_qListBlocks[b]);
+
+    //wait for the expected covariances, then a little longer to catch surplus ones
+    QElapsedTimer t_timer;
+    t_timer.start();
+    while(t_timer.elapsed() < TIMEOUT_MS)
+    {
+        {
+            QMutexLocker locker(&t_list.mutex);
+            if(t_list.cov.size() >= p_iExpected)
+                break;
+        }
+        QThread::msleep(10);
+    }
+    QThread::msleep(200);
+
+    p_rtCov.stop();
+    p_rtCov.wait();
+    QObject::disconnect(t_connection);
+
+    return t_list.cov;
+}
+
+
+//*************************************************************************************************************
+
+bool testWindow(const char* p_sName, RtCov::WindowMode p_eMode, bool p_bFloat, bool p_bArtifact, double p_dMaxRelError)
+{
+    FiffInfo::SPtr t_pInfo = makeInfo();
+    QList<MatrixXd> t_qListBlocks = makeBlocks(p_bArtifact);
+
+    RtCov t_rtCov(MAX_SAMPLES, t_pInfo);
+    t_rtCov.setWindowMode(p_eMode, p_eMode == RtCov::Tumbling ? 0 : EMIT_INTERVAL);
+    t_rtCov.setFloatAccumulation(p_bFloat);
+
+    QList<FiffCov::SPtr> t_qListRef = reference(p_eMode, t_qListBlocks, t_pInfo);
+    QList<FiffCov::SPtr> t_qListCov = runEstimation(t_rtCov, t_qListBlocks, t_qListRef.size());
+
+    bool t_bPassed = t_qListCov.size() == t_qListRef.size();
+    double t_dMaxRelError = 0.0;
+    for(qint32 i = 0; t_bPassed && i < t_qListCov.size(); ++i)
+    {
+        if(t_qListCov[i]->nfree != t_qListRef[i]->nfree || t_qListCov[i]->data.rows() != t_qListRef[i]->data.rows())
+        {
+            t_bPassed = false;
+            break;
+        }
+        t_dMaxRelError = qMax(t_dMaxRelError, (t_qListCov[i]->data - t_qListRef[i]->data).norm() / t_qListRef[i]->data.norm());
+    }
+    t_bPassed = t_bPassed && t_dMaxRelError < p_dMaxRelError;
+
+    printf("%-36s %3d of %3d covariances, max rel. error %10.3e %s\n", p_sName, t_qListCov.size(), t_qListRef.size(), t_dMaxRelError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    std::srand(42);
+
+    bool t_bPassed = true;
+
+    t_bPassed &= testWindow("tumbling", RtCov::Tumbling, false, false, 1e-10);
+    t_bPassed &= testWindow("sliding", RtCov::Sliding, false, false, 1e-10);
+    t_bPassed &= testWindow("sliding, artifact leaves the window", RtCov::Sliding, false, true, 1e-10);
+    t_bPassed &= testWindow("exponential", RtCov::Exponential, false, false, 1e-10);
+    t_bPassed &= testWindow("sliding, float accumulation", RtCov::Sliding, true, false, 1e-4);
+    t_bPassed &= testWindow("exponential, float accumulation", RtCov::Exponential, true, false, 1e-4);
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Test of the real-time inverse operator (RtInvOp) against MNEInverseOperator::make_inverse_operator.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff_raw_data.h>
+#include <fiff/fiff_cov.h>
+#include <fs/label.h>
+#include <mne/mne_forwardsolution.h>
+#include <mne/mne_inverse_operator.h>
+#include <rtInv/rtinvop.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FSLIB;
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace RTINVLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MAX_REL_ERROR               1e-6
+#define MAX_REL_ERROR_RANDOMIZED    1e-5
+#define TIMEOUT_MS                  60000
+
+
+//*************************************************************************************************************
+
+/**
+* Inverse operators emitted by the RtInvOp thread.
+*/
+struct InvOpList
+{
+    QMutex mutex;
+    QList<MNEInverseOperator::SPtr> invOp;
+};
+
+
+//*************************************************************************************************************
+
+double relError(const MatrixXd &p_matA, const MatrixXd &p_matRef)
+{
+    if(p_matA.rows() != p_matRef.rows() || p_matA.cols() != p_matRef.cols())
+        return 1.0;
+    if(p_matRef.size() == 0)
+        return 0.0;
+    return (p_matA - p_matRef).norm() / p_matRef.norm();
+}
+
+
+//*************************************************************************************************************
+
+QList<MNEInverseOperator::SPtr> runInvOp(RtInvOp &p_rtInvOp, QList<FiffCov> &p_qListNoiseCov)
+{
+    InvOpList t_list;
+    QMetaObject::Connection t_connection = QObject::connect(&p_rtInvOp, &RtInvOp::invOperatorCalculated, [&t_list](MNEInverseOperator::SPtr p_pInvOp) {
+        QMutexLocker locker(&t_list.mutex);
+        t_list.invOp.append(p_pInvOp);
+    });
+
+    p_rtInvOp.start();
+
+    //one covariance at a time - a pending one would be superseded by the next; all but the first hit the cached forward
+    for(qint32 i = 0; i < p_qListNoiseCov.size(); ++i)
+    {
+        p_rtInvOp.appendNoiseCov(p_qListNoiseCov[i]);
+
+        QElapsedTimer t_timer;
+        t_timer.start();
+        while(t_timer.elapsed() < TIMEOUT_MS)
+        {
+            {
+                QMutexLocker locker(&t_list.mutex);
+                if(t_list.invOp.size() > i)
+                    break;
+            }
+            QThread::msleep(10);
+        }
+    }
+
+    p_rtInvOp.stop();
+    QObject::disconnect(t_connection);
+
+    return t_list.invOp;
+}
+
+
+//*************************************************************************************************************
+
+bool compare(const MNEInverseOperator &p_invOp, const MNEInverseOperator &p_invOpRef, float p_fLambda2, const char* p_sMethod, const char* p_sName, double p_dMaxRelError)
+{
+    QString t_sMethod(p_sMethod);
+    bool t_bDSPM = t_sMethod == "dSPM";
+    Label t_label;
+    QList<VectorXi> t_qListVertno;
+
+    MNEInverseOperator t_inv = p_invOp.prepare_inverse_operator(1, p_fLambda2, t_bDSPM);
+    MatrixXd t_matK;
+    SparseMatrix<double> t_noiseNorm;
+    if(!t_inv.assemble_kernel(t_label, t_sMethod, false, t_matK, t_noiseNorm, t_qListVertno))
+    {
+        printf("%-26s %-5s kernel could not be assembled!\n", p_sName, p_sMethod);
+        return false;
+    }
+
+    //
+    //   Reference: the full preparation and kernel assembly of the operator from make_inverse_operator
+    //
+    MNEInverseOperator t_invRef = p_invOpRef.prepare_inverse_operator(1, p_fLambda2, t_bDSPM);
+    MatrixXd t_matKRef;
+    SparseMatrix<double> t_noiseNormRef;
+    if(!t_invRef.assemble_kernel(t_label, t_sMethod, false, t_matKRef, t_noiseNormRef, t_qListVertno))
+    {
+        printf("%-26s %-5s reference kernel could not be assembled!\n", p_sName, p_sMethod);
+        return false;
+    }
+
+    double t_dKernelError = relError(t_matK, t_matKRef);
+
+    VectorXd t_vecNoiseNorm = t_noiseNorm.nonZeros() > 0 ? VectorXd(t_noiseNorm.diagonal()) : VectorXd();
+    VectorXd t_vecNoiseNormRef = t_noiseNormRef.nonZeros() > 0 ? VectorXd(t_noiseNormRef.diagonal()) : VectorXd();
+    double t_dNoiseNormError = relError(t_vecNoiseNorm, t_vecNoiseNormRef);
+
+    bool t_bPassed = t_dKernelError < p_dMaxRelError && t_dNoiseNormError < p_dMaxRelError;
+    printf("%-26s %-5s kernel error %10.3e, noise norm error %10.3e %s\n", p_sName, p_sMethod, t_dKernelError, t_dNoiseNormError, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile t_fileRaw("./MNE-sample-data/MEG/sample/sample_audvis_raw.fif");
+    QFile t_fileFwd("./MNE-sample-data/MEG/sample/sample_audvis-meg-eeg-oct-6-fwd.fif");
+    QFile t_fileCov("./MNE-sample-data/MEG/sample/sample_audvis-cov.fif");
+
+    //
+    //   Read the measurement info, the forward solution and the noise covariance
+    //
+    FiffRawData t_raw(t_fileRaw);
+    FiffInfo::SPtr t_pFiffInfo(new FiffInfo(t_raw.info));
+
+    MNEForwardSolution::SPtr t_pFwd(new MNEForwardSolution(t_fileFwd));
+    if(t_pFwd->isEmpty())
+    {
+        printf("Could not read the forward solution!\n");
+        return 1;
+    }
+
+    FiffCov t_noiseCov(t_fileCov);
+
+    //the second covariance reuses the cached forward quantities of the first
+    QList<FiffCov> t_qListNoiseCov;
+    t_qListNoiseCov << t_noiseCov << t_noiseCov.regularize(*t_pFiffInfo, 0.05, 0.05, 0.1, true);
+
+    //
+    //   References as RtInvOp did it before the cache: make_inverse_operator on the MEG forward
+    //
+    QList<MNEInverseOperator> t_qListInvOpRef;
+    for(qint32 i = 0; i < t_qListNoiseCov.size(); ++i)
+        t_qListInvOpRef << MNEInverseOperator(*t_pFiffInfo, t_pFwd->pick_types(true, false), t_qListNoiseCov[i], 0.2f, 0.8f);
+
+    //the randomized SVD is exact up to rounding when its rank covers the numerical rank of the whitened gain
+    qint32 t_iRank = 0;
+    for(qint32 i = 0; i < t_qListInvOpRef[0].sing.size(); ++i)
+        if(t_qListInvOpRef[0].sing[i] > 1e-10 * t_qListInvOpRef[0].sing.maxCoeff())
+            ++t_iRank;
+
+    const RtInvOp::SvdMethod t_eMethods[] = {RtInvOp::JacobiSvd, RtInvOp::GramSvd, RtInvOp::RandomizedSvd};
+    const char* t_sSvdNames[] = {"jacobi", "gram", "randomized"};
+    const double t_dMaxErrors[] = {MAX_REL_ERROR, MAX_REL_ERROR, MAX_REL_ERROR_RANDOMIZED};
+    const char* t_sMethods[] = {"MNE", "dSPM"};
+    const float t_fLambda2 = 1.0f/9.0f;
+
+    bool t_bPassed = true;
+    for(qint32 s = 0; s < 3; ++s)
+    {
+        RtInvOp t_rtInvOp(t_pFiffInfo, t_pFwd);
+        t_rtInvOp.setSvdMethod(t_eMethods[s], t_eMethods[s] == RtInvOp::RandomizedSvd ? t_iRank : 0);
+
+        QList<MNEInverseOperator::SPtr> t_qListInvOp = runInvOp(t_rtInvOp, t_qListNoiseCov);
+        if(t_qListInvOp.size() != t_qListNoiseCov.size())
+        {
+            printf("%-26s %d of %d inverse operators calculated FAILED\n", t_sSvdNames[s], t_qListInvOp.size(), t_qListNoiseCov.size());
+            t_bPassed = false;
+            continue;
+        }
+
+        for(qint32 i = 0; i < t_qListInvOp.size(); ++i)
+        {
+            QString t_sName = QString("%1 %2").arg(t_sSvdNames[s]).arg(i == 0 ? "(cache built)" : "(cache reused)");
+            for(qint32 m = 0; m < 2; ++m)
+                t_bPassed &= compare(*t_qListInvOp[i], t_qListInvOpRef[i], t_fLambda2, t_sMethods[m], t_sName.toLatin1().constData(), t_dMaxErrors[s]);
+        }
+    }
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Benchmark of the batched robust SSS of the RtSss plugin against the per sample reference.
+*
+*/
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <fiff/fiff.h>
+#include <rtsssalgo.h>
+
+#include <stdio.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace FIFFLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define BLOCK_SIZE      20      /**< Block size the plugin hands to RtSssAlgo::getSSSRR. */
+#define MAX_REL_ERROR   5e-3    /**< The re-weighting stops at a relative change of 1e-3. */
+
+
+//*************************************************************************************************************
+/**
+* Reference robust SSS, which runs the bi-square IRLS for one sample after the other with the explicit
+* inverses and index gathers getSSSRR used before it was batched.
+*/
+MatrixXd referenceRR(const MatrixXd &EqnIn, const MatrixXd &EqnARR, const MatrixXd &EqnA, const MatrixXd &EqnB)
+{
+    const qint32 NumBIn = EqnIn.cols();
+    const double ErrTolRel = 1e-3;
+    const double WeightThres = 1 - 1e-6;
+    const double RR_K3 = 3;
+    const double RR_K2 = 4.685;
+    const double RR_K1 = qSqrt(1-qSqrt(3)/2) * RR_K2;
+
+    MatrixXd EqnRRInv = (EqnARR.transpose() * EqnARR).inverse();
+    MatrixXd EqnInv = (EqnA.transpose() * EqnA).inverse();
+
+    MatrixXd SSSIn(EqnB.rows(), EqnB.cols());
+    MatrixXd sol_X, sol_X_old, eqn_Y, eqn_D, temp_M, temp_N, diagMat;
+    VectorXd eqn_err, weight_index, weight;
+
+    for(qint32 i = 0; i < EqnB.cols(); ++i)
+    {
+        sol_X = EqnRRInv * (EqnARR.transpose() * EqnB.col(i));
+        eqn_err = EqnARR * sol_X - EqnB.col(i);
+        double eqn_scale0 = stdev(eqn_err);
+        eqn_err = eqn_err.cwiseAbs() / eqn_scale0;
+
+        sol_X_old.setConstant(sol_X.rows(), sol_X.cols(), 1e30);
+        for(qint32 it = 0; it < 20 && (sol_X - sol_X_old).norm() / sol_X.norm() > ErrTolRel; ++it)
+        {
+            sol_X_old = sol_X;
+            weight = eigen_LTE(eqn_err,RR_K1).array() + eigen_AND(eigen_GT(eqn_err,RR_K1),eigen_LTE(eqn_err,RR_K2)).array() * (1 - ((eqn_err.array()-RR_K1).pow(2)) / pow(RR_K2-RR_K1,2) ).pow(2);
+            weight_index = eigen_LT_index(weight, WeightThres);
+
+            eqn_Y.resize(weight_index.size(), EqnARR.cols());
+            eqn_D.resize(weight_index.size(), 1);
+            for(qint32 k = 0; k < weight_index.size(); ++k)
+            {
+                eqn_Y.row(k) = EqnARR.row(weight_index(k));
+                eqn_D(k) = weight(weight_index(k)) - 1;
+            }
+            temp_M = EqnARR.transpose() * (weight.array() * EqnB.col(i).array()).matrix();
+            temp_N = EqnRRInv * eqn_Y.transpose();
+            diagMat = (1 / eqn_D.array()).matrix().asDiagonal();
+            sol_X = EqnRRInv * temp_M - temp_N * (diagMat + eqn_Y * temp_N).inverse() * (temp_N.transpose() * temp_M);
+
+            eqn_err = (EqnARR * sol_X - EqnB.col(i)).cwiseAbs();
+            double eqn_scale = qMin(eqn_scale0, RR_K3 * qSqrt((weight.array() * eqn_err.array() * eqn_err.array()).mean()));
+            eqn_err = eqn_err / eqn_scale;
+        }
+
+        eqn_Y.resize(weight_index.size(), EqnA.cols());
+        for(qint32 k = 0; k < weight_index.size(); ++k)
+            eqn_Y.row(k) = EqnA.row(weight_index(k));
+        temp_M = EqnA.transpose() * (weight.array() * EqnB.col(i).array()).matrix();
+        temp_N = EqnInv * eqn_Y.transpose();
+        diagMat = (1 / eqn_D.array()).matrix().asDiagonal();
+        sol_X = EqnInv * temp_M - temp_N * (diagMat + eqn_Y * temp_N).inverse() * (temp_N.transpose() * temp_M);
+
+        SSSIn.col(i) = EqnIn * sol_X.topRows(NumBIn);
+    }
+
+    return SSSIn;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QFile t_fileRaw("./MNE-sample-data/MEG/sample/sample_audvis_raw.fif");
+
+    //
+    //   Read the VectorView measurement info and one second worth of samples of the MEG channels
+    //
+    FiffRawData raw(t_fileRaw);
+    if(raw.info.nchan == 0)
+    {
+        printf("Could not read the raw data!\n");
+        return 1;
+    }
+
+    //one second at the sampling rate of the file, in whole blocks
+    qint32 t_iSamples = qMax((qint32)(raw.info.sfreq/BLOCK_SIZE), 1)*BLOCK_SIZE;
+
+    RowVectorXi picks = raw.info.pick_types(true, false, false);
+    MatrixXd data, times;
+    if(!raw.read_raw_segment(data, times, raw.first_samp, raw.first_samp + t_iSamples - 1, picks))
+    {
+        printf("Could not read the raw segment!\n");
+        return 1;
+    }
+
+    RtSssAlgo rsss;
+    rsss.setMEGInfo(FiffInfo::SPtr(new FiffInfo(raw.info)));
+    QList<int> expOrder;
+    expOrder << 5 << 4 << 8 << 4;
+    rsss.setSSSParameter(expOrder);
+
+    //  Remove bad channel signals, as RtSss::run does
+    qint32 nmegchan = rsss.getNumMEGChan();
+    VectorXi badch = rsss.getBadChan();
+    MatrixXd EqnB(rsss.getNumMEGChanUsed(), data.cols());
+    for(qint32 i = 0, k = 0; i < nmegchan; ++i)
+        if(badch(i) == 0)
+            EqnB.row(k++) = data.row(i);
+
+    printf("Robust SSS benchmark: %d channels x %d samples (%.3f s at %.1f Hz), blocks of %d samples, one thread\n\n", (int)EqnB.rows(), (int)EqnB.cols(), t_iSamples/raw.info.sfreq, raw.info.sfreq, BLOCK_SIZE);
+
+    QElapsedTimer t_timer;
+    t_timer.start();
+    rsss.buildLinearEqn();
+    printf("%-32s %10.2f ms\n", "build linear equation", t_timer.nsecsElapsed() * 1e-6);
+
+    //
+    //   Reference: per sample IRLS
+    //
+    QList<MatrixXd> LinEqn = rsss.getLinEqn();
+    MatrixXd SSSRef(EqnB.rows(), EqnB.cols());
+    t_timer.restart();
+    for(qint32 b = 0; b + BLOCK_SIZE <= EqnB.cols(); b += BLOCK_SIZE)
+        SSSRef.middleCols(b, BLOCK_SIZE) = referenceRR(LinEqn[0], LinEqn[2], LinEqn[3], EqnB.middleCols(b, BLOCK_SIZE));
+    printf("%-32s %10.2f ms\n", "reference per sample", t_timer.nsecsElapsed() * 1e-6);
+
+    //
+    //   Batched IRLS with the cached factors
+    //
+    MatrixXd SSSIn(EqnB.rows(), EqnB.cols());
+    t_timer.restart();
+    for(qint32 b = 0; b + BLOCK_SIZE <= EqnB.cols(); b += BLOCK_SIZE)
+        SSSIn.middleCols(b, BLOCK_SIZE) = rsss.getSSSRR(EqnB.middleCols(b, BLOCK_SIZE));
+    qint64 t_iNsecs = t_timer.nsecsElapsed();
+    printf("%-32s %10.2f ms\n", "batched", t_iNsecs * 1e-6);
+
+    double t_dRelError = (SSSIn - SSSRef).norm() / SSSRef.norm();
+    double t_dRealTime = t_iNsecs * 1e-9 / (t_iSamples / raw.info.sfreq);
+    bool t_bPassed = t_dRelError < MAX_REL_ERROR;
+
+    //wall-clock timing depends on build and host, it only counts when asked for
+    if(a.arguments().contains("--benchmark"))
+        t_bPassed &= t_dRealTime < 1.0;
+
+    printf("\nrelative error %10.3e, %.2f x real time at %.1f Hz %s\n", t_dRelError, t_dRealTime, raw.info.sfreq, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+//=============================================================================================================
+/**
+* @file     main.cpp
+* @author   Christoph Dinh <chdinh@nmr.mgh.harvard.edu>;
+*           Matti Hamalainen <msh@nmr.mgh.harvard.edu>
+* @version  1.0
+* @date     March, 2015
+*
+* @section  LICENSE
+*
+* Copyright (C) 2015, Christoph Dinh and Matti Hamalainen. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+* the following conditions are met:
+*     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+*       following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+*       the following disclaimer in the documentation and/or other materials provided with the distribution.
+*     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+*       to endorse or promote products derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+* PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+* NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*
+*
+* @brief    Regression test of the streaming Welch power spectral density estimator.
+*
+*/
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/welchpsd.h>
+
+#include <stdio.h>
+#include <math.h>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// Eigen
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QCoreApplication>
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace Eigen;
+using namespace UTILSLIB;
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define SFREQ           1000.0
+#define FFT_LENGTH      256
+#define NUM_SAMPLES     8192
+#define SINE_BIN        50
+
+
+//*************************************************************************************************************
+
+bool check(const char* p_sName, double p_dValue, double p_dExpected, double p_dTol)
+{
+    double t_dRelError = fabs(p_dValue - p_dExpected) / fabs(p_dExpected);
+    bool t_bPassed = t_dRelError < p_dTol;
+
+    printf("%-40s %14.6e expected %14.6e %s\n", p_sName, p_dValue, p_dExpected, t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed;
+}
+
+
+//*************************************************************************************************************
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+//=============================================================================================================
+/**
+* The function main marks the entry point of the program.
+* By default, main has the storage class extern.
+*
+* @param [in] argc (argument count) is an integer that indicates how many arguments were entered on the command line when the program was started.
+* @param [in] argv (argument vector) is an array of pointers to arrays of character objects. The array objects are null-terminated strings, representing the arguments that were entered on the command line when the program was started.
+* @return the value that was set to exit() (which is 0 if exit() is called via quit()).
+*/
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    //
+    //   Channel 0: sine on a bin with amplitude 2, channel 1: white noise with variance 1
+    //
+    const double t_dAmplitude = 2.0;
+    const double t_dFreq = SINE_BIN*SFREQ/FFT_LENGTH;
+
+    srand(42);
+    MatrixXd t_matData(2, NUM_SAMPLES);
+    for(qint32 n = 0; n < NUM_SAMPLES; ++n)
+    {
+        t_matData(0, n) = t_dAmplitude*sin(2.0*M_PI*t_dFreq*n/SFREQ + 0.3);
+        t_matData(1, n) = sqrt(3.0)*(2.0*rand()/RAND_MAX - 1.0);
+    }
+
+    printf("Welch PSD: %d samples at %.0f Hz, segments of %d samples\n\n", NUM_SAMPLES, SFREQ, FFT_LENGTH);
+
+    bool t_bPassed = true;
+
+    //
+    //   One-shot estimate over all segments
+    //
+    WelchPsd t_welchOneShot(2, FFT_LENGTH, SFREQ, 0);
+    qint32 t_iSegments = t_welchOneShot.append(t_matData);
+    t_bPassed &= check("segments with 50% overlap", t_iSegments, 2*NUM_SAMPLES/FFT_LENGTH - 1, 1e-12);
+
+    const MatrixXd &t_matPsd = t_welchOneShot.psd();
+    const double t_dBinWidth = SFREQ/FFT_LENGTH;
+
+    qint32 t_iPeak;
+    t_matPsd.row(0).maxCoeff(&t_iPeak);
+    t_bPassed &= check("sine peak bin", t_iPeak, SINE_BIN, 1e-12);
+    t_bPassed &= check("sine peak frequency [Hz]", t_welchOneShot.frequencies()[t_iPeak], t_dFreq, 1e-12);
+
+    //Parseval: the integrated one sided PSD is the mean square A^2/2
+    t_bPassed &= check("sine integrated power", t_matPsd.row(0).sum()*t_dBinWidth, t_dAmplitude*t_dAmplitude/2.0, 1e-6);
+
+    //white noise: flat one sided density 2 sigma^2 / fs
+    t_bPassed &= check("noise integrated power", t_matPsd.row(1).sum()*t_dBinWidth, 1.0, 0.05);
+    t_bPassed &= check("noise mean density", t_matPsd.row(1).segment(1, FFT_LENGTH/2 - 1).mean(), 2.0/SFREQ, 0.05);
+
+    //
+    //   Block-wise append must give the same estimate as the one-shot run
+    //
+    WelchPsd t_welchBlocks(2, FFT_LENGTH, SFREQ, 0);
+    const qint32 t_aBlockSizes[] = {100, 1, 37, 300, 64};
+    qint32 t_iBlockSegments = 0;
+    for(qint32 i = 0, t_iCol = 0; t_iCol < NUM_SAMPLES; ++i)
+    {
+        qint32 t_iNum = qMin(t_aBlockSizes[i % 5], NUM_SAMPLES - t_iCol);
+        t_iBlockSegments += t_welchBlocks.append(t_matData.middleCols(t_iCol, t_iNum));
+        t_iCol += t_iNum;
+    }
+    t_bPassed &= check("block-wise segments", t_iBlockSegments, t_iSegments, 1e-12);
+
+    double t_dRelError = (t_welchBlocks.psd() - t_matPsd).norm() / t_matPsd.norm();
+    printf("%-40s relative error %10.3e %s\n", "block-wise against one-shot", t_dRelError, t_dRelError < 1e-12 ? "ok" : "FAILED");
+    t_bPassed &= t_dRelError < 1e-12;
+
+    //
+    //   Hop of one block: after the first segment every block completes one segment
+    //
+    const qint32 t_iHop = 100;
+    WelchPsd t_welchHop(2, FFT_LENGTH, SFREQ, 0, t_iHop);
+    qint32 t_iHopSegments = 0;
+    bool t_bOnePerBlock = true;
+    for(qint32 t_iCol = 0; t_iCol + t_iHop <= NUM_SAMPLES; t_iCol += t_iHop)
+    {
+        qint32 t_iNum = t_welchHop.append(t_matData.middleCols(t_iCol, t_iHop));
+        if(t_iCol + t_iHop >= FFT_LENGTH)
+            t_bOnePerBlock &= t_iNum == 1;
+        t_iHopSegments += t_iNum;
+    }
+    printf("%-40s %s\n", "one segment per block with hop 100", t_bOnePerBlock ? "ok" : "FAILED");
+    t_bPassed &= t_bOnePerBlock;
+    t_bPassed &= check("segments with hop 100", t_iHopSegments, (NUM_SAMPLES/t_iHop*t_iHop - FFT_LENGTH)/t_iHop + 1, 1e-12);
+    t_bPassed &= check("sine integrated power, hop 100", t_welchHop.psd().row(0).sum()*t_dBinWidth, t_dAmplitude*t_dAmplitude/2.0, 1e-6);
+    t_bPassed &= check("noise mean density, hop 100", t_welchHop.psd().row(1).segment(1, FFT_LENGTH/2 - 1).mean(), 2.0/SFREQ, 0.05);
+
+    //the default hop is half the segment length
+    WelchPsd t_welchHalf(2, FFT_LENGTH, SFREQ, 0, FFT_LENGTH/2);
+    t_welchHalf.append(t_matData);
+    t_dRelError = (t_welchHalf.psd() - t_matPsd).norm() / t_matPsd.norm();
+    printf("%-40s relative error %10.3e %s\n", "explicit half hop against default", t_dRelError, t_dRelError < 1e-12 ? "ok" : "FAILED");
+    t_bPassed &= t_dRelError < 1e-12;
+
+    printf("\n%s\n", t_bPassed ? "ok" : "FAILED");
+
+    return t_bPassed ? 0 : 1;
+}
@@ -41,7 +41,23 @@ SUBDIRS += \
     test_mne_libs \
     test_mne_rt \
     mne_x_plugin_com \
-    test_mne_future
+    test_mne_future \
+    test_mne_buffer \
+    test_mne_rt_latency \
+    test_mne_float_inverse \
+    test_mne_kmeans \
+    test_mne_rtsss \
+    test_mne_filter \
+    test_mne_welchpsd \
+    test_mne_fixdict \
+    test_mne_kernel_cache \
+    test_mne_rapmusic \
+    test_mne_rtave \
+    test_mne_rtcov \
+    test_mne_hpifit \
+    test_mne_adaptivemp \
+    test_mne_rtinvop \
+    test_mne_raw_segment
 
 contains(MNECPP_CONFIG, withGui) {
     SUBDIRS += \